@@ -1,94 +1,130 @@
 // Class that calls an internal Windows API to acquire information about all handles held by all processes.
 
-// Need to define WIN32_NO_STATUS temporarily when including both Windows.h and ntstatus.h
-#define WIN32_NO_STATUS
-#include <Windows.h>
-#undef WIN32_NO_STATUS
-#include <ntstatus.h>
+#include "PlatformTypes.h"
 #include <sstream>
 #include <fstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
 #include "AllHandlesSystemwide.h"
+#include "StringUtils.h"
 #include "FileOutput.h"
-#include "HEX.h"
+#include "Utf8Writer.h"
 #include "SysErrorMessage.h"
+#include "Platform.h"
+#ifndef _WIN32
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 /// <summary>
 /// Acquire information about the current set of handles held by all processes
 /// </summary>
+/// <param name="platform">Input: the system whose handle table to acquire</param>
 /// <param name="sErrorInfo">Output: Information about any failures during acquisition</param>
 /// <returns>true if successful</returns>
-bool AllHandlesSystemwide::Update(std::wstring& sErrorInfo)
+bool AllHandlesSystemwide::Update(Platform& platform, std::wstring& sErrorInfo)
 {
     // Initialize output variable
     sErrorInfo.clear();
-    // Initialize memory buffer
-    Clear();
-
-    // Get pointer to NtQuerySystemInformation API in ntdll.dll
-    HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
-    if (nullptr == ntdll)
+    // Release any mapped snapshot or attached information, but keep the memory buffer from a previous Update call for reuse.
+    if (nullptr != m_pSnapshotHandleInfo)
     {
-        sErrorInfo = L"Couldn't get module ntdll.dll";
-        return false;
-    }
-    pfn_NtQuerySystemInformation_t NtQuerySystemInformation = (pfn_NtQuerySystemInformation_t)GetProcAddress(ntdll, "NtQuerySystemInformation");
-    if (nullptr == NtQuerySystemInformation)
-    {
-        sErrorInfo = L"Couldn't get function NtQuerySystemInformation";
-        return false;
+        Clear();
     }
+    m_ulCaptureTime = 0;
+    HandleTableProvider& handleTable = platform.HandleTable();
 
-    // First call: pass in the minimal-size buffer to get the required buffer size to retrieve all handle info.
-    // Smaller buffer than this and returns a value that doesn't help us.
-    byte dummyBuffer[sizeof(SYSTEM_HANDLE_INFORMATION_EX)] = { 0 };
     ULONG sysInfoLength = 0, returnLength = 0;
-    NTSTATUS ntStat = NtQuerySystemInformation(SystemExtendedHandleInformation, &dummyBuffer, sizeof(dummyBuffer), &returnLength);
-    // Problem if the API returns anything but STATUS_INFO_LENGTH_MISMATCH
-    if (STATUS_INFO_LENGTH_MISMATCH != ntStat)
+    NTSTATUS ntStat = STATUS_INFO_LENGTH_MISMATCH;
+    if (0 == m_ulLastRequiredLength)
     {
-        std::wstringstream strErrorInfo;
-        strErrorInfo << L"NtQuerySystemInformation first call failed: " << SysErrorMessageWithCode(ntStat, true);
-        sErrorInfo = strErrorInfo.str();
-        return false;
+        // First Update call: pass in the minimal-size buffer to get the required buffer size to retrieve all handle info.
+        // Smaller buffer than this and returns a value that doesn't help us.
+        BYTE dummyBuffer[sizeof(SYSTEM_HANDLE_INFORMATION_EX)] = { 0 };
+        ntStat = handleTable.QuerySystemHandleInformation(dummyBuffer, sizeof(dummyBuffer), &returnLength);
+        ++m_counters.nQueryCalls;
+        // Problem if the API returns anything but STATUS_INFO_LENGTH_MISMATCH, or success for a table small enough to fit
+        // the minimal buffer (e.g., Linux with no zombies), which is then queried again like any other.
+        if (STATUS_INFO_LENGTH_MISMATCH != ntStat && STATUS_SUCCESS != ntStat)
+        {
+            std::wstringstream strErrorInfo;
+            strErrorInfo << L"NtQuerySystemInformation first call failed: " << SysErrorMessageWithCode(ntStat, true);
+            sErrorInfo = strErrorInfo.str();
+            return false;
+        }
+        // Until any growth has been observed, allow 25% more than demanded in case more handles get opened 
+        // between that call and the next.
+        m_ulGrowthMargin = returnLength / 4;
+        ntStat = STATUS_INFO_LENGTH_MISMATCH;
+    }
+    else
+    {
+        // Subsequent Update calls: skip the size probe and predict the size from the previous successful call.
+        returnLength = m_ulLastRequiredLength;
     }
 
-    // Repeat in a loop until successful:
-    // Whatever the last API call said was necessary, allocate 25% more than that in case more handles get opened 
-    // between that call and the next.
+    // Repeat in a loop until successful
     while (STATUS_INFO_LENGTH_MISMATCH == ntStat)
     {
-        // Deallocate previous allocation.
-        Clear();
-
-        // 25% higher than last demanded
-        sysInfoLength = returnLength + (returnLength / 4);
-        // Unlikely to overflow, but check anyway
-        if (sysInfoLength < returnLength)
+        // Last demanded size plus the growth margin. Unlikely to overflow, but check anyway
+        const ULONGLONG ullTargetLength = ULONGLONG(returnLength) + m_ulGrowthMargin;
+        if (ullTargetLength > ULONG(-1))
         {
+            Clear();
             sErrorInfo = L"Unable to allocate memory: integer overflow";
             return false;
         }
-        // Allocate the memory
-        if (!m_Mem.Alloc(sysInfoLength, sErrorInfo))
+        sysInfoLength = ULONG(ullTargetLength);
+
+        // Reuse the buffer from the previous call if it's big enough (and not grossly oversized); otherwise reallocate.
+        if (m_Mem.Size() < sysInfoLength || m_Mem.Size() / 4 > sysInfoLength)
         {
-            return false;
+            if (!m_Mem.Alloc(sysInfoLength, sErrorInfo))
+            {
+                return false;
+            }
+            ++m_counters.nAllocations;
+            m_counters.nBytesAllocated += sysInfoLength;
         }
+        else
+        {
+            sysInfoLength = ULONG(m_Mem.Size());
+        }
+
         // Get extended information about handles, systemwide
-        ntStat = NtQuerySystemInformation(SystemExtendedHandleInformation, m_Mem.Get(), sysInfoLength, &returnLength);
+        const ULONG prevReturnLength = returnLength;
+        ntStat = handleTable.QuerySystemHandleInformation(m_Mem.Get(), sysInfoLength, &returnLength);
+        ++m_counters.nQueryCalls;
 
         switch (ntStat)
         {
         case STATUS_SUCCESS:
-            // Successful
+            // Successful. Learn from how much the table grew since the previous Update call.
+            if (0 != m_ulLastRequiredLength && returnLength > m_ulLastRequiredLength)
+                m_ulGrowthEstimate = (3 * m_ulGrowthEstimate + (returnLength - m_ulLastRequiredLength)) / 4;
+            else
+                m_ulGrowthEstimate = (3 * m_ulGrowthEstimate) / 4;
+            m_ulLastRequiredLength = returnLength;
+            // Margin for next time: twice the typical growth, but at least 1/32 of the current size.
+            m_ulGrowthMargin = std::max<ULONGLONG>(2 * m_ulGrowthEstimate, ULONGLONG(returnLength / 32));
+            m_ulCaptureTime = platform.Clock().Now();
             return true;
 
         case STATUS_INFO_LENGTH_MISMATCH:
-            // Not enough memory - try again based on new returnLength
+            // Not enough memory - the table grew faster than predicted. Widen the margin, at least to the observed shortfall,
+            // and try again based on new returnLength.
+            ++m_counters.nRetries;
+            m_ulGrowthMargin = std::max<ULONGLONG>(2 * m_ulGrowthMargin, ULONGLONG(returnLength > prevReturnLength ? returnLength - prevReturnLength : 0));
             break;
 
         default:
         {
             // Something went wrong. Fail out.
+            Clear();
             std::wstringstream strErrorInfo;
             strErrorInfo << L"NtQuerySystemInformation second call failed: " << SysErrorMessageWithCode(ntStat, true) << std::endl
                 << L"returnLength = " << returnLength << std::endl
@@ -103,6 +139,26 @@ bool AllHandlesSystemwide::Update(std::wstring& sErrorInfo)
     return true;
 }
 
+/// <summary>
+/// Clear the allocated memory structure and any mapped snapshot
+/// </summary>
+void AllHandlesSystemwide::Clear()
+{
+    m_Mem.Dealloc();
+    if (nullptr != m_pSnapshotView)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(m_pSnapshotView);
+#else
+        munmap(m_pSnapshotView, m_nSnapshotViewSize);
+#endif
+    }
+    m_pSnapshotView = nullptr;
+    m_nSnapshotViewSize = 0;
+    m_pSnapshotHandleInfo = nullptr;
+    m_ulCaptureTime = 0;
+}
+
 /// <summary>
 /// Returns the number of handles for which information was obtained by the last Update call.
 /// </summary>
@@ -138,22 +194,23 @@ const PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX AllHandlesSystemwide::HandleInfo(ULONG_
 /// <returns>true if successful</returns>
 bool AllHandlesSystemwide::Dump(const wchar_t* szOutFile, bool bAppend, std::wstring& sErrorInfo) const
 {
-    // Output file stream, optionally appending
-    std::wofstream fs;
-    if (!CreateFileOutput(szOutFile, fs, bAppend))
+    // Output file, optionally appending
+    Utf8Writer writer;
+    if (!writer.OpenFile(szOutFile, bAppend, sErrorInfo))
     {
         std::wstringstream strErrorInfo;
-        strErrorInfo << L"AllHandlesSystemwide::Dump to " << szOutFile << L" fails";
+        strErrorInfo << L"AllHandlesSystemwide::Dump to " << szOutFile << L" fails: " << sErrorInfo;
         sErrorInfo = strErrorInfo.str();
         return false;
     }
 
     // Tab-delimited headers
-    fs
+    writer
         << L"PID\t"
         << L"Handle\t"
         << L"ObjectTypeIndex\t"
-        << L"ObjectAddr" << std::endl;
+        << L"ObjectAddr";
+    writer.EndLine();
 
     const ULONG_PTR nHandles = NumberOfHandles();
     for (ULONG_PTR ix = 0; ix < nHandles; ++ix)
@@ -161,20 +218,303 @@ bool AllHandlesSystemwide::Dump(const wchar_t* szOutFile, bool bAppend, std::wst
         const PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX pInfo = HandleInfo(ix);
         if (nullptr != pInfo)
         {
-            fs
-                << pInfo->UniqueProcessId << L"\t"
-                << HEX(pInfo->HandleValue, 8, false, true) << L"\t"
-                << pInfo->ObjectTypeIndex << L"\t"
-                << pInfo->Object << std::endl;
+            writer << pInfo->UniqueProcessId << L'\t';
+            writer.WriteHex(pInfo->HandleValue, 8, false, true) << L'\t' << pInfo->ObjectTypeIndex << L'\t';
+            writer.WriteHex(ULONG_PTR(pInfo->Object), sizeof(PVOID) * 2, false, true).EndLine();
         }
         else
         {
-            fs << L"NULL" << std::endl;
+            (writer << L"NULL").EndLine();
+        }
+    }
+
+    // Close the file
+    if (!writer.Close())
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"AllHandlesSystemwide::Dump to " << szOutFile << L" fails: write error";
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Offline analysis and benchmarking: replaces any information from the last Update call with handle information in memory
+/// owned by the caller (e.g., a synthetic workload), used in place. The memory must remain valid and unchanged until
+/// this instance is destroyed or the next Update, LoadFromDump, LoadSnapshot, or Attach call.
+/// </summary>
+/// <param name="pHandleInfo">Input: handle information laid out as NtQuerySystemInformation returns it</param>
+/// <param name="ulCaptureTime">Input: time at which the information was acquired (FILETIME value); 0 if not known</param>
+void AllHandlesSystemwide::Attach(const SYSTEM_HANDLE_INFORMATION_EX* pHandleInfo, ULONGLONG ulCaptureTime)
+{
+    // Release any previous buffer or view
+    Clear();
+    m_pSnapshotHandleInfo = PSYSTEM_HANDLE_INFORMATION_EX(pHandleInfo);
+    m_ulCaptureTime = ulCaptureTime;
+}
+
+/// <summary>
+/// Offline analysis: replaces any information from the last Update call with handle information previously 
+/// written to a tab-delimited file by Dump.
+/// </summary>
+/// <param name="szInFile">Input: full path to input file</param>
+/// <param name="sErrorInfo">Output: Information about any errors on failure</param>
+/// <returns>true if successful</returns>
+bool AllHandlesSystemwide::LoadFromDump(const wchar_t* szInFile, std::wstring& sErrorInfo)
+{
+    // Initialize output variable
+    sErrorInfo.clear();
+    // Initialize memory buffer
+    Clear();
+
+    std::wifstream fs;
+    if (!OpenFileInput(szInFile, fs))
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"AllHandlesSystemwide::LoadFromDump from " << szInFile << L" fails";
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    // Read all the entries first so that the memory buffer can be allocated in one shot.
+    // Skip the header line; the rest are PID, Handle, ObjectTypeIndex, ObjectAddr.
+    std::vector<SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX> entries;
+    std::wstring sLine;
+    std::vector<std::wstring> fields;
+    size_t nLine = 0;
+    while (std::getline(fs, sLine))
+    {
+        if (0 == nLine++)
+            continue;
+        if (EndsWith(sLine, L'\r'))
+            sLine.pop_back();
+        SplitStringToVector(sLine, L'\t', fields);
+        if (fields.size() < 4)
+        {
+            // Dump writes "NULL" for an entry it couldn't retrieve; ignore those and any blank lines.
+            continue;
         }
+        SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX entry = { 0 };
+        entry.UniqueProcessId = ULONG_PTR(wcstoull(fields[0].c_str(), nullptr, 10));
+        entry.HandleValue = ULONG_PTR(wcstoull(fields[1].c_str(), nullptr, 16));
+        entry.ObjectTypeIndex = USHORT(wcstoul(fields[2].c_str(), nullptr, 10));
+        entry.Object = PVOID(ULONG_PTR(wcstoull(fields[3].c_str(), nullptr, 16)));
+        entries.push_back(entry);
     }
-    
-    // Close the file stream
     fs.close();
 
+    // Lay the entries out exactly as NtQuerySystemInformation would have.
+    const size_t nBytes = sizeof(SYSTEM_HANDLE_INFORMATION_EX) + entries.size() * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX);
+    if (!m_Mem.Alloc(nBytes, sErrorInfo))
+    {
+        return false;
+    }
+    PSYSTEM_HANDLE_INFORMATION_EX pHandleCollection = (PSYSTEM_HANDLE_INFORMATION_EX)m_Mem.Get();
+    pHandleCollection->NumberOfHandles = entries.size();
+    pHandleCollection->Reserved = 0;
+    if (entries.size() > 0)
+    {
+        memcpy(pHandleCollection->Handles, entries.data(), entries.size() * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX));
+    }
+
+    return true;
+}
+
+#ifdef _WIN32
+typedef HANDLE SnapshotFile_t;
+#else
+typedef FILE* SnapshotFile_t;
+#endif
+
+/// <summary>
+/// Internal helper: write a block of any size to a file with as few WriteFile calls as possible.
+/// </summary>
+static bool WriteAll(SnapshotFile_t hFile, const void* pData, size_t nBytes)
+{
+#ifndef _WIN32
+    return fwrite(pData, 1, nBytes, hFile) == nBytes;
+#else
+    const BYTE* pNext = (const BYTE*)pData;
+    while (nBytes > 0)
+    {
+        // WriteFile takes a DWORD length; write at most 1GB at a time.
+        const DWORD dwChunk = DWORD(std::min<size_t>(nBytes, 0x40000000));
+        DWORD dwWritten = 0;
+        if (!WriteFile(hFile, pNext, dwChunk, &dwWritten, nullptr) || dwWritten != dwChunk)
+            return false;
+        pNext += dwChunk;
+        nBytes -= dwChunk;
+    }
+    return true;
+#endif
+}
+
+/// <summary>
+/// Writes information acquired by last Update call to a binary snapshot file (see AllHandlesSnapshotHeader).
+/// Much faster and smaller than Dump's text output.
+/// </summary>
+/// <param name="szOutFile">Input: full path to output file; overwritten if it exists</param>
+/// <param name="sErrorInfo">Output: Information about any errors on failure</param>
+/// <returns>true if successful</returns>
+bool AllHandlesSystemwide::SaveSnapshot(const wchar_t* szOutFile, std::wstring& sErrorInfo) const
+{
+    const PSYSTEM_HANDLE_INFORMATION_EX pHandleCollection = Get();
+    if (nullptr == pHandleCollection)
+    {
+        sErrorInfo = L"AllHandlesSystemwide::SaveSnapshot: no handle information";
+        return false;
+    }
+    const ULONG_PTR nHandles = pHandleCollection->NumberOfHandles;
+
+    // The handle information starts on a 16-byte boundary following the header.
+    AllHandlesSnapshotHeader header = { 0 };
+    memcpy(header.Magic, AllHandlesSnapshotMagic, sizeof(header.Magic));
+    header.Version = AllHandlesSnapshotVersion;
+    header.HeaderSize = sizeof(AllHandlesSnapshotHeader);
+    header.EntrySize = sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX);
+    header.CaptureTime = m_ulCaptureTime;
+    header.NumberOfHandles = nHandles;
+    header.HandleInfoOffset = (sizeof(AllHandlesSnapshotHeader) + 15) & ~ULONGLONG(15);
+    header.HandleInfoSize = FIELD_OFFSET(SYSTEM_HANDLE_INFORMATION_EX, Handles) + nHandles * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX);
+
+#ifdef _WIN32
+    SnapshotFile_t hFile = CreateFileW(szOutFile, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (INVALID_HANDLE_VALUE == hFile)
+#else
+    SnapshotFile_t hFile = fopen(NarrowFilePath(szOutFile).c_str(), "wb");
+    if (nullptr == hFile)
+#endif
+    {
+        DWORD dwLastErr = GetLastError();
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"AllHandlesSystemwide::SaveSnapshot to " << szOutFile << L" fails: " << SysErrorMessageWithCode(dwLastErr);
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    // Header plus padding, then the whole handle table in one write.
+    const BYTE padding[16] = { 0 };
+    const bool bSuccess =
+        WriteAll(hFile, &header, sizeof(header)) &&
+        WriteAll(hFile, padding, size_t(header.HandleInfoOffset - sizeof(header))) &&
+        WriteAll(hFile, pHandleCollection, size_t(header.HandleInfoSize));
+    if (!bSuccess)
+    {
+        DWORD dwLastErr = GetLastError();
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"AllHandlesSystemwide::SaveSnapshot: writing " << szOutFile << L" fails: " << SysErrorMessageWithCode(dwLastErr);
+        sErrorInfo = strErrorInfo.str();
+    }
+#ifdef _WIN32
+    CloseHandle(hFile);
+#else
+    fclose(hFile);
+#endif
+
+    return bSuccess;
+}
+
+/// <summary>
+/// Offline analysis: replaces any information from the last Update call with a memory-mapped view of a binary snapshot file
+/// written by SaveSnapshot. The handle information is used in place, without parsing.
+/// </summary>
+/// <param name="szInFile">Input: full path to input file</param>
+/// <param name="sErrorInfo">Output: Information about any errors on failure</param>
+/// <returns>true if successful</returns>
+bool AllHandlesSystemwide::LoadSnapshot(const wchar_t* szInFile, std::wstring& sErrorInfo)
+{
+    // Initialize output variable
+    sErrorInfo.clear();
+    // Release any previous buffer or view
+    Clear();
+
+#ifdef _WIN32
+    HANDLE hFile = CreateFileW(szInFile, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (INVALID_HANDLE_VALUE == hFile)
+#else
+    const int fd = open(NarrowFilePath(szInFile).c_str(), O_RDONLY);
+    if (fd < 0)
+#endif
+    {
+        DWORD dwLastErr = GetLastError();
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"AllHandlesSystemwide::LoadSnapshot from " << szInFile << L" fails: " << SysErrorMessageWithCode(dwLastErr);
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+    // The view remains valid after the file and mapping handles are closed.
+#ifdef _WIN32
+    LARGE_INTEGER fileSize = { 0 };
+    GetFileSizeEx(hFile, &fileSize);
+    const ULONGLONG nFileSize = ULONGLONG(fileSize.QuadPart);
+    HANDLE hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (nullptr != hMapping)
+    {
+        m_pSnapshotView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(hMapping);
+    }
+    CloseHandle(hFile);
+#else
+    // (mmap can't map an empty file; an empty file fails validation below as not a snapshot anyway.)
+    struct stat st;
+    const ULONGLONG nFileSize = (0 == fstat(fd, &st)) ? ULONGLONG(st.st_size) : 0;
+    if (nFileSize > 0)
+    {
+        PVOID pView = mmap(nullptr, size_t(nFileSize), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (MAP_FAILED != pView)
+        {
+            m_pSnapshotView = pView;
+            m_nSnapshotViewSize = size_t(nFileSize);
+        }
+    }
+    close(fd);
+#endif
+    if (nullptr == m_pSnapshotView)
+    {
+        DWORD dwLastErr = GetLastError();
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"AllHandlesSystemwide::LoadSnapshot: mapping " << szInFile << L" fails: " << SysErrorMessageWithCode(dwLastErr);
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    // Validate the header and verify that everything it describes is within the file, without overflowing:
+    // the handle information is used in place, and its own NumberOfHandles field bounds every access to it.
+    const BYTE* pBase = (const BYTE*)m_pSnapshotView;
+    const AllHandlesSnapshotHeader* pHeader = (const AllHandlesSnapshotHeader*)pBase;
+    const ULONGLONG nHandlesHeaderSize = FIELD_OFFSET(SYSTEM_HANDLE_INFORMATION_EX, Handles);
+    const wchar_t* szProblem = nullptr;
+    if (nFileSize < sizeof(AllHandlesSnapshotHeader) || 0 != memcmp(pHeader->Magic, AllHandlesSnapshotMagic, sizeof(pHeader->Magic)))
+        szProblem = L"not a handle snapshot file";
+    else if (AllHandlesSnapshotVersion != pHeader->Version || sizeof(AllHandlesSnapshotHeader) != pHeader->HeaderSize)
+        szProblem = L"unsupported snapshot version";
+    else if (sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX) != pHeader->EntrySize)
+        szProblem = L"snapshot was written by a different architecture (x86 vs. x64)";
+    else if (0 != pHeader->HandleInfoOffset % 8 || pHeader->HandleInfoOffset < sizeof(AllHandlesSnapshotHeader))
+        szProblem = L"handle information is misplaced";
+    else if (
+        pHeader->HandleInfoOffset > nFileSize ||
+        pHeader->HandleInfoSize > nFileSize - pHeader->HandleInfoOffset ||
+        pHeader->HandleInfoSize < nHandlesHeaderSize ||
+        pHeader->NumberOfHandles > (pHeader->HandleInfoSize - nHandlesHeaderSize) / sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX) ||
+        pHeader->HandleInfoSize != nHandlesHeaderSize + pHeader->NumberOfHandles * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX)
+        )
+        szProblem = L"handle information is truncated";
+    else if (ULONGLONG(((const SYSTEM_HANDLE_INFORMATION_EX*)(pBase + pHeader->HandleInfoOffset))->NumberOfHandles) != pHeader->NumberOfHandles)
+        szProblem = L"handle count doesn't match the header";
+    if (nullptr != szProblem)
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"AllHandlesSystemwide::LoadSnapshot: " << szInFile << L": " << szProblem;
+        sErrorInfo = strErrorInfo.str();
+        Clear();
+        return false;
+    }
+
+    m_pSnapshotHandleInfo = (PSYSTEM_HANDLE_INFORMATION_EX)(pBase + pHeader->HandleInfoOffset);
+    m_ulCaptureTime = pHeader->CaptureTime;
+
     return true;
 }
@@ -0,0 +1,53 @@
+// Fixed-capacity table of PIDs that many threads can add to at once, without locks, each PID getting a slot number.
+
+#include "ConcurrentPidTable.h"
+
+/// <summary>
+/// Empties the table and makes room for up to nMaxPids distinct PIDs. Not thread-safe.
+/// </summary>
+void ConcurrentPidTable::Reset(size_t nMaxPids)
+{
+    // At most half full, so that probe sequences stay short
+    size_t nSlots = 16;
+    unsigned nShift = 64 - 4;
+    while (nSlots < nMaxPids * 2)
+    {
+        nSlots *= 2;
+        --nShift;
+    }
+    m_nSlots = nSlots;
+    m_nShift = nShift;
+
+    if (m_slots.size() < nSlots)
+    {
+        // (Atomics can't be copied or moved, so the vector can't be resized; replace it.)
+        std::vector<std::atomic<ULONG_PTR>> slots(nSlots);
+        m_slots.swap(slots);
+    }
+    for (size_t ixSlot = 0; ixSlot < nSlots; ++ixSlot)
+        m_slots[ixSlot].store(0, std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Returns the slot number of the PID, adding it to the table if it isn't there yet. Thread-safe and wait-free.
+/// </summary>
+/// <returns>true if successful; false if the table is full</returns>
+bool ConcurrentPidTable::Insert(ULONG_PTR pid, size_t& ixSlot)
+{
+    const ULONG_PTR key = pid + 1;
+    // Fibonacci hashing, as FlatIndexLookup does: PIDs are multiples of 4 on Windows.
+    size_t ix = size_t((ULONGLONG(pid) * 0x9E3779B97F4A7C15ull) >> m_nShift);
+    for (size_t nProbes = 0; nProbes < m_nSlots; ++nProbes, ix = (ix + 1) & (m_nSlots - 1))
+    {
+        ULONG_PTR current = m_slots[ix].load(std::memory_order_relaxed);
+        // Claim an empty slot. If another thread claims it first, current receives its PID, which might be this one.
+        if (0 == current && m_slots[ix].compare_exchange_strong(current, key, std::memory_order_relaxed))
+            current = key;
+        if (key == current)
+        {
+            ixSlot = ix;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+// Fixed-capacity table of PIDs that many threads can add to at once, without locks, each PID getting a slot number.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <vector>
+#include <atomic>
+
+/// <summary>
+/// Set of PIDs, each identified by the slot it occupies, that many threads can add to and look up concurrently.
+/// It's an open-addressing hash table whose slots are claimed with a compare-exchange: a thread never waits for another,
+/// and threads that look up the same PID (e.g., that of an owner holding most of the handles) only read the slot.
+/// Threads that need to aggregate per PID can tag their items with slot numbers, and then combine them by slot number
+/// without hashing, in whatever deterministic order they like.
+/// The capacity is fixed by Reset; PIDs can't be removed.
+/// </summary>
+class ConcurrentPidTable
+{
+public:
+    ConcurrentPidTable() = default;
+
+    /// <summary>
+    /// Empties the table and makes room for up to nMaxPids distinct PIDs. Not thread-safe.
+    /// The memory is kept for reuse, unless a larger table is needed.
+    /// </summary>
+    void Reset(size_t nMaxPids);
+
+    /// <summary>
+    /// Returns the slot number of the PID, adding it to the table if it isn't there yet.
+    /// Thread-safe and wait-free: at most Capacity() probes, each one load and at most one compare-exchange.
+    /// </summary>
+    /// <param name="pid">Input: PID to look up</param>
+    /// <param name="ixSlot">Output: the PID's slot number, less than Capacity(), if successful</param>
+    /// <returns>true if successful; false if more distinct PIDs were added than Reset made room for</returns>
+    bool Insert(ULONG_PTR pid, size_t& ixSlot);
+
+    /// <summary>
+    /// Number of slots. Slot numbers are less than this.
+    /// </summary>
+    size_t Capacity() const { return m_nSlots; }
+
+private:
+    // PID + 1 in each slot, so that PID 0 can be stored; 0 for an empty slot
+    std::vector<std::atomic<ULONG_PTR>> m_slots;
+    // Slots in use, a power of two; m_slots can be larger, from an earlier Reset
+    size_t m_nSlots = 0;
+    // Right shift that turns a 64-bit hash into a slot number
+    unsigned m_nShift = 64;
+
+private:
+    // Not implemented
+    ConcurrentPidTable(const ConcurrentPidTable&) = delete;
+    ConcurrentPidTable& operator = (const ConcurrentPidTable&) = delete;
+};
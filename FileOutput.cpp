@@ -1,7 +1,11 @@
 #include "FileOutput.h"
 #include <locale>
 #include <codecvt>
-#include <Windows.h>
+#include "PlatformTypes.h"
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 /// <summary>
 /// Ensure that output stream produces UTF-8 with optional BOM
@@ -12,56 +16,87 @@ void ImbueStreamUtf8(std::wostream& stream, bool bGenerateHeader)
     // Ensure that stream output is UTF-8.
     // Note that the heap-allocated std::codecvt_utf8 will eventually be deleted by the std::locale
     // it's initializing, so we MUST NOT match that "new" with a "delete" here.
+    std::locale loc(std::locale(), new std::codecvt_utf8<wchar_t, 0x10ffff>);
+    stream.imbue(loc);
+    // Write the BOM explicitly rather than with std::generate_header, which libstdc++ applies to every
+    // conversion (i.e., every flush) instead of only the first.
     if (bGenerateHeader)
     {
-        std::locale loc(std::locale(), new std::codecvt_utf8<wchar_t, 0x10ffff, std::generate_header>);
-        stream.imbue(loc);
-    }
-    else
-    {
-        std::locale loc(std::locale(), new std::codecvt_utf8<wchar_t, 0x10ffff>);
-        stream.imbue(loc);
+        stream << L'\xFEFF';
     }
 }
 
 
 /// <summary>
-/// Creates a output file stream for UTF-8 output with BOM.
+/// Opens an input file stream for reading UTF-8 text, such as the files written by Utf8Writer.
+/// A leading BOM, if present, is consumed.
 /// </summary>
-/// <param name="szFilename">Input: name of output file</param>
-/// <param name="fOutput">Output: resulting wofstream object</param>
-/// <param name="bAppend">Input: true to append to file, false to overwrite (default)</param>
+/// <param name="szFilename">Input: name of input file</param>
+/// <param name="fInput">Output: resulting wifstream object</param>
 /// <returns>true on success, false otherwise</returns>
-bool CreateFileOutput(const wchar_t* szFilename, std::wofstream & fOutput, bool bAppend /*= false*/)
+bool OpenFileInput(const wchar_t* szFilename, std::wifstream& fInput)
 {
-    // If appending and the file already exists and is more than 0 bytes in length, do not generate the BOM header.
-    // If it doesn't exist or is zero-length, append doesn't matter, so use that bool to determine whether to 
-    // generate the BOM.
-    if (bAppend)
-    {
-        WIN32_FILE_ATTRIBUTE_DATA data = { 0 };
-        if (GetFileAttributesExW(szFilename, GetFileExInfoStandard, &data))
-        {
-            if (0 == data.nFileSizeHigh && 0 == data.nFileSizeLow)
-            {
-                bAppend = false;
-            }
-        }
-        else
-        {
-            DWORD dwLastErr = GetLastError();
-            if (ERROR_FILE_NOT_FOUND == dwLastErr)
-            {
-                bAppend = false;
-            }
-        }
-    }
-    fOutput.open(szFilename, (bAppend ? (std::ios_base::out | std::ios_base::app) : std::ios_base::out));
-    if (fOutput.fail())
+#ifdef _WIN32
+    fInput.open(szFilename, std::ios_base::in);
+#else
+    fInput.open(NarrowFilePath(szFilename), std::ios_base::in);
+#endif
+    if (fInput.fail())
     {
         return false;
     }
-    // Ensure that file output is UTF-8. BOM unless appending to a non-empty existing file.
-    ImbueStreamUtf8(fOutput, !bAppend);
+    // As with ImbueStreamUtf8, the std::locale takes ownership of the heap-allocated codecvt.
+    std::locale loc(std::locale(), new std::codecvt_utf8<wchar_t, 0x10ffff, std::consume_header>);
+    fInput.imbue(loc);
     return true;
 }
+
+/// <summary>
+/// Returns true if the file or directory exists.
+/// </summary>
+bool FileExists(const wchar_t* szFilename)
+{
+#ifdef _WIN32
+    return INVALID_FILE_ATTRIBUTES != GetFileAttributesW(szFilename);
+#else
+    struct stat st;
+    return 0 == stat(NarrowFilePath(szFilename).c_str(), &st);
+#endif
+}
+
+/// <summary>
+/// Deletes the file. Returns true if successful.
+/// </summary>
+bool RemoveFile(const wchar_t* szFilename)
+{
+#ifdef _WIN32
+    return FALSE != DeleteFileW(szFilename);
+#else
+    return 0 == unlink(NarrowFilePath(szFilename).c_str());
+#endif
+}
+
+/// <summary>
+/// Returns true if the path exists and is a directory.
+/// </summary>
+bool DirectoryExists(const wchar_t* szPath)
+{
+#ifdef _WIN32
+    DWORD dwAttributes = GetFileAttributesW(szPath);
+    return INVALID_FILE_ATTRIBUTES != dwAttributes && 0 != (FILE_ATTRIBUTE_DIRECTORY & dwAttributes);
+#else
+    struct stat st;
+    return 0 == stat(NarrowFilePath(szPath).c_str(), &st) && S_ISDIR(st.st_mode);
+#endif
+}
+
+#ifndef _WIN32
+/// <summary>
+/// Converts a file path to the narrow (UTF-8) form that the non-Windows file APIs take.
+/// </summary>
+std::string NarrowFilePath(const wchar_t* szFilename)
+{
+    std::wstring_convert<std::codecvt_utf8<wchar_t>> converter;
+    return converter.to_bytes(szFilename);
+}
+#endif
@@ -11,10 +11,32 @@
 void ImbueStreamUtf8(std::wostream& stream, bool bGenerateHeader = true);
 
 /// <summary>
-/// Creates a output file stream for UTF-8 output with BOM.
+/// Opens an input file stream for reading UTF-8 text, such as the files written by Utf8Writer.
+/// A leading BOM, if present, is consumed.
 /// </summary>
-/// <param name="szFilename">Input: name of output file</param>
-/// <param name="fOutput">Output: resulting wofstream object</param>
-/// <param name="bAppend">Input: true to append to file, false to overwrite (default)</param>
+/// <param name="szFilename">Input: name of input file</param>
+/// <param name="fInput">Output: resulting wifstream object</param>
 /// <returns>true on success, false otherwise</returns>
-bool CreateFileOutput(const wchar_t* szFilename, std::wofstream& fOutput, bool bAppend = false);
+bool OpenFileInput(const wchar_t* szFilename, std::wifstream& fInput);
+
+/// <summary>
+/// Returns true if the file or directory exists.
+/// </summary>
+bool FileExists(const wchar_t* szFilename);
+
+/// <summary>
+/// Deletes the file. Returns true if successful.
+/// </summary>
+bool RemoveFile(const wchar_t* szFilename);
+
+/// <summary>
+/// Returns true if the path exists and is a directory.
+/// </summary>
+bool DirectoryExists(const wchar_t* szPath);
+
+#ifndef _WIN32
+/// <summary>
+/// Converts a file path to the narrow (UTF-8) form that the non-Windows file APIs take.
+/// </summary>
+std::string NarrowFilePath(const wchar_t* szFilename);
+#endif
@@ -0,0 +1,124 @@
+// Open-addressing hash lookup from a pointer-sized key (handle value, object address, PID) to a 32-bit record index.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <vector>
+#include <utility>
+
+/// <summary>
+/// Hash lookup from a pointer-sized key to the 32-bit index of a record in a contiguous store.
+/// The entries are kept in a vector in insertion order, which is also the iteration order. The hash table is a
+/// power-of-two array of 32-bit entry positions, probed linearly and kept at most half full. Unlike std::unordered_map,
+/// there's no allocation per entry, and a lookup touches one slot and one entry.
+/// Entries can be added and reassigned, but not removed.
+/// </summary>
+template <typename Key_t>
+class FlatIndexLookup
+{
+public:
+    typedef std::pair<Key_t, ULONG> value_type;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+    const_iterator begin() const { return m_entries.begin(); }
+    const_iterator end() const { return m_entries.end(); }
+
+    /// <summary>
+    /// Removes all entries. The table's memory is kept for reuse.
+    /// </summary>
+    void clear()
+    {
+        m_entries.clear();
+        m_slots.assign(m_slots.size(), 0);
+    }
+
+    /// <summary>
+    /// Sizes the table for nEntries entries, so that adding them doesn't rehash.
+    /// </summary>
+    void reserve(size_t nEntries)
+    {
+        m_entries.reserve(nEntries);
+        if (nEntries * 2 > m_slots.size())
+            Rehash(nEntries * 2);
+    }
+
+    /// <summary>
+    /// Returns the entry with the key, or end() if there isn't one.
+    /// </summary>
+    const_iterator find(Key_t key) const
+    {
+        if (!m_slots.empty())
+        {
+            for (size_t ixSlot = SlotOf(key); 0 != m_slots[ixSlot]; ixSlot = (ixSlot + 1) & (m_slots.size() - 1))
+            {
+                const size_t ixEntry = m_slots[ixSlot] - 1;
+                if (m_entries[ixEntry].first == key)
+                    return m_entries.begin() + ixEntry;
+            }
+        }
+        return m_entries.end();
+    }
+
+    /// <summary>
+    /// Returns the record index for the key, adding an entry (with index 0) if there isn't one.
+    /// </summary>
+    ULONG& operator[](Key_t key)
+    {
+        if ((m_entries.size() + 1) * 2 > m_slots.size())
+            Rehash((m_entries.size() + 1) * 2);
+
+        size_t ixSlot = SlotOf(key);
+        for (; 0 != m_slots[ixSlot]; ixSlot = (ixSlot + 1) & (m_slots.size() - 1))
+        {
+            value_type& entry = m_entries[m_slots[ixSlot] - 1];
+            if (entry.first == key)
+                return entry.second;
+        }
+        m_entries.push_back(value_type(key, 0));
+        m_slots[ixSlot] = ULONG(m_entries.size());
+        return m_entries.back().second;
+    }
+
+private:
+    /// <summary>
+    /// Slot at which the probe for the key starts: Fibonacci hashing, so that keys that differ only in their high bits
+    /// or that share their low bits (handle values are multiples of 4, object addresses are aligned) still spread out.
+    /// </summary>
+    size_t SlotOf(Key_t key) const
+    {
+        return size_t((ULONGLONG(ULONG_PTR(key)) * 0x9E3779B97F4A7C15ull) >> m_nShift);
+    }
+
+    /// <summary>
+    /// Replaces the table with one of at least nMinSlots slots (a power of two, at least 16) and reinserts the entries.
+    /// </summary>
+    void Rehash(size_t nMinSlots)
+    {
+        size_t nSlots = 16;
+        unsigned nShift = 64 - 4;
+        while (nSlots < nMinSlots)
+        {
+            nSlots *= 2;
+            --nShift;
+        }
+        m_nShift = nShift;
+        m_slots.assign(nSlots, 0);
+        for (size_t ixEntry = 0; ixEntry < m_entries.size(); ++ixEntry)
+        {
+            size_t ixSlot = SlotOf(m_entries[ixEntry].first);
+            while (0 != m_slots[ixSlot])
+                ixSlot = (ixSlot + 1) & (nSlots - 1);
+            m_slots[ixSlot] = ULONG(ixEntry + 1);
+        }
+    }
+
+private:
+    // Entries in insertion order
+    std::vector<value_type> m_entries;
+    // Hash table: 0 for an empty slot; otherwise, the position of the entry in m_entries plus 1
+    std::vector<ULONG> m_slots;
+    // Right shift that turns a 64-bit hash into a slot number
+    unsigned m_nShift = 64;
+};
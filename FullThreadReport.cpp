@@ -1,111 +1,105 @@
-// Need to define WIN32_NO_STATUS temporarily when including both Windows.h and ntstatus.h
-#define WIN32_NO_STATUS
-#include <Windows.h>
-#undef WIN32_NO_STATUS
-#include <ntstatus.h>
+#include "PlatformTypes.h"
 #include <iostream>
 #include <sstream>
-#include "NtInternal.h"
+#include <vector>
 #include "HEX.h"
 #include "SysErrorMessage.h"
+#include "Platform.h"
+#include "Utf8Writer.h"
+#include "WorkerPool.h"
 #include "FullThreadReport.h"
 
 /// <summary>
-/// Indicates whether the process or thread has exited.
+/// What the report shows about one process
 /// </summary>
-/// <param name="hProcessOrThread">Input: handle to a process or a thread</param>
-/// <param name="bHasExited">Output: if function is successful, true if process has exited, false otherwise; undefined if function fails</param>
-/// <returns>true if function succeeds, false otherwise</returns>
-static bool HasExited(HANDLE hProcessOrThread, bool& bHasExited)
+struct ProcessThreadRow
 {
-    DWORD dwLastErr = 0;
-    DWORD dwRet = WaitForSingleObject(hProcessOrThread, 0);
-    switch (dwRet)
+    ULONG_PTR PID = 0;
+    std::wstring sExeImagePath;
+    bool bProcessHasExited = false;
+    DWORD dwHandleCount = 0;
+    // Handle for thread enumeration, opened during process enumeration; nullptr if the process couldn't be opened
+    HANDLE hProcessQI = nullptr;
+    bool bThreadsCounted = false;
+    size_t nActiveThreads = 0, nExitedThreads = 0, nTotalThreads = 0;
+};
+
+/// <summary>
+/// Inspects each of a process' threads and counts how many are still running vs. exited, then releases the process handle.
+/// Called concurrently for different processes.
+/// </summary>
+static void CountThreads(Platform& platform, ProcessThreadRow& row)
+{
+    ThreadEnumerator& threads = platform.Threads();
+    HANDLE hPrevThread = nullptr, hThisThread = nullptr;
+    NTSTATUS ntGNT;
+    while (STATUS_SUCCESS == (ntGNT = threads.GetNextThread(row.hProcessQI, hPrevThread, true, hThisThread)))
     {
-    case WAIT_OBJECT_0:
-        bHasExited = true;
-        return true;
-    case WAIT_TIMEOUT:
-        bHasExited = false;
-        return true;
-    default:
-        dwLastErr = GetLastError();
-        return false;
+        row.nTotalThreads++;
+
+        if (nullptr != hPrevThread)
+            platform.ReleaseHandle(hPrevThread);
+        bool bThreadHasExited = false;
+        if (!platform.HasExited(hThisThread, bThreadHasExited))
+        {
+            //TODO: this shouldn't happen, but should be able to handle it if it does
+            // Total threads won't be equal to active + exited threads.
+            //std::wcerr << L"Unable to determine whether thread has exited" << std::endl;
+        }
+        else
+        {
+            if (bThreadHasExited)
+                row.nExitedThreads++;
+            else
+                row.nActiveThreads++;
+        }
+        hPrevThread = hThisThread;
     }
+
+    if (nullptr != hPrevThread)
+        platform.ReleaseHandle(hPrevThread);
+
+    platform.ReleaseHandle(row.hProcessQI);
+    row.hProcessQI = nullptr;
+    row.bThreadsCounted = true;
 }
 
 /// <summary>
 /// Lists all process objects on the system, indicating whether each has exited, how many active and exited thread objects 
 /// are associated with it, and its handle count.
+/// Processes are enumerated on the calling thread; their threads are inspected on a pool of workers, which is where
+/// nearly all the time goes on a system with many threads. Rows are written in enumeration order.
 /// </summary>
-/// <param name="pStream">Output: stream to write report to</param>
+/// <param name="platform">Input: the system to report on</param>
+/// <param name="pWriter">Output: writer to write report to; not flushed</param>
+/// <param name="nWorkers">Input: number of threads that inspect processes' threads; 0 for one per logical processor</param>
 /// <returns>true if successful, false otherwise.</returns>
-bool FullThreadReport(std::wostream* pStream)
+bool FullThreadReport(Platform& platform, Utf8Writer* pWriter, size_t nWorkers)
 {
-    // Acquire pointers to ntdll interfaces
-    HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
-    if (nullptr == ntdll)
-    {
-        std::wcerr << L"Couldn't get module ntdll.dll" << std::endl;
-        return false;
-    }
-    pfn_NtGetNextProcess_t NtGetNextProcess = (pfn_NtGetNextProcess_t)GetProcAddress(ntdll, "NtGetNextProcess");
-    pfn_NtGetNextThread_t NtGetNextThread = (pfn_NtGetNextThread_t)GetProcAddress(ntdll, "NtGetNextThread");
-    pfn_NtQueryInformationProcess_t NtQueryInformationProcess = (pfn_NtQueryInformationProcess_t)GetProcAddress(ntdll, "NtQueryInformationProcess");
-    if (NtGetNextProcess == nullptr || NtGetNextThread == nullptr || NtQueryInformationProcess == nullptr)
-    {
-        std::wcerr << L"ERROR: Unable to load functions from ntdll.dll" << std::endl;
-        return false;
-    }
+    ProcessEnumerator& processes = platform.Processes();
+    ThreadEnumerator& threads = platform.Threads();
 
     size_t nTotalProcesses = 0;
+    std::vector<ProcessThreadRow> rows;
 
-    *pStream
-        << L"PID\t"
-        << L"Exe image path\t"
-        << L"Exited\t"
-        << L"Active threads\t"
-        << L"Zombie threads\t"
-        << L"Total threads\t"
-        << L"Handle count"
-        << std::endl;
-
-    // Use NtGetNextProcess to iterate through all processes including those that have exited.
-    // Each call opens a new handle to the identified process.
+    // Iterate through all processes including those that have exited.
+    // Each call opens a new handle to the identified process, which can be waited on to determine whether it has exited.
     // Close handles as soon as we can - after using it to get the next process.
-    // Need to use PROCESS_QUERY_LIMITED_INFORMATION for the enumeration to include protected processes and other interesting processes.
-    // Using MAXIMUM_ALLOWED, or MAXIMUM_ALLOWED|PROCESS_QUERY_LIMITED_INFORMATION doesn't work. There's a never-going-to-be-fixed bug
-    // in Windows where trying to open a process with MAXIMUM_ALLOWED doesn't work if PROCESS_QUERY_LIMITED_INFORMATION is the only
-    // allowed permission - it needs to be requested explicitly.
-    // Note that NtGetNextThread requires a process handle with PROCESS_QUERY_INFORMATION, so we'll need to open a new process
-    // handle at that point.
     HANDLE hPrevProcess = nullptr, hThisProcess = nullptr;
     NTSTATUS ntGNP;
-    while (STATUS_SUCCESS == (ntGNP = NtGetNextProcess(hPrevProcess, PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, 0, 0, &hThisProcess)))
+    while (STATUS_SUCCESS == (ntGNP = processes.GetNextProcess(hPrevProcess, true, hThisProcess)))
     {
         // Close handles as soon as possible. Can't close hThisProcess until after we get the next process.
         if (nullptr != hPrevProcess)
         {
-            CloseHandle(hPrevProcess);
+            platform.ReleaseHandle(hPrevProcess);
         }
 
-        // Information to gather about each process
-        ULONG_PTR PID = 0;
-        std::wstring sExeImagePath;
-        bool bProcessHasExited = false;
-        size_t nActiveThreads = 0, nExitedThreads = 0, nTotalThreads = 0;
-        DWORD dwHandleCount = 0;
-
         nTotalProcesses++;
 
         // Acquire information about the process
-        PROCESS_EXTENDED_BASIC_INFORMATION processExtBasicInfo = { 0 };
-        processExtBasicInfo.Size = sizeof(processExtBasicInfo);
-        ULONG infoLen = ULONG(sizeof(processExtBasicInfo));
-#pragma warning(push)
-#pragma warning(disable:6001) // False positive: "Using uninitialized memory '*hThisProcess'"
-        NTSTATUS ntStat = NtQueryInformationProcess(hThisProcess, ProcessBasicInformation, &processExtBasicInfo, infoLen, &infoLen);
-#pragma warning(pop)
+        PlatformProcessBasicInfo basicInfo;
+        NTSTATUS ntStat = processes.QueryBasicInformation(hThisProcess, basicInfo);
         if (STATUS_SUCCESS != ntStat)
         {
             std::wcerr
@@ -114,94 +108,29 @@ bool FullThreadReport(std::wostream* pStream)
         }
         else
         {
-            PID = processExtBasicInfo.BasicInfo.UniqueProcessId;
-
-            // Get the process' image path. Need to use NtQueryInformationProcess because Win32 API won't work for
-            // a process that has exited.
-            // Buffer should be large enough - add extra for the UNICODE_STRING overhead.
-            byte buffer[MAX_PATH * sizeof(wchar_t) + sizeof(UNICODE_STRING)] = {0};
-            ULONG returnLength = 0;
-            ntStat = NtQueryInformationProcess(hThisProcess, ProcessImageFileName, buffer, MAX_PATH * sizeof(wchar_t), &returnLength);
-            if (STATUS_SUCCESS == ntStat)
-            {
-                const wchar_t* szExeImagePath = ((UNICODE_STRING*)buffer)->Buffer;
-                if (nullptr != szExeImagePath)
-                    sExeImagePath = szExeImagePath;
-            }
-            else
+            rows.push_back(ProcessThreadRow());
+            ProcessThreadRow& row = rows.back();
+            row.PID = basicInfo.PID;
+
+            // Get the process' image path (through its handle, which works for a process that has exited).
+            ntStat = processes.QueryImageFileName(hThisProcess, row.sExeImagePath);
+            if (STATUS_SUCCESS != ntStat)
             {
-                sExeImagePath = SysErrorMessageWithCode(ntStat, true);
+                row.sExeImagePath = SysErrorMessageWithCode(ntStat, true);
             }
 
             // Get the process' handle count
-            GetProcessHandleCount(hThisProcess, &dwHandleCount);
+            processes.GetHandleCount(hThisProcess, row.dwHandleCount);
 
-            if (!HasExited(hThisProcess, bProcessHasExited))
+            if (!platform.HasExited(hThisProcess, row.bProcessHasExited))
             {
                 //TODO: this shouldn't happen, but should be able to handle it if it does
                 //std::wcerr << L"Unable to determine whether process has exited" << std::endl;
             }
 
-            // Inspect each of this process' threads and count how many are still running vs. exited.
+            // Open the process for thread enumeration now, while the enumeration handle keeps its PID from being reused.
             // If we can't open the process for QueryInformation, we just won't be able to get thread counts for the process.
-#pragma warning(push)
-#pragma warning(disable:4244) // Nt vs. Win32 API issue: 'argument': conversion from 'ULONG_PTR' to 'DWORD', possible loss of data
-            HANDLE hProcessQI = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, PID);
-#pragma warning(pop)
-            if (nullptr != hProcessQI)
-            {
-                HANDLE hPrevThread = nullptr, hThisThread = nullptr;
-                NTSTATUS ntGNT;
-                while (STATUS_SUCCESS == (ntGNT = NtGetNextThread(hProcessQI, hPrevThread, THREAD_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, 0, 0, &hThisThread)))
-                {
-                    nTotalThreads++;
-
-                    if (nullptr != hPrevThread)
-                        CloseHandle(hPrevThread);
-                    bool bThreadHasExited = false;
-                    if (!HasExited(hThisThread, bThreadHasExited))
-                    {
-                        //TODO: this shouldn't happen, but should be able to handle it if it does
-                        // Total threads won't be equal to active + exited threads.
-                        //std::wcerr << L"Unable to determine whether thread has exited" << std::endl;
-                    }
-                    else
-                    {
-                        if (bThreadHasExited)
-                            nExitedThreads++;
-                        else
-                            nActiveThreads++;
-                    }
-                    hPrevThread = hThisThread;
-                }
-
-                if (nullptr != hPrevThread)
-                    CloseHandle(hPrevThread);
-
-                CloseHandle(hProcessQI);
-
-                *pStream
-                    << PID << L"\t"
-                    << sExeImagePath << L"\t"
-                    << (bProcessHasExited ? L"Yes" : L"No") << L"\t"
-                    << nActiveThreads << L"\t"
-                    << nExitedThreads << L"\t"
-                    << nTotalThreads << L"\t"
-                    << dwHandleCount
-                    << std::endl;
-            }
-            else
-            {
-                *pStream
-                    << PID << L"\t"
-                    << sExeImagePath << L"\t"
-                    << (bProcessHasExited ? L"Yes" : L"No") << L"\t"
-                    << L"-" << L"\t"
-                    << L"-" << L"\t"
-                    << L"-" << L"\t"
-                    << dwHandleCount
-                    << std::endl;
-            }
+            row.hProcessQI = threads.OpenProcessForThreads(row.PID);
         }
 
         // For next iteration
@@ -211,15 +140,56 @@ bool FullThreadReport(std::wostream* pStream)
     // Close the last process unless we saved it off
     if (nullptr != hPrevProcess)
     {
-        CloseHandle(hPrevProcess);
+        platform.ReleaseHandle(hPrevProcess);
     }
 
     // Report if terminating NTSTATUS value is other than STATUS_NO_MORE_ENTRIES
     if (STATUS_NO_MORE_ENTRIES != ntGNP)
     {
-        std::wcerr << L"Process enumeration failed: NtGetNextProcess returned " << HEX(ntGNP, 8, true, true) << L" after " << nTotalProcesses << L" iterations" << std::endl
+        std::wcerr << L"Process enumeration failed: GetNextProcess returned " << HEX(ntGNP, 8, true, true) << L" after " << nTotalProcesses << L" iterations" << std::endl
             << SysErrorMessage(ntGNP, true) << std::endl;
     }
 
+    // Count each process' threads. Thread counts vary widely between processes, so workers claim one process at a time.
+    RunDynamic(rows.size(), nWorkers,
+        [&](size_t ixRow)
+        {
+            if (nullptr != rows[ixRow].hProcessQI)
+                CountThreads(platform, rows[ixRow]);
+        });
+
+    (*pWriter
+        << L"PID\t"
+        << L"Exe image path\t"
+        << L"Exited\t"
+        << L"Active threads\t"
+        << L"Zombie threads\t"
+        << L"Total threads\t"
+        << L"Handle count"
+        ).EndLine();
+
+    for (std::vector<ProcessThreadRow>::const_iterator iter = rows.begin(); iter != rows.end(); ++iter)
+    {
+        *pWriter
+            << iter->PID << L"\t"
+            << iter->sExeImagePath << L"\t"
+            << (iter->bProcessHasExited ? L"Yes" : L"No") << L"\t";
+        if (iter->bThreadsCounted)
+        {
+            *pWriter
+                << iter->nActiveThreads << L"\t"
+                << iter->nExitedThreads << L"\t"
+                << iter->nTotalThreads << L"\t";
+        }
+        else
+        {
+            *pWriter
+                << L"-" << L"\t"
+                << L"-" << L"\t"
+                << L"-" << L"\t";
+        }
+        (*pWriter << iter->dwHandleCount).EndLine();
+    }
+
     return true;
 }
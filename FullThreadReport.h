@@ -1,11 +1,18 @@
 #pragma once
 
-#include <iostream>
+#include <cstddef>
+
+class Platform;
+class Utf8Writer;
 
 /// <summary>
 /// Lists all process objects on the system, indicating whether each has exited, how many active and exited thread objects 
 /// are associated with it, and its handle count.
+/// Processes are enumerated on the calling thread; their threads are inspected on a pool of workers. Rows are written
+/// in enumeration order, so the report doesn't depend on the number of workers.
 /// </summary>
-/// <param name="pStream">Output: stream to write report to</param>
+/// <param name="platform">Input: the system to report on</param>
+/// <param name="pWriter">Output: writer to write report to; not flushed</param>
+/// <param name="nWorkers">Input: number of threads that inspect processes' threads; 0 for one per logical processor</param>
 /// <returns>true if successful, false otherwise.</returns>
-bool FullThreadReport(std::wostream* pStream);
+bool FullThreadReport(Platform& platform, Utf8Writer* pWriter, size_t nWorkers = 0);
@@ -2,9 +2,11 @@
 // Class to manage a large heap allocation and automatically deallocate,
 // without raising exceptions on failure
 
-#include <Windows.h>
+#include "PlatformTypes.h"
 #include <sstream>
+#include <cstdlib>
 #include "SysErrorMessage.h"
+#include "RunStats.h"
 #include "HeapMem.h"
 
 /// <summary>
@@ -21,15 +23,21 @@ bool HeapMem::Alloc(size_t nBytes, std::wstring& sErrorInfo)
     // Deallocate any previously allocated memory
     if (!Dealloc(sErrorInfo))
         return false;
+#ifdef _WIN32
     // Get the process heap for the current process
     HANDLE hProcessHeap = ProcessHeap(sErrorInfo);
     if (nullptr == hProcessHeap)
         return false;
     // Allocate heap memory
     m_pMem = HeapAlloc(hProcessHeap, 0, nBytes);
+#else
+    m_pMem = malloc(nBytes);
+#endif
     if (nullptr != m_pMem)
     {
         m_nSize = nBytes;
+        StatsAddCount(StatsCounter_t::BufferAllocations);
+        StatsAddCount(StatsCounter_t::BytesAllocated, nBytes);
     }
     else
     {
@@ -52,12 +60,17 @@ bool HeapMem::Dealloc(std::wstring& sErrorInfo)
     sErrorInfo.clear();
     if (nullptr != m_pMem)
     {
+#ifdef _WIN32
         // Get the process heap for the current process
         HANDLE hProcessHeap = ProcessHeap(sErrorInfo);
         if (nullptr == hProcessHeap)
             return false;
         // Deallocate the memory, clear pointer
         BOOL ret = HeapFree(hProcessHeap, 0, m_pMem);
+#else
+        free(m_pMem);
+        BOOL ret = TRUE;
+#endif
         m_pMem = nullptr;
         m_nSize = 0;
         if (!ret)
@@ -82,6 +95,7 @@ bool HeapMem::Dealloc()
     return Dealloc(sUnused);
 }
 
+#ifdef _WIN32
 /// <summary>
 /// Returns a handle to the process heap, handling any error conditions
 /// Note that this is not a handle to a kernel/executive object; do not call CloseHandle on it.
@@ -101,4 +115,5 @@ HANDLE HeapMem::ProcessHeap(std::wstring& sErrorInfo)
     }
     return hProcessHeap;
 }
+#endif
 
@@ -2,6 +2,9 @@
 
 #pragma once
 
+#include "PlatformTypes.h"
+#include <string>
+
 /// <summary>
 /// Class to manage a large heap allocation and automatically deallocate,
 /// without raising exceptions on failure
@@ -47,6 +50,7 @@ public:
     size_t Size() const { return m_nSize; }
 
 private:
+#ifdef _WIN32
     /// <summary>
     /// Returns a handle to the process heap, handling any error conditions
     /// Note that this is not a handle to a kernel/executive object; do not call CloseHandle on it.
@@ -54,6 +58,7 @@ private:
     /// <param name="sErrorInfo">Output: information about any failure</param>
     /// <returns>Handle to process heap if successful; nullptr if unsuccessful</returns>
     HANDLE ProcessHeap(std::wstring& sErrorInfo);
+#endif
 
 private:
     // Pointer to memory buffer
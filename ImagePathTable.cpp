@@ -0,0 +1,94 @@
+// Table of interned executable image paths, so that the records of zombie processes and threads, which are copied
+// into several lookups and once per handle to them, carry a 32-bit identifier rather than their own strings.
+
+#include "PlatformTypes.h"
+#include "ImagePathTable.h"
+
+// An identifier's high bit is the generation its path is in; the rest, the path's index in that generation.
+static const ULONG GenerationBit = 0x80000000;
+static const ULONG PathIndexMask = GenerationBit - 1;
+
+/// <summary>
+/// Discards the generation's paths, leaving only the empty path.
+/// </summary>
+void ImagePathTable::Generation::Clear()
+{
+    paths.clear();
+    pathIds.clear();
+    paths.push_back(std::wstring());
+    pathIds.insert(std::make_pair(std::wstring(), ULONG(0)));
+}
+
+/// <summary>
+/// Begins a new generation in place of the one before the current one, discarding that generation's paths.
+/// </summary>
+void ImagePathTable::BeginGeneration()
+{
+    m_ixCurrent = 1 - m_ixCurrent;
+    m_generations[m_ixCurrent].Clear();
+}
+
+/// <summary>
+/// Discards the current generation and makes the previous one current again.
+/// </summary>
+void ImagePathTable::RevertGeneration()
+{
+    m_generations[m_ixCurrent].Clear();
+    m_ixCurrent = 1 - m_ixCurrent;
+}
+
+/// <summary>
+/// Returns the identifier of a path in the current generation, adding it if it isn't there yet.
+/// </summary>
+ImagePathId_t ImagePathTable::Intern(const std::wstring& sPath)
+{
+    if (sPath.empty())
+        return 0;
+
+    Generation& generation = m_generations[m_ixCurrent];
+    std::unordered_map<std::wstring, ULONG>::const_iterator iter = generation.pathIds.find(sPath);
+    ULONG ixPath;
+    if (generation.pathIds.end() != iter)
+    {
+        ixPath = iter->second;
+    }
+    else
+    {
+        ixPath = ULONG(generation.paths.size());
+        generation.paths.push_back(sPath);
+        generation.pathIds.insert(std::make_pair(sPath, ixPath));
+    }
+    return (0 != m_ixCurrent ? GenerationBit : 0) | ixPath;
+}
+
+/// <summary>
+/// Returns the identifier in the current generation of a path from the current or the previous generation.
+/// </summary>
+ImagePathId_t ImagePathTable::Renew(ImagePathId_t id)
+{
+    const bool bCurrent = (0 != (id & GenerationBit)) == (0 != m_ixCurrent);
+    if (bCurrent || 0 == (id & PathIndexMask))
+        return id;
+    // (The path is in the other generation, so interning it doesn't move it.)
+    return Intern(Path(id));
+}
+
+/// <summary>
+/// Returns the path with the identifier; the empty path if the identifier isn't valid.
+/// </summary>
+const std::wstring& ImagePathTable::Path(ImagePathId_t id) const
+{
+    const Generation& generation = m_generations[0 != (id & GenerationBit) ? 1 : 0];
+    const ULONG ixPath = id & PathIndexMask;
+    return (ixPath < generation.paths.size()) ? generation.paths[ixPath] : generation.paths[0];
+}
+
+/// <summary>
+/// Discards all paths.
+/// </summary>
+void ImagePathTable::Clear()
+{
+    m_generations[0].Clear();
+    m_generations[1].Clear();
+    m_ixCurrent = 0;
+}
@@ -0,0 +1,93 @@
+// Table of interned executable image paths, so that the records of zombie processes and threads, which are copied
+// into several lookups and once per handle to them, carry a 32-bit identifier rather than their own strings.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string>
+#include <deque>
+#include <unordered_map>
+
+/// <summary>
+/// Identifies an interned image path in an ImagePathTable. 0 is the empty path.
+/// </summary>
+typedef ULONG ImagePathId_t;
+
+/// <summary>
+/// Table of interned executable image paths.
+///
+/// Paths are kept in generations. Each ZombieOwners Update, Replay, or Analyze call begins a new generation in place of
+/// the generation before the current one, so that identifiers from the previous call (e.g., in a -watch sample being
+/// compared with the new one) stay valid through the next call, while storage stays bounded by two calls' paths.
+/// Identifiers kept longer than that (e.g., in ZombieProcessCache) must be renewed into the current generation.
+///
+/// Not thread-safe. Only the thread that drives the owning ZombieOwners instance interns paths and begins generations;
+/// WorkerPool workers never touch the table. Path doesn't modify the table, so lookups can be made from several threads
+/// at once while nothing is being interned.
+/// </summary>
+class ImagePathTable
+{
+public:
+    ImagePathTable() = default;
+    ~ImagePathTable() = default;
+
+    /// <summary>
+    /// Begins a new generation in place of the one before the current one, discarding that generation's paths.
+    /// Identifiers from the current generation remain valid until the next call.
+    /// </summary>
+    void BeginGeneration();
+
+    /// <summary>
+    /// Discards the current generation and makes the previous one current again; for a call that failed, so that the
+    /// identifiers from the last successful call remain valid through the next one. Identifiers from the discarded
+    /// generation must not be used again.
+    /// </summary>
+    void RevertGeneration();
+
+    /// <summary>
+    /// Returns the identifier of a path in the current generation, adding it if it isn't there yet.
+    /// </summary>
+    ImagePathId_t Intern(const std::wstring& sPath);
+
+    /// <summary>
+    /// Returns the identifier in the current generation of a path from the current or the previous generation.
+    /// </summary>
+    ImagePathId_t Renew(ImagePathId_t id);
+
+    /// <summary>
+    /// Returns the path with the identifier; the empty path if the identifier isn't valid. The reference remains valid
+    /// as long as the identifier does.
+    /// </summary>
+    const std::wstring& Path(ImagePathId_t id) const;
+
+    /// <summary>
+    /// Number of distinct paths in the current generation, including the empty path.
+    /// </summary>
+    size_t Count() const { return m_generations[m_ixCurrent].paths.size(); }
+
+    /// <summary>
+    /// Discards all paths.
+    /// </summary>
+    void Clear();
+
+private:
+    struct Generation
+    {
+        // The paths by index; a deque, so that references to them stay valid as paths are added.
+        // Index 0, the empty path, is always present.
+        std::deque<std::wstring> paths;
+        std::unordered_map<std::wstring, ULONG> pathIds;
+
+        Generation() { Clear(); }
+        void Clear();
+    };
+
+    // The current generation, and the previous one; an identifier's high bit selects the generation
+    Generation m_generations[2];
+    ULONG m_ixCurrent = 0;
+
+private:
+    // Not implemented
+    ImagePathTable(const ImagePathTable&) = delete;
+    ImagePathTable& operator = (const ImagePathTable&) = delete;
+};
@@ -1,9 +1,10 @@
 // Declarations for Windows interfaces and structures beyond what's in the SDK headers.
 // Some of these are documented but not all.
+// The handle table structures are also used on other operating systems, by the analysis code and snapshot files.
 
 #pragma once
 
-#include <winternl.h>
+#include "PlatformTypes.h"
 
 typedef struct _SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX
 {
@@ -24,6 +25,10 @@ typedef struct _SYSTEM_HANDLE_INFORMATION_EX
     SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX Handles[1];
 } SYSTEM_HANDLE_INFORMATION_EX, * PSYSTEM_HANDLE_INFORMATION_EX;
 
+#ifdef _WIN32
+
+#include <winternl.h>
+
 typedef NTSTATUS(NTAPI* pfn_NtQuerySystemInformation_t)(
     IN SYSTEM_INFORMATION_CLASS SystemInformationClass,
     OUT PVOID SystemInformation,
@@ -34,6 +39,61 @@ typedef NTSTATUS(NTAPI* pfn_NtQuerySystemInformation_t)(
 // Undocumented system information class enum value
 const SYSTEM_INFORMATION_CLASS SystemExtendedHandleInformation = SYSTEM_INFORMATION_CLASS(0x40);
 
+// The leading members of each entry that NtQuerySystemInformation(SystemProcessInformation) returns.
+// (winternl.h's SYSTEM_PROCESS_INFORMATION hides the creation time in a reserved field.)
+typedef struct _SYSTEM_PROCESS_INFORMATION_HEADER {
+    ULONG NextEntryOffset;
+    ULONG NumberOfThreads;
+    LARGE_INTEGER WorkingSetPrivateSize;
+    ULONG HardFaultCount;
+    ULONG NumberOfThreadsHighWatermark;
+    ULONGLONG CycleTime;
+    LARGE_INTEGER CreateTime;
+    LARGE_INTEGER UserTime;
+    LARGE_INTEGER KernelTime;
+    UNICODE_STRING ImageName;
+    KPRIORITY BasePriority;
+    HANDLE UniqueProcessId;
+    HANDLE InheritedFromUniqueProcessId;
+} SYSTEM_PROCESS_INFORMATION_HEADER, * PSYSTEM_PROCESS_INFORMATION_HEADER;
+
+typedef NTSTATUS(NTAPI* pfn_NtQueryObject_t)(
+    _In_opt_ HANDLE Handle,
+    _In_ OBJECT_INFORMATION_CLASS ObjectInformationClass,
+    _Out_opt_ PVOID ObjectInformation,
+    _In_ ULONG ObjectInformationLength,
+    _Out_opt_ PULONG ReturnLength
+    );
+
+// What NtQueryObject(ObjectTypeInformation) returns, followed by the type name.
+// (winternl.h's PUBLIC_OBJECT_TYPE_INFORMATION hides everything but the type name in a reserved field.)
+// TypeIndex is the index that the systemwide handle table reports as ObjectTypeIndex; Windows 8.1 and later. 0 before then.
+typedef struct _OBJECT_TYPE_INFORMATION_FULL {
+    UNICODE_STRING TypeName;
+    ULONG TotalNumberOfObjects;
+    ULONG TotalNumberOfHandles;
+    ULONG TotalPagedPoolUsage;
+    ULONG TotalNonPagedPoolUsage;
+    ULONG TotalNamePoolUsage;
+    ULONG TotalHandleTableUsage;
+    ULONG HighWaterNumberOfObjects;
+    ULONG HighWaterNumberOfHandles;
+    ULONG HighWaterPagedPoolUsage;
+    ULONG HighWaterNonPagedPoolUsage;
+    ULONG HighWaterNamePoolUsage;
+    ULONG HighWaterHandleTableUsage;
+    ULONG InvalidAttributes;
+    GENERIC_MAPPING GenericMapping;
+    ULONG ValidAccessMask;
+    BOOLEAN SecurityRequired;
+    BOOLEAN MaintainHandleCount;
+    UCHAR TypeIndex;
+    CHAR ReservedByte;
+    ULONG PoolType;
+    ULONG DefaultPagedPoolCharge;
+    ULONG DefaultNonPagedPoolCharge;
+} OBJECT_TYPE_INFORMATION_FULL, * POBJECT_TYPE_INFORMATION_FULL;
+
 typedef NTSTATUS(NTAPI* pfn_NtGetNextProcess_t)(
     _In_opt_ HANDLE ProcessHandle,
     _In_ ACCESS_MASK DesiredAccess,
@@ -95,3 +155,4 @@ typedef struct _PROCESS_EXTENDED_BASIC_INFORMATION {
 } PROCESS_EXTENDED_BASIC_INFORMATION, * PPROCESS_EXTENDED_BASIC_INFORMATION;
 #pragma warning (pop)
 
+#endif
@@ -0,0 +1,170 @@
+// Prefilter for the systemwide handle table: selects the entries that reference objects of particular types.
+
+#include <cstddef>
+#include "ObjectTypeFilter.h"
+
+// AVX2 is available to x86/x64 builds. Only the functions that use it are compiled for it (no /arch:AVX2 needed);
+// whether to call them is decided at run time.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define OBJECTTYPEFILTER_AVX2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+/// <summary>
+/// Selects the handle table entries whose ObjectTypeIndex is one of the input type indexes.
+/// Uses AVX2 if the processor supports it; scalar code otherwise. Both produce identical results.
+/// </summary>
+void FilterHandlesByObjectType(
+    const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries,
+    ULONG_PTR nEntries,
+    const USHORT* pTypeIndexes,
+    size_t nTypeIndexes,
+    HandleIndexList_t& indexes)
+{
+    if (!FilterHandlesByObjectType_AVX2(pEntries, nEntries, pTypeIndexes, nTypeIndexes, indexes))
+        FilterHandlesByObjectType_Scalar(pEntries, nEntries, pTypeIndexes, nTypeIndexes, indexes);
+}
+
+/// <summary>
+/// Scalar implementation of FilterHandlesByObjectType.
+/// </summary>
+void FilterHandlesByObjectType_Scalar(
+    const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries,
+    ULONG_PTR nEntries,
+    const USHORT* pTypeIndexes,
+    size_t nTypeIndexes,
+    HandleIndexList_t& indexes)
+{
+    indexes.clear();
+    for (ULONG_PTR ix = 0; ix < nEntries; ++ix)
+    {
+        const USHORT typeIndex = pEntries[ix].ObjectTypeIndex;
+        for (size_t ixType = 0; ixType < nTypeIndexes; ++ixType)
+        {
+            if (typeIndex == pTypeIndexes[ixType])
+            {
+                indexes.push_back(ix);
+                break;
+            }
+        }
+    }
+}
+
+#ifdef OBJECTTYPEFILTER_AVX2
+
+/// <summary>
+/// AVX2 loop of FilterHandlesByObjectType_AVX2: eight entries at a time.
+/// The entries are strided, so each group of eight ObjectTypeIndex values is collected with a gather of the
+/// 32-bit words that contain them, compared against each requested type index, and the matching lanes appended.
+/// </summary>
+AVX2_TARGET static ULONG_PTR FilterHandlesByObjectType_AVX2_Impl(
+    const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries,
+    ULONG_PTR nEntries,
+    const USHORT* pTypeIndexes,
+    size_t nTypeIndexes,
+    HandleIndexList_t& indexes)
+{
+    // ObjectTypeIndex is the high half of the 32-bit word that starts at CreatorBackTraceIndex.
+    const int nStride = int(sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX));
+    const size_t nWordOffset = offsetof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX, CreatorBackTraceIndex);
+    static_assert(offsetof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX, ObjectTypeIndex) == offsetof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX, CreatorBackTraceIndex) + 2,
+        "ObjectTypeIndex must immediately follow CreatorBackTraceIndex");
+    const __m256i vOffsets = _mm256_setr_epi32(0, nStride, 2 * nStride, 3 * nStride, 4 * nStride, 5 * nStride, 6 * nStride, 7 * nStride);
+    __m256i vTypes[MaxFilterObjectTypes];
+    for (size_t ixType = 0; ixType < nTypeIndexes; ++ixType)
+        vTypes[ixType] = _mm256_set1_epi32(int(pTypeIndexes[ixType]));
+
+    ULONG_PTR ix = 0;
+    for (; ix + 8 <= nEntries; ix += 8)
+    {
+        const int* pWords = reinterpret_cast<const int*>(reinterpret_cast<const char*>(pEntries + ix) + nWordOffset);
+        const __m256i vTypeIndexes = _mm256_srli_epi32(_mm256_i32gather_epi32(pWords, vOffsets, 1), 16);
+        __m256i vMatch = _mm256_cmpeq_epi32(vTypeIndexes, vTypes[0]);
+        for (size_t ixType = 1; ixType < nTypeIndexes; ++ixType)
+            vMatch = _mm256_or_si256(vMatch, _mm256_cmpeq_epi32(vTypeIndexes, vTypes[ixType]));
+        unsigned mask = unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(vMatch)));
+        while (0 != mask)
+        {
+            unsigned long lane = 0;
+#if defined(_MSC_VER)
+            _BitScanForward(&lane, mask);
+#else
+            lane = static_cast<unsigned long>(__builtin_ctz(mask));
+#endif
+            indexes.push_back(ix + lane);
+            mask &= mask - 1;
+        }
+    }
+    // Number of entries processed; the caller handles the remainder.
+    return ix;
+}
+
+#endif
+
+/// <summary>
+/// AVX2 implementation of FilterHandlesByObjectType. Returns false without doing anything if AVX2 isn't available.
+/// </summary>
+bool FilterHandlesByObjectType_AVX2(
+    const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries,
+    ULONG_PTR nEntries,
+    const USHORT* pTypeIndexes,
+    size_t nTypeIndexes,
+    HandleIndexList_t& indexes)
+{
+#ifdef OBJECTTYPEFILTER_AVX2
+    if (!Avx2Available() || 0 == nTypeIndexes || nTypeIndexes > MaxFilterObjectTypes)
+        return false;
+
+    indexes.clear();
+    const ULONG_PTR nProcessed = FilterHandlesByObjectType_AVX2_Impl(pEntries, nEntries, pTypeIndexes, nTypeIndexes, indexes);
+
+    // The last few entries
+    HandleIndexList_t tail;
+    FilterHandlesByObjectType_Scalar(pEntries + nProcessed, nEntries - nProcessed, pTypeIndexes, nTypeIndexes, tail);
+    for (HandleIndexList_t::const_iterator iter = tail.begin(); iter != tail.end(); ++iter)
+        indexes.push_back(nProcessed + *iter);
+    return true;
+#else
+    UNREFERENCED_PARAMETER(pEntries);
+    UNREFERENCED_PARAMETER(nEntries);
+    UNREFERENCED_PARAMETER(pTypeIndexes);
+    UNREFERENCED_PARAMETER(nTypeIndexes);
+    UNREFERENCED_PARAMETER(indexes);
+    return false;
+#endif
+}
+
+/// <summary>
+/// Returns true if the processor and operating system support AVX2.
+/// </summary>
+bool Avx2Available()
+{
+#ifdef OBJECTTYPEFILTER_AVX2
+    static const bool bAvailable = []()
+    {
+#if defined(_MSC_VER)
+        int cpuInfo[4] = { 0 };
+        __cpuid(cpuInfo, 0);
+        if (cpuInfo[0] < 7)
+            return false;
+        // OSXSAVE and AVX, and the OS saves the YMM registers on context switches
+        __cpuid(cpuInfo, 1);
+        if (0 == (cpuInfo[2] & (1 << 27)) || 0 == (cpuInfo[2] & (1 << 28)) || 6 != (_xgetbv(0) & 6))
+            return false;
+        __cpuidex(cpuInfo, 7, 0);
+        return 0 != (cpuInfo[1] & (1 << 5));
+#else
+        return 0 != __builtin_cpu_supports("avx2");
+#endif
+    }();
+    return bAvailable;
+#else
+    return false;
+#endif
+}
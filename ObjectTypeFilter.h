@@ -0,0 +1,58 @@
+// Prefilter for the systemwide handle table: selects the entries that reference objects of particular types.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <vector>
+#include "NtInternal.h"
+
+/// <summary>
+/// List of indexes into the handle table, in ascending order.
+/// </summary>
+typedef std::vector<ULONG_PTR> HandleIndexList_t;
+
+/// <summary>
+/// Maximum number of distinct object type indexes that FilterHandlesByObjectType accepts.
+/// </summary>
+const size_t MaxFilterObjectTypes = 4;
+
+/// <summary>
+/// Selects the handle table entries whose ObjectTypeIndex is one of the input type indexes.
+/// Uses AVX2 if the processor supports it; scalar code otherwise. Both produce identical results.
+/// </summary>
+/// <param name="pEntries">Input: handle table entries</param>
+/// <param name="nEntries">Input: number of handle table entries</param>
+/// <param name="pTypeIndexes">Input: object type indexes to select</param>
+/// <param name="nTypeIndexes">Input: number of object type indexes; 1 to MaxFilterObjectTypes</param>
+/// <param name="indexes">Output: indexes (relative to pEntries) of the selected entries, in ascending order</param>
+void FilterHandlesByObjectType(
+    const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries,
+    ULONG_PTR nEntries,
+    const USHORT* pTypeIndexes,
+    size_t nTypeIndexes,
+    HandleIndexList_t& indexes);
+
+/// <summary>
+/// Scalar implementation of FilterHandlesByObjectType.
+/// </summary>
+void FilterHandlesByObjectType_Scalar(
+    const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries,
+    ULONG_PTR nEntries,
+    const USHORT* pTypeIndexes,
+    size_t nTypeIndexes,
+    HandleIndexList_t& indexes);
+
+/// <summary>
+/// AVX2 implementation of FilterHandlesByObjectType. Returns false without doing anything if AVX2 isn't available.
+/// </summary>
+bool FilterHandlesByObjectType_AVX2(
+    const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries,
+    ULONG_PTR nEntries,
+    const USHORT* pTypeIndexes,
+    size_t nTypeIndexes,
+    HandleIndexList_t& indexes);
+
+/// <summary>
+/// Returns true if the processor and operating system support AVX2.
+/// </summary>
+bool Avx2Available();
@@ -0,0 +1,255 @@
+// Interfaces between the zombie analysis and the operating system: process and thread enumeration, the systemwide handle
+// table, services, and the clock. The analysis code makes no system calls of its own; it goes through a Platform,
+// which is either the live system (PlatformWindows.h, PlatformLinux.h) or a deterministic in-memory model (PlatformInMemory.h).
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string>
+#include <vector>
+#include "ServiceLookupByPID.h"
+
+/// <summary>
+/// Information about a process from its handle, including one that has exited but is still represented in kernel memory.
+/// </summary>
+struct PlatformProcessBasicInfo
+{
+    ULONG_PTR PID = 0;
+    ULONG_PTR ParentPID = 0;
+    // The process has exited or is exiting
+    bool bDeleting = false;
+};
+
+/// <summary>
+/// Identifies a running process. (PIDs are reused, so the PID alone doesn't.)
+/// </summary>
+struct PlatformProcessIdentity
+{
+    ULONG_PTR PID = 0;
+    // FILETIME value
+    ULONGLONG createTime = 0;
+};
+
+/// <summary>
+/// Enumerates all processes, including those that have exited but are still represented in kernel memory,
+/// and queries them through the handles the enumeration opens.
+/// </summary>
+class ProcessEnumerator
+{
+public:
+    virtual ~ProcessEnumerator() = default;
+
+    /// <summary>
+    /// Opens a new handle to the process following hPrevProcess in the enumeration (semantics of NtGetNextProcess).
+    /// Does not close hPrevProcess. The caller releases each handle with Platform::ReleaseHandle.
+    /// </summary>
+    /// <param name="hPrevProcess">Input: handle returned by the previous call; nullptr to get the first process</param>
+    /// <param name="bSynchronize">Input: true if the handle will be passed to Platform::HasExited</param>
+    /// <param name="hNextProcess">Output: handle to the next process</param>
+    /// <returns>STATUS_SUCCESS; STATUS_NO_MORE_ENTRIES after the last process; otherwise, the reason enumeration failed</returns>
+    virtual NTSTATUS GetNextProcess(HANDLE hPrevProcess, bool bSynchronize, HANDLE& hNextProcess) = 0;
+
+    /// <summary>
+    /// Gets the process ID, parent process ID, and whether the process is deleting.
+    /// </summary>
+    /// <returns>STATUS_SUCCESS, or the reason for failure</returns>
+    virtual NTSTATUS QueryBasicInformation(HANDLE hProcess, PlatformProcessBasicInfo& basicInfo) = 0;
+
+    /// <summary>
+    /// Gets the process' creation and exit times. The exit time is 0 if the process has not exited.
+    /// </summary>
+    /// <returns>true if successful</returns>
+    virtual bool GetTimes(HANDLE hProcess, FILETIME& createTime, FILETIME& exitTime) = 0;
+
+    /// <summary>
+    /// Gets the process' executable image path, in Object Manager namespace. Works for processes that have exited.
+    /// </summary>
+    /// <returns>STATUS_SUCCESS, or the reason for failure</returns>
+    virtual NTSTATUS QueryImageFileName(HANDLE hProcess, std::wstring& sImagePath) = 0;
+
+    /// <summary>
+    /// Gets the number of handles the process holds.
+    /// </summary>
+    /// <returns>true if successful</returns>
+    virtual bool GetHandleCount(HANDLE hProcess, DWORD& dwHandleCount) = 0;
+
+    /// <summary>
+    /// Gets the executable image path associated with a Process ID, if that process is running
+    /// </summary>
+    /// <param name="pid">Input: process ID</param>
+    /// <param name="sProcessImagePath">Output: full image path of executable, if running; otherwise error text, or empty</param>
+    /// <returns>true if successful</returns>
+    virtual bool GetImagePathFromPID(ULONG_PTR pid, std::wstring& sProcessImagePath) = 0;
+
+    /// <summary>
+    /// Gets the executable image path of the parent process, if possible.
+    /// "Possible" means that the input parent process ID is a still-running process and that its start time
+    /// is no later than the child process start time. (Start times are only as fine as the clock that records them, so a
+    /// parent that starts its child right away can have the same start time; a process that reused the parent's PID
+    /// started after the child.)
+    /// </summary>
+    /// <param name="ppid">Input: parent process ID</param>
+    /// <param name="ftChildStartTime">Input: child process start time</param>
+    /// <param name="sProcessImagePath">Output: full image path of executable associated with ppid</param>
+    /// <returns>true if successful</returns>
+    virtual bool GetParentProcessImagePathIfStillRunning(ULONG_PTR ppid, const FILETIME& ftChildStartTime, std::wstring& sProcessImagePath) = 0;
+
+    /// <summary>
+    /// Gets the PID and creation time of every running process at once, without opening any of them
+    /// (semantics of NtQuerySystemInformation(SystemProcessInformation)).
+    /// </summary>
+    /// <param name="processes">Output: the running processes</param>
+    /// <returns>true if successful</returns>
+    virtual bool GetRunningProcesses(std::vector<PlatformProcessIdentity>& processes) = 0;
+
+    /// <summary>
+    /// Gets the PIDs of the running processes whose executable file name (not the full path) is sExeName, compared
+    /// case-insensitively, without opening any of them (semantics of NtQuerySystemInformation(SystemProcessInformation)).
+    /// </summary>
+    /// <param name="sExeName">Input: executable file name; e.g., "svchost.exe"</param>
+    /// <param name="pids">Output: PIDs of the matching processes</param>
+    /// <returns>true if successful</returns>
+    virtual bool FindRunningProcessesByExeName(const std::wstring& sExeName, std::vector<ULONG_PTR>& pids) = 0;
+};
+
+/// <summary>
+/// Enumerates the threads of a process, including exited threads that are still represented in kernel memory.
+/// Implementations allow different processes' threads to be enumerated concurrently, along with Platform::HasExited
+/// and Platform::ReleaseHandle on the handles returned.
+/// </summary>
+class ThreadEnumerator
+{
+public:
+    virtual ~ThreadEnumerator() = default;
+
+    /// <summary>
+    /// Opens a process for thread enumeration. The caller releases the handle with Platform::ReleaseHandle.
+    /// </summary>
+    /// <param name="pid">Input: process ID</param>
+    /// <returns>Handle to pass to GetNextThread; nullptr if the process can't be opened</returns>
+    virtual HANDLE OpenProcessForThreads(ULONG_PTR pid) = 0;
+
+    /// <summary>
+    /// Opens a new handle to the thread following hPrevThread in the process (semantics of NtGetNextThread).
+    /// Does not close hPrevThread. The caller releases each handle with Platform::ReleaseHandle.
+    /// </summary>
+    /// <param name="hProcess">Input: handle returned by OpenProcessForThreads</param>
+    /// <param name="hPrevThread">Input: handle returned by the previous call; nullptr to get the first thread</param>
+    /// <param name="bSynchronize">Input: true if the handle will be passed to Platform::HasExited</param>
+    /// <param name="hNextThread">Output: handle to the next thread</param>
+    /// <returns>STATUS_SUCCESS; STATUS_NO_MORE_ENTRIES after the last thread; otherwise, the reason enumeration failed</returns>
+    virtual NTSTATUS GetNextThread(HANDLE hProcess, HANDLE hPrevThread, bool bSynchronize, HANDLE& hNextThread) = 0;
+
+    /// <summary>
+    /// Returns the thread ID of a thread; 0 on failure.
+    /// </summary>
+    virtual DWORD GetThreadId(HANDLE hThread) = 0;
+};
+
+/// <summary>
+/// Source of the systemwide handle table.
+/// </summary>
+class HandleTableProvider
+{
+public:
+    virtual ~HandleTableProvider() = default;
+
+    /// <summary>
+    /// Copies the systemwide handle table into the buffer, laid out as SYSTEM_HANDLE_INFORMATION_EX
+    /// (semantics of NtQuerySystemInformation(SystemExtendedHandleInformation)).
+    /// </summary>
+    /// <param name="pBuffer">Output: buffer to receive the table</param>
+    /// <param name="ulBufferLength">Input: size of the buffer in bytes</param>
+    /// <param name="pulReturnLength">Output: size the table requires</param>
+    /// <returns>STATUS_SUCCESS; STATUS_INFO_LENGTH_MISMATCH if the buffer is too small; otherwise, the reason for failure</returns>
+    virtual NTSTATUS QuerySystemHandleInformation(PVOID pBuffer, ULONG ulBufferLength, ULONG* pulReturnLength) = 0;
+
+    /// <summary>
+    /// Gets the object type index of a handle held by the current process, as the systemwide handle table reports it
+    /// (the ObjectTypeIndex of the handle's entry).
+    /// </summary>
+    /// <param name="h">Input: handle held by the current process</param>
+    /// <param name="typeIndex">Output: object type index, if successful</param>
+    /// <returns>true if successful; false if the platform can't determine it</returns>
+    virtual bool GetObjectTypeIndex(HANDLE h, USHORT& typeIndex) = 0;
+};
+
+/// <summary>
+/// Source of the services hosted by each service process.
+/// </summary>
+class ServiceProvider
+{
+public:
+    virtual ~ServiceProvider() = default;
+
+    /// <summary>
+    /// Replaces the contents of serviceLookup with the active services, by hosting process ID.
+    /// </summary>
+    /// <returns>true if successful</returns>
+    virtual bool EnumerateServices(ServiceLookupByPID_t& serviceLookup, std::wstring& sErrorInfo) = 0;
+};
+
+/// <summary>
+/// Source of the current time.
+/// </summary>
+class SystemClock
+{
+public:
+    virtual ~SystemClock() = default;
+
+    /// <summary>
+    /// Returns the current time as a FILETIME value (100-nanosecond intervals since January 1, 1601 UTC).
+    /// </summary>
+    virtual ULONGLONG Now() = 0;
+};
+
+/// <summary>
+/// An operating system, real or modeled: the components above, and operations on the handles they return.
+/// </summary>
+class Platform
+{
+public:
+    virtual ~Platform() = default;
+
+    virtual ProcessEnumerator& Processes() = 0;
+    virtual ThreadEnumerator& Threads() = 0;
+    virtual HandleTableProvider& HandleTable() = 0;
+    virtual ServiceProvider& Services() = 0;
+    virtual SystemClock& Clock() = 0;
+
+    /// <summary>
+    /// Process ID of the process that holds the handles that enumeration returns.
+    /// </summary>
+    virtual DWORD CurrentProcessId() = 0;
+
+    /// <summary>
+    /// Releases a handle returned by enumeration.
+    /// </summary>
+    virtual void ReleaseHandle(HANDLE h) = 0;
+
+    /// <summary>
+    /// Indicates whether the process or thread has exited.
+    /// </summary>
+    /// <param name="hProcessOrThread">Input: handle to a process or a thread, opened with bSynchronize</param>
+    /// <param name="bHasExited">Output: if function is successful, true if process has exited, false otherwise; undefined if function fails</param>
+    /// <returns>true if function succeeds, false otherwise</returns>
+    virtual bool HasExited(HANDLE hProcessOrThread, bool& bHasExited) = 0;
+
+    /// <summary>
+    /// Acquires the rights that the calling thread needs to enumerate and query all processes (on Windows, the
+    /// Debug Programs privilege). Must be paired with EndPrivilegedAccess on the same thread if successful.
+    /// </summary>
+    /// <returns>true if successful</returns>
+    virtual bool BeginPrivilegedAccess(std::wstring& sErrorInfo) = 0;
+    virtual void EndPrivilegedAccess() = 0;
+
+    /// <summary>
+    /// Cumulative number of process/thread/handle calls into the kernel made through this platform, for -stats.
+    /// </summary>
+    virtual ULONGLONG SystemCallCount() const = 0;
+};
+
+/// <summary>
+/// The platform for the operating system the program is running on.
+/// </summary>
+Platform& SystemPlatform();
@@ -0,0 +1,436 @@
+// Deterministic in-memory Platform implementation: processes, threads, a handle table, services, and a clock that the
+// caller sets up, or loads from a synthetic workload. Makes no operating system calls, so the whole pipeline, from
+// process enumeration through correlation, can run anywhere the code builds.
+
+#include "PlatformTypes.h"
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "HEX.h"
+#include "StringUtils.h"
+#include "SyntheticWorkload.h"
+#include "PlatformInMemory.h"
+
+// (Definition of the in-class constant)
+const size_t InMemoryPlatform::NoThread;
+
+// Handle values that LoadWorkload assigns to running processes: above any handle value of the synthetic handle table
+static const ULONG_PTR RunningProcessHandleBase = 0x40000000;
+// Creation time that LoadWorkload assigns to running processes, relative to the capture time: before any synthetic
+// zombie was created, so that running parents are found.
+static const ULONGLONG RunningProcessAge = 60ull * 24 * 3600 * 10000000;
+
+#if !defined(_WIN32) && !defined(__linux__)
+/// <summary>
+/// The platform for the operating system the program is running on. There is no live-system implementation for this
+/// operating system, so it's an empty in-memory platform: no processes, no handles, and no services.
+/// </summary>
+Platform& SystemPlatform()
+{
+    static InMemoryPlatform emptyPlatform;
+    return emptyPlatform;
+}
+#endif
+
+/// <summary>
+/// Removes all processes, the handle table, and services, and resets the clock, current process ID, and object type indexes.
+/// </summary>
+void InMemoryPlatform::Clear()
+{
+    m_processes.clear();
+    m_handles.clear();
+    m_processByPID.clear();
+    m_ownedHandleInfo.clear();
+    m_pHandleInfo = nullptr;
+    m_services.clear();
+    m_dwCurrentPID = 0;
+    m_ulNow = 0;
+    m_processTypeIndex = m_threadTypeIndex = 0;
+}
+
+/// <summary>
+/// Adds a process. Its handle value and those of its threads must not already be in use.
+/// </summary>
+/// <returns>true if successful</returns>
+bool InMemoryPlatform::AddProcess(const InMemoryProcess& process, std::wstring& sErrorInfo)
+{
+    // Validate all of the handle values before changing anything
+    std::vector<HANDLE> newHandles;
+    newHandles.push_back(process.hProcess);
+    for (std::vector<InMemoryThread>::const_iterator iThread = process.threads.begin(); iThread != process.threads.end(); ++iThread)
+        newHandles.push_back(iThread->hThread);
+    for (std::vector<HANDLE>::const_iterator iHandle = newHandles.begin(); iHandle != newHandles.end(); ++iHandle)
+    {
+        if (nullptr == *iHandle || m_handles.end() != m_handles.find(*iHandle) || std::count(newHandles.begin(), newHandles.end(), *iHandle) > 1)
+        {
+            std::wstringstream strErrorInfo;
+            strErrorInfo << L"InMemoryPlatform::AddProcess: PID " << process.PID << L": handle value " << HEX(ULONG_PTR(*iHandle), 8, false, true) << L" is null or already in use";
+            sErrorInfo = strErrorInfo.str();
+            return false;
+        }
+    }
+
+    const size_t ixProcess = m_processes.size();
+    m_processes.push_back(process);
+    ObjectRef ref = { ixProcess, NoThread };
+    m_handles[process.hProcess] = ref;
+    for (size_t ixThread = 0; ixThread < process.threads.size(); ++ixThread)
+    {
+        ref.ixThread = ixThread;
+        m_handles[process.threads[ixThread].hThread] = ref;
+    }
+    m_processByPID[process.PID] = ixProcess;
+    return true;
+}
+
+/// <summary>
+/// Sets the handle table to a copy of the entries.
+/// </summary>
+void InMemoryPlatform::SetHandleTable(const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries, size_t nEntries)
+{
+    const size_t nHeaderBytes = FIELD_OFFSET(SYSTEM_HANDLE_INFORMATION_EX, Handles);
+    m_ownedHandleInfo.assign(nHeaderBytes + nEntries * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX), 0);
+    SYSTEM_HANDLE_INFORMATION_EX* pHandleInfo = (SYSTEM_HANDLE_INFORMATION_EX*)m_ownedHandleInfo.data();
+    pHandleInfo->NumberOfHandles = nEntries;
+    if (nEntries > 0)
+        memcpy(pHandleInfo->Handles, pEntries, nEntries * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX));
+    m_pHandleInfo = pHandleInfo;
+}
+
+/// <summary>
+/// Sets the handle table to memory owned by the caller, used in place.
+/// </summary>
+void InMemoryPlatform::AttachHandleTable(const SYSTEM_HANDLE_INFORMATION_EX* pHandleInfo)
+{
+    m_ownedHandleInfo.clear();
+    m_pHandleInfo = pHandleInfo;
+}
+
+/// <summary>
+/// Replaces the contents of the platform with a synthetic workload.
+/// Zombie processes and threads get the handle values that the workload's capturing process holds to them, so that the
+/// workload's handle table references them; running processes get handle values above any in the table.
+/// </summary>
+/// <returns>true if successful</returns>
+bool InMemoryPlatform::LoadWorkload(const SyntheticWorkload& workload, std::wstring& sErrorInfo)
+{
+    sErrorInfo.clear();
+    Clear();
+    m_dwCurrentPID = workload.HandleOwnerPID();
+    m_ulNow = workload.CaptureTime();
+    m_services = workload.Services();
+    SetObjectTypeIndexes(SyntheticWorkload::ProcessTypeIndex, SyntheticWorkload::ThreadTypeIndex);
+    AttachHandleTable(workload.NumberOfHandles() > 0 ? workload.HandleInformation() : nullptr);
+
+    // Handle counts of the running processes
+    std::unordered_map<ULONG_PTR, DWORD> handleCounts;
+    const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries = workload.HandleEntries();
+    for (size_t ix = 0; ix < workload.NumberOfHandles(); ++ix)
+        handleCounts[pEntries[ix].UniqueProcessId]++;
+
+    // Zombie processes and their threads, by PID
+    std::map<ULONG_PTR, InMemoryProcess> zombies;
+    const ZombieHandleLookup_t& zombieHandleLookup = workload.ZombieHandleLookup();
+    for (ZombieHandleLookup_t::const_iterator iter = zombieHandleLookup.begin(); iter != zombieHandleLookup.end(); ++iter)
+    {
+        const ZombieProcessThreadInfo& zombieInfo = workload.ZombieRecords()[iter->second];
+        InMemoryProcess& zombie = zombies[zombieInfo.PID];
+        if (0 == zombieInfo.TID)
+        {
+            zombie.hProcess = iter->first;
+            zombie.PID = zombieInfo.PID;
+            zombie.ParentPID = zombieInfo.ParentPID;
+            zombie.createTime = *(const ULONGLONG*)&zombieInfo.createTime;
+            zombie.exitTime = *(const ULONGLONG*)&zombieInfo.exitTime;
+            zombie.sImagePath = workload.ImagePaths().Path(zombieInfo.imagePathId);
+        }
+        else
+        {
+            InMemoryThread thread;
+            thread.hThread = iter->first;
+            thread.TID = zombieInfo.TID;
+            thread.bExited = true;
+            zombie.threads.push_back(thread);
+        }
+    }
+
+    // All processes in PID order
+    std::map<ULONG_PTR, InMemoryProcess> processes;
+    const std::vector<std::pair<ULONG_PTR, std::wstring>>& processImagePaths = workload.ProcessImagePaths();
+    for (size_t ix = 0; ix < processImagePaths.size(); ++ix)
+    {
+        InMemoryProcess& process = processes[processImagePaths[ix].first];
+        process.hProcess = HANDLE(RunningProcessHandleBase + 4 * ix);
+        process.PID = processImagePaths[ix].first;
+        process.createTime = workload.CaptureTime() - RunningProcessAge;
+        process.sImagePath = processImagePaths[ix].second;
+        process.dwHandleCount = handleCounts[process.PID];
+    }
+    for (std::map<ULONG_PTR, InMemoryProcess>::iterator iter = zombies.begin(); iter != zombies.end(); ++iter)
+    {
+        std::sort(iter->second.threads.begin(), iter->second.threads.end(),
+            [](const InMemoryThread& a, const InMemoryThread& b) { return a.TID < b.TID; }
+        );
+        processes[iter->first] = iter->second;
+    }
+    for (std::map<ULONG_PTR, InMemoryProcess>::const_iterator iter = processes.begin(); iter != processes.end(); ++iter)
+    {
+        if (!AddProcess(iter->second, sErrorInfo))
+            return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Returns the process (and thread, if any) that a handle refers to; false if the handle is not valid.
+/// </summary>
+bool InMemoryPlatform::Lookup(HANDLE h, ObjectRef& ref) const
+{
+    std::unordered_map<HANDLE, ObjectRef>::const_iterator iter = m_handles.find(h);
+    if (m_handles.end() == iter)
+        return false;
+    ref = iter->second;
+    return true;
+}
+
+const InMemoryProcess* InMemoryPlatform::LookupProcess(HANDLE hProcess) const
+{
+    ObjectRef ref;
+    if (!Lookup(hProcess, ref) || NoThread != ref.ixThread)
+        return nullptr;
+    return &m_processes[ref.ixProcess];
+}
+
+/// <summary>
+/// Returns the process with the PID, running or not; nullptr if none.
+/// </summary>
+const InMemoryProcess* InMemoryPlatform::FindProcess(ULONG_PTR pid) const
+{
+    std::unordered_map<ULONG_PTR, size_t>::const_iterator iter = m_processByPID.find(pid);
+    if (m_processByPID.end() == iter)
+        return nullptr;
+    return &m_processes[iter->second];
+}
+
+/// <summary>
+/// Spends the time set by SetCallCost, busy-waiting as a kernel call would occupy the calling thread.
+/// </summary>
+void InMemoryPlatform::SimulateCallCost() const
+{
+    if (0 == m_nCallCostNs)
+        return;
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(m_nCallCostNs);
+    while (std::chrono::steady_clock::now() < end)
+    {
+    }
+}
+
+bool InMemoryPlatform::HasExited(HANDLE hProcessOrThread, bool& bHasExited)
+{
+    SimulateCallCost();
+    ObjectRef ref;
+    if (!Lookup(hProcessOrThread, ref))
+        return false;
+    const InMemoryProcess& process = m_processes[ref.ixProcess];
+    // A process' threads have all exited once the process has.
+    bHasExited = (0 != process.exitTime) || (NoThread != ref.ixThread && process.threads[ref.ixThread].bExited);
+    return true;
+}
+
+NTSTATUS InMemoryPlatform::GetNextProcess(HANDLE hPrevProcess, bool, HANDLE& hNextProcess)
+{
+    SimulateCallCost();
+    size_t ixNext = 0;
+    if (nullptr != hPrevProcess)
+    {
+        ObjectRef ref;
+        if (!Lookup(hPrevProcess, ref) || NoThread != ref.ixThread)
+            return STATUS_INVALID_HANDLE;
+        ixNext = ref.ixProcess + 1;
+    }
+    if (ixNext >= m_processes.size())
+        return STATUS_NO_MORE_ENTRIES;
+    hNextProcess = m_processes[ixNext].hProcess;
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS InMemoryPlatform::QueryBasicInformation(HANDLE hProcess, PlatformProcessBasicInfo& basicInfo)
+{
+    SimulateCallCost();
+    const InMemoryProcess* pProcess = LookupProcess(hProcess);
+    if (nullptr == pProcess)
+        return STATUS_INVALID_HANDLE;
+    basicInfo.PID = pProcess->PID;
+    basicInfo.ParentPID = pProcess->ParentPID;
+    basicInfo.bDeleting = (0 != pProcess->exitTime);
+    return STATUS_SUCCESS;
+}
+
+bool InMemoryPlatform::GetTimes(HANDLE hProcess, FILETIME& createTime, FILETIME& exitTime)
+{
+    SimulateCallCost();
+    const InMemoryProcess* pProcess = LookupProcess(hProcess);
+    if (nullptr == pProcess)
+        return false;
+    *(ULONGLONG*)&createTime = pProcess->createTime;
+    *(ULONGLONG*)&exitTime = pProcess->exitTime;
+    return true;
+}
+
+NTSTATUS InMemoryPlatform::QueryImageFileName(HANDLE hProcess, std::wstring& sImagePath)
+{
+    SimulateCallCost();
+    sImagePath.clear();
+    const InMemoryProcess* pProcess = LookupProcess(hProcess);
+    if (nullptr == pProcess)
+        return STATUS_INVALID_HANDLE;
+    sImagePath = pProcess->sImagePath;
+    return STATUS_SUCCESS;
+}
+
+bool InMemoryPlatform::GetHandleCount(HANDLE hProcess, DWORD& dwHandleCount)
+{
+    SimulateCallCost();
+    const InMemoryProcess* pProcess = LookupProcess(hProcess);
+    if (nullptr == pProcess)
+        return false;
+    dwHandleCount = pProcess->dwHandleCount;
+    return true;
+}
+
+bool InMemoryPlatform::GetImagePathFromPID(ULONG_PTR pid, std::wstring& sProcessImagePath)
+{
+    SimulateCallCost();
+    sProcessImagePath.clear();
+    const InMemoryProcess* pProcess = FindProcess(pid);
+    if (nullptr == pProcess || 0 != pProcess->exitTime)
+        return false;
+    sProcessImagePath = pProcess->sImagePath;
+    return true;
+}
+
+bool InMemoryPlatform::GetParentProcessImagePathIfStillRunning(ULONG_PTR ppid, const FILETIME& ftChildStartTime, std::wstring& sProcessImagePath)
+{
+    SimulateCallCost();
+    sProcessImagePath.clear();
+    const InMemoryProcess* pProcess = FindProcess(ppid);
+    if (nullptr == pProcess || 0 != pProcess->exitTime || pProcess->createTime > *(const ULONGLONG*)&ftChildStartTime)
+        return false;
+    sProcessImagePath = pProcess->sImagePath;
+    return true;
+}
+
+bool InMemoryPlatform::GetRunningProcesses(std::vector<PlatformProcessIdentity>& processes)
+{
+    SimulateCallCost();
+    processes.clear();
+    for (
+        std::vector<InMemoryProcess>::const_iterator iter = m_processes.begin();
+        iter != m_processes.end();
+        ++iter
+        )
+    {
+        if (0 == iter->exitTime)
+        {
+            PlatformProcessIdentity identity;
+            identity.PID = iter->PID;
+            identity.createTime = iter->createTime;
+            processes.push_back(identity);
+        }
+    }
+    return true;
+}
+
+bool InMemoryPlatform::FindRunningProcessesByExeName(const std::wstring& sExeName, std::vector<ULONG_PTR>& pids)
+{
+    SimulateCallCost();
+    pids.clear();
+    for (
+        std::vector<InMemoryProcess>::const_iterator iter = m_processes.begin();
+        iter != m_processes.end();
+        ++iter
+        )
+    {
+        if (0 == iter->exitTime && 0 == _wcsicmp(sExeName.c_str(), GetFileNameFromFilePath(iter->sImagePath).c_str()))
+            pids.push_back(iter->PID);
+    }
+    return true;
+}
+
+HANDLE InMemoryPlatform::OpenProcessForThreads(ULONG_PTR pid)
+{
+    SimulateCallCost();
+    // The process handle serves for thread enumeration.
+    const InMemoryProcess* pProcess = FindProcess(pid);
+    return (nullptr != pProcess) ? pProcess->hProcess : nullptr;
+}
+
+NTSTATUS InMemoryPlatform::GetNextThread(HANDLE hProcess, HANDLE hPrevThread, bool, HANDLE& hNextThread)
+{
+    SimulateCallCost();
+    ObjectRef processRef;
+    if (!Lookup(hProcess, processRef) || NoThread != processRef.ixThread)
+        return STATUS_INVALID_HANDLE;
+    size_t ixNext = 0;
+    if (nullptr != hPrevThread)
+    {
+        ObjectRef threadRef;
+        if (!Lookup(hPrevThread, threadRef) || threadRef.ixProcess != processRef.ixProcess || NoThread == threadRef.ixThread)
+            return STATUS_INVALID_HANDLE;
+        ixNext = threadRef.ixThread + 1;
+    }
+    const InMemoryProcess& process = m_processes[processRef.ixProcess];
+    if (ixNext >= process.threads.size())
+        return STATUS_NO_MORE_ENTRIES;
+    hNextThread = process.threads[ixNext].hThread;
+    return STATUS_SUCCESS;
+}
+
+DWORD InMemoryPlatform::GetThreadId(HANDLE hThread)
+{
+    ObjectRef ref;
+    if (!Lookup(hThread, ref) || NoThread == ref.ixThread)
+        return 0;
+    return m_processes[ref.ixProcess].threads[ref.ixThread].TID;
+}
+
+NTSTATUS InMemoryPlatform::QuerySystemHandleInformation(PVOID pBuffer, ULONG ulBufferLength, ULONG* pulReturnLength)
+{
+    // Required size, as NtQuerySystemInformation reports it: never less than the structure with its one declared entry
+    const size_t nHandles = (nullptr != m_pHandleInfo) ? size_t(m_pHandleInfo->NumberOfHandles) : 0;
+    const size_t nRequired = std::max<size_t>(
+        FIELD_OFFSET(SYSTEM_HANDLE_INFORMATION_EX, Handles) + nHandles * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX),
+        sizeof(SYSTEM_HANDLE_INFORMATION_EX));
+    if (nRequired > ULONG(-1))
+        return STATUS_INSUFFICIENT_RESOURCES;
+    if (nullptr != pulReturnLength)
+        *pulReturnLength = ULONG(nRequired);
+    if (ulBufferLength < nRequired)
+        return STATUS_INFO_LENGTH_MISMATCH;
+
+    SYSTEM_HANDLE_INFORMATION_EX* pHandleInfo = (SYSTEM_HANDLE_INFORMATION_EX*)pBuffer;
+    pHandleInfo->NumberOfHandles = nHandles;
+    pHandleInfo->Reserved = 0;
+    if (nHandles > 0)
+        memcpy(pHandleInfo->Handles, m_pHandleInfo->Handles, nHandles * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX));
+    return STATUS_SUCCESS;
+}
+
+bool InMemoryPlatform::GetObjectTypeIndex(HANDLE h, USHORT& typeIndex)
+{
+    SimulateCallCost();
+    ObjectRef ref;
+    if (!Lookup(h, ref))
+        return false;
+    typeIndex = (NoThread == ref.ixThread) ? m_processTypeIndex : m_threadTypeIndex;
+    return 0 != typeIndex;
+}
+
+bool InMemoryPlatform::EnumerateServices(ServiceLookupByPID_t& serviceLookup, std::wstring& sErrorInfo)
+{
+    sErrorInfo.clear();
+    serviceLookup = m_services;
+    return true;
+}
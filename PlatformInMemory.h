@@ -0,0 +1,195 @@
+// Deterministic in-memory Platform implementation: processes, threads, a handle table, services, and a clock that the
+// caller sets up, or loads from a synthetic workload. Makes no operating system calls, so the whole pipeline, from
+// process enumeration through correlation, can run anywhere the code builds.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include "NtInternal.h"
+#include "Platform.h"
+
+class SyntheticWorkload;
+
+/// <summary>
+/// A thread in an InMemoryProcess.
+/// </summary>
+struct InMemoryThread
+{
+    // Handle value that enumeration returns for the thread; unique among all handles of the platform
+    HANDLE hThread = nullptr;
+    DWORD TID = 0;
+    bool bExited = false;
+};
+
+/// <summary>
+/// A process of an InMemoryPlatform. Exited processes (nonzero exit time) are zombies.
+/// </summary>
+struct InMemoryProcess
+{
+    // Handle value that enumeration returns for the process; unique among all handles of the platform
+    HANDLE hProcess = nullptr;
+    ULONG_PTR PID = 0;
+    ULONG_PTR ParentPID = 0;
+    // FILETIME values; exit time is 0 for a running process
+    ULONGLONG createTime = 0;
+    ULONGLONG exitTime = 0;
+    std::wstring sImagePath;
+    DWORD dwHandleCount = 0;
+    std::vector<InMemoryThread> threads;
+};
+
+/// <summary>
+/// Deterministic in-memory Platform implementation. Processes are enumerated in the order in which they were added.
+/// Handles are the values assigned to the processes and threads, so that a handle table can reference them;
+/// releasing them does nothing. Queries don't modify the platform, so they can be made concurrently.
+/// </summary>
+class InMemoryPlatform :
+    public Platform,
+    private ProcessEnumerator,
+    private ThreadEnumerator,
+    private HandleTableProvider,
+    private ServiceProvider,
+    private SystemClock
+{
+public:
+    InMemoryPlatform() = default;
+    virtual ~InMemoryPlatform() = default;
+
+    /// <summary>
+    /// Removes all processes, the handle table, and services, and resets the clock and current process ID.
+    /// </summary>
+    void Clear();
+
+    /// <summary>
+    /// Adds a process. Its handle value and those of its threads must not already be in use.
+    /// </summary>
+    /// <returns>true if successful</returns>
+    bool AddProcess(const InMemoryProcess& process, std::wstring& sErrorInfo);
+
+    /// <summary>
+    /// Sets the handle table to a copy of the entries.
+    /// </summary>
+    void SetHandleTable(const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries, size_t nEntries);
+
+    /// <summary>
+    /// Sets the handle table to memory owned by the caller, used in place. The memory must remain valid and unchanged
+    /// until this instance is destroyed or the handle table is replaced.
+    /// </summary>
+    void AttachHandleTable(const SYSTEM_HANDLE_INFORMATION_EX* pHandleInfo);
+
+    void SetServices(const ServiceLookupByPID_t& services) { m_services = services; }
+    void SetCurrentProcessId(DWORD dwPID) { m_dwCurrentPID = dwPID; }
+    void SetTime(ULONGLONG ulNow) { m_ulNow = ulNow; }
+
+    /// <summary>
+    /// Sets the object type indexes that GetObjectTypeIndex reports for process and thread handles, which should match
+    /// those of the handle table's entries. 0 for unknown: GetObjectTypeIndex then fails, as it does by default.
+    /// </summary>
+    void SetObjectTypeIndexes(USHORT processTypeIndex, USHORT threadTypeIndex) { m_processTypeIndex = processTypeIndex; m_threadTypeIndex = threadTypeIndex; }
+
+    /// <summary>
+    /// Sets the time that each process and thread query spends busy-waiting, to model the cost of the kernel calls
+    /// that a live system makes (e.g., to measure parallel enumeration). Default 0, for none.
+    /// </summary>
+    void SetCallCost(ULONG nNanoseconds) { m_nCallCostNs = nNanoseconds; }
+
+    /// <summary>
+    /// Replaces the contents of the platform with a synthetic workload: its running and zombie processes, threads,
+    /// handle table (used in place; the workload must outlive this instance or the next Clear or LoadWorkload call),
+    /// and services. The current process is the workload's capturing process, and the clock is its capture time.
+    /// </summary>
+    /// <returns>true if successful</returns>
+    bool LoadWorkload(const SyntheticWorkload& workload, std::wstring& sErrorInfo);
+
+    size_t ProcessCount() const { return m_processes.size(); }
+
+    // Platform
+    ProcessEnumerator& Processes() override { return *this; }
+    ThreadEnumerator& Threads() override { return *this; }
+    HandleTableProvider& HandleTable() override { return *this; }
+    ServiceProvider& Services() override { return *this; }
+    SystemClock& Clock() override { return *this; }
+    DWORD CurrentProcessId() override { return m_dwCurrentPID; }
+    void ReleaseHandle(HANDLE) override {}
+    bool HasExited(HANDLE hProcessOrThread, bool& bHasExited) override;
+    bool BeginPrivilegedAccess(std::wstring& sErrorInfo) override { sErrorInfo.clear(); return true; }
+    void EndPrivilegedAccess() override {}
+    ULONGLONG SystemCallCount() const override { return 0; }
+
+private:
+    // ProcessEnumerator
+    NTSTATUS GetNextProcess(HANDLE hPrevProcess, bool bSynchronize, HANDLE& hNextProcess) override;
+    NTSTATUS QueryBasicInformation(HANDLE hProcess, PlatformProcessBasicInfo& basicInfo) override;
+    bool GetTimes(HANDLE hProcess, FILETIME& createTime, FILETIME& exitTime) override;
+    NTSTATUS QueryImageFileName(HANDLE hProcess, std::wstring& sImagePath) override;
+    bool GetHandleCount(HANDLE hProcess, DWORD& dwHandleCount) override;
+    bool GetImagePathFromPID(ULONG_PTR pid, std::wstring& sProcessImagePath) override;
+    bool GetParentProcessImagePathIfStillRunning(ULONG_PTR ppid, const FILETIME& ftChildStartTime, std::wstring& sProcessImagePath) override;
+    bool GetRunningProcesses(std::vector<PlatformProcessIdentity>& processes) override;
+    bool FindRunningProcessesByExeName(const std::wstring& sExeName, std::vector<ULONG_PTR>& pids) override;
+
+    // ThreadEnumerator
+    HANDLE OpenProcessForThreads(ULONG_PTR pid) override;
+    NTSTATUS GetNextThread(HANDLE hProcess, HANDLE hPrevThread, bool bSynchronize, HANDLE& hNextThread) override;
+    DWORD GetThreadId(HANDLE hThread) override;
+
+    // HandleTableProvider
+    NTSTATUS QuerySystemHandleInformation(PVOID pBuffer, ULONG ulBufferLength, ULONG* pulReturnLength) override;
+    bool GetObjectTypeIndex(HANDLE h, USHORT& typeIndex) override;
+
+    // ServiceProvider
+    bool EnumerateServices(ServiceLookupByPID_t& serviceLookup, std::wstring& sErrorInfo) override;
+
+    // SystemClock
+    ULONGLONG Now() override { return m_ulNow; }
+
+private:
+    /// <summary>
+    /// What a handle refers to: a process, or one of its threads
+    /// </summary>
+    struct ObjectRef
+    {
+        size_t ixProcess;
+        size_t ixThread;    // NoThread for the process itself
+    };
+    static const size_t NoThread = size_t(-1);
+
+    /// <summary>
+    /// Returns the process (and thread, if any) that a handle refers to; false if the handle is not valid.
+    /// </summary>
+    bool Lookup(HANDLE h, ObjectRef& ref) const;
+    const InMemoryProcess* LookupProcess(HANDLE hProcess) const;
+
+    /// <summary>
+    /// Returns the process with the PID, running or not; nullptr if none. (A PID isn't reused while a zombie has it.)
+    /// </summary>
+    const InMemoryProcess* FindProcess(ULONG_PTR pid) const;
+
+    /// <summary>
+    /// Spends the time set by SetCallCost.
+    /// </summary>
+    void SimulateCallCost() const;
+
+private:
+    std::vector<InMemoryProcess> m_processes;
+    std::unordered_map<HANDLE, ObjectRef> m_handles;
+    std::unordered_map<ULONG_PTR, size_t> m_processByPID;
+    // Handle table: SYSTEM_HANDLE_INFORMATION_EX in m_ownedHandleInfo, or attached memory
+    std::vector<BYTE> m_ownedHandleInfo;
+    const SYSTEM_HANDLE_INFORMATION_EX* m_pHandleInfo = nullptr;
+    ServiceLookupByPID_t m_services;
+    DWORD m_dwCurrentPID = 0;
+    ULONGLONG m_ulNow = 0;
+    ULONG m_nCallCostNs = 0;
+    USHORT m_processTypeIndex = 0;
+    USHORT m_threadTypeIndex = 0;
+
+private:
+    // Not implemented
+    InMemoryPlatform(const InMemoryPlatform&) = delete;
+    InMemoryPlatform& operator = (const InMemoryPlatform&) = delete;
+};
@@ -0,0 +1,578 @@
+// Platform implementation for the live Linux system, from /proc: exited processes that haven't been reaped by their
+// parents (state Z), and processes pinned by the pidfds that other processes hold, including ones that have been reaped.
+
+#ifdef __linux__
+
+#include "PlatformTypes.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "StringUtils.h"
+#include "WorkerPool.h"
+#include "PlatformLinux.h"
+
+// (Definition of the in-class constant)
+const ULONG_PTR LinuxPlatform::UnreapedChildHandleValue;
+
+// Handle values assigned to the processes of a snapshot: above any file descriptor number
+static const ULONG_PTR ProcessHandleBase = 0x40000000;
+
+// Object type index of the handle table entries of a snapshot. All of them reference processes.
+static const USHORT ProcessObjectTypeIndex = 7;
+
+// Don't split the /proc scan across workers for fewer processes than this per worker
+static const size_t nMinProcessesPerPartition = 64;
+
+/// <summary>
+/// The platform for the operating system the program is running on.
+/// </summary>
+Platform& SystemPlatform()
+{
+    static LinuxPlatform linuxPlatform;
+    return linuxPlatform;
+}
+
+/// <summary>
+/// A pidfd held by a process: its descriptor, and the PID (-1 if reaped; 0 if in another PID namespace) and inode of
+/// the process it refers to.
+/// </summary>
+struct LinuxPidfd
+{
+    int fd;
+    LONGLONG targetPID;
+    ULONGLONG ulInode;
+};
+
+/// <summary>
+/// What a scan of one /proc/[pid] directory found.
+/// </summary>
+struct LinuxProcessScan
+{
+    // False if the process was gone before its stat file could be read
+    bool bValid = false;
+    ULONG_PTR PID = 0;
+    ULONG_PTR ParentPID = 0;
+    // Process state; 'Z' for a zombie
+    char state = 0;
+    // Start time in clock ticks since boot
+    ULONGLONG ulStartTicks = 0;
+    // For a zombie: when it last ran, in milliseconds of the scheduler clock; negative if not known
+    double dExecStartMs = -1.0;
+    DWORD nFds = 0;
+    // Thread IDs of a process that hasn't exited
+    std::vector<DWORD> tids;
+    std::wstring sImagePath;
+    // systemd service unit that the process belongs to, if any
+    std::wstring sServiceUnit;
+    std::vector<LinuxPidfd> pidfds;
+    ULONGLONG nSystemCalls = 0;
+};
+
+/// <summary>
+/// Reads a small file relative to a directory into a caller-supplied buffer, NUL-terminated. Reads at most nBufferSize - 1 bytes.
+/// </summary>
+/// <returns>Number of bytes read, or -1 if the file can't be opened</returns>
+static ssize_t ReadSmallFile(int dirFd, const char* szPath, char* buffer, size_t nBufferSize, ULONGLONG& nSystemCalls)
+{
+    ++nSystemCalls;
+    const int fd = openat(dirFd, szPath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    size_t nRead = 0;
+    while (nRead < nBufferSize - 1)
+    {
+        ++nSystemCalls;
+        const ssize_t n = read(fd, buffer + nRead, nBufferSize - 1 - nRead);
+        if (n <= 0)
+            break;
+        nRead += size_t(n);
+    }
+    ++nSystemCalls;
+    close(fd);
+    buffer[nRead] = '\0';
+    return ssize_t(nRead);
+}
+
+/// <summary>
+/// Returns the value of a "Name:\tvalue" line in the text; bFound false if there's no such line.
+/// </summary>
+static LONGLONG FieldValue(const char* szText, const char* szName, bool& bFound)
+{
+    const size_t nNameLen = strlen(szName);
+    for (const char* pLine = szText; nullptr != pLine && '\0' != *pLine; )
+    {
+        if (0 == strncmp(pLine, szName, nNameLen) && ':' == pLine[nNameLen])
+        {
+            bFound = true;
+            return strtoll(pLine + nNameLen + 1, nullptr, 10);
+        }
+        pLine = strchr(pLine, '\n');
+        if (nullptr != pLine)
+            ++pLine;
+    }
+    bFound = false;
+    return 0;
+}
+
+/// <summary>
+/// Returns the se.exec_start value (when the task last started running, in milliseconds of the scheduler clock) from a
+/// /proc sched file; negative if not available.
+/// </summary>
+static double SchedExecStartMs(int dirFd, const char* szPath, ULONGLONG& nSystemCalls)
+{
+    char buffer[512];
+    if (ReadSmallFile(dirFd, szPath, buffer, sizeof(buffer), nSystemCalls) <= 0)
+        return -1.0;
+    const char* pExecStart = strstr(buffer, "se.exec_start");
+    const char* pColon = (nullptr != pExecStart) ? strchr(pExecStart, ':') : nullptr;
+    return (nullptr != pColon) ? strtod(pColon + 1, nullptr) : -1.0;
+}
+
+/// <summary>
+/// Scans /proc/[pid]: its state, parent, start time, image path, and service unit, and its pidfds. For a zombie, when it last ran.
+/// Uses fixed-size buffers; the only allocations are for the process' strings and the pidfds found, not per descriptor.
+/// </summary>
+/// <param name="procFd">Input: descriptor of the /proc directory</param>
+/// <param name="pid">Input: process ID</param>
+/// <param name="scan">Output: what was found</param>
+static void ScanProcess(int procFd, ULONG_PTR pid, LinuxProcessScan& scan)
+{
+    char szPath[320];
+    char buffer[4096];
+    scan.PID = pid;
+
+    // stat: "pid (comm) state ppid pgrp session tty_nr tpgid flags minflt cminflt majflt cmajflt utime stime cutime cstime
+    //        priority nice num_threads itrealvalue starttime ..."
+    // comm can contain spaces and parentheses, so find the last ')'.
+    snprintf(szPath, sizeof(szPath), "%lu/stat", (unsigned long)pid);
+    if (ReadSmallFile(procFd, szPath, buffer, sizeof(buffer), scan.nSystemCalls) <= 0)
+        return;
+    char* pCommStart = strchr(buffer, '(');
+    char* pCommEnd = strrchr(buffer, ')');
+    if (nullptr == pCommStart || nullptr == pCommEnd || pCommEnd < pCommStart || '\0' == pCommEnd[1])
+        return;
+    std::wstring sComm;
+    WideFromUtf8(pCommStart + 1, size_t(pCommEnd - pCommStart - 1), sComm);
+    const char* pField = pCommEnd + 2;
+    scan.state = *pField;
+    // Fields after the state, counting from 0: ppid is 0, starttime is 18.
+    char* pNext = nullptr;
+    ++pField;
+    for (int ixField = 0; ixField <= 18; ++ixField)
+    {
+        const ULONGLONG ulValue = strtoull(pField, &pNext, 10);
+        if (pNext == pField)
+            return;
+        if (0 == ixField)
+            scan.ParentPID = ULONG_PTR(ulValue);
+        else if (18 == ixField)
+            scan.ulStartTicks = ulValue;
+        pField = pNext;
+    }
+    scan.bValid = true;
+
+    // Image path: the exe link, which can't be read for a zombie or a kernel thread; the process name otherwise.
+    snprintf(szPath, sizeof(szPath), "%lu/exe", (unsigned long)pid);
+    ++scan.nSystemCalls;
+    const ssize_t nExeLen = readlinkat(procFd, szPath, buffer, sizeof(buffer));
+    if (nExeLen > 0 && size_t(nExeLen) < sizeof(buffer))
+        WideFromUtf8(buffer, size_t(nExeLen), scan.sImagePath);
+    else
+        scan.sImagePath = sComm;
+
+    // Service unit: the last component of the cgroup path that names a .service; e.g., "0::/system.slice/sshd.service"
+    snprintf(szPath, sizeof(szPath), "%lu/cgroup", (unsigned long)pid);
+    if (ReadSmallFile(procFd, szPath, buffer, sizeof(buffer), scan.nSystemCalls) > 0)
+    {
+        const char* pUnitEnd = nullptr;
+        for (const char* pFound = strstr(buffer, ".service"); nullptr != pFound; pFound = strstr(pFound + 1, ".service"))
+        {
+            const char chAfter = pFound[8];
+            if ('\0' == chAfter || '\n' == chAfter || '/' == chAfter)
+                pUnitEnd = pFound + 8;
+        }
+        if (nullptr != pUnitEnd)
+        {
+            const char* pUnitStart = pUnitEnd;
+            while (pUnitStart > buffer && '/' != pUnitStart[-1] && '\n' != pUnitStart[-1])
+                --pUnitStart;
+            WideFromUtf8(pUnitStart, size_t(pUnitEnd - pUnitStart), scan.sServiceUnit);
+        }
+    }
+
+    // A zombie has no descriptors; when it last ran is when it exited.
+    if ('Z' == scan.state)
+    {
+        snprintf(szPath, sizeof(szPath), "%lu/sched", (unsigned long)pid);
+        scan.dExecStartMs = SchedExecStartMs(procFd, szPath, scan.nSystemCalls);
+        return;
+    }
+
+    // Threads
+    snprintf(szPath, sizeof(szPath), "%lu/task", (unsigned long)pid);
+    ++scan.nSystemCalls;
+    const int taskDirFd = openat(procFd, szPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR* pTaskDir = (taskDirFd >= 0) ? fdopendir(taskDirFd) : nullptr;
+    if (nullptr == pTaskDir && taskDirFd >= 0)
+    {
+        close(taskDirFd);
+    }
+    else if (nullptr != pTaskDir)
+    {
+        struct dirent* pTask;
+        while (nullptr != (pTask = readdir(pTaskDir)))
+        {
+            if (pTask->d_name[0] >= '0' && pTask->d_name[0] <= '9')
+                scan.tids.push_back(DWORD(strtoul(pTask->d_name, nullptr, 10)));
+        }
+        closedir(pTaskDir);
+    }
+
+    // Descriptors: count them, and find the pidfds. Another user's process' descriptors can't be listed without root.
+    snprintf(szPath, sizeof(szPath), "%lu/fd", (unsigned long)pid);
+    ++scan.nSystemCalls;
+    const int fdDirFd = openat(procFd, szPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fdDirFd < 0)
+        return;
+    DIR* pFdDir = fdopendir(fdDirFd);
+    if (nullptr == pFdDir)
+    {
+        close(fdDirFd);
+        return;
+    }
+    static const char szPidfdLink[] = "anon_inode:[pidfd]";
+    const size_t nPidfdLinkLen = sizeof(szPidfdLink) - 1;
+    char szLink[sizeof(szPidfdLink) + 8];
+    struct dirent* pEntry;
+    while (nullptr != (pEntry = readdir(pFdDir)))
+    {
+        if (pEntry->d_name[0] < '0' || pEntry->d_name[0] > '9')
+            continue;
+        scan.nFds++;
+        ++scan.nSystemCalls;
+        const ssize_t nLinkLen = readlinkat(fdDirFd, pEntry->d_name, szLink, sizeof(szLink));
+        if (size_t(nLinkLen) != nPidfdLinkLen || 0 != memcmp(szLink, szPidfdLink, nPidfdLinkLen))
+            continue;
+
+        // fdinfo of a pidfd: "pos:\t0\nflags:\t...\nmnt_id:\t...\nino:\t...\nPid:\t1234\nNSpid:\t1234\n"
+        snprintf(szPath, sizeof(szPath), "%lu/fdinfo/%s", (unsigned long)pid, pEntry->d_name);
+        if (ReadSmallFile(procFd, szPath, buffer, 512, scan.nSystemCalls) <= 0)
+            continue;
+        bool bPidFound = false, bInodeFound = false;
+        LinuxPidfd pidfd;
+        pidfd.fd = atoi(pEntry->d_name);
+        pidfd.targetPID = FieldValue(buffer, "Pid", bPidFound);
+        pidfd.ulInode = ULONGLONG(FieldValue(buffer, "ino", bInodeFound));
+        if (bPidFound)
+            scan.pidfds.push_back(pidfd);
+    }
+    closedir(pFdDir);
+}
+
+/// <summary>
+/// Object "address" of a handle table entry of a snapshot: a key that identifies the process it references.
+/// The low bits distinguish the kinds of keys: by PID, by pidfd inode, or unique to one pidfd.
+/// </summary>
+static PVOID ProcessObjectKey(ULONGLONG ulValue, ULONG_PTR kind)
+{
+    return PVOID((ULONG_PTR(ulValue) << 2) | kind);
+}
+static const ULONG_PTR ObjectKeyByPID = 1, ObjectKeyByInode = 2, ObjectKeyUnique = 3;
+
+/// <summary>
+/// Returns a handle table entry.
+/// </summary>
+static SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX HandleEntry(PVOID pObject, ULONG_PTR holderPID, ULONG_PTR handleValue)
+{
+    SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX entry = { 0 };
+    entry.Object = pObject;
+    entry.UniqueProcessId = holderPID;
+    entry.HandleValue = handleValue;
+    entry.GrantedAccess = PROCESS_QUERY_LIMITED_INFORMATION;
+    entry.ObjectTypeIndex = ProcessObjectTypeIndex;
+    return entry;
+}
+
+/// <summary>
+/// The current time as a FILETIME value.
+/// </summary>
+static ULONGLONG CurrentFileTime()
+{
+    FILETIME ftNow;
+    GetSystemTimeAsFileTime(&ftNow);
+    return (ULONGLONG(ftNow.dwHighDateTime) << 32) | ftNow.dwLowDateTime;
+}
+
+/// <summary>
+/// Ctor: get the time references for process start times, and determine whether pidfds have distinct inodes (pidfs)
+/// by comparing pidfds to two different processes.
+/// </summary>
+LinuxPlatform::LinuxPlatform()
+{
+    // The boot time, from the time since boot, once, so that the start times computed from it don't vary between scans.
+    struct timespec tsBoot = { 0, 0 };
+    clock_gettime(CLOCK_BOOTTIME, &tsBoot);
+    m_ulBootTime = CurrentFileTime() - (ULONGLONG(tsBoot.tv_sec) * 10000000 + ULONGLONG(tsBoot.tv_nsec) / 100);
+    m_ulTicksPerSec = ULONGLONG(sysconf(_SC_CLK_TCK));
+
+#ifdef SYS_pidfd_open
+    const pid_t otherPID = (getppid() > 0) ? getppid() : 1;
+    const int pidfdSelf = int(syscall(SYS_pidfd_open, getpid(), 0));
+    const int pidfdOther = int(syscall(SYS_pidfd_open, otherPID, 0));
+    struct stat stSelf, stOther;
+    if (pidfdSelf >= 0 && pidfdOther >= 0 && 0 == fstat(pidfdSelf, &stSelf) && 0 == fstat(pidfdOther, &stOther))
+    {
+        m_bPidfdInodesDistinct = (stSelf.st_ino != stOther.st_ino);
+    }
+    if (pidfdSelf >= 0)
+        close(pidfdSelf);
+    if (pidfdOther >= 0)
+        close(pidfdOther);
+#endif
+}
+
+DWORD LinuxPlatform::CurrentProcessId()
+{
+    return DWORD(getpid());
+}
+
+/// <summary>
+/// Reading other users' processes' descriptors requires root.
+/// </summary>
+bool LinuxPlatform::BeginPrivilegedAccess(std::wstring& sErrorInfo)
+{
+    if (0 != geteuid())
+    {
+        sErrorInfo = L"Cannot read other processes' file descriptors. This program must be executed as root.";
+        return false;
+    }
+    return true;
+}
+
+ULONGLONG LinuxPlatform::Now()
+{
+    const ULONGLONG ulNow = CurrentFileTime();
+    if (0 == m_ulFirstNowSinceScan)
+        m_ulFirstNowSinceScan = ulNow;
+    return ulNow;
+}
+
+/// <summary>
+/// Starting the enumeration takes a new snapshot.
+/// </summary>
+NTSTATUS LinuxPlatform::GetNextProcess(HANDLE hPrevProcess, bool bSynchronize, HANDLE& hNextProcess)
+{
+    if (nullptr == hPrevProcess)
+    {
+        const NTSTATUS ntStat = Scan();
+        if (STATUS_SUCCESS != ntStat)
+            return ntStat;
+    }
+    return m_snapshot.Processes().GetNextProcess(hPrevProcess, bSynchronize, hNextProcess);
+}
+
+/// <summary>
+/// Returns the handle table of the most recent snapshot; takes one if there isn't one yet.
+/// </summary>
+NTSTATUS LinuxPlatform::QuerySystemHandleInformation(PVOID pBuffer, ULONG ulBufferLength, ULONG* pulReturnLength)
+{
+    if (!m_bScanned)
+    {
+        const NTSTATUS ntStat = Scan();
+        if (STATUS_SUCCESS != ntStat)
+            return ntStat;
+    }
+    return m_snapshot.HandleTable().QuerySystemHandleInformation(pBuffer, ulBufferLength, pulReturnLength);
+}
+
+/// <summary>
+/// Replaces the snapshot with the current contents of /proc. The /proc/[pid] directories are scanned in parallel,
+/// each into its own result, and the results are combined in PID order, so that the snapshot doesn't depend on the
+/// number of workers.
+/// </summary>
+/// <returns>STATUS_SUCCESS, or the reason for failure</returns>
+NTSTATUS LinuxPlatform::Scan()
+{
+    // Exit times are no later than the earliest time the caller got from Now() since the previous scan: the time of
+    // the capture, which it compares them with.
+    const ULONGLONG ulCallerNow = m_ulFirstNowSinceScan;
+    m_ulFirstNowSinceScan = 0;
+
+    // Time references: now; and now on the scheduler clock (which the zombies' last run times are in): when this
+    // thread, which is running, last started running.
+    const ULONGLONG ulNow = CurrentFileTime();
+    const ULONGLONG ulLatestExit = (0 != ulCallerNow && ulCallerNow < ulNow) ? ulCallerNow : ulNow;
+    const double dSchedNowMs = SchedExecStartMs(AT_FDCWD, "/proc/thread-self/sched", m_nSystemCalls);
+
+    DIR* pProcDir = opendir("/proc");
+    ++m_nSystemCalls;
+    if (nullptr == pProcDir)
+        return STATUS_UNSUCCESSFUL;
+    std::vector<ULONG_PTR> pids;
+    struct dirent* pEntry;
+    while (nullptr != (pEntry = readdir(pProcDir)))
+    {
+        if (pEntry->d_name[0] >= '0' && pEntry->d_name[0] <= '9')
+            pids.push_back(ULONG_PTR(strtoul(pEntry->d_name, nullptr, 10)));
+    }
+    std::sort(pids.begin(), pids.end());
+
+    std::vector<LinuxProcessScan> scans(pids.size());
+    const int procFd = dirfd(pProcDir);
+    RunPartitioned(pids.size(), PartitionCount(pids.size(), 0, nMinProcessesPerPartition),
+        [&](size_t, size_t ixBegin, size_t ixEnd)
+        {
+            for (size_t ix = ixBegin; ix < ixEnd; ++ix)
+                ScanProcess(procFd, pids[ix], scans[ix]);
+        });
+    closedir(pProcDir);
+
+    // Build the snapshot: all processes, with the zombies in state Z, and a handle table entry for each reference to a zombie.
+    m_snapshot.Clear();
+    // (Only processes become zombies here, so no handle table entry references a thread.)
+    m_snapshot.SetObjectTypeIndexes(ProcessObjectTypeIndex, 0);
+    const ULONG_PTR currentPID = ULONG_PTR(getpid());
+    m_snapshot.SetCurrentProcessId(DWORD(currentPID));
+    m_snapshot.SetTime(ulNow);
+    std::vector<SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX> entries;
+    ServiceLookupByPID_t services;
+    std::map<FirstSeenKey_t, ULONGLONG> firstSeenExited;
+    std::unordered_map<ULONG_PTR, const LinuxProcessScan*> zombieScans;
+    ULONG_PTR nextHandleValue = ProcessHandleBase;
+    std::wstring sErrorInfo;
+
+    // Returns when a zombie was first seen exited, and remembers it for the next scan
+    auto FirstSeenExited = [&](ULONGLONG ulKey1, ULONGLONG ulKey2, ULONGLONG ulKey3)
+    {
+        const FirstSeenKey_t key(ulKey1, ulKey2, ulKey3);
+        std::map<FirstSeenKey_t, ULONGLONG>::const_iterator iter = m_firstSeenExited.find(key);
+        const ULONGLONG ulFirstSeen = (m_firstSeenExited.end() != iter) ? iter->second : ulLatestExit;
+        firstSeenExited[key] = ulFirstSeen;
+        return ulFirstSeen;
+    };
+
+    for (std::vector<LinuxProcessScan>::const_iterator iScan = scans.begin(); iScan != scans.end(); ++iScan)
+    {
+        m_nSystemCalls += iScan->nSystemCalls;
+        if (!iScan->bValid)
+            continue;
+
+        InMemoryProcess process;
+        process.hProcess = HANDLE(nextHandleValue);
+        nextHandleValue += 4;
+        process.PID = iScan->PID;
+        process.ParentPID = iScan->ParentPID;
+        process.createTime = m_ulBootTime + iScan->ulStartTicks * 10000000 / m_ulTicksPerSec;
+        process.sImagePath = iScan->sImagePath;
+        process.dwHandleCount = iScan->nFds;
+        for (std::vector<DWORD>::const_iterator iTid = iScan->tids.begin(); iTid != iScan->tids.end(); ++iTid)
+        {
+            InMemoryThread thread;
+            thread.hThread = HANDLE(nextHandleValue);
+            nextHandleValue += 4;
+            thread.TID = *iTid;
+            process.threads.push_back(thread);
+        }
+
+        if ('Z' == iScan->state)
+        {
+            // Exit time: when it last ran, if known and plausible
+            const double dSinceExitMs = dSchedNowMs - iScan->dExecStartMs;
+            const ULONGLONG ulSinceExit = ULONGLONG(dSinceExitMs * 10000.0);
+            if (dSchedNowMs >= 0.0 && iScan->dExecStartMs >= 0.0 && dSinceExitMs >= 0.0 && ulSinceExit < ulNow && ulNow - ulSinceExit >= process.createTime)
+                process.exitTime = std::min(ulNow - ulSinceExit, ulLatestExit);
+            else
+                process.exitTime = FirstSeenExited(process.PID, process.createTime, 0);
+            zombieScans[process.PID] = &*iScan;
+
+            // This process' handle to it, and its parent's obligation to reap it
+            const PVOID pObject = ProcessObjectKey(process.PID, ObjectKeyByPID);
+            entries.push_back(HandleEntry(pObject, currentPID, ULONG_PTR(process.hProcess)));
+            if (0 != process.ParentPID)
+                entries.push_back(HandleEntry(pObject, process.ParentPID, UnreapedChildHandleValue));
+        }
+
+        if (iScan->sServiceUnit.length() > 0)
+        {
+            ServiceNames_t names;
+            names.sDisplayName = iScan->sServiceUnit;
+            names.sServiceName = iScan->sServiceUnit.substr(0, iScan->sServiceUnit.length() - 8);
+            services[process.PID].push_back(names);
+        }
+
+        if (!m_snapshot.AddProcess(process, sErrorInfo))
+            return STATUS_UNSUCCESSFUL;
+    }
+
+    // pidfds to zombies, and to reaped processes
+    std::map<ULONGLONG, PVOID> reapedByInode;
+    std::map<FirstSeenKey_t, ULONGLONG> uniqueReapedKeys;
+    for (std::vector<LinuxProcessScan>::const_iterator iScan = scans.begin(); iScan != scans.end(); ++iScan)
+    {
+        for (std::vector<LinuxPidfd>::const_iterator iPidfd = iScan->pidfds.begin(); iPidfd != iScan->pidfds.end(); ++iPidfd)
+        {
+            if (iPidfd->targetPID > 0)
+            {
+                // A pidfd to a running process doesn't matter.
+                if (zombieScans.end() != zombieScans.find(ULONG_PTR(iPidfd->targetPID)))
+                    entries.push_back(HandleEntry(ProcessObjectKey(ULONGLONG(iPidfd->targetPID), ObjectKeyByPID), iScan->PID, ULONG_PTR(iPidfd->fd)));
+            }
+            else if (iPidfd->targetPID < 0)
+            {
+                // Reaped: the pidfds to the same process share an inode, if pidfds have their own inodes.
+                // Otherwise there's no telling which pidfds refer to the same process, so each is its own, first seen
+                // when that descriptor of that holder was.
+                PVOID pObject = nullptr;
+                bool bNewZombie = true;
+                ULONGLONG ulExitTime = 0;
+                if (m_bPidfdInodesDistinct)
+                {
+                    std::map<ULONGLONG, PVOID>::const_iterator iReaped = reapedByInode.find(iPidfd->ulInode);
+                    bNewZombie = (reapedByInode.end() == iReaped);
+                    pObject = bNewZombie ? ProcessObjectKey(iPidfd->ulInode, ObjectKeyByInode) : iReaped->second;
+                    reapedByInode[iPidfd->ulInode] = pObject;
+                    if (bNewZombie)
+                        ulExitTime = FirstSeenExited(0, iPidfd->ulInode, 0);
+                }
+                else
+                {
+                    const FirstSeenKey_t key(iScan->PID, iScan->ulStartTicks, ULONGLONG(iPidfd->fd) + 1);
+                    std::map<FirstSeenKey_t, ULONGLONG>::const_iterator iKey = m_uniqueReapedKeys.find(key);
+                    const ULONGLONG ulKey = (m_uniqueReapedKeys.end() != iKey) ? iKey->second : ++m_nUniqueReapedKeys;
+                    uniqueReapedKeys[key] = ulKey;
+                    pObject = ProcessObjectKey(ulKey, ObjectKeyUnique);
+                    ulExitTime = FirstSeenExited(iScan->PID, iScan->ulStartTicks, ULONGLONG(iPidfd->fd) + 1);
+                }
+                if (bNewZombie)
+                {
+                    InMemoryProcess reaped;
+                    reaped.hProcess = HANDLE(nextHandleValue);
+                    nextHandleValue += 4;
+                    reaped.exitTime = ulExitTime;
+                    reaped.sImagePath = L"(reaped)";
+                    if (!m_snapshot.AddProcess(reaped, sErrorInfo))
+                        return STATUS_UNSUCCESSFUL;
+                    entries.push_back(HandleEntry(pObject, currentPID, ULONG_PTR(reaped.hProcess)));
+                }
+                entries.push_back(HandleEntry(pObject, iScan->PID, ULONG_PTR(iPidfd->fd)));
+            }
+        }
+    }
+
+    m_snapshot.SetHandleTable(entries.data(), entries.size());
+    m_snapshot.SetServices(services);
+    m_firstSeenExited.swap(firstSeenExited);
+    m_uniqueReapedKeys.swap(uniqueReapedKeys);
+    m_bScanned = true;
+    return STATUS_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,128 @@
+// Platform implementation for the live Linux system, from /proc: exited processes that haven't been reaped by their
+// parents (state Z), and processes pinned by the pidfds that other processes hold, including ones that have been reaped.
+
+#pragma once
+
+#ifdef __linux__
+
+#include "PlatformTypes.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include "NtInternal.h"
+#include "Platform.h"
+#include "PlatformInMemory.h"
+
+/// <summary>
+/// Platform implementation for the live Linux system.
+///
+/// Linux has no handle table, so each scan of /proc is expressed as one, for the same correlation as on Windows:
+/// * An exited process that its parent hasn't reaped (state Z) is a zombie, and its parent is an owner, with a
+///   "handle" of value UnreapedChildHandleValue: until the parent waits for it, the zombie stays in the process table.
+/// * A process that holds a pidfd (anon_inode:[pidfd]) to a zombie is an owner, with the descriptor as the handle.
+/// * A pidfd whose process has been reaped (its fdinfo reports Pid -1) pins what's left of that process;
+///   each such process is a zombie with PID 0, whose owners are the processes holding pidfds to it.
+///
+/// Processes and handle table come from a snapshot that is taken when process enumeration starts (GetNextProcess with
+/// no previous process), so that the handle table that the correlation queries next is consistent with it. The snapshot
+/// is held in an InMemoryPlatform, through which the process, thread, and service queries are answered.
+///
+/// Linux doesn't record when a process exited. The exit time of a zombie in state Z is estimated from when it last ran
+/// (se.exec_start in /proc/[pid]/sched, relative to that of the scanning thread); when that's not available, and for
+/// reaped processes, it's the time this instance first saw the process exited. (Before Linux 6.9, pidfds to the same
+/// process can't be told apart, so each pidfd to a reaped process is a zombie of its own, first seen when this
+/// instance first saw that descriptor of that holder.)
+/// </summary>
+class LinuxPlatform :
+    public Platform,
+    private ProcessEnumerator,
+    private HandleTableProvider,
+    private SystemClock
+{
+public:
+    // Ctor: get the time references, and determine whether pidfds have distinct inodes (pidfs)
+    LinuxPlatform();
+    virtual ~LinuxPlatform() = default;
+
+    // Platform
+    ProcessEnumerator& Processes() override { return *this; }
+    ThreadEnumerator& Threads() override { return m_snapshot.Threads(); }
+    HandleTableProvider& HandleTable() override { return *this; }
+    ServiceProvider& Services() override { return m_snapshot.Services(); }
+    SystemClock& Clock() override { return *this; }
+    DWORD CurrentProcessId() override;
+    void ReleaseHandle(HANDLE) override {}
+    bool HasExited(HANDLE hProcessOrThread, bool& bHasExited) override { return m_snapshot.HasExited(hProcessOrThread, bHasExited); }
+    bool BeginPrivilegedAccess(std::wstring& sErrorInfo) override;
+    void EndPrivilegedAccess() override {}
+    ULONGLONG SystemCallCount() const override { return m_nSystemCalls; }
+
+    /// <summary>
+    /// "Handle" value of the handle table entry that represents a parent's obligation to reap a zombie child.
+    /// (Not a file descriptor.)
+    /// </summary>
+    static const ULONG_PTR UnreapedChildHandleValue = ULONG_PTR(-1);
+
+private:
+    // ProcessEnumerator
+    NTSTATUS GetNextProcess(HANDLE hPrevProcess, bool bSynchronize, HANDLE& hNextProcess) override;
+    NTSTATUS QueryBasicInformation(HANDLE hProcess, PlatformProcessBasicInfo& basicInfo) override { return m_snapshot.Processes().QueryBasicInformation(hProcess, basicInfo); }
+    bool GetTimes(HANDLE hProcess, FILETIME& createTime, FILETIME& exitTime) override { return m_snapshot.Processes().GetTimes(hProcess, createTime, exitTime); }
+    NTSTATUS QueryImageFileName(HANDLE hProcess, std::wstring& sImagePath) override { return m_snapshot.Processes().QueryImageFileName(hProcess, sImagePath); }
+    bool GetHandleCount(HANDLE hProcess, DWORD& dwHandleCount) override { return m_snapshot.Processes().GetHandleCount(hProcess, dwHandleCount); }
+    bool GetImagePathFromPID(ULONG_PTR pid, std::wstring& sProcessImagePath) override { return m_snapshot.Processes().GetImagePathFromPID(pid, sProcessImagePath); }
+    bool GetParentProcessImagePathIfStillRunning(ULONG_PTR ppid, const FILETIME& ftChildStartTime, std::wstring& sProcessImagePath) override { return m_snapshot.Processes().GetParentProcessImagePathIfStillRunning(ppid, ftChildStartTime, sProcessImagePath); }
+    bool GetRunningProcesses(std::vector<PlatformProcessIdentity>& processes) override { return m_snapshot.Processes().GetRunningProcesses(processes); }
+    bool FindRunningProcessesByExeName(const std::wstring& sExeName, std::vector<ULONG_PTR>& pids) override { return m_snapshot.Processes().FindRunningProcessesByExeName(sExeName, pids); }
+
+    // HandleTableProvider
+    NTSTATUS QuerySystemHandleInformation(PVOID pBuffer, ULONG ulBufferLength, ULONG* pulReturnLength) override;
+    bool GetObjectTypeIndex(HANDLE h, USHORT& typeIndex) override { return m_snapshot.HandleTable().GetObjectTypeIndex(h, typeIndex); }
+
+    // SystemClock
+    ULONGLONG Now() override;
+
+private:
+    /// <summary>
+    /// Replaces the snapshot with the current contents of /proc.
+    /// </summary>
+    /// <returns>STATUS_SUCCESS, or the reason for failure</returns>
+    NTSTATUS Scan();
+
+private:
+    // The most recent scan
+    InMemoryPlatform m_snapshot;
+    bool m_bScanned = false;
+
+    // Boot time (FILETIME value), and the units of process start times
+    ULONGLONG m_ulBootTime = 0;
+    ULONGLONG m_ulTicksPerSec = 100;
+
+    // True if each pidfd's inode identifies its process (pidfs, Linux 6.9 and later); false if all pidfds share one inode
+    bool m_bPidfdInodesDistinct = false;
+
+    // When each zombie was first seen exited, for zombies whose exit time can't be estimated: by (PID, start time, 0)
+    // for zombies in state Z; for reaped processes, by (0, pidfd inode, 0) if pidfds have their own inodes, and otherwise
+    // by (holder PID, holder start time, fd + 1). Entries are dropped when the zombie is gone.
+    typedef std::tuple<ULONGLONG, ULONGLONG, ULONGLONG> FirstSeenKey_t;
+    std::map<FirstSeenKey_t, ULONGLONG> m_firstSeenExited;
+
+    // Without distinct pidfd inodes, the object key of each reaped process' pidfd, by (holder PID, holder start time,
+    // fd + 1), so that it stays the same from scan to scan; and the last key number assigned. Entries are dropped with
+    // the pidfd.
+    std::map<FirstSeenKey_t, ULONGLONG> m_uniqueReapedKeys;
+    ULONGLONG m_nUniqueReapedKeys = 0;
+
+    // The first value Now() returned since the last scan; 0 if none
+    ULONGLONG m_ulFirstNowSinceScan = 0;
+
+    ULONGLONG m_nSystemCalls = 0;
+
+private:
+    // Not implemented
+    LinuxPlatform(const LinuxPlatform&) = delete;
+    LinuxPlatform& operator = (const LinuxPlatform&) = delete;
+};
+
+#endif
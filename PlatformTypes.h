@@ -0,0 +1,212 @@
+// Portable definitions of the Windows types, status codes, and helper functions that the analysis code uses, so that
+// it builds on operating systems other than Windows. On Windows, everything comes from the SDK headers, including the
+// NTSTATUS codes.
+
+#pragma once
+
+#ifdef _WIN32
+
+// Need to define WIN32_NO_STATUS temporarily when including both Windows.h and ntstatus.h
+#define WIN32_NO_STATUS
+#include <Windows.h>
+#undef WIN32_NO_STATUS
+#include <ntstatus.h>
+
+#else
+
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <cwchar>
+#include <cwctype>
+#include <chrono>
+
+// Integer types have the sizes they have on 64-bit Windows (LLP64), so that structures such as
+// SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX, and files containing them, have the same layout.
+typedef uint8_t BYTE;
+typedef int32_t BOOL;
+typedef uint16_t USHORT, WORD;
+typedef uint32_t ULONG, DWORD;
+typedef int32_t LONG, NTSTATUS;
+typedef uint64_t ULONGLONG;
+typedef int64_t LONGLONG;
+typedef uintptr_t ULONG_PTR, SIZE_T;
+typedef void* PVOID;
+typedef void* HANDLE;
+typedef ULONG* PULONG;
+
+#define FALSE 0
+#define TRUE 1
+#define MAX_PATH 260
+#define MAXDWORD 0xffffffff
+#define FIELD_OFFSET(type, field) offsetof(type, field)
+
+typedef struct _FILETIME
+{
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME, * LPFILETIME;
+
+typedef struct _SYSTEMTIME
+{
+    WORD wYear;
+    WORD wMonth;
+    WORD wDayOfWeek;
+    WORD wDay;
+    WORD wHour;
+    WORD wMinute;
+    WORD wSecond;
+    WORD wMilliseconds;
+} SYSTEMTIME;
+
+typedef union _LARGE_INTEGER
+{
+    struct
+    {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    struct
+    {
+        DWORD LowPart;
+        LONG HighPart;
+    } u;
+    LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+// Status codes of the NT interfaces that the platform interfaces (Platform.h) also use
+#define STATUS_SUCCESS              ((NTSTATUS)0x00000000L)
+#define STATUS_NO_MORE_ENTRIES      ((NTSTATUS)0x8000001AL)
+#define STATUS_UNSUCCESSFUL         ((NTSTATUS)0xC0000001L)
+#define STATUS_NOT_IMPLEMENTED      ((NTSTATUS)0xC0000002L)
+#define STATUS_INFO_LENGTH_MISMATCH ((NTSTATUS)0xC0000004L)
+#define STATUS_INVALID_HANDLE       ((NTSTATUS)0xC0000008L)
+#define STATUS_INSUFFICIENT_RESOURCES ((NTSTATUS)0xC000009AL)
+
+// Access rights recorded in handle table entries
+#define PROCESS_QUERY_LIMITED_INFORMATION 0x1000
+#define THREAD_QUERY_LIMITED_INFORMATION 0x0800
+
+// Win32 error code for a request the platform doesn't support
+#define ERROR_NOT_SUPPORTED 50L
+
+/// <summary>
+/// Case-insensitive string comparisons, as in the Microsoft C runtime
+/// </summary>
+inline int _wcsicmp(const wchar_t* sz1, const wchar_t* sz2)
+{
+    return wcscasecmp(sz1, sz2);
+}
+inline int _wcsnicmp(const wchar_t* sz1, const wchar_t* sz2, size_t nCount)
+{
+    return wcsncasecmp(sz1, sz2, nCount);
+}
+
+/// <summary>
+/// Converts a string to lowercase in place, as in the Microsoft C runtime; the same folding as _wcsicmp's.
+/// </summary>
+inline int _wcslwr_s(wchar_t* sz, size_t nSize)
+{
+    for (size_t ix = 0; ix < nSize && L'\0' != sz[ix]; ++ix)
+        sz[ix] = wchar_t(towlower(wint_t(sz[ix])));
+    return 0;
+}
+
+/// <summary>
+/// The calling thread's last error code; on this platform, errno.
+/// </summary>
+inline DWORD GetLastError()
+{
+    return DWORD(errno);
+}
+
+/// <summary>
+/// Milliseconds since an arbitrary fixed point (on Windows, system start); for measuring intervals.
+/// </summary>
+inline ULONGLONG GetTickCount64()
+{
+    return ULONGLONG(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/// <summary>
+/// The Microsoft C runtime's checked swscanf. Equivalent to swscanf for the numeric conversions the program uses.
+/// </summary>
+#define swscanf_s swscanf
+
+/// <summary>
+/// The current time as a FILETIME: 100-nanosecond intervals since January 1, 1601 (UTC).
+/// </summary>
+inline void GetSystemTimeAsFileTime(LPFILETIME pFileTime)
+{
+    // 100-nanosecond intervals between 1601-01-01 and the Unix epoch, 1970-01-01
+    const ULONGLONG ulUnixEpoch = 116444736000000000ULL;
+    const ULONGLONG ulNow = ulUnixEpoch + ULONGLONG(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count() / 100);
+    pFileTime->dwLowDateTime = DWORD(ulNow);
+    pFileTime->dwHighDateTime = DWORD(ulNow >> 32);
+}
+
+/// <summary>
+/// Converts a FILETIME to calendar date and time (UTC).
+/// </summary>
+inline BOOL FileTimeToSystemTime(const FILETIME* pFileTime, SYSTEMTIME* pSystemTime)
+{
+    const ULONGLONG ulTime = (ULONGLONG(pFileTime->dwHighDateTime) << 32) | pFileTime->dwLowDateTime;
+    const ULONGLONG ulSeconds = ulTime / 10000000;
+    const ULONGLONG ulSecondOfDay = ulSeconds % 86400;
+    // Days since 0000-03-01 in the proleptic Gregorian calendar (1601-01-01 is day 584694), split into 400-year eras
+    // of 146097 days; the year starts in March so that the leap day is at its end.
+    const ULONGLONG ulDays = ulSeconds / 86400 + 584694;
+    const ULONGLONG ulEra = ulDays / 146097;
+    const ULONGLONG ulDayOfEra = ulDays % 146097;
+    const ULONGLONG ulYearOfEra = (ulDayOfEra - ulDayOfEra / 1460 + ulDayOfEra / 36524 - ulDayOfEra / 146096) / 365;
+    const ULONGLONG ulDayOfYear = ulDayOfEra - (365 * ulYearOfEra + ulYearOfEra / 4 - ulYearOfEra / 100);
+    const ULONGLONG ulMonthFromMarch = (5 * ulDayOfYear + 2) / 153;
+    const ULONGLONG ulMonth = ulMonthFromMarch < 10 ? ulMonthFromMarch + 3 : ulMonthFromMarch - 9;
+    pSystemTime->wYear = WORD(ulEra * 400 + ulYearOfEra + (ulMonth <= 2 ? 1 : 0));
+    pSystemTime->wMonth = WORD(ulMonth);
+    pSystemTime->wDay = WORD(ulDayOfYear - (153 * ulMonthFromMarch + 2) / 5 + 1);
+    // 1601-01-01 was a Monday
+    pSystemTime->wDayOfWeek = WORD((ulSeconds / 86400 + 1) % 7);
+    pSystemTime->wHour = WORD(ulSecondOfDay / 3600);
+    pSystemTime->wMinute = WORD(ulSecondOfDay / 60 % 60);
+    pSystemTime->wSecond = WORD(ulSecondOfDay % 60);
+    pSystemTime->wMilliseconds = WORD(ulTime / 10000 % 1000);
+    return TRUE;
+}
+
+/// <summary>
+/// Converts calendar date and time (UTC) to a FILETIME. wDayOfWeek is ignored.
+/// </summary>
+inline BOOL SystemTimeToFileTime(const SYSTEMTIME* pSystemTime, LPFILETIME pFileTime)
+{
+    const SYSTEMTIME& st = *pSystemTime;
+    if (st.wYear < 1601 || st.wMonth < 1 || st.wMonth > 12 || st.wDay < 1 || st.wDay > 31 ||
+        st.wHour > 23 || st.wMinute > 59 || st.wSecond > 59 || st.wMilliseconds > 999)
+        return FALSE;
+    // The inverse of FileTimeToSystemTime's day count: days since 0000-03-01, with the year starting in March.
+    const ULONGLONG ulYear = ULONGLONG(st.wYear) - (st.wMonth <= 2 ? 1 : 0);
+    const ULONGLONG ulEra = ulYear / 400;
+    const ULONGLONG ulYearOfEra = ulYear % 400;
+    const ULONGLONG ulMonthFromMarch = st.wMonth > 2 ? st.wMonth - 3 : st.wMonth + 9;
+    const ULONGLONG ulDayOfYear = (153 * ulMonthFromMarch + 2) / 5 + st.wDay - 1;
+    const ULONGLONG ulDayOfEra = 365 * ulYearOfEra + ulYearOfEra / 4 - ulYearOfEra / 100 + ulDayOfYear;
+    const ULONGLONG ulDays = ulEra * 146097 + ulDayOfEra - 584694;
+    const ULONGLONG ulSeconds = ulDays * 86400 + ULONGLONG(st.wHour) * 3600 + ULONGLONG(st.wMinute) * 60 + st.wSecond;
+    const ULONGLONG ulTime = ulSeconds * 10000000 + ULONGLONG(st.wMilliseconds) * 10000;
+    pFileTime->dwLowDateTime = DWORD(ulTime);
+    pFileTime->dwHighDateTime = DWORD(ulTime >> 32);
+    return TRUE;
+}
+
+/// <summary>
+/// The current calendar date and time (UTC).
+/// </summary>
+inline void GetSystemTime(SYSTEMTIME* pSystemTime)
+{
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    FileTimeToSystemTime(&ft, pSystemTime);
+}
+
+#endif
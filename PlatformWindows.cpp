@@ -0,0 +1,481 @@
+// Platform implementation for the live Windows system: ntdll process/thread enumeration and handle table queries,
+// the Service Control Manager, and the Debug Programs privilege.
+
+#ifdef _WIN32
+
+#include "PlatformTypes.h"
+#include <sstream>
+#include "SysErrorMessage.h"
+#include "SecurityUtils.h"
+#include "RunStats.h"
+#include "PlatformWindows.h"
+
+/// <summary>
+/// The platform for the operating system the program is running on.
+/// </summary>
+Platform& SystemPlatform()
+{
+    static WindowsPlatform windowsPlatform;
+    return windowsPlatform;
+}
+
+/// <summary>
+/// Ctor: acquire pointers to the ntdll interfaces. Any that aren't available fail with STATUS_NOT_IMPLEMENTED when called.
+/// </summary>
+WindowsPlatform::WindowsPlatform()
+{
+    HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
+    if (nullptr != ntdll)
+    {
+        m_pfnNtGetNextProcess = (pfn_NtGetNextProcess_t)GetProcAddress(ntdll, "NtGetNextProcess");
+        m_pfnNtGetNextThread = (pfn_NtGetNextThread_t)GetProcAddress(ntdll, "NtGetNextThread");
+        m_pfnNtQueryInformationProcess = (pfn_NtQueryInformationProcess_t)GetProcAddress(ntdll, "NtQueryInformationProcess");
+        m_pfnNtQuerySystemInformation = (pfn_NtQuerySystemInformation_t)GetProcAddress(ntdll, "NtQuerySystemInformation");
+        m_pfnNtQueryObject = (pfn_NtQueryObject_t)GetProcAddress(ntdll, "NtQueryObject");
+    }
+}
+
+DWORD WindowsPlatform::CurrentProcessId()
+{
+    return GetCurrentProcessId();
+}
+
+void WindowsPlatform::ReleaseHandle(HANDLE h)
+{
+    CloseHandle(h);
+}
+
+/// <summary>
+/// Indicates whether the process or thread has exited.
+/// </summary>
+/// <param name="hProcessOrThread">Input: handle to a process or a thread</param>
+/// <param name="bHasExited">Output: if function is successful, true if process has exited, false otherwise; undefined if function fails</param>
+/// <returns>true if function succeeds, false otherwise</returns>
+bool WindowsPlatform::HasExited(HANDLE hProcessOrThread, bool& bHasExited)
+{
+    ++m_nSystemCalls;
+    DWORD dwRet = WaitForSingleObject(hProcessOrThread, 0);
+    switch (dwRet)
+    {
+    case WAIT_OBJECT_0:
+        bHasExited = true;
+        return true;
+    case WAIT_TIMEOUT:
+        bHasExited = false;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/// <summary>
+/// Enables the Debug Programs privilege for the current thread, so that all processes can be opened.
+/// </summary>
+bool WindowsPlatform::BeginPrivilegedAccess(std::wstring& sErrorInfo)
+{
+    // Essentially, ensure that this thread has its own token and not that of the process token.
+    if (!ImpersonateSelf(SecurityImpersonation))
+    {
+        std::wstringstream strErrorInfo;
+        DWORD dwLastErr = GetLastError();
+        strErrorInfo << L"ImpersonateSelf failed: " << SysErrorMessageWithCode(dwLastErr);
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    // Enable the Debug Programs privilege. Fail if it's not available to be enabled.
+    std::wstring sPrivError;
+    if (!EnablePrivilege(SE_DEBUG_NAME, sPrivError))
+    {
+        RevertToSelf();
+        std::wstringstream strErrorInfo;
+        strErrorInfo
+            << L"Cannot enable Debug Programs privilege. This program must be executed with administrative privileges." << std::endl
+            << sPrivError;
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Reverts to using the process token.
+/// </summary>
+void WindowsPlatform::EndPrivilegedAccess()
+{
+    RevertToSelf();
+}
+
+/// <summary>
+/// NtGetNextProcess.
+/// Need to use PROCESS_QUERY_LIMITED_INFORMATION for the enumeration to include protected processes and other interesting processes.
+/// Using MAXIMUM_ALLOWED, or MAXIMUM_ALLOWED|PROCESS_QUERY_LIMITED_INFORMATION doesn't work. There's a never-going-to-be-fixed bug
+/// in Windows where trying to open a process with MAXIMUM_ALLOWED doesn't work if PROCESS_QUERY_LIMITED_INFORMATION is the only
+/// allowed permission - it needs to be requested explicitly.
+/// </summary>
+NTSTATUS WindowsPlatform::GetNextProcess(HANDLE hPrevProcess, bool bSynchronize, HANDLE& hNextProcess)
+{
+    if (nullptr == m_pfnNtGetNextProcess)
+        return STATUS_NOT_IMPLEMENTED;
+    ++m_nSystemCalls;
+    const ACCESS_MASK access = PROCESS_QUERY_LIMITED_INFORMATION | (bSynchronize ? SYNCHRONIZE : 0);
+    return m_pfnNtGetNextProcess(hPrevProcess, access, 0, 0, &hNextProcess);
+}
+
+/// <summary>
+/// NtQueryInformationProcess(ProcessBasicInformation), with the extended structure that includes IsProcessDeleting.
+/// </summary>
+NTSTATUS WindowsPlatform::QueryBasicInformation(HANDLE hProcess, PlatformProcessBasicInfo& basicInfo)
+{
+    if (nullptr == m_pfnNtQueryInformationProcess)
+        return STATUS_NOT_IMPLEMENTED;
+    PROCESS_EXTENDED_BASIC_INFORMATION processExtBasicInfo = { 0 };
+    processExtBasicInfo.Size = sizeof(processExtBasicInfo);
+    ULONG infoLen = ULONG(sizeof(processExtBasicInfo));
+    ++m_nSystemCalls;
+    NTSTATUS ntStat = m_pfnNtQueryInformationProcess(hProcess, ProcessBasicInformation, &processExtBasicInfo, infoLen, &infoLen);
+    if (STATUS_SUCCESS == ntStat)
+    {
+        basicInfo.PID = processExtBasicInfo.BasicInfo.UniqueProcessId;
+        basicInfo.ParentPID = processExtBasicInfo.BasicInfo.InheritedFromUniqueProcessId;
+        basicInfo.bDeleting = (0 != processExtBasicInfo.IsProcessDeleting);
+    }
+    return ntStat;
+}
+
+bool WindowsPlatform::GetTimes(HANDLE hProcess, FILETIME& createTime, FILETIME& exitTime)
+{
+    FILETIME unused1, unused2;
+    ++m_nSystemCalls;
+    return FALSE != GetProcessTimes(hProcess, &createTime, &exitTime, &unused1, &unused2);
+}
+
+/// <summary>
+/// NtQueryInformationProcess(ProcessImageFileName). The Win32 API won't work for a process that has exited.
+/// </summary>
+NTSTATUS WindowsPlatform::QueryImageFileName(HANDLE hProcess, std::wstring& sImagePath)
+{
+    sImagePath.clear();
+    if (nullptr == m_pfnNtQueryInformationProcess)
+        return STATUS_NOT_IMPLEMENTED;
+    // Buffer should be large enough - add extra for the UNICODE_STRING overhead.
+    BYTE buffer[MAX_PATH * sizeof(wchar_t) + sizeof(UNICODE_STRING)] = { 0 };
+    ULONG returnLength = 0;
+    ++m_nSystemCalls;
+    NTSTATUS ntStat = m_pfnNtQueryInformationProcess(hProcess, ProcessImageFileName, buffer, MAX_PATH * sizeof(wchar_t), &returnLength);
+    if (STATUS_SUCCESS == ntStat)
+    {
+        const wchar_t* szImagePath = ((UNICODE_STRING*)buffer)->Buffer;
+        if (nullptr != szImagePath)
+            sImagePath = szImagePath;
+    }
+    return ntStat;
+}
+
+bool WindowsPlatform::GetHandleCount(HANDLE hProcess, DWORD& dwHandleCount)
+{
+    ++m_nSystemCalls;
+    return FALSE != GetProcessHandleCount(hProcess, &dwHandleCount);
+}
+
+/// <summary>
+/// Gets the executable image path associated with a Process ID, if that process is running
+/// </summary>
+/// <param name="pid">Input: process ID</param>
+/// <param name="sProcessImagePath">Output: full image path of executable, if running; error text otherwise</param>
+/// <returns>true if successful</returns>
+bool WindowsPlatform::GetImagePathFromPID(ULONG_PTR pid, std::wstring& sProcessImagePath)
+{
+    sProcessImagePath.clear();
+
+    // Getting the executable image path of the parent process requires PROCESS_QUERY_LIMITED_INFORMATION or PROCESS_QUERY_INFORMATION
+    ++m_nSystemCalls;
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(pid));
+    if (NULL != hProcess)
+    {
+        // MAX_PATH*2 should be plenty for all expected use cases.
+        // Unfortunately, if QueryFullProcessImageNameW fails with ERROR_INSUFFICIENT_BUFFER, the fourth parameter does not return
+        // the required buffer size, as most APIs like this do.
+        wchar_t szImagePath[MAX_PATH * 2] = { 0 };
+        DWORD dwPathSize = sizeof(szImagePath) / sizeof(szImagePath[0]);
+        ++m_nSystemCalls;
+        BOOL ret = QueryFullProcessImageNameW(hProcess, 0, szImagePath, &dwPathSize);
+        CloseHandle(hProcess);
+        if (ret)
+        {
+            sProcessImagePath = szImagePath;
+            return true;
+        }
+        else
+        {
+            DWORD dwLastError = GetLastError();
+            sProcessImagePath = SysErrorMessageWithCode(dwLastError);
+        }
+    }
+    else
+    {
+        DWORD dwLastErr = GetLastError();
+        sProcessImagePath = SysErrorMessageWithCode(dwLastErr);
+    }
+    return false;
+}
+
+/// <summary>
+/// Gets the executable image path of the parent process, if possible.
+/// "Possible" means that the input parent process ID is a still-running process and that its start time
+/// is no later than the child process start time. (Start times are only as fine as the clock that records them, so a
+/// parent that starts its child right away can have the same start time; a process that reused the parent's PID
+/// started after the child.)
+/// </summary>
+/// <param name="ppid">Input: parent process ID</param>
+/// <param name="ftChildStartTime">Input: child process start time</param>
+/// <param name="sProcessImagePath">Output: full image path of executable associated with ppid</param>
+/// <returns>true if successful</returns>
+bool WindowsPlatform::GetParentProcessImagePathIfStillRunning(ULONG_PTR ppid, const FILETIME& ftChildStartTime, std::wstring& sProcessImagePath)
+{
+    bool retval = false;
+    sProcessImagePath.clear();
+    ++m_nSystemCalls;
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, DWORD(ppid));
+    if (nullptr != hProcess)
+    {
+        // Note: FILETIME, ULARGE_INTEGER, and ULONGLONG are all 8 bytes, and lay out the same way.
+        FILETIME ftCreateTime, ftExitTime, ftKernelTime, ftUserTime;
+        ++m_nSystemCalls;
+        if (GetProcessTimes(hProcess, &ftCreateTime, &ftExitTime, &ftKernelTime, &ftUserTime))
+        {
+            const ULONGLONG& ulStartTime = (*(const ULONGLONG*)&ftCreateTime);
+            const ULONGLONG& ulChildStartTime = (*(const ULONGLONG*)&ftChildStartTime);
+            if (ulStartTime <= ulChildStartTime)
+            {
+                retval = true;
+
+                // MAX_PATH*2 should be plenty for all expected use cases.
+                wchar_t szImagePath[MAX_PATH * 2] = { 0 };
+                DWORD dwPathSize = sizeof(szImagePath) / sizeof(szImagePath[0]);
+                ++m_nSystemCalls;
+                BOOL ret = QueryFullProcessImageNameW(hProcess, 0, szImagePath, &dwPathSize);
+                if (ret)
+                {
+                    sProcessImagePath = szImagePath;
+                }
+            }
+        }
+        CloseHandle(hProcess);
+    }
+    return retval;
+}
+
+/// <summary>
+/// NtQuerySystemInformation(SystemProcessInformation) into m_processInfoBuffer.
+/// </summary>
+bool WindowsPlatform::QueryProcessInformation()
+{
+    if (nullptr == m_pfnNtQuerySystemInformation)
+        return false;
+
+    // Processes can start between calls, so allow for more than the size the previous call reported.
+    NTSTATUS ntStat = STATUS_INFO_LENGTH_MISMATCH;
+    for (int nTries = 0; STATUS_INFO_LENGTH_MISMATCH == ntStat && nTries < 5; ++nTries)
+    {
+        if (m_processInfoBuffer.empty())
+            m_processInfoBuffer.resize(256 * 1024);
+        ULONG ulReturnLength = 0;
+        ++m_nSystemCalls;
+        ntStat = m_pfnNtQuerySystemInformation(SystemProcessInformation, m_processInfoBuffer.data(), ULONG(m_processInfoBuffer.size()), &ulReturnLength);
+        if (STATUS_INFO_LENGTH_MISMATCH == ntStat)
+            m_processInfoBuffer.resize(size_t(ulReturnLength) + size_t(ulReturnLength) / 4);
+    }
+    return STATUS_SUCCESS == ntStat;
+}
+
+/// <summary>
+/// NtQuerySystemInformation(SystemProcessInformation): one call for all processes, rather than opening each of them.
+/// </summary>
+bool WindowsPlatform::GetRunningProcesses(std::vector<PlatformProcessIdentity>& processes)
+{
+    processes.clear();
+    if (!QueryProcessInformation())
+        return false;
+
+    const BYTE* pEntry = m_processInfoBuffer.data();
+    for (;;)
+    {
+        const SYSTEM_PROCESS_INFORMATION_HEADER* pInfo = (const SYSTEM_PROCESS_INFORMATION_HEADER*)pEntry;
+        // (Skip the System Idle Process, PID 0, which can't be opened.)
+        if (nullptr != pInfo->UniqueProcessId)
+        {
+            PlatformProcessIdentity identity;
+            identity.PID = ULONG_PTR(pInfo->UniqueProcessId);
+            identity.createTime = ULONGLONG(pInfo->CreateTime.QuadPart);
+            processes.push_back(identity);
+        }
+        if (0 == pInfo->NextEntryOffset)
+            break;
+        pEntry += pInfo->NextEntryOffset;
+    }
+    return true;
+}
+
+/// <summary>
+/// NtQuerySystemInformation(SystemProcessInformation), whose ImageName is the executable file name.
+/// </summary>
+bool WindowsPlatform::FindRunningProcessesByExeName(const std::wstring& sExeName, std::vector<ULONG_PTR>& pids)
+{
+    pids.clear();
+    if (!QueryProcessInformation())
+        return false;
+
+    const BYTE* pEntry = m_processInfoBuffer.data();
+    for (;;)
+    {
+        const SYSTEM_PROCESS_INFORMATION_HEADER* pInfo = (const SYSTEM_PROCESS_INFORMATION_HEADER*)pEntry;
+        // (ImageName isn't null-terminated; its Length is in bytes.)
+        const size_t nNameLength = pInfo->ImageName.Length / sizeof(wchar_t);
+        if (nullptr != pInfo->UniqueProcessId && nullptr != pInfo->ImageName.Buffer &&
+            sExeName.length() == nNameLength && 0 == _wcsnicmp(sExeName.c_str(), pInfo->ImageName.Buffer, nNameLength))
+        {
+            pids.push_back(ULONG_PTR(pInfo->UniqueProcessId));
+        }
+        if (0 == pInfo->NextEntryOffset)
+            break;
+        pEntry += pInfo->NextEntryOffset;
+    }
+    return true;
+}
+
+/// <summary>
+/// Opens the process with PROCESS_QUERY_INFORMATION, which NtGetNextThread requires.
+/// </summary>
+HANDLE WindowsPlatform::OpenProcessForThreads(ULONG_PTR pid)
+{
+    ++m_nSystemCalls;
+#pragma warning(push)
+#pragma warning(disable:4244) // Nt vs. Win32 API issue: 'argument': conversion from 'ULONG_PTR' to 'DWORD', possible loss of data
+    return OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, pid);
+#pragma warning(pop)
+}
+
+/// <summary>
+/// NtGetNextThread.
+/// </summary>
+NTSTATUS WindowsPlatform::GetNextThread(HANDLE hProcess, HANDLE hPrevThread, bool bSynchronize, HANDLE& hNextThread)
+{
+    if (nullptr == m_pfnNtGetNextThread)
+        return STATUS_NOT_IMPLEMENTED;
+    ++m_nSystemCalls;
+    const ACCESS_MASK access = THREAD_QUERY_LIMITED_INFORMATION | (bSynchronize ? SYNCHRONIZE : 0);
+    return m_pfnNtGetNextThread(hProcess, hPrevThread, access, 0, 0, &hNextThread);
+}
+
+DWORD WindowsPlatform::GetThreadId(HANDLE hThread)
+{
+    return ::GetThreadId(hThread);
+}
+
+/// <summary>
+/// NtQuerySystemInformation(SystemExtendedHandleInformation).
+/// </summary>
+NTSTATUS WindowsPlatform::QuerySystemHandleInformation(PVOID pBuffer, ULONG ulBufferLength, ULONG* pulReturnLength)
+{
+    if (nullptr == m_pfnNtQuerySystemInformation)
+        return STATUS_NOT_IMPLEMENTED;
+    ++m_nSystemCalls;
+    return m_pfnNtQuerySystemInformation(SystemExtendedHandleInformation, pBuffer, ulBufferLength, pulReturnLength);
+}
+
+/// <summary>
+/// Gets the object type index of a handle held by the current process, as the systemwide handle table reports it.
+/// Requires Windows 8.1 or later; earlier versions don't report the index.
+/// </summary>
+bool WindowsPlatform::GetObjectTypeIndex(HANDLE h, USHORT& typeIndex)
+{
+    if (nullptr == m_pfnNtQueryObject)
+        return false;
+    // Room for the structure and the type name that follows it (e.g., "Process"); 8-byte aligned
+    ULONGLONG buffer[128];
+    ULONG ulReturnLength = 0;
+    ++m_nSystemCalls;
+    NTSTATUS ntStat = m_pfnNtQueryObject(h, ObjectTypeInformation, buffer, sizeof(buffer), &ulReturnLength);
+    if (STATUS_SUCCESS != ntStat)
+        return false;
+    typeIndex = ((const OBJECT_TYPE_INFORMATION_FULL*)buffer)->TypeIndex;
+    return 0 != typeIndex;
+}
+
+/// <summary>
+/// Queries the Service Control Manager for the active Win32 services and the processes hosting them.
+/// </summary>
+bool WindowsPlatform::EnumerateServices(ServiceLookupByPID_t& serviceLookup, std::wstring& sErrorInfo)
+{
+    serviceLookup.clear();
+    sErrorInfo.clear();
+
+    SC_HANDLE hSCM = OpenSCManagerW(NULL, NULL, SC_MANAGER_ENUMERATE_SERVICE);
+    if (NULL == hSCM)
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"OpenSCManagerW failed: " << SysErrorMessageWithCode();
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    DWORD cbBytesNeeded = 0, dwServicesReturned = 0, dwResumeHandle = 0;
+#pragma warning(push)
+#pragma warning(disable:6031) // False positive: "Return value ignored: 'EnumServicesStatusExW'"
+    EnumServicesStatusExW(hSCM, SC_ENUM_PROCESS_INFO, SERVICE_WIN32, SERVICE_ACTIVE, nullptr, 0, &cbBytesNeeded, &dwServicesReturned, &dwResumeHandle, nullptr);
+#pragma warning(pop)
+    DWORD dwLastErr = GetLastError();
+    if (ERROR_MORE_DATA != dwLastErr)
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"EnumServicesStatusExW (first call) failed: " << SysErrorMessageWithCode(dwLastErr);
+        sErrorInfo = strErrorInfo.str();
+        CloseServiceHandle(hSCM);
+        return false;
+    }
+    // Add 50% in case other services have become active in between calls.
+    cbBytesNeeded = cbBytesNeeded + cbBytesNeeded / 2;
+    LPENUM_SERVICE_STATUS_PROCESSW pServiceInfoBuffer = LPENUM_SERVICE_STATUS_PROCESSW(new BYTE[cbBytesNeeded]);
+    StatsAddCount(StatsCounter_t::BufferAllocations);
+    StatsAddCount(StatsCounter_t::BytesAllocated, cbBytesNeeded);
+    BOOL ret = EnumServicesStatusExW(hSCM, SC_ENUM_PROCESS_INFO, SERVICE_WIN32, SERVICE_ACTIVE, (LPBYTE)pServiceInfoBuffer, cbBytesNeeded, &cbBytesNeeded, &dwServicesReturned, &dwResumeHandle, nullptr);
+    if (!ret)
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"EnumServicesStatusExW (second call) failed: " << SysErrorMessageWithCode();
+        sErrorInfo = strErrorInfo.str();
+    }
+    else
+    {
+        for (DWORD ix = 0; ix < dwServicesReturned; ++ix)
+        {
+#pragma warning(push)
+#pragma warning(disable:6385) // False positive: "Reading invalid data from 'pServiceInfoBuffer'"
+            const ENUM_SERVICE_STATUS_PROCESSW& svc = pServiceInfoBuffer[ix];
+#pragma warning(pop)
+            ServiceNames_t names;
+            names.sDisplayName = svc.lpDisplayName;
+            names.sServiceName = svc.lpServiceName;
+            serviceLookup[svc.ServiceStatusProcess.dwProcessId].push_back(names);
+        }
+    }
+
+    delete[](LPBYTE)pServiceInfoBuffer;
+    CloseServiceHandle(hSCM);
+    return FALSE != ret;
+}
+
+/// <summary>
+/// The current time as a FILETIME value.
+/// </summary>
+ULONGLONG WindowsPlatform::Now()
+{
+    // Note that FILETIME and ULONGLONG are somewhat interchangeable here.
+    ULONGLONG ulNow = 0;
+    GetSystemTimeAsFileTime((LPFILETIME)&ulNow);
+    return ulNow;
+}
+
+#endif
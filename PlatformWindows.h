@@ -0,0 +1,93 @@
+// Platform implementation for the live Windows system: ntdll process/thread enumeration and handle table queries,
+// the Service Control Manager, and the Debug Programs privilege.
+
+#pragma once
+
+#ifdef _WIN32
+
+#include "PlatformTypes.h"
+#include <atomic>
+#include <vector>
+#include "NtInternal.h"
+#include "Platform.h"
+
+/// <summary>
+/// Platform implementation for the live Windows system.
+/// </summary>
+class WindowsPlatform :
+    public Platform,
+    private ProcessEnumerator,
+    private ThreadEnumerator,
+    private HandleTableProvider,
+    private ServiceProvider,
+    private SystemClock
+{
+public:
+    // Ctor: acquire pointers to the ntdll interfaces
+    WindowsPlatform();
+    virtual ~WindowsPlatform() = default;
+
+    // Platform
+    ProcessEnumerator& Processes() override { return *this; }
+    ThreadEnumerator& Threads() override { return *this; }
+    HandleTableProvider& HandleTable() override { return *this; }
+    ServiceProvider& Services() override { return *this; }
+    SystemClock& Clock() override { return *this; }
+    DWORD CurrentProcessId() override;
+    void ReleaseHandle(HANDLE h) override;
+    bool HasExited(HANDLE hProcessOrThread, bool& bHasExited) override;
+    bool BeginPrivilegedAccess(std::wstring& sErrorInfo) override;
+    void EndPrivilegedAccess() override;
+    ULONGLONG SystemCallCount() const override { return m_nSystemCalls; }
+
+private:
+    // ProcessEnumerator
+    NTSTATUS GetNextProcess(HANDLE hPrevProcess, bool bSynchronize, HANDLE& hNextProcess) override;
+    NTSTATUS QueryBasicInformation(HANDLE hProcess, PlatformProcessBasicInfo& basicInfo) override;
+    bool GetTimes(HANDLE hProcess, FILETIME& createTime, FILETIME& exitTime) override;
+    NTSTATUS QueryImageFileName(HANDLE hProcess, std::wstring& sImagePath) override;
+    bool GetHandleCount(HANDLE hProcess, DWORD& dwHandleCount) override;
+    bool GetImagePathFromPID(ULONG_PTR pid, std::wstring& sProcessImagePath) override;
+    bool GetParentProcessImagePathIfStillRunning(ULONG_PTR ppid, const FILETIME& ftChildStartTime, std::wstring& sProcessImagePath) override;
+    bool GetRunningProcesses(std::vector<PlatformProcessIdentity>& processes) override;
+    bool FindRunningProcessesByExeName(const std::wstring& sExeName, std::vector<ULONG_PTR>& pids) override;
+
+    // ThreadEnumerator
+    HANDLE OpenProcessForThreads(ULONG_PTR pid) override;
+    NTSTATUS GetNextThread(HANDLE hProcess, HANDLE hPrevThread, bool bSynchronize, HANDLE& hNextThread) override;
+    DWORD GetThreadId(HANDLE hThread) override;
+
+    // HandleTableProvider
+    NTSTATUS QuerySystemHandleInformation(PVOID pBuffer, ULONG ulBufferLength, ULONG* pulReturnLength) override;
+    bool GetObjectTypeIndex(HANDLE h, USHORT& typeIndex) override;
+
+    // ServiceProvider
+    bool EnumerateServices(ServiceLookupByPID_t& serviceLookup, std::wstring& sErrorInfo) override;
+
+    // SystemClock
+    ULONGLONG Now() override;
+
+    // NtQuerySystemInformation(SystemProcessInformation) into m_processInfoBuffer
+    bool QueryProcessInformation();
+
+private:
+    // ntdll interfaces; nullptr if not available
+    pfn_NtGetNextProcess_t m_pfnNtGetNextProcess = nullptr;
+    pfn_NtGetNextThread_t m_pfnNtGetNextThread = nullptr;
+    pfn_NtQueryInformationProcess_t m_pfnNtQueryInformationProcess = nullptr;
+    pfn_NtQuerySystemInformation_t m_pfnNtQuerySystemInformation = nullptr;
+    pfn_NtQueryObject_t m_pfnNtQueryObject = nullptr;
+
+    // SystemProcessInformation buffer, kept between calls
+    std::vector<BYTE> m_processInfoBuffer;
+
+    // Incremented by the workers that enumerate threads concurrently
+    std::atomic<ULONGLONG> m_nSystemCalls{ 0 };
+
+private:
+    // Not implemented
+    WindowsPlatform(const WindowsPlatform&) = delete;
+    WindowsPlatform& operator = (const WindowsPlatform&) = delete;
+};
+
+#endif
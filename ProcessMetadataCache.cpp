@@ -0,0 +1,133 @@
+// Cache of information about running processes (owners and zombies' parents), kept across process enumeration passes.
+
+#include "ProcessMetadataCache.h"
+
+/// <summary>
+/// Call at the start of each enumeration pass.
+/// </summary>
+/// <param name="processes">Input: the processes to query in this pass; must remain valid until EndPass</param>
+void ProcessMetadataCache::BeginPass(ProcessEnumerator& processes)
+{
+    // A different source's processes aren't the cached ones.
+    if (m_pProcesses != &processes)
+        m_entries.clear();
+    m_pProcesses = &processes;
+    m_running.clear();
+    m_bSnapshotTaken = m_bSnapshotValid = false;
+}
+
+/// <summary>
+/// Call at the end of each enumeration pass: evicts entries for processes that are no longer running.
+/// </summary>
+void ProcessMetadataCache::EndPass()
+{
+    // Without a snapshot this pass, there's nothing to say the cached processes have exited.
+    if (!m_bSnapshotValid)
+        return;
+
+    std::unordered_map<ULONG_PTR, ProcessMetadata>::iterator iter = m_entries.begin();
+    while (iter != m_entries.end())
+    {
+        std::unordered_map<ULONG_PTR, ULONGLONG>::const_iterator iRunning = m_running.find(iter->first);
+        if (m_running.end() == iRunning || iRunning->second != iter->second.createTime)
+        {
+            iter = m_entries.erase(iter);
+            ++m_nEvictions;
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+/// <summary>
+/// Takes this pass' snapshot of the running processes if it hasn't been taken yet.
+/// </summary>
+/// <returns>true if the snapshot is available</returns>
+bool ProcessMetadataCache::EnsureSnapshot()
+{
+    if (!m_bSnapshotTaken)
+    {
+        m_bSnapshotTaken = true;
+        ++m_nSnapshots;
+        m_bSnapshotValid = m_pProcesses->GetRunningProcesses(m_snapshotList);
+        if (m_bSnapshotValid)
+        {
+            m_running.reserve(m_snapshotList.size());
+            for (
+                std::vector<PlatformProcessIdentity>::const_iterator iter = m_snapshotList.begin();
+                iter != m_snapshotList.end();
+                ++iter
+                )
+            {
+                m_running[iter->PID] = iter->createTime;
+            }
+        }
+    }
+    return m_bSnapshotValid;
+}
+
+/// <summary>
+/// Returns the information about a process in the snapshot, querying the platform for it if it isn't cached.
+/// </summary>
+const ProcessMetadata& ProcessMetadataCache::Resolve(ULONG_PTR pid, ULONGLONG createTime)
+{
+    std::unordered_map<ULONG_PTR, ProcessMetadata>::iterator iter = m_entries.find(pid);
+    // Same PID but different creation time: the PID was reused, and the cached information is for a different process.
+    if (iter != m_entries.end() && iter->second.createTime == createTime)
+    {
+        ++m_nHits;
+        return iter->second;
+    }
+    ++m_nMisses;
+    ProcessMetadata& entry = (iter != m_entries.end()) ? iter->second : m_entries[pid];
+    entry.createTime = createTime;
+    entry.bImagePathValid = m_pProcesses->GetImagePathFromPID(pid, entry.sImagePath);
+    return entry;
+}
+
+/// <summary>
+/// Gets the executable image path of a running process, as ProcessEnumerator::GetImagePathFromPID does.
+/// </summary>
+/// <param name="pid">Input: process ID</param>
+/// <param name="sProcessImagePath">Output: full image path of executable, if running; otherwise error text, or empty</param>
+/// <returns>true if successful</returns>
+bool ProcessMetadataCache::GetImagePathFromPID(ULONG_PTR pid, std::wstring& sProcessImagePath)
+{
+    std::unordered_map<ULONG_PTR, ULONGLONG>::const_iterator iRunning;
+    if (!EnsureSnapshot() || m_running.end() == (iRunning = m_running.find(pid)))
+    {
+        // Not known to be running, so not cacheable; the platform reports why there's no image path.
+        return m_pProcesses->GetImagePathFromPID(pid, sProcessImagePath);
+    }
+
+    const ProcessMetadata& entry = Resolve(pid, iRunning->second);
+    sProcessImagePath = entry.sImagePath;
+    return entry.bImagePathValid;
+}
+
+/// <summary>
+/// Gets the executable image path of the parent process, if it's running and started no later than the child,
+/// as ProcessEnumerator::GetParentProcessImagePathIfStillRunning does.
+/// </summary>
+/// <param name="ppid">Input: parent process ID</param>
+/// <param name="ftChildStartTime">Input: child process start time</param>
+/// <param name="sProcessImagePath">Output: full image path of executable associated with ppid</param>
+/// <returns>true if successful</returns>
+bool ProcessMetadataCache::GetParentProcessImagePathIfStillRunning(ULONG_PTR ppid, const FILETIME& ftChildStartTime, std::wstring& sProcessImagePath)
+{
+    if (!EnsureSnapshot())
+        return m_pProcesses->GetParentProcessImagePathIfStillRunning(ppid, ftChildStartTime, sProcessImagePath);
+
+    sProcessImagePath.clear();
+    // A running process with the parent's PID that started after the child is a different process that reused the PID.
+    std::unordered_map<ULONG_PTR, ULONGLONG>::const_iterator iRunning = m_running.find(ppid);
+    if (m_running.end() == iRunning || iRunning->second > *(const ULONGLONG*)&ftChildStartTime)
+        return false;
+
+    const ProcessMetadata& entry = Resolve(ppid, iRunning->second);
+    if (entry.bImagePathValid)
+        sProcessImagePath = entry.sImagePath;
+    return true;
+}
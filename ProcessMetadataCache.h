@@ -0,0 +1,117 @@
+// Cache of information about running processes (owners and zombies' parents), kept across process enumeration passes.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "Platform.h"
+
+/// <summary>
+/// Information about a running process that doesn't change while it runs.
+/// </summary>
+struct ProcessMetadata
+{
+    /// <summary>
+    /// Process creation time; together with the PID, identifies the process. (PIDs are reused.)
+    /// </summary>
+    ULONGLONG createTime = 0;
+    /// <summary>
+    /// true if the image path query succeeded
+    /// </summary>
+    bool bImagePathValid = false;
+    /// <summary>
+    /// Executable image path if the query succeeded; otherwise, the error text it returned
+    /// </summary>
+    std::wstring sImagePath;
+};
+
+/// <summary>
+/// Cache of information about running processes, keyed by PID and validated by process creation time, so that each
+/// process is opened and queried at most once however many zombies it owns or parented, and however many passes it
+/// survives.
+///
+/// Creation times come from a snapshot of all running processes (ProcessEnumerator::GetRunningProcesses), taken once per
+/// pass, on the first lookup. Entries for processes that aren't in the snapshot are evicted at the end of the pass.
+/// If the snapshot can't be taken, lookups in that pass query the platform directly.
+/// </summary>
+class ProcessMetadataCache
+{
+public:
+    // Default ctor and dtor
+    ProcessMetadataCache() = default;
+    virtual ~ProcessMetadataCache() = default;
+
+    /// <summary>
+    /// Call at the start of each enumeration pass.
+    /// </summary>
+    /// <param name="processes">Input: the processes to query in this pass; must remain valid until EndPass</param>
+    void BeginPass(ProcessEnumerator& processes);
+
+    /// <summary>
+    /// Call at the end of each enumeration pass: evicts entries for processes that are no longer running.
+    /// </summary>
+    void EndPass();
+
+    /// <summary>
+    /// Gets the executable image path of a running process, as ProcessEnumerator::GetImagePathFromPID does.
+    /// </summary>
+    /// <param name="pid">Input: process ID</param>
+    /// <param name="sProcessImagePath">Output: full image path of executable, if running; otherwise error text, or empty</param>
+    /// <returns>true if successful</returns>
+    bool GetImagePathFromPID(ULONG_PTR pid, std::wstring& sProcessImagePath);
+
+    /// <summary>
+    /// Gets the executable image path of the parent process, if it's running and started no later than the child,
+    /// as ProcessEnumerator::GetParentProcessImagePathIfStillRunning does.
+    /// </summary>
+    /// <param name="ppid">Input: parent process ID</param>
+    /// <param name="ftChildStartTime">Input: child process start time</param>
+    /// <param name="sProcessImagePath">Output: full image path of executable associated with ppid</param>
+    /// <returns>true if successful</returns>
+    bool GetParentProcessImagePathIfStillRunning(ULONG_PTR ppid, const FILETIME& ftChildStartTime, std::wstring& sProcessImagePath);
+
+    /// <summary>
+    /// Number of cached processes
+    /// </summary>
+    size_t Size() const { return m_entries.size(); }
+
+    /// <summary>
+    /// Cumulative numbers of lookups that found and didn't find cached information (the latter are the image path
+    /// queries), of running process snapshots, and of evicted entries
+    /// </summary>
+    ULONGLONG Hits() const { return m_nHits; }
+    ULONGLONG Misses() const { return m_nMisses; }
+    ULONGLONG Snapshots() const { return m_nSnapshots; }
+    ULONGLONG Evictions() const { return m_nEvictions; }
+
+private:
+    /// <summary>
+    /// Takes this pass' snapshot of the running processes if it hasn't been taken yet.
+    /// </summary>
+    /// <returns>true if the snapshot is available</returns>
+    bool EnsureSnapshot();
+
+    /// <summary>
+    /// Returns the information about a process in the snapshot, querying the platform for it if it isn't cached.
+    /// </summary>
+    const ProcessMetadata& Resolve(ULONG_PTR pid, ULONGLONG createTime);
+
+private:
+    std::unordered_map<ULONG_PTR, ProcessMetadata> m_entries;
+    ProcessEnumerator* m_pProcesses = nullptr;
+
+    // This pass' snapshot: creation times of the running processes, by PID
+    std::vector<PlatformProcessIdentity> m_snapshotList;
+    std::unordered_map<ULONG_PTR, ULONGLONG> m_running;
+    bool m_bSnapshotTaken = false;
+    bool m_bSnapshotValid = false;
+
+    ULONGLONG m_nHits = 0, m_nMisses = 0, m_nSnapshots = 0, m_nEvictions = 0;
+
+private:
+    // Not implemented
+    ProcessMetadataCache(const ProcessMetadataCache&) = delete;
+    ProcessMetadataCache& operator = (const ProcessMetadataCache&) = delete;
+};
@@ -0,0 +1,191 @@
+// Lightweight instrumentation: high-resolution per-phase timers and counters, accumulated over the life of the
+// process and reported by the -stats command-line option.
+
+#include "PlatformTypes.h"
+#include <iomanip>
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <chrono>
+#include <sys/resource.h>
+#endif
+#include "RunStats.h"
+
+/// <summary>
+/// Names of a phase or counter: identifier for machine-readable output, and description for the table.
+/// </summary>
+struct StatsNames_t
+{
+    const wchar_t* szKey;
+    const wchar_t* szDescription;
+};
+
+// In the same order as StatsPhase_t. Indented descriptions are included in the phase above them.
+static const StatsNames_t PhaseNames[size_t(StatsPhase_t::NumPhases)] = {
+    { L"Total",                 L"Total" },
+    { L"ProcessEnumeration",    L"Process enumeration" },
+    { L"ZombieInfoQueries",     L"  Zombie image path and parent queries" },
+    { L"ThreadEnumeration",     L"  Zombie thread enumeration" },
+    { L"HandleTableQuery",      L"Systemwide handle table query" },
+    { L"CorrelateOwnHandles",   L"Correlation: own handles to zombies" },
+    { L"CorrelateOtherHandles", L"Correlation: all handles to zombies" },
+    { L"OwnerAttribution",      L"Owner attribution" },
+    { L"OwnerImagePathLookups", L"  Owner image path lookups" },
+    { L"ServiceEnumeration",    L"  Service enumeration" },
+    { L"Sort",                  L"Sorting" },
+    { L"Output",                L"Output" },
+    { L"DiagnosticDump",        L"Diagnostic dump" },
+};
+
+// In the same order as StatsCounter_t
+static const StatsNames_t CounterNames[size_t(StatsCounter_t::NumCounters)] = {
+    { L"Samples",             L"Samples" },
+    { L"ProcessesEnumerated", L"Processes enumerated" },
+    { L"ZombieProcesses",     L"Zombie processes" },
+    { L"ThreadsEnumerated",   L"Zombie threads enumerated" },
+    { L"SystemCalls",         L"Process/thread/handle system calls" },
+    { L"HandleQueryCalls",    L"NtQuerySystemInformation calls" },
+    { L"HandleQueryRetries",  L"NtQuerySystemInformation retries" },
+    { L"BufferAllocations",   L"Large buffer allocations" },
+    { L"BytesAllocated",      L"Large buffer bytes allocated" },
+    { L"HandlesScanned",      L"Handle table entries scanned" },
+    { L"HandleTablePasses",   L"Full handle table passes" },
+    { L"SinglePassFallbacks", L"Single passes discarded" },
+    { L"CandidateHandles",    L"Process/thread handles examined" },
+    { L"ZombieHandleMatches", L"Handles to zombies" },
+    { L"Owners",              L"Owner processes" },
+    { L"ServicesEnumerated",  L"Services enumerated" },
+    { L"ZombieCacheHits",     L"Zombie cache hits" },
+    { L"ZombieCacheMisses",   L"Zombie cache misses" },
+    { L"ProcessCacheHits",    L"Owner/parent cache hits" },
+    { L"ProcessCacheMisses",  L"Owner/parent cache misses" },
+    { L"PeakMemoryBytes",     L"Peak memory (bytes)" },
+};
+
+// Accumulated performance counter ticks and occurrences per phase, and counter values
+static ULONGLONG PhaseTicks[size_t(StatsPhase_t::NumPhases)] = { 0 };
+static ULONGLONG PhaseCounts[size_t(StatsPhase_t::NumPhases)] = { 0 };
+static ULONGLONG CounterValues[size_t(StatsCounter_t::NumCounters)] = { 0 };
+
+/// <summary>
+/// Returns the current value of the high-resolution performance counter, for passing to StatsAddTime.
+/// </summary>
+ULONGLONG StatsTimestamp()
+{
+#ifdef _WIN32
+    LARGE_INTEGER li;
+    QueryPerformanceCounter(&li);
+    return ULONGLONG(li.QuadPart);
+#else
+    // Nanoseconds
+    return ULONGLONG(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+/// <summary>
+/// Adds the time elapsed since ullStartTimestamp to a phase, and counts one more occurrence of that phase.
+/// </summary>
+/// <param name="phase">Input: the phase to which to attribute the time</param>
+/// <param name="ullStartTimestamp">Input: value previously returned by StatsTimestamp</param>
+void StatsAddTime(StatsPhase_t phase, ULONGLONG ullStartTimestamp)
+{
+    PhaseTicks[size_t(phase)] += StatsTimestamp() - ullStartTimestamp;
+    PhaseCounts[size_t(phase)]++;
+}
+
+/// <summary>
+/// Adds to a counter.
+/// </summary>
+void StatsAddCount(StatsCounter_t counter, ULONGLONG nAmount)
+{
+    CounterValues[size_t(counter)] += nAmount;
+}
+
+/// <summary>
+/// Sets a counter; for quantities that another component already accumulates.
+/// </summary>
+void StatsSetCount(StatsCounter_t counter, ULONGLONG nValue)
+{
+    CounterValues[size_t(counter)] = nValue;
+}
+
+/// <summary>
+/// Peak physical memory use of this process so far, in bytes: the peak working set on Windows, the maximum resident set
+/// size elsewhere. 0 if not available.
+/// </summary>
+static ULONGLONG PeakMemoryBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS memoryCounters = { 0 };
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters)))
+        return 0;
+    return ULONGLONG(memoryCounters.PeakWorkingSetSize);
+#else
+    struct rusage usage;
+    if (0 != getrusage(RUSAGE_SELF, &usage))
+        return 0;
+    // Kilobytes
+    return ULONGLONG(usage.ru_maxrss) * 1024;
+#endif
+}
+
+/// <summary>
+/// Writes all phase timings and counters.
+/// </summary>
+/// <param name="pStream">Output: stream to write to</param>
+/// <param name="bMachineReadable">Input: true for tab-delimited name/value lines; false for a human-readable table</param>
+void WriteStats(std::wostream* pStream, bool bMachineReadable)
+{
+#ifdef _WIN32
+    LARGE_INTEGER liFrequency;
+    QueryPerformanceFrequency(&liFrequency);
+    const double dMsPerTick = 1000.0 / double(liFrequency.QuadPart);
+#else
+    const double dMsPerTick = 1.0e-6;
+#endif
+    StatsSetCount(StatsCounter_t::PeakMemoryBytes, PeakMemoryBytes());
+
+    const std::streamsize nPrevPrecision = pStream->precision();
+    *pStream << std::fixed << std::setprecision(3);
+
+    if (bMachineReadable)
+    {
+        // Phase <tab> key <tab> occurrences <tab> milliseconds; Counter <tab> key <tab> value
+        for (size_t ix = 0; ix < size_t(StatsPhase_t::NumPhases); ++ix)
+        {
+            *pStream << L"Phase\t" << PhaseNames[ix].szKey << L"\t" << PhaseCounts[ix] << L"\t" << double(PhaseTicks[ix]) * dMsPerTick << std::endl;
+        }
+        for (size_t ix = 0; ix < size_t(StatsCounter_t::NumCounters); ++ix)
+        {
+            *pStream << L"Counter\t" << CounterNames[ix].szKey << L"\t" << CounterValues[ix] << std::endl;
+        }
+    }
+    else
+    {
+        const int nNameFieldWidth = 42, nCountFieldWidth = 10, nTimeFieldWidth = 14;
+        *pStream
+            << std::endl
+            << std::left << std::setw(nNameFieldWidth) << L"Phase" << std::right << std::setw(nCountFieldWidth) << L"Count" << std::setw(nTimeFieldWidth) << L"Time (ms)" << std::endl
+            << std::left << std::setw(nNameFieldWidth) << L"-----" << std::right << std::setw(nCountFieldWidth) << L"-----" << std::setw(nTimeFieldWidth) << L"---------" << std::endl;
+        for (size_t ix = 0; ix < size_t(StatsPhase_t::NumPhases); ++ix)
+        {
+            *pStream
+                << std::left << std::setw(nNameFieldWidth) << PhaseNames[ix].szDescription
+                << std::right << std::setw(nCountFieldWidth) << PhaseCounts[ix]
+                << std::setw(nTimeFieldWidth) << double(PhaseTicks[ix]) * dMsPerTick << std::endl;
+        }
+        *pStream
+            << std::endl
+            << std::left << std::setw(nNameFieldWidth) << L"Counter" << std::right << std::setw(nCountFieldWidth + nTimeFieldWidth) << L"Value" << std::endl
+            << std::left << std::setw(nNameFieldWidth) << L"-------" << std::right << std::setw(nCountFieldWidth + nTimeFieldWidth) << L"-----" << std::endl;
+        for (size_t ix = 0; ix < size_t(StatsCounter_t::NumCounters); ++ix)
+        {
+            *pStream
+                << std::left << std::setw(nNameFieldWidth) << CounterNames[ix].szDescription
+                << std::right << std::setw(nCountFieldWidth + nTimeFieldWidth) << CounterValues[ix] << std::endl;
+        }
+        *pStream << std::endl;
+    }
+
+    *pStream << std::defaultfloat << std::setprecision(nPrevPrecision);
+}
@@ -0,0 +1,106 @@
+// Lightweight instrumentation: high-resolution per-phase timers and counters, accumulated over the life of the
+// process and reported by the -stats command-line option.
+// Not thread-safe: record timings and counts only from the thread that drives the run, not from worker threads.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <iostream>
+
+/// <summary>
+/// Timed phases of a run. Phases whose names are indented in the report are included in the phase above them.
+/// </summary>
+enum class StatsPhase_t
+{
+    Total,
+    ProcessEnumeration,
+    ZombieInfoQueries,
+    ThreadEnumeration,
+    HandleTableQuery,
+    CorrelateOwnHandles,
+    CorrelateOtherHandles,
+    OwnerAttribution,
+    OwnerImagePathLookups,
+    ServiceEnumeration,
+    Sort,
+    Output,
+    DiagnosticDump,
+    NumPhases
+};
+
+/// <summary>
+/// Counted events and quantities.
+/// </summary>
+enum class StatsCounter_t
+{
+    Samples,
+    ProcessesEnumerated,
+    ZombieProcesses,
+    ThreadsEnumerated,
+    SystemCalls,
+    HandleQueryCalls,
+    HandleQueryRetries,
+    BufferAllocations,
+    BytesAllocated,
+    HandlesScanned,
+    HandleTablePasses,
+    SinglePassFallbacks,
+    CandidateHandles,
+    ZombieHandleMatches,
+    Owners,
+    ServicesEnumerated,
+    ZombieCacheHits,
+    ZombieCacheMisses,
+    ProcessCacheHits,
+    ProcessCacheMisses,
+    PeakMemoryBytes,
+    NumCounters
+};
+
+/// <summary>
+/// Returns the current value of the high-resolution performance counter, for passing to StatsAddTime.
+/// </summary>
+ULONGLONG StatsTimestamp();
+
+/// <summary>
+/// Adds the time elapsed since ullStartTimestamp to a phase, and counts one more occurrence of that phase.
+/// </summary>
+/// <param name="phase">Input: the phase to which to attribute the time</param>
+/// <param name="ullStartTimestamp">Input: value previously returned by StatsTimestamp</param>
+void StatsAddTime(StatsPhase_t phase, ULONGLONG ullStartTimestamp);
+
+/// <summary>
+/// Adds to a counter.
+/// </summary>
+void StatsAddCount(StatsCounter_t counter, ULONGLONG nAmount = 1);
+
+/// <summary>
+/// Sets a counter; for quantities that another component already accumulates.
+/// </summary>
+void StatsSetCount(StatsCounter_t counter, ULONGLONG nValue);
+
+/// <summary>
+/// Writes all phase timings and counters.
+/// </summary>
+/// <param name="pStream">Output: stream to write to</param>
+/// <param name="bMachineReadable">Input: true for tab-delimited name/value lines; false for a human-readable table</param>
+void WriteStats(std::wostream* pStream, bool bMachineReadable);
+
+/// <summary>
+/// Attributes the time between its construction and its destruction to a phase.
+/// </summary>
+class StatsPhaseTimer
+{
+public:
+    StatsPhaseTimer(StatsPhase_t phase) : m_phase(phase), m_ullStart(StatsTimestamp()) {}
+    ~StatsPhaseTimer() { StatsAddTime(m_phase, m_ullStart); }
+
+private:
+    const StatsPhase_t m_phase;
+    const ULONGLONG m_ullStart;
+
+private:
+    // Not implemented
+    StatsPhaseTimer(const StatsPhaseTimer&) = delete;
+    StatsPhaseTimer& operator = (const StatsPhaseTimer&) = delete;
+};
@@ -1,175 +1,336 @@
+#include "PlatformTypes.h"
 #include <map>
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <iomanip>
+#include <algorithm>
 #include "FileOutput.h"
+#include "Utf8Writer.h"
+#include "StringUtils.h"
+#include "RunStats.h"
 #include "ServiceLookupByPID.h"
+#include "Platform.h"
 
-typedef std::map<ULONG_PTR, ServiceList_t> ServiceLookupByPID_t;
+/// <summary>
+/// Sets the source that the information is acquired from, and discards any information already acquired or loaded.
+/// </summary>
+/// <param name="provider">Input: source of services; must outlive its use here</param>
+void ServiceIndex::SetProvider(ServiceProvider& provider)
+{
+	m_pProvider = &provider;
+	Clear();
+}
 
-static ServiceLookupByPID_t ServiceLookupByPID;
-static bool bInitialized = false;
+/// <summary>
+/// Discards all information.
+/// </summary>
+void ServiceIndex::Clear()
+{
+	m_generations[0].Clear();
+	m_generations[1].Clear();
+	m_ixCurrent = 0;
+	m_byPID.clear();
+	m_bAcquired = m_bFixed = false;
+	m_ulAcquiredTime = 0;
+}
 
 /// <summary>
-/// Initialize the lookup object.
+/// Acquires the information from the provider if it hasn't been acquired, or if it has expired.
 /// If it fails, it fails silently.
 /// </summary>
-static void InitializeServiceLookup()
+/// <param name="ulNow">Input: current time, as a FILETIME value</param>
+void ServiceIndex::EnsureCurrent(ULONGLONG ulNow)
 {
-	if (bInitialized)
+	if (m_bFixed)
+		return;
+	// (A clock that has gone backward also expires the information.)
+	if (m_bAcquired && ulNow >= m_ulAcquiredTime && ulNow - m_ulAcquiredTime < m_nTimeToLiveSecs * 10000000)
 		return;
 
-	bInitialized = true;
+	// Don't retry a failure until the time to live has passed.
+	m_bAcquired = true;
+	m_ulAcquiredTime = ulNow;
 
-	BOOL ret;
-	DWORD dwLastErr;
-	SC_HANDLE hSCM = NULL;
-	LPENUM_SERVICE_STATUS_PROCESSW pServiceInfoBuffer = nullptr;
-	DWORD cbBytesNeeded = 0, dwServicesReturned = 0, dwResumeHandle = 0;
-	hSCM = OpenSCManagerW(NULL, NULL, SC_MANAGER_ENUMERATE_SERVICE);
-	if (NULL == hSCM)
+	StatsPhaseTimer phaseTimer(StatsPhase_t::ServiceEnumeration);
+	if (nullptr == m_pProvider)
+		m_pProvider = &SystemPlatform().Services();
+	ServiceLookupByPID_t serviceLookup;
+	std::wstring sErrorInfo;
+	if (!m_pProvider->EnumerateServices(serviceLookup, sErrorInfo))
 	{
-		//dwLastErr = GetLastError();
-		//std::wcerr << L"OpenSCManagerW failed; error " << dwLastErr << std::endl;
-		//retval = -1;
-		goto cleanup;
-	}
-#pragma warning(push)
-#pragma warning(disable:6031) // False positive: "Return value ignored: 'EnumServicesStatusExW'"
-	/*ret =*/ EnumServicesStatusExW(hSCM, SC_ENUM_PROCESS_INFO, SERVICE_WIN32, SERVICE_ACTIVE, nullptr, 0, &cbBytesNeeded, &dwServicesReturned, &dwResumeHandle, nullptr);
-#pragma warning(pop)
-	dwLastErr = GetLastError();
-	if (ERROR_MORE_DATA != dwLastErr)
-	{
-		//std::wcerr << L"EnumServicesStatusExW (first call) failed; error " << dwLastErr << std::endl;
-		//retval = -2;
-		goto cleanup;
+		//std::wcerr << L"Service enumeration failed: " << sErrorInfo << std::endl;
+		return;
 	}
-	// Add 50% in case other services have become active in between calls.
-	cbBytesNeeded = cbBytesNeeded + cbBytesNeeded / 2;
-	pServiceInfoBuffer = LPENUM_SERVICE_STATUS_PROCESSW(new BYTE[cbBytesNeeded]);
-	ret = EnumServicesStatusExW(hSCM, SC_ENUM_PROCESS_INFO, SERVICE_WIN32, SERVICE_ACTIVE, (LPBYTE)pServiceInfoBuffer, cbBytesNeeded, &cbBytesNeeded, &dwServicesReturned, &dwResumeHandle, nullptr);
-	if (!ret)
+
+	Replace(serviceLookup);
+
+	size_t nServices = 0;
+	for (
+		ServiceLookupByPID_t::const_iterator iterLookup = serviceLookup.begin();
+		iterLookup != serviceLookup.end();
+		iterLookup++
+		)
 	{
-		//std::wcerr << L"EnumServicesStatusExW (second call) failed; error " << dwLastErr << std::endl;
-		//retval = -3;
-		goto cleanup;
+		nServices += iterLookup->second.size();
 	}
+	StatsAddCount(StatsCounter_t::ServicesEnumerated, nServices);
+}
+
+/// <summary>
+/// Discards the generation's names and entries, keeping their storage for reuse.
+/// </summary>
+void ServiceIndex::Generation::Clear()
+{
+	names.clear();
+	nameIds.clear();
+	entries.clear();
+}
+
+/// <summary>
+/// Returns the id of a name, storing it if it's new.
+/// </summary>
+ULONG ServiceIndex::Generation::Intern(const std::wstring& sName)
+{
+	std::unordered_map<std::wstring, ULONG>::const_iterator iter = nameIds.find(sName);
+	if (nameIds.end() != iter)
+		return iter->second;
+	const ULONG ixName = ULONG(names.size());
+	names.push_back(sName);
+	nameIds.insert(std::make_pair(sName, ixName));
+	return ixName;
+}
 
-	for (DWORD ix = 0; ix < dwServicesReturned; ++ix)
+/// <summary>
+/// Replaces the information with the lookup's. The new information is built in place of the generation before the
+/// current one, which becomes the previous one, so that ServiceSet values from the current generation remain valid
+/// until the next refresh; only names in use are kept.
+/// </summary>
+void ServiceIndex::Replace(const ServiceLookupByPID_t& serviceLookup)
+{
+	const ULONG ixNext = 1 - m_ixCurrent;
+	Generation& generation = m_generations[ixNext];
+	generation.Clear();
+	std::unordered_map<ULONG_PTR, ServiceRun> byPID;
+	byPID.reserve(serviceLookup.size());
+	for (
+		ServiceLookupByPID_t::const_iterator iterLookup = serviceLookup.begin();
+		iterLookup != serviceLookup.end();
+		iterLookup++
+		)
 	{
-#pragma warning(push)
-#pragma warning(disable:6385) // False positive: "Reading invalid data from 'pServiceInfoBuffer'"
-		const ENUM_SERVICE_STATUS_PROCESSW& svc = pServiceInfoBuffer[ix];
-#pragma warning(pop)
-		ServiceNames_t names;
-		names.sDisplayName = svc.lpDisplayName;
-		names.sServiceName = svc.lpServiceName;
-		ServiceLookupByPID_t::iterator iSvc = ServiceLookupByPID.find(svc.ServiceStatusProcess.dwProcessId);
-		if (iSvc == ServiceLookupByPID.end())
-		{
-			ServiceList_t list;
-			list.push_back(names);
-			ServiceLookupByPID[svc.ServiceStatusProcess.dwProcessId] = list;
-		}
-		else
+		const ServiceList_t& serviceList = iterLookup->second;
+		if (serviceList.empty())
+			continue;
+
+		ServiceRun run;
+		run.ixFirst = ULONG(generation.entries.size());
+		run.nCount = ULONG(serviceList.size());
+		for (ServiceList_t::const_iterator iterSvc = serviceList.begin();
+			iterSvc != serviceList.end();
+			iterSvc++
+			)
 		{
-			iSvc->second.push_back(names);
+			ServiceEntry entry;
+			entry.ixServiceName = generation.Intern(iterSvc->sServiceName);
+			entry.ixDisplayName = generation.Intern(iterSvc->sDisplayName);
+			generation.entries.push_back(entry);
 		}
+		byPID.insert(std::make_pair(iterLookup->first, run));
 	}
-
-cleanup:
-	delete[](LPBYTE)pServiceInfoBuffer;
-	if (NULL != hSCM)
-		CloseServiceHandle(hSCM);
-	//return retval;
+	m_byPID.swap(byPID);
+	m_ixCurrent = ixNext;
 }
 
 /// <summary>
-/// If the input process ID is a service process, return the service and display names of those services.
+/// Returns the services hosted by a process; empty if it isn't a service process.
 /// </summary>
-/// <param name="dwPID">Input: process ID</param>
-/// <param name="pServiceList">Output: if the process is a service process, returns a pointer information about the services it hosts; NULL otherwise.</param>
-/// <returns>true if the process is a service process; false otherwise</returns>
-bool LookupServicesByPID(ULONG_PTR pid, const ServiceList_t** ppServiceList)
+ServiceSet ServiceIndex::Lookup(ULONG_PTR pid) const
 {
-	// Make sure the lookup object has been initialized
-	InitializeServiceLookup();
+	ServiceSet serviceSet;
+	std::unordered_map<ULONG_PTR, ServiceRun>::const_iterator iter = m_byPID.find(pid);
+	if (m_byPID.end() != iter)
+	{
+		serviceSet.m_pIndex = this;
+		serviceSet.m_ixGeneration = m_ixCurrent;
+		serviceSet.m_ixFirst = iter->second.ixFirst;
+		serviceSet.m_nCount = iter->second.nCount;
+	}
+	return serviceSet;
+}
 
-	ServiceLookupByPID_t::const_iterator iter = ServiceLookupByPID.find(pid);
-	if (iter == ServiceLookupByPID.end())
+/// <summary>
+/// Gets the PIDs of the processes hosting a service, identified by its key name, compared case-insensitively.
+/// </summary>
+/// <param name="sServiceName">Input: service key name</param>
+/// <param name="pids">Output: PIDs of the processes hosting the service</param>
+void ServiceIndex::FindProcessesHostingService(const std::wstring& sServiceName, std::vector<ULONG_PTR>& pids) const
+{
+	pids.clear();
+	const Generation& generation = m_generations[m_ixCurrent];
+	// Which of the stored names match; only service names are checked against them
+	std::vector<bool> matchingNames(generation.names.size());
+	for (size_t ixName = 0; ixName < generation.names.size(); ++ixName)
 	{
-		*ppServiceList = nullptr;
-		return false;
+		matchingNames[ixName] = (0 == _wcsicmp(sServiceName.c_str(), generation.names[ixName].c_str()));
 	}
-	else
+	for (
+		std::unordered_map<ULONG_PTR, ServiceRun>::const_iterator iter = m_byPID.begin();
+		iter != m_byPID.end();
+		++iter
+		)
 	{
-		*ppServiceList = &iter->second;
-		return true;
+		for (ULONG ixEntry = iter->second.ixFirst; ixEntry < iter->second.ixFirst + iter->second.nCount; ++ixEntry)
+		{
+			if (matchingNames[generation.entries[ixEntry].ixServiceName])
+			{
+				pids.push_back(iter->first);
+				break;
+			}
+		}
 	}
 }
 
 /// <summary>
-/// For diagnostic purposes, dump the PID to services information to an ostream in human-readable form.
+/// Offline analysis and benchmarking: replaces the information with information supplied by the caller, which is
+/// not refreshed.
+/// </summary>
+/// <param name="serviceLookup">Input: services hosted by each service process</param>
+void ServiceIndex::Set(const ServiceLookupByPID_t& serviceLookup)
+{
+	Clear();
+	Replace(serviceLookup);
+	m_bAcquired = m_bFixed = true;
+}
+
+/// <summary>
+/// For diagnostic purposes, dump the PID to services information to a file in human-readable form, in PID order.
 /// </summary>
 /// <param name="szOutFile">Input: full path to output file</param>
 /// <param name="bAppend">Input: true to append to the file; false to overwrite it</param>
 /// <param name="sErrorInfo">Output: Information about any errors on failure</param>
 /// <returns>true if successful</returns>
-bool DumpPIDtoServiceLookupInfo(const wchar_t* szOutFile, bool bAppend, std::wstring& sErrorInfo)
+bool ServiceIndex::Dump(const wchar_t* szOutFile, bool bAppend, std::wstring& sErrorInfo) const
 {
-	// Output file stream, optionally appending
-	std::wofstream fs;
-	if (!CreateFileOutput(szOutFile, fs, bAppend))
+	// Output file, optionally appending
+	Utf8Writer writer;
+	if (!writer.OpenFile(szOutFile, bAppend, sErrorInfo))
 	{
 		std::wstringstream strErrorInfo;
-		strErrorInfo << L"DumpPIDtoServiceLookupInfo to " << szOutFile << L" fails";
+		strErrorInfo << L"ServiceIndex::Dump to " << szOutFile << L" fails: " << sErrorInfo;
 		sErrorInfo = strErrorInfo.str();
 		return false;
 	}
 
-	// Make sure the lookup object has been initialized
-	InitializeServiceLookup();
-
-	// Determine longest service name, for formatting.
+	// PIDs in order, and the longest service name, for formatting.
+	std::vector<ULONG_PTR> pids;
+	pids.reserve(m_byPID.size());
 	size_t nSvcNameFieldWidth = 0;
 	for (
-		ServiceLookupByPID_t::const_iterator iterLookup = ServiceLookupByPID.begin();
-		iterLookup != ServiceLookupByPID.end();
+		std::unordered_map<ULONG_PTR, ServiceRun>::const_iterator iterLookup = m_byPID.begin();
+		iterLookup != m_byPID.end();
 		iterLookup++
 		)
 	{
-		for (ServiceList_t::const_iterator iterSvc = iterLookup->second.begin();
-			iterSvc != iterLookup->second.end();
-			iterSvc++
-			)
+		pids.push_back(iterLookup->first);
+		const ServiceSet serviceSet = Lookup(iterLookup->first);
+		for (size_t ixSvc = 0; ixSvc < serviceSet.size(); ++ixSvc)
 		{
-			if (iterSvc->sServiceName.length() > nSvcNameFieldWidth)
-				nSvcNameFieldWidth = iterSvc->sServiceName.length();
+			if (serviceSet.ServiceName(ixSvc).length() > nSvcNameFieldWidth)
+				nSvcNameFieldWidth = serviceSet.ServiceName(ixSvc).length();
 		}
 	}
+	std::sort(pids.begin(), pids.end());
 
 	nSvcNameFieldWidth += 3;
 
 	for (
-		ServiceLookupByPID_t::const_iterator iterLookup = ServiceLookupByPID.begin();
-		iterLookup != ServiceLookupByPID.end();
-		iterLookup++
+		std::vector<ULONG_PTR>::const_iterator iterPID = pids.begin();
+		iterPID != pids.end();
+		iterPID++
 		)
 	{
-		fs << L"PID: " << iterLookup->first << std::endl;
-		for (ServiceList_t::const_iterator iterSvc = iterLookup->second.begin();
-			iterSvc != iterLookup->second.end();
-			iterSvc++
-			)
+		(writer << L"PID: " << *iterPID).EndLine();
+		const ServiceSet serviceSet = Lookup(*iterPID);
+		for (size_t ixSvc = 0; ixSvc < serviceSet.size(); ++ixSvc)
 		{
-			fs << L"             " << std::left << std::setw(nSvcNameFieldWidth) << iterSvc->sServiceName << L"  " << iterSvc->sDisplayName << std::endl;
+			// Service name left-aligned in its field
+			const std::wstring& sServiceName = serviceSet.ServiceName(ixSvc);
+			writer << L"             " << sServiceName;
+			writer.WriteRepeated(' ', nSvcNameFieldWidth - sServiceName.length());
+			(writer << L"  " << serviceSet.DisplayName(ixSvc)).EndLine();
 		}
-		fs << std::endl;
+		writer.EndLine();
+	}
+
+	if (!writer.Close())
+	{
+		std::wstringstream strErrorInfo;
+		strErrorInfo << L"ServiceIndex::Dump to " << szOutFile << L" fails: write error";
+		sErrorInfo = strErrorInfo.str();
+		return false;
 	}
 
+	return true;
+}
+
+/// <summary>
+/// Offline analysis: replaces the information with information previously written by Dump, which is not refreshed.
+/// </summary>
+/// <param name="szInFile">Input: full path to input file</param>
+/// <param name="sErrorInfo">Output: Information about any errors on failure</param>
+/// <returns>true if successful</returns>
+bool ServiceIndex::Load(const wchar_t* szInFile, std::wstring& sErrorInfo)
+{
+	sErrorInfo.clear();
+
+	std::wifstream fs;
+	if (!OpenFileInput(szInFile, fs))
+	{
+		std::wstringstream strErrorInfo;
+		strErrorInfo << L"ServiceIndex::Load from " << szInFile << L" fails";
+		sErrorInfo = strErrorInfo.str();
+		return false;
+	}
+
+	// Format written by Dump:
+	// "PID: nnn" line, followed by one indented line per service: the service name, padded with spaces, two more spaces,
+	// then the display name. Blank line between PIDs.
+	ServiceLookupByPID_t serviceLookup;
+	const std::wstring sPidPrefix = L"PID: ";
+	ServiceList_t* pCurrentList = nullptr;
+	std::wstring sLine;
+	while (std::getline(fs, sLine))
+	{
+		if (EndsWith(sLine, L'\r'))
+			sLine.pop_back();
+
+		if (StartsWith(sLine, sPidPrefix, true))
+		{
+			ULONG_PTR pid = ULONG_PTR(wcstoull(sLine.c_str() + sPidPrefix.length(), nullptr, 10));
+			pCurrentList = &serviceLookup[pid];
+			continue;
+		}
+
+		size_t ixNameStart = sLine.find_first_not_of(L' ');
+		if (std::wstring::npos == ixNameStart || nullptr == pCurrentList)
+			continue;
+
+		// The service name ends at the first run of two spaces; the display name follows the padding.
+		ServiceNames_t names;
+		size_t ixNameEnd = sLine.find(L"  ", ixNameStart);
+		names.sServiceName = sLine.substr(ixNameStart, ixNameEnd - ixNameStart);
+		if (std::wstring::npos != ixNameEnd)
+		{
+			size_t ixDisplayStart = sLine.find_first_not_of(L' ', ixNameEnd);
+			if (std::wstring::npos != ixDisplayStart)
+				names.sDisplayName = sLine.substr(ixDisplayStart);
+		}
+		pCurrentList->push_back(names);
+	}
 	fs.close();
 
+	// Don't query the provider from here on.
+	Set(serviceLookup);
+
 	return true;
 }
@@ -1,8 +1,14 @@
 #pragma once
 
-#include <Windows.h>
+#include "PlatformTypes.h"
 #include <string>
 #include <list>
+#include <map>
+#include <vector>
+#include <unordered_map>
+
+class ServiceProvider;
+class ServiceIndex;
 
 /// <summary>
 /// Structure that contains a service's key name and display name
@@ -15,21 +21,175 @@ struct ServiceNames_t
 /// List of structures containing service information.
 /// </summary>
 typedef std::list<ServiceNames_t> ServiceList_t;
+/// <summary>
+/// Services hosted by each service process, by PID, as service providers and data sources supply them.
+/// </summary>
+typedef std::map<ULONG_PTR, ServiceList_t> ServiceLookupByPID_t;
 
 /// <summary>
-/// If the input process ID is a service process, return the service and display names of those services.
+/// The services hosted by one process: a view into a ServiceIndex. Empty if the process isn't a service process.
+/// Remains valid across one refresh of the index: until the second refresh after the lookup, or until the index is
+/// cleared or replaced (SetProvider, Set, Load).
 /// </summary>
-/// <param name="dwPID">Input: process ID</param>
-/// <param name="pServiceList">Output: if the process is a service process, returns a pointer information about the services it hosts; NULL otherwise.</param>
-/// <returns>true if the process is a service process; false otherwise</returns>
-bool LookupServicesByPID(ULONG_PTR pid, const ServiceList_t** ppServiceList);
+class ServiceSet
+{
+public:
+	ServiceSet() = default;
+
+	size_t size() const { return m_nCount; }
+	bool empty() const { return 0 == m_nCount; }
+	const std::wstring& ServiceName(size_t ix) const;
+	const std::wstring& DisplayName(size_t ix) const;
+
+private:
+	friend class ServiceIndex;
+	const ServiceIndex* m_pIndex = nullptr;
+	ULONG m_ixGeneration = 0;
+	ULONG m_ixFirst = 0;
+	ULONG m_nCount = 0;
+};
 
 /// <summary>
-/// For diagnostic purposes, dump the PID to services information to an ostream in human-readable form.
+/// Services hosted by each service process, indexed by PID.
+///
+/// Names are interned: each distinct name is stored once, and each process' services are a contiguous run of
+/// (service name, display name) ids in one array, found through a hash table by PID. Lookups don't modify the index,
+/// so they can be made from multiple threads at once.
+///
+/// Information comes from a ServiceProvider (by default, the operating system's), and is acquired on first use and
+/// reacquired when it's older than the time to live. A refresh builds the new information compactly in place of the
+/// generation before the current one, so that ServiceSet values from the current generation stay valid through the
+/// refresh while storage stays bounded by two generations.
+/// Information that is Set or Loaded (offline analysis) is never refreshed.
 /// </summary>
-/// <param name="szOutFile">Input: full path to output file</param>
-/// <param name="bAppend">Input: true to append to the file; false to overwrite it</param>
-/// <param name="sErrorInfo">Output: Information about any errors on failure</param>
-/// <returns>true if successful</returns>
-bool DumpPIDtoServiceLookupInfo(const wchar_t* szOutFile, bool bAppend, std::wstring& sErrorInfo);
+class ServiceIndex
+{
+public:
+	ServiceIndex() = default;
+	~ServiceIndex() = default;
+
+	/// <summary>
+	/// Sets the source that the information is acquired from, and discards any information already acquired or loaded.
+	/// </summary>
+	/// <param name="provider">Input: source of services; must remain valid while in use</param>
+	void SetProvider(ServiceProvider& provider);
+
+	/// <summary>
+	/// Sets how long acquired information is used before EnsureCurrent reacquires it. Default 60 seconds.
+	/// </summary>
+	void SetTimeToLive(ULONGLONG nSeconds) { m_nTimeToLiveSecs = nSeconds; }
+
+	/// <summary>
+	/// Acquires the information from the provider if it hasn't been acquired, or if it was acquired more than the time
+	/// to live before ulNow. Does nothing if the information was Set or Loaded. If it fails, it fails silently, and
+	/// the previous information remains.
+	/// </summary>
+	/// <param name="ulNow">Input: current time, as a FILETIME value</param>
+	void EnsureCurrent(ULONGLONG ulNow);
+
+	/// <summary>
+	/// Returns the services hosted by a process; empty if it isn't a service process.
+	/// </summary>
+	ServiceSet Lookup(ULONG_PTR pid) const;
+
+	/// <summary>
+	/// Gets the PIDs of the processes hosting a service, identified by its key name, compared case-insensitively.
+	/// </summary>
+	/// <param name="sServiceName">Input: service key name; e.g., "Winmgmt"</param>
+	/// <param name="pids">Output: PIDs of the processes hosting the service (ordinarily no more than one)</param>
+	void FindProcessesHostingService(const std::wstring& sServiceName, std::vector<ULONG_PTR>& pids) const;
+
+	/// <summary>
+	/// Offline analysis and benchmarking: replaces the information with information supplied by the caller
+	/// (e.g., a synthetic workload), which is not refreshed.
+	/// </summary>
+	/// <param name="serviceLookup">Input: services hosted by each service process</param>
+	void Set(const ServiceLookupByPID_t& serviceLookup);
+
+	/// <summary>
+	/// For diagnostic purposes, dump the PID to services information to a file in human-readable form, in PID order.
+	/// </summary>
+	/// <param name="szOutFile">Input: full path to output file</param>
+	/// <param name="bAppend">Input: true to append to the file; false to overwrite it</param>
+	/// <param name="sErrorInfo">Output: Information about any errors on failure</param>
+	/// <returns>true if successful</returns>
+	bool Dump(const wchar_t* szOutFile, bool bAppend, std::wstring& sErrorInfo) const;
 
+	/// <summary>
+	/// Offline analysis: replaces the information with information previously written by Dump, which is not refreshed.
+	/// </summary>
+	/// <param name="szInFile">Input: full path to input file</param>
+	/// <param name="sErrorInfo">Output: Information about any errors on failure</param>
+	/// <returns>true if successful</returns>
+	bool Load(const wchar_t* szInFile, std::wstring& sErrorInfo);
+
+	/// <summary>
+	/// Number of service processes, and number of distinct names stored.
+	/// </summary>
+	size_t ProcessCount() const { return m_byPID.size(); }
+	size_t NameCount() const { return m_generations[m_ixCurrent].names.size(); }
+
+private:
+	friend class ServiceSet;
+
+	// Discards all information.
+	void Clear();
+	// Replaces the information with the lookup's, as a new generation in place of the previous one.
+	void Replace(const ServiceLookupByPID_t& serviceLookup);
+
+private:
+	struct ServiceEntry
+	{
+		ULONG ixServiceName;
+		ULONG ixDisplayName;
+	};
+	struct ServiceRun
+	{
+		ULONG ixFirst;
+		ULONG nCount;
+	};
+
+	struct Generation
+	{
+		// Interned names, and their ids
+		std::vector<std::wstring> names;
+		std::unordered_map<std::wstring, ULONG> nameIds;
+		// Each process' services are a contiguous run of entries.
+		std::vector<ServiceEntry> entries;
+
+		void Clear();
+		// Returns the id of a name, storing it if it's new.
+		ULONG Intern(const std::wstring& sName);
+	};
+
+	// The current generation, which m_byPID refers to, and the previous one, kept for ServiceSet values from before
+	// the last refresh
+	Generation m_generations[2];
+	ULONG m_ixCurrent = 0;
+	std::unordered_map<ULONG_PTR, ServiceRun> m_byPID;
+
+	// Source of the services; the operating system's if not set
+	ServiceProvider* m_pProvider = nullptr;
+	// True once acquired from the provider, Set, or Loaded; and whether it can be refreshed
+	bool m_bAcquired = false;
+	bool m_bFixed = false;
+	ULONGLONG m_ulAcquiredTime = 0;
+	ULONGLONG m_nTimeToLiveSecs = 60;
+
+private:
+	// Not implemented
+	ServiceIndex(const ServiceIndex&) = delete;
+	ServiceIndex& operator = (const ServiceIndex&) = delete;
+};
+
+inline const std::wstring& ServiceSet::ServiceName(size_t ix) const
+{
+	const ServiceIndex::Generation& generation = m_pIndex->m_generations[m_ixGeneration];
+	return generation.names[generation.entries[m_ixFirst + ix].ixServiceName];
+}
+
+inline const std::wstring& ServiceSet::DisplayName(size_t ix) const
+{
+	const ServiceIndex::Generation& generation = m_pIndex->m_generations[m_ixGeneration];
+	return generation.names[generation.entries[m_ixFirst + ix].ixDisplayName];
+}
@@ -1,6 +1,6 @@
 // String utilities
 
-#include <Windows.h>
+#include "PlatformTypes.h"
 #include <sstream>
 #include <locale>
 
@@ -102,6 +102,38 @@ std::wstring FileTimeToWString(const FILETIME& ft, bool bIncludeMilliseconds, co
 	return SystemTimeToWString(st, bIncludeMilliseconds, false);
 }
 
+/// <summary>
+/// Converts a date/time string written by FileTimeToWString or SystemTimeToWString back to a filetime structure.
+/// The empty string (FileTimeToWString's default for a zero filetime) converts to zero.
+/// </summary>
+/// <param name="sTimestamp">Input: timestamp string with a format like yyyy-MM-dd HH:mm:ss[.fff], or yyyyMMdd_HHmmss[_fff] if bForFileSystem</param>
+/// <param name="bForFileSystem">Input: true if the string has only file-object-valid characters</param>
+/// <param name="ft">Output: FILETIME structure representing the date/time</param>
+/// <returns>true if the string has the expected format and represents a valid date/time</returns>
+bool WStringToFileTime(const std::wstring& sTimestamp, bool bForFileSystem, FILETIME& ft)
+{
+	ft.dwHighDateTime = ft.dwLowDateTime = 0;
+	if (sTimestamp.empty())
+		return true;
+
+	int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0, milliseconds = 0;
+	const int nFields = swscanf_s(sTimestamp.c_str(),
+		bForFileSystem ? L"%4d%2d%2d_%2d%2d%2d_%3d" : L"%4d-%2d-%2d %2d:%2d:%2d.%3d",
+		&year, &month, &day, &hour, &minute, &second, &milliseconds);
+	if (nFields < 6)
+		return false;
+
+	SYSTEMTIME st = { 0 };
+	st.wYear = WORD(year);
+	st.wMonth = WORD(month);
+	st.wDay = WORD(day);
+	st.wHour = WORD(hour);
+	st.wMinute = WORD(minute);
+	st.wSecond = WORD(second);
+	st.wMilliseconds = WORD(milliseconds);
+	return FALSE != SystemTimeToFileTime(&st, &ft);
+}
+
 /// <summary>
 /// Converts input LARGE_INTEGER to an alpha-sortable date/time string, where the input value represents
 /// the number of 100-nanosecond intervals since January 1, 1601 (UTC).
@@ -241,3 +273,47 @@ std::wstring GetDirectoryNameFromFilePath(const std::wstring& sFilePath)
 	// All verifications check out. Return the string up to the last path separator.
 	return sFilePath.substr(0, ixLastPathSep);
 }
+
+#ifndef _WIN32
+/// <summary>
+/// Converts UTF-8 to a wide string. Invalid sequences become U+FFFD rather than failing: file names and process names
+/// aren't necessarily valid UTF-8.
+/// </summary>
+/// <param name="sz">Input: UTF-8 bytes; need not be NUL-terminated</param>
+/// <param name="nLength">Input: number of bytes</param>
+/// <param name="sResult">Output: the wide string</param>
+/// <returns>true if every sequence was valid UTF-8</returns>
+bool WideFromUtf8(const char* sz, size_t nLength, std::wstring& sResult)
+{
+	bool bValid = true;
+	sResult.clear();
+	sResult.reserve(nLength);
+	size_t ix = 0;
+	while (ix < nLength)
+	{
+		const unsigned char c = (unsigned char)sz[ix];
+		size_t nContinuation = 0;
+		wchar_t wc = 0;
+		if (c < 0x80) { wc = c; }
+		else if (c >= 0xC2 && c < 0xE0) { wc = c & 0x1F; nContinuation = 1; }
+		else if (c >= 0xE0 && c < 0xF0) { wc = c & 0x0F; nContinuation = 2; }
+		else if (c >= 0xF0 && c < 0xF5) { wc = c & 0x07; nContinuation = 3; }
+		else { sResult.push_back(L'\xFFFD'); bValid = false; ++ix; continue; }
+		size_t ixNext = ix + 1;
+		while (nContinuation > 0 && ixNext < nLength && 0x80 == (((unsigned char)sz[ixNext]) & 0xC0))
+		{
+			wc = (wc << 6) | (((unsigned char)sz[ixNext]) & 0x3F);
+			++ixNext;
+			--nContinuation;
+		}
+		if (0 != nContinuation)
+		{
+			wc = L'\xFFFD';
+			bValid = false;
+		}
+		sResult.push_back(wc);
+		ix = ixNext;
+	}
+	return bValid;
+}
+#endif
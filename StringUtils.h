@@ -1,5 +1,6 @@
 #pragma once
 
+#include "PlatformTypes.h"
 #include <string>
 #include <sstream>
 #include <vector>
@@ -198,6 +199,16 @@ std::wstring SystemTimeToWString(const SYSTEMTIME& st, bool bIncludeMilliseconds
 /// <returns>Timestamp string with a format like yyyy-MM-dd HH:mm:ss.fff, or alternate string value</returns>
 std::wstring FileTimeToWString(const FILETIME& ft, bool bIncludeMilliseconds, const wchar_t* szIfZero = L"");
 
+/// <summary>
+/// Converts a date/time string written by FileTimeToWString or SystemTimeToWString back to a filetime structure.
+/// The empty string (FileTimeToWString's default for a zero filetime) converts to zero.
+/// </summary>
+/// <param name="sTimestamp">Input: timestamp string with a format like yyyy-MM-dd HH:mm:ss[.fff], or yyyyMMdd_HHmmss[_fff] if bForFileSystem</param>
+/// <param name="bForFileSystem">Input: true if the string has only file-object-valid characters</param>
+/// <param name="ft">Output: FILETIME structure representing the date/time</param>
+/// <returns>true if the string has the expected format and represents a valid date/time</returns>
+bool WStringToFileTime(const std::wstring& sTimestamp, bool bForFileSystem, FILETIME& ft);
+
 /// <summary>
 /// Converts input LARGE_INTEGER to an alpha-sortable date/time string, where the input value represents
 /// the number of 100-nanosecond intervals since January 1, 1601 (UTC).
@@ -257,4 +268,16 @@ inline std::wstring GetFileNameFromFilePath(const std::wstring& sFilePath)
 	}
 }
 
-std::wstring GetDirectoryNameFromFilePath(const std::wstring& sFilePath);
\ No newline at end of file
+std::wstring GetDirectoryNameFromFilePath(const std::wstring& sFilePath);
+
+#ifndef _WIN32
+/// <summary>
+/// Converts UTF-8 to a wide string. Invalid sequences become U+FFFD rather than failing: file names and process names
+/// aren't necessarily valid UTF-8.
+/// </summary>
+/// <param name="sz">Input: UTF-8 bytes; need not be NUL-terminated</param>
+/// <param name="nLength">Input: number of bytes</param>
+/// <param name="sResult">Output: the wide string</param>
+/// <returns>true if every sequence was valid UTF-8</returns>
+bool WideFromUtf8(const char* sz, size_t nLength, std::wstring& sResult);
+#endif
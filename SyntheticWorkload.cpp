@@ -0,0 +1,319 @@
+// Generator of synthetic systemwide handle tables, zombies, and owners, for exercising the correlation code at scale
+// without a live system. Makes no operating system calls, so it can run anywhere the code builds.
+
+#include "PlatformTypes.h"
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <random>
+#include "SyntheticWorkload.h"
+
+// (Definitions of the in-class constants)
+const USHORT SyntheticWorkload::ProcessTypeIndex;
+const USHORT SyntheticWorkload::ThreadTypeIndex;
+
+// Capture time of every synthetic workload: 2024-01-01 00:00:00 UTC as a FILETIME value
+static const ULONGLONG ulSyntheticCaptureTime = 133485408000000000ull;
+// FILETIME units per second
+static const ULONGLONG ulTicksPerSecond = 10000000ull;
+
+/// <summary>
+/// Random numbers derived directly from the std::mt19937_64 output sequence, which the C++ standard fully specifies.
+/// (The std distributions and std::shuffle are implementation-defined, and would make workloads differ between compilers.)
+/// </summary>
+class SyntheticRandom
+{
+public:
+    SyntheticRandom(ULONGLONG seed) : m_rng(seed) {}
+
+    // Uniformly distributed integer in [0, n); n must be non-zero
+    ULONGLONG Below(ULONGLONG n) { return m_rng() % n; }
+
+    // Uniformly distributed value in [0, 1)
+    double Unit() { return double(m_rng() >> 11) * (1.0 / 9007199254740992.0); }
+
+    // Kernel-like object address: high bits set, 16-byte aligned, spread over a 16 GB range
+    PVOID ObjectAddress() { return PVOID(ULONG_PTR(0xFFFF800000000000ull | ((m_rng() & 0x3FFFFFFFull) << 4))); }
+
+    // Fisher-Yates shuffle
+    template <typename T>
+    void Shuffle(std::vector<T>& v)
+    {
+        for (size_t ix = v.size(); ix > 1; --ix)
+            std::swap(v[ix - 1], v[size_t(Below(ix))]);
+    }
+
+private:
+    std::mt19937_64 m_rng;
+};
+
+/// <summary>
+/// Splits nTotal into counts proportional to the input weights, summing exactly to nTotal.
+/// </summary>
+static void ApportionCounts(size_t nTotal, const std::vector<double>& weights, std::vector<size_t>& counts)
+{
+    double totalWeight = 0;
+    for (std::vector<double>::const_iterator iter = weights.begin(); iter != weights.end(); ++iter)
+        totalWeight += *iter;
+
+    counts.assign(weights.size(), 0);
+    double cumulativeWeight = 0;
+    size_t nAssigned = 0;
+    for (size_t ix = 0; ix < weights.size(); ++ix)
+    {
+        cumulativeWeight += weights[ix];
+        const size_t nCumulative = (ix + 1 == weights.size()) ? nTotal : size_t(double(nTotal) * cumulativeWeight / totalWeight);
+        counts[ix] = nCumulative - nAssigned;
+        nAssigned = nCumulative;
+    }
+}
+
+/// <summary>
+/// Replaces any previously generated workload with a new one.
+/// </summary>
+/// <param name="params">Input: shape of the workload</param>
+/// <param name="sErrorInfo">Output: information about any failures (inconsistent parameters)</param>
+/// <returns>true if successful</returns>
+bool SyntheticWorkload::Generate(const SyntheticWorkloadParams& params, std::wstring& sErrorInfo)
+{
+    // Initialize output variable
+    sErrorInfo.clear();
+    // Initialize internal data
+    m_handleInfoBuffer.clear();
+    m_zombieRecords.clear();
+    m_imagePaths.Clear();
+    m_zombieHandleLookup.clear();
+    m_zombieObjectAddrLookup.clear();
+    m_zombieObjectTypes.clear();
+    m_processImagePaths.clear();
+    m_services.clear();
+    m_ulCaptureTime = ulSyntheticCaptureTime;
+
+    if (
+        params.nProcesses < 2 ||
+        params.nObjectTypes <= ThreadTypeIndex + 1 ||
+        params.zombieRatio < 0 ||
+        params.unreferencedZombieFraction < 0 || params.unreferencedZombieFraction > 1 ||
+        params.zombieHandleFraction < 0 || params.zombieHandleFraction > 1 ||
+        params.processHandleFraction < 0 || params.threadHandleFraction < 0 ||
+        params.processHandleFraction + params.threadHandleFraction > 1 ||
+        params.ownerSkew < 0
+        )
+    {
+        sErrorInfo = L"SyntheticWorkload::Generate: invalid parameters";
+        return false;
+    }
+
+    SyntheticRandom random(params.seed);
+    const size_t nZombieProcesses = size_t(params.zombieRatio * double(params.nProcesses) + 0.5);
+    m_nTotalProcesses = params.nProcesses + nZombieProcesses;
+
+    // ------------------------------------------------------------------------------------------
+    // Running and zombie processes share the PID space. Running processes appear in the handle table in PID order;
+    // the capturing process is the running process with the highest PID.
+    std::vector<ULONG_PTR> pids(m_nTotalProcesses);
+    for (size_t ix = 0; ix < pids.size(); ++ix)
+        pids[ix] = ULONG_PTR(4 * (ix + 2));
+    random.Shuffle(pids);
+    std::vector<ULONG_PTR> runningPIDs(pids.begin(), pids.begin() + params.nProcesses);
+    std::sort(runningPIDs.begin(), runningPIDs.end());
+    const size_t ixCapturing = runningPIDs.size() - 1;
+    m_dwHandleOwnerPID = DWORD(runningPIDs[ixCapturing]);
+
+    // Image paths of running processes: service hosts, the capturing process, and a limited set of application names
+    // (so that owners with the same name are ordered by PID)
+    std::vector<bool> isServiceProcess(params.nProcesses, false);
+    for (size_t nService = 0; nService < params.nServiceProcesses && nService < ixCapturing; )
+    {
+        const size_t ix = size_t(random.Below(ixCapturing));
+        if (!isServiceProcess[ix])
+        {
+            isServiceProcess[ix] = true;
+            ++nService;
+        }
+    }
+    m_processImagePaths.resize(params.nProcesses);
+    size_t nServices = 0;
+    for (size_t ix = 0; ix < params.nProcesses; ++ix)
+    {
+        m_processImagePaths[ix].first = runningPIDs[ix];
+        std::wstringstream strPath;
+        if (ix == ixCapturing)
+        {
+            strPath << L"C:\\Tools\\ZombieFinder.exe";
+        }
+        else if (isServiceProcess[ix])
+        {
+            strPath << L"C:\\Windows\\System32\\svchost.exe";
+            ServiceList_t& serviceList = m_services[runningPIDs[ix]];
+            for (ULONGLONG nHosted = 1 + random.Below(3); nHosted > 0; --nHosted)
+            {
+                ServiceNames_t names;
+                std::wstringstream strName, strDisplayName;
+                strName << L"SyntheticSvc" << nServices;
+                strDisplayName << L"Synthetic Service " << nServices;
+                names.sServiceName = strName.str();
+                names.sDisplayName = strDisplayName.str();
+                serviceList.push_back(names);
+                ++nServices;
+            }
+        }
+        else
+        {
+            strPath << L"C:\\Program Files\\Synthetic\\App" << random.Below(200) << L".exe";
+        }
+        m_processImagePaths[ix].second = strPath.str();
+    }
+
+    // ------------------------------------------------------------------------------------------
+    // Zombie processes and their remaining threads. The capturing process holds a handle to each of them;
+    // other processes' handles reference only the zombies that aren't meant to be unexplained.
+    std::vector<SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX> ownEntries;
+    std::vector<size_t> referencedObjects;
+    // (Thread IDs come from the same ID space as process IDs, after all of the PIDs.)
+    DWORD lastTID = DWORD(4 * (m_nTotalProcesses + 1));
+    bool bAnyThreads = false;
+    for (size_t ixZombie = 0; ixZombie < nZombieProcesses; ++ixZombie)
+    {
+        ZombieProcessThreadInfo zombieInfo;
+        zombieInfo.PID = pids[params.nProcesses + ixZombie];
+        std::wstringstream strPath;
+        strPath << L"\\Device\\HarddiskVolume3\\Program Files\\Synthetic\\Worker" << random.Below(100) << L".exe";
+        zombieInfo.imagePathId = m_imagePaths.Intern(strPath.str());
+        // Exited between 10 seconds and 30 days before the capture, after running for up to a day
+        const ULONGLONG ulExitTime = m_ulCaptureTime - (10 + random.Below(30 * 24 * 3600)) * ulTicksPerSecond;
+        const ULONGLONG ulCreateTime = ulExitTime - (1 + random.Below(24 * 3600)) * ulTicksPerSecond;
+        *(ULONGLONG*)&zombieInfo.exitTime = ulExitTime;
+        *(ULONGLONG*)&zombieInfo.createTime = ulCreateTime;
+        zombieInfo.nThreads = ULONG(random.Below(ULONGLONG(params.nMaxZombieThreads) + 1));
+        const size_t ixParent = size_t(random.Below(params.nProcesses));
+        zombieInfo.ParentPID = runningPIDs[ixParent];
+        zombieInfo.parentImagePathId = m_imagePaths.Intern(m_processImagePaths[ixParent].second);
+        const bool bReferenced = random.Unit() >= params.unreferencedZombieFraction;
+
+        // Process object, then thread objects
+        for (ULONG ixObject = 0; ixObject <= zombieInfo.nThreads; ++ixObject)
+        {
+            zombieInfo.TID = (0 == ixObject) ? 0 : (lastTID += 4);
+            SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX entry = { 0 };
+            do
+            {
+                entry.Object = random.ObjectAddress();
+            } while (m_zombieObjectAddrLookup.end() != m_zombieObjectAddrLookup.find(entry.Object));
+            entry.UniqueProcessId = m_dwHandleOwnerPID;
+            entry.HandleValue = ULONG_PTR(4 * (ownEntries.size() + 1));
+            entry.ObjectTypeIndex = (0 == ixObject) ? ProcessTypeIndex : ThreadTypeIndex;
+            entry.GrantedAccess = (0 == ixObject) ? PROCESS_QUERY_LIMITED_INFORMATION : THREAD_QUERY_LIMITED_INFORMATION;
+            bAnyThreads = bAnyThreads || (0 != ixObject);
+
+            m_zombieHandleLookup[HANDLE(entry.HandleValue)] = m_zombieObjectAddrLookup[entry.Object] = ZombieRecordIndex_t(m_zombieRecords.size());
+            m_zombieRecords.push_back(zombieInfo);
+            if (bReferenced)
+                referencedObjects.push_back(ownEntries.size());
+            ownEntries.push_back(entry);
+        }
+    }
+    if (nZombieProcesses > 0)
+        m_zombieObjectTypes.push_back(ProcessTypeIndex);
+    if (bAnyThreads)
+        m_zombieObjectTypes.push_back(ThreadTypeIndex);
+
+    // ------------------------------------------------------------------------------------------
+    // How many handles each running process holds: to zombies, assigned by skewed owner rank, and to other objects,
+    // spread unevenly but without skew.
+    const size_t nZombieHandles = referencedObjects.empty() ? 0 : size_t(params.zombieHandleFraction * double(params.nHandles) + 0.5);
+    if (params.nHandles < nZombieHandles + ownEntries.size())
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"SyntheticWorkload::Generate: " << params.nHandles << L" handles is too few for "
+            << ownEntries.size() << L" zombie objects and " << nZombieHandles << L" handles to them";
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+    const size_t nOtherHandles = params.nHandles - nZombieHandles - ownEntries.size();
+
+    std::vector<size_t> zombieHandleCounts(params.nProcesses, 0);
+    if (nZombieHandles > 0)
+    {
+        // Owner ranks: a random ordering of the running processes other than the capturing process
+        std::vector<size_t> rankedProcesses(ixCapturing);
+        for (size_t ix = 0; ix < rankedProcesses.size(); ++ix)
+            rankedProcesses[ix] = ix;
+        random.Shuffle(rankedProcesses);
+        // Cumulative distribution of 1 / rank^skew
+        std::vector<double> cumulative(rankedProcesses.size());
+        double total = 0;
+        for (size_t ixRank = 0; ixRank < cumulative.size(); ++ixRank)
+        {
+            total += 1.0 / pow(double(ixRank + 1), params.ownerSkew);
+            cumulative[ixRank] = total;
+        }
+        for (size_t n = 0; n < nZombieHandles; ++n)
+        {
+            const size_t ixRank = std::min<size_t>(
+                size_t(std::upper_bound(cumulative.begin(), cumulative.end(), random.Unit() * total) - cumulative.begin()),
+                cumulative.size() - 1);
+            zombieHandleCounts[rankedProcesses[ixRank]]++;
+        }
+    }
+
+    std::vector<double> otherHandleWeights(params.nProcesses);
+    for (size_t ix = 0; ix < otherHandleWeights.size(); ++ix)
+        otherHandleWeights[ix] = 0.5 + random.Unit();
+    std::vector<size_t> otherHandleCounts;
+    ApportionCounts(nOtherHandles, otherHandleWeights, otherHandleCounts);
+
+    // ------------------------------------------------------------------------------------------
+    // Fill the handle table, process by process. Within a process, handles to zombies are at random positions among
+    // its other handles.
+    const size_t nHeaderBytes = offsetof(SYSTEM_HANDLE_INFORMATION_EX, Handles);
+    m_handleInfoBuffer.assign(nHeaderBytes + params.nHandles * sizeof(SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX), 0);
+    SYSTEM_HANDLE_INFORMATION_EX* pHandleInfo = (SYSTEM_HANDLE_INFORMATION_EX*)m_handleInfoBuffer.data();
+    pHandleInfo->NumberOfHandles = params.nHandles;
+    SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntry = pHandleInfo->Handles;
+    for (size_t ixProcess = 0; ixProcess < params.nProcesses; ++ixProcess)
+    {
+        const ULONG_PTR pid = runningPIDs[ixProcess];
+        ULONG_PTR handleValue = 4;
+        if (ixProcess == ixCapturing)
+        {
+            for (std::vector<SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX>::const_iterator iter = ownEntries.begin(); iter != ownEntries.end(); ++iter)
+                *pEntry++ = *iter;
+            handleValue = ULONG_PTR(4 * (ownEntries.size() + 1));
+        }
+
+        size_t nZombieRemaining = zombieHandleCounts[ixProcess];
+        size_t nRemaining = nZombieRemaining + otherHandleCounts[ixProcess];
+        for (; nRemaining > 0; --nRemaining, ++pEntry, handleValue += 4)
+        {
+            pEntry->UniqueProcessId = pid;
+            pEntry->HandleValue = handleValue;
+            if (nZombieRemaining > 0 && random.Below(nRemaining) < nZombieRemaining)
+            {
+                const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX& target = ownEntries[referencedObjects[size_t(random.Below(referencedObjects.size()))]];
+                pEntry->Object = target.Object;
+                pEntry->ObjectTypeIndex = target.ObjectTypeIndex;
+                pEntry->GrantedAccess = target.GrantedAccess;
+                --nZombieRemaining;
+            }
+            else
+            {
+                do
+                {
+                    pEntry->Object = random.ObjectAddress();
+                } while (m_zombieObjectAddrLookup.end() != m_zombieObjectAddrLookup.find(pEntry->Object));
+                const double typeRoll = random.Unit();
+                if (typeRoll < params.processHandleFraction)
+                    pEntry->ObjectTypeIndex = ProcessTypeIndex;
+                else if (typeRoll < params.processHandleFraction + params.threadHandleFraction)
+                    pEntry->ObjectTypeIndex = ThreadTypeIndex;
+                else
+                    pEntry->ObjectTypeIndex = USHORT(ThreadTypeIndex + 1 + random.Below(params.nObjectTypes - ThreadTypeIndex - 1));
+                pEntry->GrantedAccess = 0x001F0003;
+            }
+        }
+    }
+
+    return true;
+}
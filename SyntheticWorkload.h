@@ -0,0 +1,127 @@
+// Generator of synthetic systemwide handle tables, zombies, and owners, for exercising the correlation code at scale
+// without a live system. Makes no operating system calls, so it can run anywhere the code builds.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string>
+#include <vector>
+#include "NtInternal.h"
+#include "ZombieProcessThreadInfo.h"
+#include "ServiceLookupByPID.h"
+
+/// <summary>
+/// Shape of a synthetic workload.
+/// </summary>
+struct SyntheticWorkloadParams
+{
+    // Entries in the systemwide handle table
+    size_t nHandles = 4000000;
+    // Running processes, which hold all of the handles
+    size_t nProcesses = 2000;
+    // Zombie processes per running process
+    double zombieRatio = 1.25;
+    // Each zombie process still has between 0 and this many threads, uniformly distributed
+    ULONG nMaxZombieThreads = 2;
+    // Fraction of zombie processes to which no running process holds a handle (other than the capturing process)
+    double unreferencedZombieFraction = 0.05;
+    // Fraction of handle table entries that reference a zombie process or thread
+    double zombieHandleFraction = 0.01;
+    // Fractions of the remaining handle table entries that are process and thread handles;
+    // the rest are spread over the other object types
+    double processHandleFraction = 0.03;
+    double threadHandleFraction = 0.03;
+    // Number of object types, including Process and Thread
+    USHORT nObjectTypes = 70;
+    // Handles to zombies are assigned to running processes in a random order of ranks with probability proportional
+    // to 1 / rank^ownerSkew: 0 spreads them evenly; 1 or more concentrates them in a few leaking processes.
+    double ownerSkew = 1.0;
+    // Running processes that host services (1 to 3 each)
+    size_t nServiceProcesses = 20;
+    // Random number generator seed; the same parameters and seed always produce the same workload
+    ULONGLONG seed = 12345;
+};
+
+/// <summary>
+/// A generated workload: a systemwide handle table laid out as NtQuerySystemInformation returns it (grouped by process),
+/// the zombie processes/threads and the capturing process' handles to them, and the running processes' image paths
+/// and services.
+/// </summary>
+class SyntheticWorkload
+{
+public:
+    SyntheticWorkload() = default;
+    virtual ~SyntheticWorkload() = default;
+
+    /// <summary>
+    /// Object type indexes used for process and thread handles (the values of recent Windows versions).
+    /// </summary>
+    static const USHORT ProcessTypeIndex = 7;
+    static const USHORT ThreadTypeIndex = 8;
+
+    /// <summary>
+    /// Replaces any previously generated workload with a new one.
+    /// </summary>
+    /// <param name="params">Input: shape of the workload</param>
+    /// <param name="sErrorInfo">Output: information about any failures (inconsistent parameters)</param>
+    /// <returns>true if successful</returns>
+    bool Generate(const SyntheticWorkloadParams& params, std::wstring& sErrorInfo);
+
+    /// <summary>
+    /// The systemwide handle table, laid out as NtQuerySystemInformation returns it
+    /// </summary>
+    const SYSTEM_HANDLE_INFORMATION_EX* HandleInformation() const { return (const SYSTEM_HANDLE_INFORMATION_EX*)m_handleInfoBuffer.data(); }
+    const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* HandleEntries() const { return HandleInformation()->Handles; }
+    size_t NumberOfHandles() const { return m_handleInfoBuffer.empty() ? 0 : size_t(HandleInformation()->NumberOfHandles); }
+
+    /// <summary>
+    /// The zombie processes/threads, the table of their image paths, the capturing process' handles to them (indexes into
+    /// ZombieRecords), and its PID
+    /// </summary>
+    const ZombieRecordStore_t& ZombieRecords() const { return m_zombieRecords; }
+    const ImagePathTable& ImagePaths() const { return m_imagePaths; }
+    const ZombieHandleLookup_t& ZombieHandleLookup() const { return m_zombieHandleLookup; }
+    DWORD HandleOwnerPID() const { return m_dwHandleOwnerPID; }
+
+    /// <summary>
+    /// The object address lookup that correlation builds from the capturing process' handles, and the object types
+    /// of the zombie objects, for exercising the handle table search directly
+    /// </summary>
+    const ZombieObjectAddrLookup_t& ZombieObjectAddrLookup() const { return m_zombieObjectAddrLookup; }
+    const std::vector<USHORT>& ZombieObjectTypes() const { return m_zombieObjectTypes; }
+
+    /// <summary>
+    /// Image paths of the running processes, and services hosted by service processes
+    /// </summary>
+    const std::vector<std::pair<ULONG_PTR, std::wstring>>& ProcessImagePaths() const { return m_processImagePaths; }
+    const ServiceLookupByPID_t& Services() const { return m_services; }
+
+    /// <summary>
+    /// Number of running and zombie processes
+    /// </summary>
+    size_t TotalProcessCount() const { return m_nTotalProcesses; }
+
+    /// <summary>
+    /// Time at which the workload was "captured" (FILETIME value); zombie exit times are before it
+    /// </summary>
+    ULONGLONG CaptureTime() const { return m_ulCaptureTime; }
+
+private:
+    // SYSTEM_HANDLE_INFORMATION_EX header and entries
+    std::vector<BYTE> m_handleInfoBuffer;
+    ZombieRecordStore_t m_zombieRecords;
+    ImagePathTable m_imagePaths;
+    ZombieHandleLookup_t m_zombieHandleLookup;
+    DWORD m_dwHandleOwnerPID = 0;
+    ZombieObjectAddrLookup_t m_zombieObjectAddrLookup;
+    std::vector<USHORT> m_zombieObjectTypes;
+    std::vector<std::pair<ULONG_PTR, std::wstring>> m_processImagePaths;
+    ServiceLookupByPID_t m_services;
+    size_t m_nTotalProcesses = 0;
+    ULONGLONG m_ulCaptureTime = 0;
+
+private:
+    // Not implemented
+    SyntheticWorkload(const SyntheticWorkload&) = delete;
+    SyntheticWorkload& operator = (const SyntheticWorkload&) = delete;
+};
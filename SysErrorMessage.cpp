@@ -1,5 +1,8 @@
-#include <Windows.h>
+#include "PlatformTypes.h"
 #include <sstream>
+#ifndef _WIN32
+#include <cstring>
+#endif
 #include "SysErrorMessage.h"
 #include "HEX.h"
 
@@ -24,6 +27,26 @@ wchar_t* RemoveTrailingCRLF(wchar_t* psz)
 	return psz;
 }
 
+#ifndef _WIN32
+static std::wstring SysErrorMessage_Impl(DWORD dwErrCode, bool bWithErrorCode, bool bNtStatus)
+{
+	// errno values have text; the NTSTATUS values that the platform layer reports don't.
+	std::wstringstream sRetval;
+	if (!bNtStatus && 0 != dwErrCode)
+	{
+		const char* szErrMsg = strerror(int(dwErrCode));
+		while (nullptr != szErrMsg && '\0' != *szErrMsg)
+			sRetval << wchar_t(*szErrMsg++);
+		if (bWithErrorCode)
+			sRetval << L" ";
+	}
+	if (bNtStatus || 0 == dwErrCode || bWithErrorCode)
+	{
+		sRetval << L"Error # " << dwErrCode << L" (" << HEX(dwErrCode, 8, true, true) << L")";
+	}
+	return sRetval.str();
+}
+#else
 static std::wstring SysErrorMessage_Impl(DWORD dwErrCode, bool bWithErrorCode, bool bNtStatus)
 {
 	LPWSTR pszErrMsg = NULL;
@@ -64,6 +87,7 @@ static std::wstring SysErrorMessage_Impl(DWORD dwErrCode, bool bWithErrorCode, b
 
 	return sRetval.str();
 }
+#endif
 
 /// <summary>
 /// Returns human-language error text from a Windows error code
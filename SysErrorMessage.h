@@ -1,6 +1,6 @@
 #pragma once
 
-#include <Windows.h>
+#include "PlatformTypes.h"
 #include <string>
 
 // ----------------------------------------------------------------------------------------------------
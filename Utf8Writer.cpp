@@ -0,0 +1,600 @@
+// Buffered UTF-8 text output to a file, standard output, or memory, with allocation-free formatting of the numbers,
+// timestamps, and durations that the results and diagnostic dumps contain.
+
+#include "PlatformTypes.h"
+#include <algorithm>
+#include <cstring>
+#include "FileOutput.h"
+#include "SysErrorMessage.h"
+#include "Utf8Writer.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+static const char szLineEnd[] = "\r\n";
+#else
+static const char szLineEnd[] = "\n";
+#endif
+
+Utf8Writer::Utf8Writer() :
+    m_target(Target_t::None),
+#ifdef _WIN32
+    m_hFile(INVALID_HANDLE_VALUE),
+#else
+    m_fd(-1),
+#endif
+    m_bFailed(false),
+    m_nBytesFlushed(0),
+    m_nBuffered(0)
+{
+}
+
+Utf8Writer::~Utf8Writer()
+{
+    Close();
+}
+
+/// <summary>
+/// Opens a file for output. Text output begins with a UTF-8 BOM unless appending to an existing, non-empty file.
+/// Closes any previous target first.
+/// </summary>
+/// <param name="szFilename">Input: name of output file</param>
+/// <param name="bAppend">Input: true to append to the file, false to overwrite it</param>
+/// <param name="sErrorInfo">Output: the system's error message on failure</param>
+/// <param name="bText">Input: false for binary output (WriteBytes), which gets no BOM</param>
+/// <returns>true if successful</returns>
+bool Utf8Writer::OpenFile(const wchar_t* szFilename, bool bAppend, std::wstring& sErrorInfo, bool bText)
+{
+    Close();
+    m_bFailed = false;
+    m_nBytesFlushed = 0;
+
+    // The BOM goes at the start of the file; when appending, only if the file is empty or doesn't exist yet.
+    bool bWriteBom = bText;
+#ifdef _WIN32
+    m_hFile = CreateFileW(szFilename, bAppend ? FILE_APPEND_DATA : GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        bAppend ? OPEN_ALWAYS : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (INVALID_HANDLE_VALUE == m_hFile)
+    {
+        sErrorInfo = SysErrorMessageWithCode(GetLastError());
+        return false;
+    }
+    LARGE_INTEGER fileSize = { 0 };
+    if (bAppend && GetFileSizeEx(m_hFile, &fileSize) && fileSize.QuadPart > 0)
+    {
+        bWriteBom = false;
+    }
+#else
+    m_fd = open(NarrowFilePath(szFilename).c_str(), O_WRONLY | O_CREAT | O_CLOEXEC | (bAppend ? O_APPEND : O_TRUNC), 0666);
+    if (m_fd < 0)
+    {
+        sErrorInfo = SysErrorMessageWithCode(GetLastError());
+        return false;
+    }
+    struct stat st;
+    if (bAppend && 0 == fstat(m_fd, &st) && st.st_size > 0)
+    {
+        bWriteBom = false;
+    }
+#endif
+    m_target = Target_t::File;
+    if (bWriteBom)
+    {
+        Write(L'\xFEFF');
+    }
+    return true;
+}
+
+/// <summary>
+/// Directs output to the process' standard output (no BOM). Closes any previous target first.
+/// </summary>
+void Utf8Writer::OpenStandardOutput()
+{
+    Close();
+    m_bFailed = false;
+    m_nBytesFlushed = 0;
+#ifdef _WIN32
+    m_hFile = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD dwMode = 0;
+    m_target = GetConsoleMode(m_hFile, &dwMode) ? Target_t::Console : Target_t::StandardOutput;
+#else
+    m_fd = STDOUT_FILENO;
+    m_target = Target_t::StandardOutput;
+#endif
+}
+
+/// <summary>
+/// Directs output to memory; see MemoryContents. Closes any previous target first.
+/// </summary>
+void Utf8Writer::OpenMemory()
+{
+    Close();
+    m_bFailed = false;
+    m_nBytesFlushed = 0;
+    m_sMemory.clear();
+    m_target = Target_t::Memory;
+}
+
+/// <summary>
+/// Writes any buffered output to the target.
+/// </summary>
+/// <returns>true if all output so far has been written successfully</returns>
+bool Utf8Writer::Flush()
+{
+    if (m_nBuffered > 0)
+    {
+        if (!m_bFailed && !WriteBuffer())
+        {
+            m_bFailed = true;
+        }
+        m_nBytesFlushed += m_nBuffered;
+        m_nBuffered = 0;
+    }
+    return !m_bFailed;
+}
+
+/// <summary>
+/// Flushes, and closes the target if it's a file.
+/// </summary>
+/// <returns>true if all output has been written successfully</returns>
+bool Utf8Writer::Close()
+{
+    bool bSuccess = Flush();
+#ifdef _WIN32
+    if (Target_t::File == m_target && !CloseHandle(m_hFile))
+    {
+        bSuccess = false;
+    }
+    m_hFile = INVALID_HANDLE_VALUE;
+#else
+    if (Target_t::File == m_target && 0 != close(m_fd))
+    {
+        bSuccess = false;
+    }
+    m_fd = -1;
+#endif
+    if (!bSuccess)
+    {
+        m_bFailed = true;
+    }
+    m_target = Target_t::None;
+    return bSuccess;
+}
+
+/// <summary>
+/// Internal: writes the buffered bytes to the target.
+/// </summary>
+bool Utf8Writer::WriteBuffer()
+{
+    switch (m_target)
+    {
+    case Target_t::Memory:
+        m_sMemory.append(m_buffer, m_nBuffered);
+        return true;
+
+#ifdef _WIN32
+    case Target_t::Console:
+    {
+        // The buffer always ends on a character boundary, so each flush converts on its own.
+        const int nWide = MultiByteToWideChar(CP_UTF8, 0, m_buffer, int(m_nBuffered), nullptr, 0);
+        m_sConsoleConversion.resize(size_t(nWide));
+        if (nWide > 0)
+        {
+            MultiByteToWideChar(CP_UTF8, 0, m_buffer, int(m_nBuffered), &m_sConsoleConversion[0], nWide);
+        }
+        const wchar_t* pNext = m_sConsoleConversion.c_str();
+        DWORD dwRemaining = DWORD(nWide);
+        while (dwRemaining > 0)
+        {
+            DWORD dwWritten = 0;
+            if (!WriteConsoleW(m_hFile, pNext, dwRemaining, &dwWritten, nullptr) || 0 == dwWritten)
+                return false;
+            pNext += dwWritten;
+            dwRemaining -= dwWritten;
+        }
+        return true;
+    }
+
+    case Target_t::File:
+    case Target_t::StandardOutput:
+    {
+        const char* pNext = m_buffer;
+        DWORD dwRemaining = DWORD(m_nBuffered);
+        while (dwRemaining > 0)
+        {
+            DWORD dwWritten = 0;
+            if (!WriteFile(m_hFile, pNext, dwRemaining, &dwWritten, nullptr) || 0 == dwWritten)
+                return false;
+            pNext += dwWritten;
+            dwRemaining -= dwWritten;
+        }
+        return true;
+    }
+#else
+    case Target_t::File:
+    case Target_t::StandardOutput:
+    {
+        const char* pNext = m_buffer;
+        size_t nRemaining = m_nBuffered;
+        while (nRemaining > 0)
+        {
+            const ssize_t nWritten = write(m_fd, pNext, nRemaining);
+            if (nWritten < 0 && EINTR == errno)
+                continue;
+            if (nWritten <= 0)
+                return false;
+            pNext += nWritten;
+            nRemaining -= size_t(nWritten);
+        }
+        return true;
+    }
+#endif
+
+    default:
+        // No target: output is discarded
+        return true;
+    }
+}
+
+/// <summary>
+/// Internal: makes room for at least nBytes in the buffer, flushing if necessary.
+/// </summary>
+inline void Utf8Writer::Reserve(size_t nBytes)
+{
+    if (BufferSize - m_nBuffered < nBytes)
+    {
+        Flush();
+    }
+}
+
+Utf8Writer& Utf8Writer::Write(const wchar_t* sz)
+{
+    return Write(sz, wcslen(sz));
+}
+
+Utf8Writer& Utf8Writer::Write(const wchar_t* pch, size_t nChars)
+{
+    const wchar_t* const pEnd = pch + nChars;
+    while (pch < pEnd)
+    {
+        // Room for one code point at a time, at most 4 bytes; ASCII runs are copied without further checks.
+        Reserve(4);
+        char* pOut = m_buffer + m_nBuffered;
+        char* const pOutEnd = m_buffer + BufferSize - 4;
+        while (pch < pEnd && pOut <= pOutEnd)
+        {
+            ULONG cp = ULONG(*pch++);
+            if (cp < 0x80)
+            {
+                *pOut++ = char(cp);
+                continue;
+            }
+            // Combine a UTF-16 surrogate pair; an unpaired surrogate, or any value that isn't a code point, becomes U+FFFD.
+            if (cp >= 0xD800 && cp <= 0xDBFF && pch < pEnd && ULONG(*pch) >= 0xDC00 && ULONG(*pch) <= 0xDFFF)
+            {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (ULONG(*pch++) - 0xDC00);
+            }
+            else if ((cp >= 0xD800 && cp <= 0xDFFF) || cp > 0x10FFFF)
+            {
+                cp = 0xFFFD;
+            }
+            if (cp < 0x800)
+            {
+                *pOut++ = char(0xC0 | (cp >> 6));
+                *pOut++ = char(0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000)
+            {
+                *pOut++ = char(0xE0 | (cp >> 12));
+                *pOut++ = char(0x80 | ((cp >> 6) & 0x3F));
+                *pOut++ = char(0x80 | (cp & 0x3F));
+            }
+            else
+            {
+                *pOut++ = char(0xF0 | (cp >> 18));
+                *pOut++ = char(0x80 | ((cp >> 12) & 0x3F));
+                *pOut++ = char(0x80 | ((cp >> 6) & 0x3F));
+                *pOut++ = char(0x80 | (cp & 0x3F));
+            }
+        }
+        m_nBuffered = size_t(pOut - m_buffer);
+    }
+    return *this;
+}
+
+/// <summary>
+/// Writes bytes as they are, for binary output.
+/// </summary>
+Utf8Writer& Utf8Writer::WriteBytes(const void* pData, size_t nBytes)
+{
+    const char* pNext = (const char*)pData;
+    while (nBytes > 0)
+    {
+        Reserve(1);
+        const size_t nNow = std::min(nBytes, BufferSize - m_nBuffered);
+        memcpy(m_buffer + m_nBuffered, pNext, nNow);
+        m_nBuffered += nNow;
+        pNext += nNow;
+        nBytes -= nNow;
+    }
+    return *this;
+}
+
+/// <summary>
+/// Writes text as a JSON string literal: in quotes, with quotes, backslashes, and control characters escaped.
+/// </summary>
+Utf8Writer& Utf8Writer::WriteJsonString(const wchar_t* pch, size_t nChars)
+{
+    WriteRepeated('"', 1);
+    // Runs of characters that need no escaping are written as they are
+    const wchar_t* pRun = pch;
+    const wchar_t* const pEnd = pch + nChars;
+    for (; pch < pEnd; ++pch)
+    {
+        const wchar_t ch = *pch;
+        if (ch >= 0x20 && L'"' != ch && L'\\' != ch)
+            continue;
+        Write(pRun, size_t(pch - pRun));
+        pRun = pch + 1;
+        Reserve(6);
+        char* pOut = m_buffer + m_nBuffered;
+        *pOut++ = '\\';
+        switch (ch)
+        {
+        case L'"': *pOut++ = '"'; break;
+        case L'\\': *pOut++ = '\\'; break;
+        case L'\n': *pOut++ = 'n'; break;
+        case L'\r': *pOut++ = 'r'; break;
+        case L'\t': *pOut++ = 't'; break;
+        default:
+            *pOut++ = 'u';
+            *pOut++ = '0';
+            *pOut++ = '0';
+            *pOut++ = "0123456789abcdef"[(ch >> 4) & 0xF];
+            *pOut++ = "0123456789abcdef"[ch & 0xF];
+            break;
+        }
+        m_nBuffered = size_t(pOut - m_buffer);
+    }
+    Write(pRun, size_t(pch - pRun));
+    return WriteRepeated('"', 1);
+}
+
+/// <summary>
+/// Writes nCount copies of an ASCII character, such as spaces to fill out a field.
+/// </summary>
+Utf8Writer& Utf8Writer::WriteRepeated(char ch, size_t nCount)
+{
+    while (nCount > 0)
+    {
+        Reserve(1);
+        const size_t nNow = std::min(nCount, BufferSize - m_nBuffered);
+        memset(m_buffer + m_nBuffered, ch, nNow);
+        m_nBuffered += nNow;
+        nCount -= nNow;
+    }
+    return *this;
+}
+
+/// <summary>
+/// Writes the line end.
+/// </summary>
+Utf8Writer& Utf8Writer::EndLine()
+{
+    Reserve(sizeof(szLineEnd) - 1);
+    memcpy(m_buffer + m_nBuffered, szLineEnd, sizeof(szLineEnd) - 1);
+    m_nBuffered += sizeof(szLineEnd) - 1;
+    return *this;
+}
+
+/// <summary>
+/// Number of characters in the decimal representation of a number, for computing field widths.
+/// </summary>
+size_t Utf8Writer::DecimalLength(ULONGLONG value)
+{
+    size_t nDigits = 1;
+    while (value >= 10)
+    {
+        value /= 10;
+        ++nDigits;
+    }
+    return nDigits;
+}
+
+/// <summary>
+/// Number of bytes that Write produces for the text, for length-prefixed strings in binary output.
+/// </summary>
+size_t Utf8Writer::Utf8Length(const wchar_t* pch, size_t nChars)
+{
+    // Same rules as Write: surrogate pairs combine into one 4-byte sequence, anything else invalid becomes U+FFFD.
+    size_t nBytes = 0;
+    const wchar_t* const pEnd = pch + nChars;
+    while (pch < pEnd)
+    {
+        ULONG cp = ULONG(*pch++);
+        if (cp < 0x80)
+            nBytes += 1;
+        else if (cp < 0x800)
+            nBytes += 2;
+        else if (cp >= 0xD800 && cp <= 0xDBFF && pch < pEnd && ULONG(*pch) >= 0xDC00 && ULONG(*pch) <= 0xDFFF)
+        {
+            ++pch;
+            nBytes += 4;
+        }
+        else if ((cp >= 0xD800 && cp <= 0xDFFF) || cp < 0x10000 || cp > 0x10FFFF)
+            nBytes += 3;
+        else
+            nBytes += 4;
+    }
+    return nBytes;
+}
+
+/// <summary>
+/// Writes a decimal number, right-aligned in a field nWidth characters wide (padded with spaces) if it's shorter.
+/// </summary>
+Utf8Writer& Utf8Writer::WriteUnsigned(ULONGLONG value, size_t nWidth)
+{
+    // Digits are generated from the end of a local buffer; 20 digits is enough for any 64-bit value.
+    char digits[20];
+    char* pFirst = digits + sizeof(digits);
+    do
+    {
+        *--pFirst = char('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    const size_t nDigits = size_t(digits + sizeof(digits) - pFirst);
+    if (nWidth > nDigits)
+    {
+        WriteRepeated(' ', nWidth - nDigits);
+    }
+    Reserve(nDigits);
+    memcpy(m_buffer + m_nBuffered, pFirst, nDigits);
+    m_nBuffered += nDigits;
+    return *this;
+}
+
+Utf8Writer& Utf8Writer::WriteSigned(LONGLONG value)
+{
+    if (value < 0)
+    {
+        WriteRepeated('-', 1);
+        // Negate as unsigned so that the most negative value doesn't overflow
+        return WriteUnsigned(0 - ULONGLONG(value));
+    }
+    return WriteUnsigned(ULONGLONG(value));
+}
+
+/// <summary>
+/// Writes a number in hexadecimal, zero-filled to at least nDigits digits, as HEX() formats it.
+/// </summary>
+Utf8Writer& Utf8Writer::WriteHex(ULONGLONG value, size_t nDigits, bool bUpcase, bool b0xPrefix)
+{
+    const char* const szHexDigits = bUpcase ? "0123456789ABCDEF" : "0123456789abcdef";
+    char digits[16];
+    char* pFirst = digits + sizeof(digits);
+    do
+    {
+        *--pFirst = szHexDigits[value & 0xF];
+        value >>= 4;
+    } while (value > 0);
+    const size_t nValueDigits = size_t(digits + sizeof(digits) - pFirst);
+    if (b0xPrefix)
+    {
+        Write(L"0x", 2);
+    }
+    if (nDigits > nValueDigits)
+    {
+        WriteRepeated('0', nDigits - nValueDigits);
+    }
+    Reserve(nValueDigits);
+    memcpy(m_buffer + m_nBuffered, pFirst, nValueDigits);
+    m_nBuffered += nValueDigits;
+    return *this;
+}
+
+/// <summary>
+/// Internal helper: stores a number as a fixed count of zero-filled decimal digits.
+/// </summary>
+static inline char* PutDigits(char* pOut, unsigned value, size_t nDigits)
+{
+    for (size_t ix = nDigits; ix > 0; --ix)
+    {
+        pOut[ix - 1] = char('0' + value % 10);
+        value /= 10;
+    }
+    return pOut + nDigits;
+}
+
+/// <summary>
+/// Writes a FILETIME as FileTimeToWString formats it: yyyy-MM-dd HH:mm:ss[.fff], or szIfZero if the value is zero.
+/// </summary>
+Utf8Writer& Utf8Writer::WriteFileTime(const FILETIME& ft, bool bIncludeMilliseconds, const wchar_t* szIfZero)
+{
+    if (0 == ft.dwHighDateTime && 0 == ft.dwLowDateTime)
+    {
+        return Write(szIfZero ? szIfZero : L"");
+    }
+
+    SYSTEMTIME st;
+    FileTimeToSystemTime(&ft, &st);
+    Reserve(MaxFormattedBytes);
+    char* pOut = m_buffer + m_nBuffered;
+    pOut = PutDigits(pOut, st.wYear, st.wYear > 9999 ? 5 : 4);
+    *pOut++ = '-';
+    pOut = PutDigits(pOut, st.wMonth, 2);
+    *pOut++ = '-';
+    pOut = PutDigits(pOut, st.wDay, 2);
+    *pOut++ = ' ';
+    pOut = PutDigits(pOut, st.wHour, 2);
+    *pOut++ = ':';
+    pOut = PutDigits(pOut, st.wMinute, 2);
+    *pOut++ = ':';
+    pOut = PutDigits(pOut, st.wSecond, 2);
+    if (bIncludeMilliseconds)
+    {
+        *pOut++ = '.';
+        pOut = PutDigits(pOut, st.wMilliseconds, 3);
+    }
+    m_nBuffered = size_t(pOut - m_buffer);
+    return *this;
+}
+
+/// <summary>
+/// Writes a FILETIME as an ISO 8601 UTC timestamp with milliseconds: yyyy-MM-ddTHH:mm:ss.fffZ.
+/// </summary>
+Utf8Writer& Utf8Writer::WriteIso8601(const FILETIME& ft)
+{
+    SYSTEMTIME st;
+    FileTimeToSystemTime(&ft, &st);
+    Reserve(MaxFormattedBytes);
+    char* pOut = m_buffer + m_nBuffered;
+    pOut = PutDigits(pOut, st.wYear, st.wYear > 9999 ? 5 : 4);
+    *pOut++ = '-';
+    pOut = PutDigits(pOut, st.wMonth, 2);
+    *pOut++ = '-';
+    pOut = PutDigits(pOut, st.wDay, 2);
+    *pOut++ = 'T';
+    pOut = PutDigits(pOut, st.wHour, 2);
+    *pOut++ = ':';
+    pOut = PutDigits(pOut, st.wMinute, 2);
+    *pOut++ = ':';
+    pOut = PutDigits(pOut, st.wSecond, 2);
+    *pOut++ = '.';
+    pOut = PutDigits(pOut, st.wMilliseconds, 3);
+    *pOut++ = 'Z';
+    m_nBuffered = size_t(pOut - m_buffer);
+    return *this;
+}
+
+/// <summary>
+/// Writes a number of seconds as Ago() formats it; e.g., "1 min 30 secs".
+/// </summary>
+Utf8Writer& Utf8Writer::WriteAgo(ULONGLONG nSecondsAgo)
+{
+    const ULONGLONG nDays = nSecondsAgo / ULONGLONG(24 * 3600);
+    nSecondsAgo = nSecondsAgo % ULONGLONG(24 * 3600);
+    const ULONGLONG nHours = nSecondsAgo / 3600;
+    nSecondsAgo %= 3600;
+    const ULONGLONG nMinutes = nSecondsAgo / 60;
+    const ULONGLONG nSeconds = nSecondsAgo % 60;
+
+    bool bShow = false;
+    if (nDays > 0)
+    {
+        WriteUnsigned(nDays).Write(nDays == 1 ? L" day " : L" days ");
+        bShow = true;
+    }
+    if (bShow || nHours > 0)
+    {
+        WriteUnsigned(nHours).Write(nHours == 1 ? L" hour " : L" hrs ");
+        bShow = true;
+    }
+    if (bShow || nMinutes > 0)
+    {
+        WriteUnsigned(nMinutes).Write(L" min ");
+    }
+    return WriteUnsigned(nSeconds).Write(L" secs");
+}
@@ -0,0 +1,175 @@
+// Buffered UTF-8 text output to a file, standard output, or memory, with allocation-free formatting of the numbers,
+// timestamps, and durations that the results and diagnostic dumps contain.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string>
+
+/// <summary>
+/// Buffered UTF-8 text writer.
+///
+/// Text is converted from UTF-16 (UTF-32 where wchar_t is 32 bits) to UTF-8 directly into a fixed buffer, and numbers,
+/// timestamps, and durations are formatted there without temporary strings. The buffer is written to the target when
+/// it fills, when Flush or Close is called, and on destruction; nothing else flushes, so callers decide the flush points
+/// (e.g., after each -watch sample). Line ends are CR LF on Windows and LF elsewhere, as the text-mode streams wrote them.
+///
+/// Writing to a Windows console uses WriteConsoleW so that the text displays correctly regardless of the console code page.
+///
+/// A write failure is remembered: later output is discarded, and Flush and Close return false.
+/// </summary>
+class Utf8Writer
+{
+public:
+    Utf8Writer();
+    ~Utf8Writer();
+
+    /// <summary>
+    /// Opens a file for output. Text output begins with a UTF-8 BOM unless appending to an existing, non-empty file.
+    /// Closes any previous target first.
+    /// </summary>
+    /// <param name="szFilename">Input: name of output file</param>
+    /// <param name="bAppend">Input: true to append to the file, false to overwrite it</param>
+    /// <param name="sErrorInfo">Output: the system's error message on failure</param>
+    /// <param name="bText">Input: false for binary output (WriteBytes), which gets no BOM</param>
+    /// <returns>true if successful</returns>
+    bool OpenFile(const wchar_t* szFilename, bool bAppend, std::wstring& sErrorInfo, bool bText = true);
+
+    /// <summary>
+    /// Directs output to the process' standard output (no BOM). Closes any previous target first.
+    /// </summary>
+    void OpenStandardOutput();
+
+    /// <summary>
+    /// Directs output to memory; see MemoryContents. Closes any previous target first.
+    /// </summary>
+    void OpenMemory();
+
+    /// <summary>
+    /// UTF-8 output written so far to the memory target, up to the last flush.
+    /// </summary>
+    const std::string& MemoryContents() const { return m_sMemory; }
+
+    /// <summary>
+    /// Writes any buffered output to the target.
+    /// </summary>
+    /// <returns>true if all output so far has been written successfully</returns>
+    bool Flush();
+
+    /// <summary>
+    /// Flushes, and closes the target if it's a file.
+    /// </summary>
+    /// <returns>true if all output has been written successfully</returns>
+    bool Close();
+
+    /// <summary>
+    /// Number of bytes of UTF-8 written, including any that are still buffered.
+    /// </summary>
+    ULONGLONG BytesWritten() const { return m_nBytesFlushed + m_nBuffered; }
+
+    // Text
+    Utf8Writer& Write(const wchar_t* sz);
+    Utf8Writer& Write(const wchar_t* pch, size_t nChars);
+    Utf8Writer& Write(const std::wstring& str) { return Write(str.c_str(), str.length()); }
+    Utf8Writer& Write(wchar_t ch) { return Write(&ch, 1); }
+
+    /// <summary>
+    /// Writes bytes as they are, for binary output.
+    /// </summary>
+    Utf8Writer& WriteBytes(const void* pData, size_t nBytes);
+
+    /// <summary>
+    /// Writes text as a JSON string literal: in quotes, with quotes, backslashes, and control characters escaped.
+    /// </summary>
+    Utf8Writer& WriteJsonString(const wchar_t* pch, size_t nChars);
+    Utf8Writer& WriteJsonString(const std::wstring& str) { return WriteJsonString(str.c_str(), str.length()); }
+
+    /// <summary>
+    /// Writes nCount copies of an ASCII character, such as spaces to fill out a field.
+    /// </summary>
+    Utf8Writer& WriteRepeated(char ch, size_t nCount);
+
+    /// <summary>
+    /// Writes the line end.
+    /// </summary>
+    Utf8Writer& EndLine();
+
+    /// <summary>
+    /// Writes a decimal number, right-aligned in a field nWidth characters wide (padded with spaces) if it's shorter.
+    /// </summary>
+    Utf8Writer& WriteUnsigned(ULONGLONG value, size_t nWidth = 0);
+    Utf8Writer& WriteSigned(LONGLONG value);
+
+    /// <summary>
+    /// Writes a number in hexadecimal, zero-filled to at least nDigits digits, as HEX() formats it.
+    /// </summary>
+    Utf8Writer& WriteHex(ULONGLONG value, size_t nDigits, bool bUpcase = false, bool b0xPrefix = false);
+
+    /// <summary>
+    /// Writes a FILETIME as FileTimeToWString formats it: yyyy-MM-dd HH:mm:ss[.fff], or szIfZero if the value is zero.
+    /// </summary>
+    Utf8Writer& WriteFileTime(const FILETIME& ft, bool bIncludeMilliseconds, const wchar_t* szIfZero = L"");
+
+    /// <summary>
+    /// Writes a FILETIME as an ISO 8601 UTC timestamp with milliseconds: yyyy-MM-ddTHH:mm:ss.fffZ.
+    /// </summary>
+    Utf8Writer& WriteIso8601(const FILETIME& ft);
+
+    /// <summary>
+    /// Writes a number of seconds as Ago() formats it; e.g., "1 min 30 secs".
+    /// </summary>
+    Utf8Writer& WriteAgo(ULONGLONG nSecondsAgo);
+
+    /// <summary>
+    /// Number of characters in the decimal representation of a number, for computing field widths.
+    /// </summary>
+    static size_t DecimalLength(ULONGLONG value);
+
+    /// <summary>
+    /// Number of bytes that Write produces for the text, for length-prefixed strings in binary output.
+    /// </summary>
+    static size_t Utf8Length(const wchar_t* pch, size_t nChars);
+    static size_t Utf8Length(const std::wstring& str) { return Utf8Length(str.c_str(), str.length()); }
+
+    // Stream-style insertion of text and decimal numbers
+    Utf8Writer& operator << (const wchar_t* sz) { return Write(sz); }
+    Utf8Writer& operator << (const std::wstring& str) { return Write(str); }
+    Utf8Writer& operator << (wchar_t ch) { return Write(ch); }
+    Utf8Writer& operator << (int value) { return WriteSigned(value); }
+    Utf8Writer& operator << (long value) { return WriteSigned(value); }
+    Utf8Writer& operator << (long long value) { return WriteSigned(value); }
+    Utf8Writer& operator << (unsigned int value) { return WriteUnsigned(value); }
+    Utf8Writer& operator << (unsigned long value) { return WriteUnsigned(value); }
+    Utf8Writer& operator << (unsigned long long value) { return WriteUnsigned(value); }
+
+private:
+    // Makes room for at least nBytes in the buffer (nBytes no larger than the buffer), flushing if necessary.
+    void Reserve(size_t nBytes);
+    // Writes the buffered bytes to the target.
+    bool WriteBuffer();
+
+private:
+    enum class Target_t { None, File, StandardOutput, Console, Memory };
+    Target_t m_target;
+#ifdef _WIN32
+    HANDLE m_hFile;
+    // Console output is converted back to UTF-16 for WriteConsoleW
+    std::wstring m_sConsoleConversion;
+#else
+    int m_fd;
+#endif
+    std::string m_sMemory;
+    bool m_bFailed;
+    ULONGLONG m_nBytesFlushed;
+
+    // Largest output of any single formatting call; Reserve is never asked for more
+    static const size_t MaxFormattedBytes = 64;
+    static const size_t BufferSize = 64 * 1024;
+    char m_buffer[BufferSize];
+    size_t m_nBuffered;
+
+private:
+    // Not implemented
+    Utf8Writer(const Utf8Writer&) = delete;
+    Utf8Writer& operator = (const Utf8Writer&) = delete;
+};
@@ -0,0 +1,204 @@
+// Helpers for spreading independent work across a pool of worker threads.
+
+#include "PlatformTypes.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "WorkerPool.h"
+
+/// <summary>
+/// Callback run by each worker in a WorkerThreads round: ixWorker is 0 on the calling thread, 1 and up on the pool's threads.
+/// </summary>
+typedef std::function<void(size_t ixWorker)> RoundWork_t;
+
+/// <summary>
+/// The threads behind RunPartitioned and RunDynamic. They're started the first time a call needs them, and then wait
+/// for the next call rather than exiting, so that each handle table scan phase, thread report, and -watch sample
+/// doesn't pay for creating and joining threads. The pool grows to the largest number of workers requested, and its
+/// threads are joined at exit.
+/// One round runs at a time. A call made while a round is in progress (from another thread, or from within a worker's
+/// callback) gets false from Run and does its work serially instead.
+/// </summary>
+class WorkerThreads
+{
+public:
+    /// <summary>
+    /// The process' pool.
+    /// </summary>
+    static WorkerThreads& Instance()
+    {
+        static WorkerThreads instance;
+        return instance;
+    }
+
+    ~WorkerThreads()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bStopping = true;
+        }
+        m_cvWork.notify_all();
+        for (std::vector<std::thread>::iterator iter = m_threads.begin(); iter != m_threads.end(); ++iter)
+        {
+            iter->join();
+        }
+    }
+
+    /// <summary>
+    /// Runs work(ixWorker) for each ixWorker in [0, nWorkers): worker 0 on the calling thread, the others on the pool's
+    /// threads. Returns when all have returned; false, without running anything, if another round is in progress.
+    /// </summary>
+    bool Run(size_t nWorkers, const RoundWork_t& work)
+    {
+        std::unique_lock<std::mutex> roundLock(m_roundMutex, std::try_to_lock);
+        if (!roundLock.owns_lock())
+            return false;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            while (m_threads.size() + 1 < nWorkers)
+            {
+                m_threads.push_back(std::thread(&WorkerThreads::ThreadMain, this, m_threads.size() + 1));
+            }
+            m_pWork = &work;
+            m_nWorkers = nWorkers;
+            m_nPending = nWorkers - 1;
+            ++m_ulRound;
+        }
+        m_cvWork.notify_all();
+
+        work(0);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cvDone.wait(lock, [this]() { return 0 == m_nPending; });
+        m_pWork = nullptr;
+        return true;
+    }
+
+private:
+    WorkerThreads() = default;
+
+    /// <summary>
+    /// A pool thread: waits for each round, and takes part in the ones that need it.
+    /// </summary>
+    void ThreadMain(size_t ixWorker)
+    {
+        ULONGLONG ulLastRound = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_cvWork.wait(lock, [&]() { return m_bStopping || m_ulRound != ulLastRound; });
+            if (m_bStopping)
+                return;
+            ulLastRound = m_ulRound;
+            if (ixWorker >= m_nWorkers)
+                continue;
+
+            const RoundWork_t* pWork = m_pWork;
+            lock.unlock();
+            (*pWork)(ixWorker);
+            lock.lock();
+            if (0 == --m_nPending)
+                m_cvDone.notify_one();
+        }
+    }
+
+    // Held by the thread running a round, for the whole round
+    std::mutex m_roundMutex;
+    // Guards the members below
+    std::mutex m_mutex;
+    std::condition_variable m_cvWork, m_cvDone;
+    std::vector<std::thread> m_threads;
+    // The current round: its work, number of workers including the calling thread, and pool threads yet to finish
+    const RoundWork_t* m_pWork = nullptr;
+    size_t m_nWorkers = 0;
+    size_t m_nPending = 0;
+    // Incremented for each round, so that a thread can tell a new round from a spurious wakeup
+    ULONGLONG m_ulRound = 0;
+    bool m_bStopping = false;
+
+private:
+    // Not implemented
+    WorkerThreads(const WorkerThreads&) = delete;
+    WorkerThreads& operator = (const WorkerThreads&) = delete;
+};
+
+/// <summary>
+/// Number of workers to use when the caller doesn't specify a count: the number of logical processors.
+/// </summary>
+size_t DefaultWorkerCount()
+{
+    // hardware_concurrency can return 0 if the value isn't computable.
+    const size_t nProcessors = std::thread::hardware_concurrency();
+    return (nProcessors > 0) ? nProcessors : 1;
+}
+
+/// <summary>
+/// Number of contiguous partitions to split nItems items into, given a requested number of workers.
+/// Returns 1 (serial) if the items are too few to be worth handing to other threads.
+/// </summary>
+size_t PartitionCount(size_t nItems, size_t nWorkers, size_t nMinItemsPerPartition)
+{
+    if (0 == nWorkers)
+        nWorkers = DefaultWorkerCount();
+    if (0 == nMinItemsPerPartition)
+        nMinItemsPerPartition = 1;
+    const size_t nMaxPartitions = nItems / nMinItemsPerPartition;
+    if (nWorkers > nMaxPartitions)
+        nWorkers = nMaxPartitions;
+    return (nWorkers > 0) ? nWorkers : 1;
+}
+
+/// <summary>
+/// Splits nItems items into nPartitions contiguous, nearly equal-sized partitions and processes each one on its own thread.
+/// The calling thread processes partition 0. Returns when all partitions have been processed.
+/// </summary>
+void RunPartitioned(size_t nItems, size_t nPartitions, const PartitionWork_t& work)
+{
+    // The first (nItems % nPartitions) partitions get one extra item.
+    const size_t nPerPartition = (nPartitions > 0) ? nItems / nPartitions : nItems;
+    const size_t nRemainder = (nPartitions > 0) ? nItems % nPartitions : 0;
+    auto partition = [&](size_t ixPartition)
+    {
+        const size_t ixBegin = ixPartition * nPerPartition + (ixPartition < nRemainder ? ixPartition : nRemainder);
+        const size_t ixEnd = ixBegin + nPerPartition + (ixPartition < nRemainder ? 1 : 0);
+        work(ixPartition, ixBegin, ixEnd);
+    };
+
+    if (nPartitions <= 1)
+    {
+        work(0, 0, nItems);
+    }
+    else if (!WorkerThreads::Instance().Run(nPartitions, partition))
+    {
+        for (size_t ixPartition = 0; ixPartition < nPartitions; ++ixPartition)
+            partition(ixPartition);
+    }
+}
+
+/// <summary>
+/// Processes nItems items on up to nWorkers threads, each of which repeatedly claims the next unprocessed item.
+/// The calling thread is one of the workers. Returns when all items have been processed.
+/// </summary>
+void RunDynamic(size_t nItems, size_t nWorkers, const ItemWork_t& work)
+{
+    if (0 == nWorkers)
+        nWorkers = DefaultWorkerCount();
+    if (nWorkers > nItems)
+        nWorkers = nItems;
+
+    std::atomic<size_t> ixNext(0);
+    auto worker = [&](size_t)
+    {
+        size_t ixItem;
+        while ((ixItem = ixNext.fetch_add(1, std::memory_order_relaxed)) < nItems)
+            work(ixItem);
+    };
+
+    if (nWorkers <= 1 || !WorkerThreads::Instance().Run(nWorkers, worker))
+    {
+        worker(0);
+    }
+}
@@ -0,0 +1,54 @@
+// Helpers for spreading independent work across a pool of worker threads.
+
+#pragma once
+
+#include <functional>
+
+/// <summary>
+/// Number of workers to use when the caller doesn't specify a count: the number of logical processors.
+/// </summary>
+size_t DefaultWorkerCount();
+
+/// <summary>
+/// Number of contiguous partitions to split nItems items into, given a requested number of workers.
+/// Returns 1 (serial) if the items are too few to be worth handing to other threads.
+/// </summary>
+/// <param name="nItems">Input: number of items to process</param>
+/// <param name="nWorkers">Input: requested number of workers; 0 to use DefaultWorkerCount()</param>
+/// <param name="nMinItemsPerPartition">Input: don't create partitions smaller than this</param>
+/// <returns>Number of partitions, between 1 and nWorkers</returns>
+size_t PartitionCount(size_t nItems, size_t nWorkers, size_t nMinItemsPerPartition);
+
+/// <summary>
+/// Callback for RunPartitioned: processes items [ixBegin, ixEnd) of partition ixPartition.
+/// </summary>
+typedef std::function<void(size_t ixPartition, size_t ixBegin, size_t ixEnd)> PartitionWork_t;
+
+/// <summary>
+/// Splits nItems items into nPartitions contiguous, nearly equal-sized partitions and processes each one on its own thread.
+/// The calling thread processes partition 0; the others run on threads that are kept for later calls rather than
+/// created for each one. Returns when all partitions have been processed. If another call is already in progress
+/// (e.g., a nested call from within work), the partitions are processed one after another on the calling thread.
+/// Partition i covers lower item indices than partition i+1, so callers that keep per-partition results
+/// and combine them in partition order get the same order as a serial pass.
+/// </summary>
+/// <param name="nItems">Input: number of items</param>
+/// <param name="nPartitions">Input: number of partitions (from PartitionCount)</param>
+/// <param name="work">Input: callback invoked once per partition</param>
+void RunPartitioned(size_t nItems, size_t nPartitions, const PartitionWork_t& work);
+
+/// <summary>
+/// Callback for RunDynamic: processes item ixItem.
+/// </summary>
+typedef std::function<void(size_t ixItem)> ItemWork_t;
+
+/// <summary>
+/// Processes nItems items on up to nWorkers threads, each of which repeatedly claims the next unprocessed item, so that
+/// a few costly items don't leave the other workers idle as contiguous partitions would. The calling thread is one of
+/// the workers; the others are the threads RunPartitioned uses. Returns when all items have been processed. Items are claimed in index order, but may complete in any
+/// order; callers that store per-item results by index get the same results as a serial pass.
+/// </summary>
+/// <param name="nItems">Input: number of items</param>
+/// <param name="nWorkers">Input: requested number of workers; 0 to use DefaultWorkerCount()</param>
+/// <param name="work">Input: callback invoked once per item</param>
+void RunDynamic(size_t nItems, size_t nWorkers, const ItemWork_t& work);
@@ -0,0 +1,56 @@
+// Alert thresholds for health checks: whether the zombies on a system warrant attention, reported as an exit code.
+
+#include "ZombieAlerts.h"
+#include <sstream>
+#include <vector>
+#include <cwchar>
+#include "StringUtils.h"
+
+// (Definition of the in-class constant)
+const ULONGLONG ZombieAlertThresholds::NotChecked;
+
+/// <summary>
+/// Parses the -alert command-line argument: comma-separated name=value pairs.
+/// </summary>
+/// <returns>true if successful</returns>
+bool ParseAlertThresholds(const std::wstring& sSpec, ZombieAlertThresholds& thresholds, std::wstring& sErrorInfo)
+{
+    sErrorInfo.clear();
+    thresholds = ZombieAlertThresholds();
+
+    std::vector<std::wstring> pairs;
+    SplitStringToVector(sSpec, L',', pairs);
+    for (std::vector<std::wstring>::const_iterator iPair = pairs.begin(); iPair != pairs.end(); ++iPair)
+    {
+        const size_t ixEquals = iPair->find(L'=');
+        const std::wstring sName = iPair->substr(0, ixEquals);
+        const std::wstring sValue = (std::wstring::npos != ixEquals) ? iPair->substr(ixEquals + 1) : std::wstring();
+        ULONGLONG* pThreshold = nullptr;
+        if (0 == _wcsicmp(sName.c_str(), L"owner"))
+            pThreshold = &thresholds.nOwnerHandles;
+        else if (0 == _wcsicmp(sName.c_str(), L"zombies"))
+            pThreshold = &thresholds.nZombies;
+        else if (0 == _wcsicmp(sName.c_str(), L"unexplained"))
+            pThreshold = &thresholds.nUnexplained;
+        else if (0 == _wcsicmp(sName.c_str(), L"age"))
+            pThreshold = &thresholds.nOldestAgeSecs;
+
+        // The value must be all digits; at most 19 of them, so that it's less than NotChecked.
+        const bool bValidValue =
+            !sValue.empty() && sValue.length() <= 19 && std::wstring::npos == sValue.find_first_not_of(L"0123456789");
+        if (nullptr == pThreshold || !bValidValue)
+        {
+            std::wstringstream strErrorInfo;
+            strErrorInfo << L"Invalid alert threshold \"" << *iPair << L"\": expected owner, zombies, unexplained, or age, with a number";
+            sErrorInfo = strErrorInfo.str();
+            return false;
+        }
+        *pThreshold = wcstoull(sValue.c_str(), nullptr, 10);
+    }
+    if (!thresholds.Any())
+    {
+        sErrorInfo = L"No alert thresholds";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+// Alert thresholds for health checks: whether the zombies on a system warrant attention, reported as an exit code.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string>
+
+/// <summary>
+/// Thresholds that raise an alert when exceeded. A threshold of NotChecked isn't checked.
+/// </summary>
+struct ZombieAlertThresholds
+{
+    static const ULONGLONG NotChecked = ULONGLONG(-1);
+
+    /// <summary>
+    /// An owner holds more than this many handles to zombie processes/threads
+    /// </summary>
+    ULONGLONG nOwnerHandles = NotChecked;
+    /// <summary>
+    /// There are more than this many zombie processes
+    /// </summary>
+    ULONGLONG nZombies = NotChecked;
+    /// <summary>
+    /// More than this many zombie processes have no process holding a handle to them
+    /// </summary>
+    ULONGLONG nUnexplained = NotChecked;
+    /// <summary>
+    /// A zombie process exited more than this many seconds ago
+    /// </summary>
+    ULONGLONG nOldestAgeSecs = NotChecked;
+
+    /// <summary>
+    /// true if any threshold is checked
+    /// </summary>
+    bool Any() const
+    {
+        return NotChecked != nOwnerHandles || NotChecked != nZombies || NotChecked != nUnexplained || NotChecked != nOldestAgeSecs;
+    }
+
+    /// <summary>
+    /// true if checking requires identifying the owners of the handles to the zombies
+    /// </summary>
+    bool NeedOwners() const
+    {
+        return NotChecked != nOwnerHandles || NotChecked != nUnexplained;
+    }
+};
+
+/// <summary>
+/// The threshold that raised an alert. The values are the program's exit codes.
+/// Thresholds are checked in this order, cheapest first, and checking stops at the first one exceeded.
+/// </summary>
+enum class ZombieAlert_t
+{
+    None = 0,
+    Zombies = 1,
+    OldestAge = 2,
+    OwnerHandles = 3,
+    Unexplained = 4
+};
+
+/// <summary>
+/// Result of checking the thresholds
+/// </summary>
+struct ZombieAlertVerdict
+{
+    /// <summary>
+    /// The threshold exceeded, if any
+    /// </summary>
+    ZombieAlert_t alert = ZombieAlert_t::None;
+    /// <summary>
+    /// Description of what exceeded the threshold; empty if none did
+    /// </summary>
+    std::wstring sInfo;
+};
+
+/// <summary>
+/// Parses the -alert command-line argument: comma-separated name=value pairs, with names owner, zombies,
+/// unexplained, and age (in seconds); e.g., "owner=1000,zombies=5000". Thresholds not named aren't checked.
+/// </summary>
+/// <param name="sSpec">Input: the argument</param>
+/// <param name="thresholds">Output: the thresholds</param>
+/// <param name="sErrorInfo">Output: information about the error, on failure</param>
+/// <returns>true if successful</returns>
+bool ParseAlertThresholds(const std::wstring& sSpec, ZombieAlertThresholds& thresholds, std::wstring& sErrorInfo);
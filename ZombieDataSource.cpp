@@ -0,0 +1,46 @@
+// Interface through which ZombieOwners::Analyze obtains zombie and handle information from somewhere other than
+// the live system, and its implementation for synthetic workloads.
+
+#include "PlatformTypes.h"
+#include "ZombieHandles.h"
+#include "AllHandlesSystemwide.h"
+#include "SyntheticWorkload.h"
+#include "ZombieDataSource.h"
+
+ULONGLONG SyntheticZombieDataSource::CaptureTime() const
+{
+    return m_workload.CaptureTime();
+}
+
+bool SyntheticZombieDataSource::GetZombieHandles(ZombieHandles& zombieHandles, ZombieRecordStore_t& zombieRecords, ImagePathTable& imagePaths, ZombiePidLookup_t& zombiePidLookup, std::wstring& sErrorInfo)
+{
+    sErrorInfo.clear();
+    zombieHandles.LoadFromData(m_workload.ZombieRecords(), m_workload.ImagePaths(), m_workload.ZombieHandleLookup(), m_workload.HandleOwnerPID(), m_workload.TotalProcessCount(), zombieRecords, imagePaths, zombiePidLookup);
+    return true;
+}
+
+bool SyntheticZombieDataSource::GetAllHandles(AllHandlesSystemwide& allHandlesSystemwide, std::wstring& sErrorInfo)
+{
+    sErrorInfo.clear();
+    allHandlesSystemwide.Attach(m_workload.HandleInformation(), m_workload.CaptureTime());
+    return true;
+}
+
+void SyntheticZombieDataSource::GetOwnerImagePaths(OwnerImagePathLookup_t& ownerImagePaths)
+{
+    ownerImagePaths.clear();
+    const std::vector<std::pair<ULONG_PTR, std::wstring>>& processImagePaths = m_workload.ProcessImagePaths();
+    for (
+        std::vector<std::pair<ULONG_PTR, std::wstring>>::const_iterator iter = processImagePaths.begin();
+        iter != processImagePaths.end();
+        ++iter
+        )
+    {
+        ownerImagePaths[iter->first] = iter->second;
+    }
+}
+
+void SyntheticZombieDataSource::GetServices(ServiceLookupByPID_t& serviceLookup)
+{
+    serviceLookup = m_workload.Services();
+}
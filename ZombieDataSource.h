@@ -0,0 +1,86 @@
+// Interface through which ZombieOwners::Analyze obtains zombie and handle information from somewhere other than
+// the live system, and its implementation for synthetic workloads.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string>
+#include <unordered_map>
+#include "ZombieProcessThreadInfo.h"
+#include "ServiceLookupByPID.h"
+
+class ZombieHandles;
+class AllHandlesSystemwide;
+class SyntheticWorkload;
+
+/// <summary>
+/// Executable image paths of running processes, by PID.
+/// </summary>
+typedef std::unordered_map<ULONG_PTR, std::wstring> OwnerImagePathLookup_t;
+
+/// <summary>
+/// Source of the information that ZombieOwners::Analyze correlates, in place of acquiring it from the live system.
+/// </summary>
+class ZombieDataSource
+{
+public:
+    virtual ~ZombieDataSource() = default;
+
+    /// <summary>
+    /// Time at which the information was captured (FILETIME value), for computing how long ago zombies exited.
+    /// </summary>
+    virtual ULONGLONG CaptureTime() const = 0;
+
+    /// <summary>
+    /// Fills zombieHandles with the zombie processes/threads and the handles to them held by the capturing process.
+    /// </summary>
+    /// <param name="zombieHandles">Output: the capturing process' handles to the zombies</param>
+    /// <param name="zombieRecords">Output: information about the zombie processes/threads</param>
+    /// <param name="imagePaths">Input/output: table that the records' image paths are interned in</param>
+    /// <param name="zombiePidLookup">Output: PID-based lookup of the zombie processes</param>
+    /// <param name="sErrorInfo">Output: information about any failures</param>
+    /// <returns>true if successful</returns>
+    virtual bool GetZombieHandles(ZombieHandles& zombieHandles, ZombieRecordStore_t& zombieRecords, ImagePathTable& imagePaths, ZombiePidLookup_t& zombiePidLookup, std::wstring& sErrorInfo) = 0;
+
+    /// <summary>
+    /// Fills allHandlesSystemwide with information about all handles held by all processes.
+    /// </summary>
+    /// <param name="allHandlesSystemwide">Output: systemwide handle information</param>
+    /// <param name="sErrorInfo">Output: information about any failures</param>
+    /// <returns>true if successful</returns>
+    virtual bool GetAllHandles(AllHandlesSystemwide& allHandlesSystemwide, std::wstring& sErrorInfo) = 0;
+
+    /// <summary>
+    /// Returns the image paths of the running processes, which are looked up for the processes found to hold handles to zombies.
+    /// </summary>
+    virtual void GetOwnerImagePaths(OwnerImagePathLookup_t& ownerImagePaths) = 0;
+
+    /// <summary>
+    /// Returns the services hosted by each service process.
+    /// </summary>
+    virtual void GetServices(ServiceLookupByPID_t& serviceLookup) = 0;
+};
+
+/// <summary>
+/// ZombieDataSource that supplies a generated SyntheticWorkload. The handle table is used in place, not copied;
+/// the workload must outlive any AllHandlesSystemwide instance filled from it.
+/// </summary>
+class SyntheticZombieDataSource : public ZombieDataSource
+{
+public:
+    SyntheticZombieDataSource(const SyntheticWorkload& workload) : m_workload(workload) {}
+
+    ULONGLONG CaptureTime() const override;
+    bool GetZombieHandles(ZombieHandles& zombieHandles, ZombieRecordStore_t& zombieRecords, ImagePathTable& imagePaths, ZombiePidLookup_t& zombiePidLookup, std::wstring& sErrorInfo) override;
+    bool GetAllHandles(AllHandlesSystemwide& allHandlesSystemwide, std::wstring& sErrorInfo) override;
+    void GetOwnerImagePaths(OwnerImagePathLookup_t& ownerImagePaths) override;
+    void GetServices(ServiceLookupByPID_t& serviceLookup) override;
+
+private:
+    const SyntheticWorkload& m_workload;
+
+private:
+    // Not implemented
+    SyntheticZombieDataSource(const SyntheticZombieDataSource&) = delete;
+    SyntheticZombieDataSource& operator = (const SyntheticZombieDataSource&) = delete;
+};
@@ -6,14 +6,28 @@
 #include <fstream>
 #include <locale>
 #include <codecvt>
-#include <io.h>
 #include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <clocale>
+#include <cstring>
+#include <csignal>
+#include <ctime>
+#endif
 #include "HEX.h"
 #include "UtilityFunctions.h"
 #include "StringUtils.h"
 #include "FileOutput.h"
+#include "Utf8Writer.h"
 #include "ZombieOwners.h"
+#include "AllHandlesSystemwide.h"
 #include "FullThreadReport.h"
+#include "ZombieWatch.h"
+#include "ZombieOutput.h"
+#include "SyntheticWorkload.h"
+#include "RunStats.h"
+#include "PlatformInMemory.h"
 
 //TODO: Identify if handles are duplicates of one another
 
@@ -31,21 +45,49 @@ void Usage(const wchar_t* szError, const wchar_t* argv0)
         << std::endl
         << L"Usage:" << std::endl
         << std::endl
-        << L"  " << sExe << L" [-details] [-csv] [-secs exitAgeInSecs] [-out filename] [-diag directory]" << std::endl
-        << L"  " << sExe << L" -threads [-out filename]" << std::endl
+        << L"  " << sExe << L" [-details|-top count] [-csv|-json|-binary] [-secs exitAgeInSecs] [-out filename] [-diag directory] [-pid pids] [-exe name] [-service name] [-workers count] [-stats]" << std::endl
+        << L"  " << sExe << L" -alert thresholds [-replay diagFilePrefix|-synthetic handleCount] [-secs exitAgeInSecs] [-out filename] [-pid pids] [-exe name] [-service name] [-workers count] [-stats]" << std::endl
+        << L"  " << sExe << L" -watch intervalSecs [-servicettl secs] [-details|-top count] [-csv|-json] [-secs exitAgeInSecs] [-out filename] [-pid pids] [-exe name] [-service name] [-workers count] [-stats]" << std::endl
+        << L"  " << sExe << L" -threads [-out filename] [-workers count] [-synthetic handleCount]" << std::endl
+        << L"  " << sExe << L" -replay diagFilePrefix [-details|-top count] [-csv|-json|-binary] [-out filename] [-pid pids] [-exe name] [-service name] [-workers count] [-stats]" << std::endl
+        << L"  " << sExe << L" -synthetic handleCount [-details|-top count] [-csv|-json|-binary] [-out filename] [-pid pids] [-exe name] [-service name] [-workers count] [-stats]" << std::endl
+        << L"  " << sExe << L" -convert snapshotFile textFile" << std::endl
         << std::endl
         << L"    -details" << std::endl
         << L"      Outputs details about all zombies and owners; default is to output a summary." << std::endl
         << std::endl
+        << L"    -top count" << std::endl
+        << L"      The summary lists only the count owners with the most zombie handles, selected without sorting all" << std::endl
+        << L"      of the owners. Not supported with -details or -binary. With -watch, applies to the first sample." << std::endl
+        << std::endl
+        << L"    -alert thresholds" << std::endl
+        << L"      Health check: instead of the results, output one OK or ALERT line, and exit with a code naming the first" << std::endl
+        << L"      threshold exceeded. thresholds is comma-separated name=value pairs; e.g., owner=1000,zombies=5000:" << std::endl
+        << L"        zombies=N      more than N zombie processes (exit code 1)" << std::endl
+        << L"        age=S          a zombie process exited more than S seconds ago (exit code 2)" << std::endl
+        << L"        owner=N        a process holds more than N zombie handles (exit code 3)" << std::endl
+        << L"        unexplained=N  more than N zombie processes with no handles held to them (exit code 4)" << std::endl
+        << L"      Thresholds are checked in that order; the handle table is examined only if needed. Exit code 0 if none" << std::endl
+        << L"      is exceeded; -1 on error. Not supported with -details, -top, -csv, -json, -binary, -diag, or -watch." << std::endl
+        << std::endl
         << L"    -csv" << std::endl
         << L"      Outputs results as tab-delimited fields; default is to output human-readable format with spacing." << std::endl
         << std::endl
+        << L"    -json" << std::endl
+        << L"      Outputs results as JSON Lines: a capture object, then one object per owner (summary) or per zombie" << std::endl
+        << L"      handle (-details), unowned zombies, and errors. Times are ISO 8601 UTC." << std::endl
+        << std::endl
+        << L"    -binary" << std::endl
+        << L"      Writes the complete results to the -out file in the compact binary record format described in" << std::endl
+        << L"      ZombieOutput.h. Requires -out; not supported with -watch." << std::endl
+        << std::endl
         << L"    -secs exitAgeInSecs" << std::endl
         << L"      Consider a process to be a zombie only if it exited at least exitAgeInSecs seconds ago." << std::endl
         << L"      Default is 3 seconds." << std::endl
         << std::endl
         << L"    -threads" << std::endl
         << L"      List all processes and counts of active and zombied threads in each (tab-delimited)." << std::endl
+        << L"      Processes' threads are inspected in parallel (see -workers); rows are in enumeration order." << std::endl
         << std::endl
         << L"    -out filename" << std::endl
         << L"      Write output to filename. If not specified, writes to stdout." << std::endl
@@ -54,22 +96,188 @@ void Usage(const wchar_t* szError, const wchar_t* argv0)
         << L"      Write diagnostic output - all collected handle and zombie information - to uniquely named files" << std::endl
         << L"      in the named directory." << std::endl
         << std::endl
+        << L"    -pid pids" << std::endl
+        << L"    -exe name" << std::endl
+        << L"    -service name" << std::endl
+        << L"      Report only the owners with one of the comma-separated PIDs, with the executable file name (e.g., svchost.exe)," << std::endl
+        << L"      or hosting the service (key name, e.g., Winmgmt); with more than one, owners that meet all of them." << std::endl
+        << L"      Other processes' handles are skipped while scanning, and their names and services are never looked up." << std::endl
+        << L"      Zombies with no handles held to them aren't reported. Not supported with -diag, or with -alert unexplained." << std::endl
+        << std::endl
+        << L"    -workers count" << std::endl
+        << L"      Number of threads that scan the systemwide handle table, or that inspect processes' threads for" << std::endl
+        << L"      -threads. Default is one per logical processor;" << std::endl
+        << L"      1 scans serially. Results are identical." << std::endl
+        << std::endl
+        << L"    -stats" << std::endl
+        << L"      After the results, write the time spent in each phase of the run and counts of processes, threads," << std::endl
+        << L"      handles, system calls, retries, bytes allocated, and peak memory to stderr. With -csv, writes tab-delimited lines." << std::endl
+        << L"      With -watch, totals cover all samples and are written when watching ends." << std::endl
+        << std::endl
+        << L"    -watch intervalSecs" << std::endl
+        << L"      Stay resident and sample every intervalSecs seconds until Ctrl+C. After the first sample's full output," << std::endl
+        << L"      output only changes: new zombies, released zombies, and changes in owners' zombie handle counts." << std::endl
+        << std::endl
+        << L"    -servicettl secs" << std::endl
+        << L"      With -watch, reacquire the services hosted by each process when they're more than secs seconds old." << std::endl
+        << L"      Default is 60 seconds." << std::endl
+        << std::endl
+        << L"    -replay diagFilePrefix" << std::endl
+        << L"      Analyze the diagnostic files written by a previous -diag run instead of the live system." << std::endl
+        << L"      diagFilePrefix is the directory and the common part of the file names;" << std::endl
+        << L"      e.g., C:\\Diag\\ZombieFinder_20240101_120000. Does not require administrative rights." << std::endl
+        << std::endl
+        << L"    -synthetic handleCount" << std::endl
+        << L"      Analyze a generated workload with handleCount handles instead of the live system, for testing and" << std::endl
+        << L"      performance measurement at scale. With -threads, report on its processes. Does not require" << std::endl
+        << L"      administrative rights." << std::endl
+        << std::endl
+        << L"    -convert snapshotFile textFile" << std::endl
+        << L"      Convert a binary all-handles snapshot written by -diag (*_AllHandles.bin) to tab-delimited text." << std::endl
+        << std::endl
         << std::endl;
     exit(-1);
 }
 
 // ----------------------------------------------------------------------------------------------------
-// Forward declarations for output functions
-void OutputSummary(const ZombieOwners& zombieOwners, ULONGLONG ulNow, std::wostream* pStream);
-void OutputSummaryCsv(const ZombieOwners& zombieOwners, ULONGLONG ulNow, std::wostream* pStream);
-void OutputDetails(const ZombieOwners& zombieOwners, ULONGLONG ulNow, std::wostream* pStream);
-void OutputDetailsCsv(const ZombieOwners& zombieOwners, ULONGLONG ulNow, std::wostream* pStream);
+/// <summary>
+/// Results output formats selectable on the command line
+/// </summary>
+enum class OutputFormat_t { Text, Csv, Json, Binary };
+
+// ----------------------------------------------------------------------------------------------------
+/// <summary>
+/// Output results in the format selected on the command line
+/// </summary>
+static void OutputResults(const ZombieOwners& zombieOwners, bool bDetails, OutputFormat_t outputFormat, Utf8Writer* pWriter)
+{
+    StatsPhaseTimer phaseTimer(StatsPhase_t::Output);
+
+    // "Now" is the time the information was collected.
+    // Note: FILETIME, ULARGE_INTEGER, and ULONGLONG are all 8 bytes, and lay out the same way.
+    const ULONGLONG ulNow = zombieOwners.CaptureTime();
+
+    switch (outputFormat)
+    {
+    case OutputFormat_t::Text:
+        if (!bDetails)
+            OutputSummary(zombieOwners, ulNow, pWriter);
+        else
+            OutputDetails(zombieOwners, ulNow, pWriter);
+        break;
+    case OutputFormat_t::Csv:
+        if (!bDetails)
+            OutputSummaryCsv(zombieOwners, ulNow, pWriter);
+        else
+            OutputDetailsCsv(zombieOwners, ulNow, pWriter);
+        break;
+    case OutputFormat_t::Json:
+        if (!bDetails)
+            OutputSummaryJson(zombieOwners, ulNow, pWriter);
+        else
+            OutputDetailsJson(zombieOwners, ulNow, pWriter);
+        break;
+    case OutputFormat_t::Binary:
+        // The binary format always contains the complete results.
+        OutputResultsBinary(zombieOwners, ulNow, pWriter);
+        break;
+    }
+}
+
+#ifdef _WIN32
+// Signaled by the console control handler to end -watch mode
+static HANDLE hWatchStopEvent = NULL;
+
+/// <summary>
+/// Console control handler for -watch mode: Ctrl+C, Ctrl+Break, or closing the console window ends the loop
+/// so that output is flushed and the file closed properly.
+/// </summary>
+static BOOL WINAPI WatchCtrlHandler(DWORD dwCtrlType)
+{
+    switch (dwCtrlType)
+    {
+    case CTRL_C_EVENT:
+    case CTRL_BREAK_EVENT:
+    case CTRL_CLOSE_EVENT:
+        SetEvent(hWatchStopEvent);
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+/// <summary>
+/// Sets up (or, with bEnable false, removes) the -watch mode stop handling.
+/// </summary>
+static bool EnableWatchStop(bool bEnable)
+{
+    if (bEnable)
+    {
+        hWatchStopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+        return NULL != hWatchStopEvent && SetConsoleCtrlHandler(WatchCtrlHandler, TRUE);
+    }
+    SetConsoleCtrlHandler(WatchCtrlHandler, FALSE);
+    if (NULL != hWatchStopEvent)
+    {
+        CloseHandle(hWatchStopEvent);
+        hWatchStopEvent = NULL;
+    }
+    return true;
+}
+
+/// <summary>
+/// Waits up to dwWaitMs milliseconds; returns true if -watch mode was told to stop.
+/// </summary>
+static bool WaitForWatchStop(DWORD dwWaitMs)
+{
+    return WAIT_TIMEOUT != WaitForSingleObject(hWatchStopEvent, dwWaitMs);
+}
+#else
+// Set by the signal handler to end -watch mode
+static volatile sig_atomic_t bWatchStop = 0;
+
+/// <summary>
+/// Signal handler for -watch mode: SIGINT (Ctrl+C) or SIGTERM ends the loop so that output is flushed and the file
+/// closed properly.
+/// </summary>
+static void WatchSignalHandler(int)
+{
+    bWatchStop = 1;
+}
 
-const wchar_t* const szTabDelim = L"\t";
+/// <summary>
+/// Sets up (or, with bEnable false, removes) the -watch mode stop handling.
+/// </summary>
+static bool EnableWatchStop(bool bEnable)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    // No SA_RESTART, so that the signal interrupts the wait.
+    action.sa_handler = bEnable ? WatchSignalHandler : SIG_DFL;
+    sigemptyset(&action.sa_mask);
+    return 0 == sigaction(SIGINT, &action, nullptr) && 0 == sigaction(SIGTERM, &action, nullptr);
+}
+
+/// <summary>
+/// Waits up to dwWaitMs milliseconds; returns true if -watch mode was told to stop.
+/// </summary>
+static bool WaitForWatchStop(DWORD dwWaitMs)
+{
+    struct timespec tsWait = { time_t(dwWaitMs / 1000), long(dwWaitMs % 1000) * 1000000 };
+    // nanosleep returns early, with the remaining time, if interrupted by a signal.
+    while (!bWatchStop && 0 != nanosleep(&tsWait, &tsWait) && EINTR == errno)
+    {
+    }
+    return 0 != bWatchStop;
+}
+#endif
 
 // ----------------------------------------------------------------------------------------------------
 int wmain(int argc, wchar_t** argv)
 {
+    const ULONGLONG ullStartTimestamp = StatsTimestamp();
+
+#ifdef _WIN32
     // Exit out if this is a 32-bit process on 64-bit Windows.
     BOOL bWow64Process = FALSE;
     if (IsWow64Process(GetCurrentProcess(), &bWow64Process) && bWow64Process)
@@ -83,11 +291,25 @@ int wmain(int argc, wchar_t** argv)
     {
         std::wcerr << L"Unable to set stdout and/or stderr modes to UTF8." << std::endl;
     }
-
-    bool bDetails = false, bCsv = false, bThreadsReport = false;
+#else
+    // Output UTF-8 regardless of the locale. (The wide streams convert through their own locales only when not
+    // synchronized with C stdio.)
+    std::ios_base::sync_with_stdio(false);
+    ImbueStreamUtf8(std::wcout, false);
+    ImbueStreamUtf8(std::wcerr, false);
+#endif
+
+    bool bDetails = false, bThreadsReport = false, bStats = false;
+    OutputFormat_t outputFormat = OutputFormat_t::Text;
     ULONGLONG nExitAgeInSecs = 3;
     bool bOut_toFile = false;
-    std::wstring sOutFile, sDiagDirectory;
+    std::wstring sOutFile, sDiagDirectory, sReplayPrefix, sConvertSnapshot, sConvertText;
+    size_t nWorkers = 0, nTopOwners = 0;
+    ZombieAlertThresholds alertThresholds;
+    ZombieOwnerFilter ownerFilter;
+    DWORD dwWatchIntervalSecs = 0;
+    ULONGLONG nServiceTtlSecs = 0;
+    size_t nSyntheticHandles = 0;
 
     // Parse command line options
     int ixArg = 1;
@@ -99,12 +321,30 @@ int wmain(int argc, wchar_t** argv)
         }
         else if (0 == _wcsicmp(L"-csv", argv[ixArg]))
         {
-            bCsv = true;
+            if (OutputFormat_t::Text != outputFormat)
+                Usage(L"Invalid combination of switches", argv[0]);
+            outputFormat = OutputFormat_t::Csv;
+        }
+        else if (0 == _wcsicmp(L"-json", argv[ixArg]))
+        {
+            if (OutputFormat_t::Text != outputFormat)
+                Usage(L"Invalid combination of switches", argv[0]);
+            outputFormat = OutputFormat_t::Json;
+        }
+        else if (0 == _wcsicmp(L"-binary", argv[ixArg]))
+        {
+            if (OutputFormat_t::Text != outputFormat)
+                Usage(L"Invalid combination of switches", argv[0]);
+            outputFormat = OutputFormat_t::Binary;
         }
         else if (0 == _wcsicmp(L"-threads", argv[ixArg]))
         {
             bThreadsReport = true;
         }
+        else if (0 == _wcsicmp(L"-stats", argv[ixArg]))
+        {
+            bStats = true;
+        }
         else if (0 == _wcsicmp(L"-secs", argv[ixArg]))
         {
             if (++ixArg >= argc)
@@ -125,6 +365,87 @@ int wmain(int argc, wchar_t** argv)
                 Usage(L"Missing arg for -diag", argv[0]);
             sDiagDirectory = argv[ixArg];
         }
+        else if (0 == _wcsicmp(L"-workers", argv[ixArg]))
+        {
+            if (++ixArg >= argc)
+                Usage(L"Missing arg for -workers", argv[0]);
+            if (1 != swscanf_s(argv[ixArg], L"%zu", &nWorkers) || 0 == nWorkers)
+                Usage(L"Invalid arg for -workers", argv[0]);
+        }
+        else if (0 == _wcsicmp(L"-top", argv[ixArg]))
+        {
+            if (++ixArg >= argc)
+                Usage(L"Missing arg for -top", argv[0]);
+            if (1 != swscanf_s(argv[ixArg], L"%zu", &nTopOwners) || 0 == nTopOwners)
+                Usage(L"Invalid arg for -top", argv[0]);
+        }
+        else if (0 == _wcsicmp(L"-pid", argv[ixArg]))
+        {
+            if (++ixArg >= argc)
+                Usage(L"Missing arg for -pid", argv[0]);
+            std::vector<std::wstring> pids;
+            SplitStringToVector(argv[ixArg], L',', pids);
+            for (std::vector<std::wstring>::const_iterator iPid = pids.begin(); iPid != pids.end(); ++iPid)
+            {
+                if (iPid->empty() || iPid->length() > 19 || std::wstring::npos != iPid->find_first_not_of(L"0123456789"))
+                    Usage(L"Invalid arg for -pid", argv[0]);
+                ownerFilter.pids.push_back(ULONG_PTR(wcstoull(iPid->c_str(), nullptr, 10)));
+            }
+        }
+        else if (0 == _wcsicmp(L"-exe", argv[ixArg]))
+        {
+            if (++ixArg >= argc || 0 == argv[ixArg][0])
+                Usage(L"Missing arg for -exe", argv[0]);
+            ownerFilter.sExeName = argv[ixArg];
+        }
+        else if (0 == _wcsicmp(L"-service", argv[ixArg]))
+        {
+            if (++ixArg >= argc || 0 == argv[ixArg][0])
+                Usage(L"Missing arg for -service", argv[0]);
+            ownerFilter.sServiceName = argv[ixArg];
+        }
+        else if (0 == _wcsicmp(L"-alert", argv[ixArg]))
+        {
+            if (++ixArg >= argc)
+                Usage(L"Missing arg for -alert", argv[0]);
+            std::wstring sAlertError;
+            if (!ParseAlertThresholds(argv[ixArg], alertThresholds, sAlertError))
+                Usage(sAlertError.c_str(), argv[0]);
+        }
+        else if (0 == _wcsicmp(L"-watch", argv[ixArg]))
+        {
+            if (++ixArg >= argc)
+                Usage(L"Missing arg for -watch", argv[0]);
+            if (1 != swscanf_s(argv[ixArg], L"%lu", &dwWatchIntervalSecs) || 0 == dwWatchIntervalSecs || dwWatchIntervalSecs > MAXDWORD / 1000)
+                Usage(L"Invalid arg for -watch", argv[0]);
+        }
+        else if (0 == _wcsicmp(L"-servicettl", argv[ixArg]))
+        {
+            if (++ixArg >= argc)
+                Usage(L"Missing arg for -servicettl", argv[0]);
+            if (1 != swscanf_s(argv[ixArg], L"%llu", &nServiceTtlSecs) || 0 == nServiceTtlSecs)
+                Usage(L"Invalid arg for -servicettl", argv[0]);
+        }
+        else if (0 == _wcsicmp(L"-replay", argv[ixArg]))
+        {
+            if (++ixArg >= argc)
+                Usage(L"Missing arg for -replay", argv[0]);
+            sReplayPrefix = argv[ixArg];
+        }
+        else if (0 == _wcsicmp(L"-synthetic", argv[ixArg]))
+        {
+            if (++ixArg >= argc)
+                Usage(L"Missing arg for -synthetic", argv[0]);
+            if (1 != swscanf_s(argv[ixArg], L"%zu", &nSyntheticHandles) || 0 == nSyntheticHandles)
+                Usage(L"Invalid arg for -synthetic", argv[0]);
+        }
+        else if (0 == _wcsicmp(L"-convert", argv[ixArg]))
+        {
+            if (ixArg + 2 >= argc)
+                Usage(L"Missing arg for -convert", argv[0]);
+            sConvertSnapshot = argv[++ixArg];
+            sConvertText = argv[++ixArg];
+        }
         else
         {
             // Show usage; no error message if command line param is -? or /?
@@ -138,494 +459,286 @@ int wmain(int argc, wchar_t** argv)
     }
 
     // Verify no invalid combination of switches
-    if (bThreadsReport && (bDetails || bCsv || 3 != nExitAgeInSecs || sDiagDirectory.length() > 0))
+    if (bThreadsReport && (bDetails || OutputFormat_t::Text != outputFormat || bStats || 3 != nExitAgeInSecs || sDiagDirectory.length() > 0))
     {
         Usage(L"Invalid combination of switches", argv[0]);
     }
-
-    // If sDiagDirectory is specified, ensure that it exists and is a directory
-    if (sDiagDirectory.size() > 0)
+    // Replayed data has already been filtered by exit age, and there's nothing new to write diagnostics about.
+    if (sReplayPrefix.length() > 0 && (bThreadsReport || 3 != nExitAgeInSecs || sDiagDirectory.length() > 0))
     {
-        // Remove trailing path separator if it has one. (PowerShell autocomplete likes to append them, helpfully...)
-        while (EndsWith(sDiagDirectory, L'\\') || EndsWith(sDiagDirectory, L'/'))
-            sDiagDirectory = sDiagDirectory.substr(0, sDiagDirectory.length() - 1);
-
-        DWORD dwAttributes = GetFileAttributesW(sDiagDirectory.c_str());
-        if (
-            INVALID_FILE_ATTRIBUTES == dwAttributes ||
-            0 == (FILE_ATTRIBUTE_DIRECTORY & dwAttributes)
-            )
-        {
-            Usage(L"-diag argument is not a directory", argv[0]);
-        }
+        Usage(L"Invalid combination of switches", argv[0]);
     }
 
-    // Define a wostream output; create a UTF-8 wofstream if sOutFile defined; point it to *pStream otherwise.
-    // pStream points to whatever ostream we're writing to.
-    // Default to writing to stdout/wcout.
-    // If -out specified, open an fstream for writing.
-    std::wostream* pStream = &std::wcout;
-    std::wofstream fs;
-    if (bOut_toFile)
+    // A synthetic workload is an alternative to the live system or replayed data, for the results or the -threads report.
+    if (nSyntheticHandles > 0 && (sReplayPrefix.length() > 0 || 3 != nExitAgeInSecs || sDiagDirectory.length() > 0))
     {
-        pStream = &fs;
-        if (!CreateFileOutput(sOutFile.c_str(), fs, false))
-        {
-            // If opening the file for output fails, quit now.
-            std::wcerr << L"Cannot open output file " << sOutFile << std::endl;
-            Usage(NULL, argv[0]);
-        }
+        Usage(L"Invalid combination of switches", argv[0]);
     }
 
-    int iExitCode = 0;
-
-    if (bThreadsReport)
+    // Watch mode samples the live system repeatedly; diagnostic dumps of every sample aren't supported.
+    if (dwWatchIntervalSecs > 0 && (bThreadsReport || sReplayPrefix.length() > 0 || nSyntheticHandles > 0 || sDiagDirectory.length() > 0))
     {
-        if (!FullThreadReport(pStream))
-            iExitCode = -1;
+        Usage(L"Invalid combination of switches", argv[0]);
     }
-    else
-    {    // Note: FILETIME, ULARGE_INTEGER, and ULONGLONG are all 8 bytes, and lay out the same way.
-        ULONGLONG ulNow = 0;
-        GetSystemTimeAsFileTime((LPFILETIME)&ulNow);
 
-        // ------------------------------------------------------------------------------------------
-        // Get all the info about zombie processes and their owners
-        ZombieOwners zombieOwners;
-        std::wstring sErrorInfo;
-        if (zombieOwners.Update(nExitAgeInSecs, sDiagDirectory, sErrorInfo))
-        {
-            // Output:
-            if (!bDetails)
-            {
-                if (!bCsv)
-                    OutputSummary(zombieOwners, ulNow, pStream);
-                else
-                    OutputSummaryCsv(zombieOwners, ulNow, pStream);
-            }
-            else
-            {
-                if (!bCsv)
-                    OutputDetails(zombieOwners, ulNow, pStream);
-                else
-                    OutputDetailsCsv(zombieOwners, ulNow, pStream);
-            }
-        }
-        else
-        {
-            std::wcerr << L"Error: " << sErrorInfo << std::endl;
-            iExitCode = -1;
-        }
+    // Service information is reacquired only between -watch samples.
+    if (nServiceTtlSecs > 0 && 0 == dwWatchIntervalSecs)
+    {
+        Usage(L"Invalid combination of switches", argv[0]);
     }
 
-    // ------------------------------------------------------------------------------------------
-    // If output to a file, close the file.
-    if (bOut_toFile)
+    // Binary results go only to a file, and watch mode's change records have no binary form.
+    if (OutputFormat_t::Binary == outputFormat && (!bOut_toFile || dwWatchIntervalSecs > 0))
     {
-        fs.close();
+        Usage(L"Invalid combination of switches", argv[0]);
     }
 
-    return iExitCode;
-}
-
-// ------------------------------------------------------------------------------------------
-/// <summary>
-/// Output summary results in human-readable table format
-/// </summary>
-/// <param name="zombieOwners">Input: zombie process/owner information</param>
-/// <param name="ulNow">Input: representation of current time (not used in this function)</param>
-/// <param name="pStream">Input: pointer to output stream into which to write</param>
-void OutputSummary(const ZombieOwners& zombieOwners, ULONGLONG /*ulNow*/, std::wostream* pStream)
-{
-    // Get the zombie owners, sorted by zombie handle counts in descending order
-    const ZombieOwnersCollectionSorted_t& coll = zombieOwners.OwnersCollectionSorted();
-
-    // Determine longest exe name, so the table can be properly formatted
-    size_t nExeAndPidFieldWidth = 0;
-    const size_t nCountFieldWidth = 6;
-
-    for (ZombieOwnersCollectionSorted_t::const_iterator iter = coll.begin();
-        iter != coll.end();
-        iter++)
+    // -top shortens the summary; the details and the binary format are always complete.
+    if (nTopOwners > 0 && (bThreadsReport || bDetails || OutputFormat_t::Binary == outputFormat))
     {
-        if ((*iter)->sExeName.length() > nExeAndPidFieldWidth)
-            nExeAndPidFieldWidth = (*iter)->sExeName.length();
+        Usage(L"Invalid combination of switches", argv[0]);
     }
-    // Add to cover "(pid)" plus spaces
-    nExeAndPidFieldWidth += 10;
-
-    // Table headers
-    *pStream << std::left << std::setw(nExeAndPidFieldWidth) << L"Exe name (PID)" << std::right << std::setw(nCountFieldWidth) << L"Count" << L"     Services" << std::endl;
-    *pStream << std::left << std::setw(nExeAndPidFieldWidth) << L"--------------" << std::right << std::setw(nCountFieldWidth) << L"-----" << L"     --------" << std::endl;
 
-    // Zombie owners, counts, and services (if any)
-    for (ZombieOwnersCollectionSorted_t::const_iterator iter = coll.begin();
-        iter != coll.end();
-        iter++)
+    // An alert check outputs only its verdict, once.
+    if (alertThresholds.Any() && (bThreadsReport || bDetails || nTopOwners > 0 || OutputFormat_t::Text != outputFormat || sDiagDirectory.length() > 0 || dwWatchIntervalSecs > 0))
     {
-        std::wstringstream str;
-        str << (*iter)->sExeName << L" (" << (*iter)->PID << L")";
-        *pStream
-            << std::left << std::setw(nExeAndPidFieldWidth) << str.str() << std::right << std::setw(nCountFieldWidth) << (*iter)->zombieOwningInfo.size();
-        if (nullptr != (*iter)->pServiceList)
-        {
-            *pStream << L"     ";
-            for (
-                ServiceList_t::const_iterator iterSvc = (*iter)->pServiceList->begin();
-                iterSvc != (*iter)->pServiceList->end();
-                iterSvc++
-                )
-            {
-                *pStream << iterSvc->sServiceName << L" ";
-            }
-        }
-        *pStream << std::endl;
+        Usage(L"Invalid combination of switches", argv[0]);
     }
 
-    // Zombie processes with no user-mode handles
-    if (zombieOwners.UnexplainedZombies().size() > 0)
+    // Filtered results leave out owners that a diagnostic dump must record, and zombies that might be explained by them.
+    if (ownerFilter.Any() && (bThreadsReport || sDiagDirectory.length() > 0 || ZombieAlertThresholds::NotChecked != alertThresholds.nUnexplained))
     {
-        *pStream
-            << std::left << std::setw(nExeAndPidFieldWidth) << L"(No process)" << std::right << std::setw(nCountFieldWidth) << zombieOwners.UnexplainedZombies().size() << std::endl;
+        Usage(L"Invalid combination of switches", argv[0]);
     }
 
-    // Any process enumeration errors
-    if (zombieOwners.ProcessEnumErrors().size() > 0)
+    // Snapshot conversion is a standalone operation.
+    if (sConvertSnapshot.length() > 0)
     {
-        for (
-            ProcessEnumErrorInfoList_t::const_iterator iter = zombieOwners.ProcessEnumErrors().begin();
-            iter != zombieOwners.ProcessEnumErrors().end();
-            iter++
-            )
+        if (argc != 4)
+            Usage(L"Invalid combination of switches", argv[0]);
+        AllHandlesSystemwide allHandlesSystemwide;
+        std::wstring sErrorInfo;
+        if (!allHandlesSystemwide.LoadSnapshot(sConvertSnapshot.c_str(), sErrorInfo) ||
+            !allHandlesSystemwide.Dump(sConvertText.c_str(), false, sErrorInfo))
         {
-            *pStream << L"ERROR: " << *iter << std::endl;
+            std::wcerr << L"Error: " << sErrorInfo << std::endl;
+            return -1;
         }
+        return 0;
     }
-}
 
-// ------------------------------------------------------------------------------------------
-/// <summary>
-/// Output summary results in tab-delimited fields
-/// </summary>
-/// <param name="zombieOwners">Input: zombie process/owner information</param>
-/// <param name="ulNow">Input: representation of current time (not used in this function)</param>
-/// <param name="pStream">Input: pointer to output stream into which to write</param>
-void OutputSummaryCsv(const ZombieOwners& zombieOwners, ULONGLONG /*ulNow*/, std::wostream* pStream)
-{
-    // Get the zombie owners, sorted by zombie handle counts in descending order
-    const ZombieOwnersCollectionSorted_t& coll = zombieOwners.OwnersCollectionSorted();
-
-    // Table headers
-    *pStream 
-        << L"Exe name" << szTabDelim
-        << L"PID" << szTabDelim
-        << L"Count" << szTabDelim
-        << L"Services" 
-        << std::endl;
-
-    // Zombie owners, counts, and services (if any)
-    for (ZombieOwnersCollectionSorted_t::const_iterator iter = coll.begin();
-        iter != coll.end();
-        iter++)
+    // If sDiagDirectory is specified, ensure that it exists and is a directory
+    if (sDiagDirectory.size() > 0)
     {
-        *pStream
-            << (*iter)->sExeName << szTabDelim
-            << (*iter)->PID << szTabDelim
-            << (*iter)->zombieOwningInfo.size() << szTabDelim;
-        if (nullptr != (*iter)->pServiceList)
-        {
-            for (
-                ServiceList_t::const_iterator iterSvc = (*iter)->pServiceList->begin();
-                iterSvc != (*iter)->pServiceList->end();
-                iterSvc++
-                )
-            {
-                *pStream << iterSvc->sServiceName << L" ";
-            }
+        // Remove trailing path separator if it has one. (PowerShell autocomplete likes to append them, helpfully...)
+        while (EndsWith(sDiagDirectory, L'\\') || EndsWith(sDiagDirectory, L'/'))
+            sDiagDirectory = sDiagDirectory.substr(0, sDiagDirectory.length() - 1);
+
+        if (!DirectoryExists(sDiagDirectory.c_str()))
+        {
+            Usage(L"-diag argument is not a directory", argv[0]);
         }
-        *pStream << std::endl;
     }
 
-    // Zombie processes with no user-mode handles
-    if (zombieOwners.UnexplainedZombies().size() > 0)
+    // Results go through a buffered UTF-8 writer: to the -out file if specified (with BOM unless binary), otherwise to stdout.
+    // Output is flushed after the results and after each -watch sample.
+    Utf8Writer writer;
+    if (bOut_toFile)
     {
-        *pStream
-            << L"(No process)" << szTabDelim << szTabDelim << zombieOwners.UnexplainedZombies().size() << szTabDelim << std::endl;
+        std::wstring sOpenError;
+        if (!writer.OpenFile(sOutFile.c_str(), false, sOpenError, OutputFormat_t::Binary != outputFormat))
+        {
+            // If opening the file for output fails, quit now.
+            std::wcerr << L"Cannot open output file " << sOutFile << L": " << sOpenError << std::endl;
+            Usage(NULL, argv[0]);
+        }
     }
+    else
+    {
+        writer.OpenStandardOutput();
+    }
+
+    int iExitCode = 0;
 
-    // Any process enumeration errors
-    if (zombieOwners.ProcessEnumErrors().size() > 0)
+    if (bThreadsReport)
     {
-        for (
-            ProcessEnumErrorInfoList_t::const_iterator iter = zombieOwners.ProcessEnumErrors().begin();
-            iter != zombieOwners.ProcessEnumErrors().end();
-            iter++
-            )
+        if (nSyntheticHandles > 0)
+        {
+            // The processes and threads of an in-memory model of the workload
+            SyntheticWorkload syntheticWorkload;
+            InMemoryPlatform syntheticPlatform;
+            SyntheticWorkloadParams params;
+            params.nHandles = nSyntheticHandles;
+            std::wstring sErrorInfo;
+            if (!syntheticWorkload.Generate(params, sErrorInfo) ||
+                !syntheticPlatform.LoadWorkload(syntheticWorkload, sErrorInfo))
+            {
+                std::wcerr << L"Error: " << sErrorInfo << std::endl;
+                iExitCode = -1;
+            }
+            else if (!FullThreadReport(syntheticPlatform, &writer, nWorkers))
+            {
+                iExitCode = -1;
+            }
+        }
+        else if (!FullThreadReport(SystemPlatform(), &writer, nWorkers))
         {
-            *pStream << L"ERROR: " << *iter << szTabDelim << szTabDelim << szTabDelim << std::endl;
+            iExitCode = -1;
         }
     }
-}
-
-// ------------------------------------------------------------------------------------------
-/// <summary>
-/// Output detailed results in (more or less) human-readable format
-/// </summary>
-/// <param name="zombieOwners">Input: zombie process/owner information</param>
-/// <param name="ulNow">Input: representation of current time</param>
-/// <param name="pStream">Input: pointer to output stream into which to write</param>
-void OutputDetails(const ZombieOwners& zombieOwners, ULONGLONG ulNow, std::wostream* pStream)
-{
-    // High-level summary
-    *pStream << L"Zombie processes: " << zombieOwners.ZombieProcessCount() << std::endl;
-    *pStream << L"Zombie threads  : " << zombieOwners.ZombieProcessAndThreadCount() - zombieOwners.ZombieProcessCount() << std::endl;
-    *pStream << std::endl;
-
-    // Existing user-mode processes holding handles to zombies, and info about those zombies
-    const ZombieOwnersCollectionSorted_t& coll = zombieOwners.OwnersCollectionSorted();
-    for (
-        ZombieOwnersCollectionSorted_t::const_iterator iterOwners = coll.begin();
-        coll.end() != iterOwners;
-        ++iterOwners
-        )
+    else
     {
-        const ZombieOwner_t& owner = **iterOwners;
-        const ZombieOwningInfoList_t& owningInfo = owner.zombieOwningInfo;
-        *pStream
-            << owner.sExeName << L" (" << owner.PID << L") | Full path: " << owner.sProcessImagePath;
-        if (nullptr != owner.pServiceList)
-        {
-            *pStream << L" | Service(s): ";
-            for (
-                ServiceList_t::const_iterator iterSvc = owner.pServiceList->begin();
-                iterSvc != owner.pServiceList->end();
-                iterSvc++
-                )
+        // ------------------------------------------------------------------------------------------
+        // Get all the info about zombie processes and their owners, from the live system, from diagnostic files,
+        // or from a synthetic workload.
+        // (The synthetic workload and the platform that models it must outlive zombieOwners.)
+        SyntheticWorkload syntheticWorkload;
+        InMemoryPlatform syntheticPlatform;
+        ZombieOwners zombieOwners;
+        zombieOwners.SetWorkerCount(nWorkers);
+        zombieOwners.SetTopOwners(nTopOwners);
+        zombieOwners.SetAlertThresholds(alertThresholds);
+        zombieOwners.SetOwnerFilter(ownerFilter);
+        if (nServiceTtlSecs > 0)
+            zombieOwners.SetServiceTimeToLive(nServiceTtlSecs);
+        std::wstring sErrorInfo;
+        bool bSuccess;
+        if (nSyntheticHandles > 0)
+        {
+            // The same pipeline as the live system, from process enumeration on, against an in-memory model of the workload.
+            SyntheticWorkloadParams params;
+            params.nHandles = nSyntheticHandles;
+            bSuccess =
+                syntheticWorkload.Generate(params, sErrorInfo) &&
+                syntheticPlatform.LoadWorkload(syntheticWorkload, sErrorInfo);
+            if (bSuccess)
             {
-                *pStream << iterSvc->sServiceName << L" ";
+                zombieOwners.SetPlatform(syntheticPlatform);
+                bSuccess = zombieOwners.Update(nExitAgeInSecs, sDiagDirectory, sErrorInfo);
             }
         }
-        *pStream
-            << std::endl
-            << owningInfo.size() << L" zombie handle(s):" << std::endl;
-        for (
-            ZombieOwningInfoList_t::const_iterator iterOwningInfo = owningInfo.begin();
-            owningInfo.end() != iterOwningInfo;
-            ++iterOwningInfo
-            )
+        else if (sReplayPrefix.length() > 0)
         {
-            const ZombieProcessThreadInfo& z = iterOwningInfo->zombieInfo;
-            const ULONGLONG& ulExitTime = (*(const ULONGLONG*)&z.exitTime);
-            ULONGLONG nSecondsAgo = (ulNow - ulExitTime) / 10000000;
-
-            if (0 == z.TID)
+            bSuccess = zombieOwners.Replay(sReplayPrefix, sErrorInfo);
+        }
+        else
+        {
+            bSuccess = zombieOwners.Update(nExitAgeInSecs, sDiagDirectory, sErrorInfo);
+        }
+        if (bSuccess)
+        {
+            // Output: the alert verdict, with its exit code, or the results
+            if (alertThresholds.Any())
             {
-                *pStream << L"    Handle " << HEX(iterOwningInfo->handleValue) << L"  PID " << std::right << std::setw(6) << z.PID << L"  " << z.sImagePath << L" ; exited " << FileTimeToWString(z.exitTime, false) << L": " << Ago(nSecondsAgo) << L" ago" << std::endl;
+                StatsPhaseTimer phaseTimer(StatsPhase_t::Output);
+                OutputAlertVerdict(zombieOwners, &writer);
+                iExitCode = int(zombieOwners.AlertVerdict().alert);
             }
             else
             {
-                *pStream << L"    Handle " << HEX(iterOwningInfo->handleValue) << L"  PID:TID " << z.PID << L":" << z.TID << L"  " << z.sImagePath << L" ; exited " << FileTimeToWString(z.exitTime, false) << L": " << Ago(nSecondsAgo) << L" ago" << std::endl;
+                OutputResults(zombieOwners, bDetails, outputFormat, &writer);
             }
-            *pStream << L"        Parent: " << z.ParentPID << L" " << (z.sParentImagePath.length() > 0 ? z.sParentImagePath : L"(exited)") << std::endl;
-        }
-        *pStream << std::endl;
-    }
-
-    // Information about zombie processes for which no user-mode handles could be found:
-    if (zombieOwners.UnexplainedZombies().size() > 0)
-    {
-        *pStream
-            << L"Zombie processes for which no handles were found:" << std::endl
-            << zombieOwners.UnexplainedZombies().size() << L" process(es):" << std::endl;
-        for (
-            ZombieProcessThreadInfoList_t::const_iterator iterUnexplained = zombieOwners.UnexplainedZombies().begin();
-            zombieOwners.UnexplainedZombies().end() != iterUnexplained;
-            ++iterUnexplained
-            )
-        {
-            const ZombieProcessThreadInfo& z = *iterUnexplained;
-            const ULONGLONG& ulExitTime = (*(const ULONGLONG*)&z.exitTime);
-            ULONGLONG nSecondsAgo = (ulNow - ulExitTime) / 10000000;
-
-            *pStream
-                << L"    PID " << z.PID << L"  " << z.sImagePath << std::endl
-                << L"      Exited " << FileTimeToWString(z.exitTime, false) << L": " << Ago(nSecondsAgo) << L" ago" << std::endl
-                << L"      Threads: " << z.nThreads << std::endl
-                << L"      Parent: " << z.ParentPID << L" " << (z.sParentImagePath.length() > 0 ? z.sParentImagePath : L"(exited)") << std::endl;
         }
-    }
-
-    // Any process enumeration errors
-    if (zombieOwners.ProcessEnumErrors().size() > 0)
-    {
-        for (
-            ProcessEnumErrorInfoList_t::const_iterator iter = zombieOwners.ProcessEnumErrors().begin();
-            iter != zombieOwners.ProcessEnumErrors().end();
-            iter++
-            )
+        else
         {
-            *pStream << L"ERROR: " << *iter << std::endl;
+            std::wcerr << L"Error: " << sErrorInfo << std::endl;
+            iExitCode = -1;
         }
-    }
-}
-
-// ------------------------------------------------------------------------------------------
-/// <summary>
-/// Output detailed results in tab-delimited fields
-/// </summary>
-/// <param name="zombieOwners">Input: zombie process/owner information</param>
-/// <param name="ulNow">Input: representation of current time</param>
-/// <param name="pStream">Input: pointer to output stream into which to write</param>
-void OutputDetailsCsv(const ZombieOwners& zombieOwners, ULONGLONG ulNow, std::wostream* pStream)
-{
-    // Tab-delimited headers
-    *pStream
-        << L"Owning process name" << szTabDelim
-        << L"Owning PID" << szTabDelim
-        << L"Owning process image path" << szTabDelim
-        << L"Services" << szTabDelim
-        << L"Handle" << szTabDelim
-        << L"Z PID" << szTabDelim
-        << L"Z TID" << szTabDelim
-        << L"Zombie image path" << szTabDelim
-        << L"Threads" << szTabDelim
-        << L"Started" << szTabDelim
-        << L"Exited" << szTabDelim
-        << L"Exited ago" << szTabDelim
-        << L"PPID" << szTabDelim
-        << L"Parent image path"
-        << std::endl;
 
-    // Existing user-mode processes holding handles to zombies, and info about those zombies
-    const ZombieOwnersCollectionSorted_t& coll = zombieOwners.OwnersCollectionSorted();
-    for (
-        ZombieOwnersCollectionSorted_t::const_iterator iterOwners = coll.begin();
-        coll.end() != iterOwners;
-        ++iterOwners
-        )
-    {
-        const ZombieOwner_t& owner = **iterOwners;
-        const ZombieOwningInfoList_t& owningInfo = owner.zombieOwningInfo;
-        for (
-            ZombieOwningInfoList_t::const_iterator iterOwningInfo = owningInfo.begin();
-            owningInfo.end() != iterOwningInfo;
-            ++iterOwningInfo
-            )
-        {
-            const ZombieProcessThreadInfo& z = iterOwningInfo->zombieInfo;
-            const ULONGLONG& ulExitTime = (*(const ULONGLONG*)&z.exitTime);
-            ULONGLONG nSecondsAgo = (ulNow - ulExitTime) / 10000000;
-
-            // If it's a thread handle, populate the TID field with the Thread ID, and leave the Threads field empty.
-            // If it's a process handle, populate the Threads field with the number of threads in the process, and leave the TID field empty.
-            std::wstringstream strTID, strThreads;
-            if (0 != z.TID)
+        // ------------------------------------------------------------------------------------------
+        // Watch mode: keep the same ZombieOwners instance (and its buffers and lookups) and re-sample on a timer,
+        // outputting only the changes since the previous successful sample.
+        if (bSuccess && dwWatchIntervalSecs > 0)
+        {
+            if (!EnableWatchStop(true))
             {
-                strTID << z.TID;
+                std::wcerr << L"Error: cannot set up -watch mode" << std::endl;
+                iExitCode = -1;
             }
             else
             {
-                strThreads << z.nThreads;
-            }
-
-            // First three tab-delimited fields
-            *pStream
-                << owner.sExeName << szTabDelim
-                << owner.PID << szTabDelim
-                << owner.sProcessImagePath << szTabDelim;
-            // If the process hosts services, put their key names in the next field, separated by spaces
-            if (nullptr != owner.pServiceList)
-            {
-                for (
-                    ServiceList_t::const_iterator iterSvc = owner.pServiceList->begin();
-                    iterSvc != owner.pServiceList->end();
-                    iterSvc++
-                    )
+                writer.Flush();
+                ZombieSample previousSample, currentSample;
+                previousSample.Capture(zombieOwners);
+                const ULONGLONG ullIntervalMs = ULONGLONG(dwWatchIntervalSecs) * 1000;
+                ULONGLONG ullNextSample = GetTickCount64() + ullIntervalMs;
+                for (;;)
                 {
-                    *pStream << iterSvc->sServiceName << L" ";
+                    // Wait until the next sample is due, or until told to stop.
+                    const ULONGLONG ullTickNow = GetTickCount64();
+                    const DWORD dwWaitMs = (ullNextSample > ullTickNow) ? DWORD(ullNextSample - ullTickNow) : 0;
+                    if (WaitForWatchStop(dwWaitMs))
+                        break;
+                    // Fixed sampling rate; if a sample took longer than the interval, skip the missed ones.
+                    ullNextSample += ullIntervalMs;
+                    if (ullNextSample <= GetTickCount64())
+                        ullNextSample = GetTickCount64() + ullIntervalMs;
+
+                    if (!zombieOwners.Update(nExitAgeInSecs, sDiagDirectory, sErrorInfo))
+                    {
+                        // Report and keep watching; the next sample is compared with the last successful one.
+                        std::wcerr << L"Error: " << sErrorInfo << std::endl;
+                        continue;
+                    }
+                    currentSample.Capture(zombieOwners);
+                    ZombieSampleDelta delta;
+                    currentSample.CompareWith(previousSample, delta);
+                    if (!delta.Empty())
+                    {
+                        StatsPhaseTimer phaseTimer(StatsPhase_t::Output);
+                        if (OutputFormat_t::Csv == outputFormat)
+                            OutputWatchDeltaCsv(delta, zombieOwners.CaptureTime(), &writer);
+                        else if (OutputFormat_t::Json == outputFormat)
+                            OutputWatchDeltaJson(delta, zombieOwners.CaptureTime(), &writer);
+                        else
+                            OutputWatchDelta(delta, zombieOwners.CaptureTime(), &writer);
+                        writer.Flush();
+                    }
+                    std::swap(previousSample, currentSample);
                 }
             }
-            // Rest of the fields
-            *pStream
-                << szTabDelim // tab following the Services field
-                << HEX(iterOwningInfo->handleValue, 8, false, true) << szTabDelim
-                << z.PID << szTabDelim
-                << strTID.str() << szTabDelim
-                << z.sImagePath << szTabDelim
-                << strThreads.str() << szTabDelim
-                << FileTimeToWString(z.createTime, false) << szTabDelim
-                << FileTimeToWString(z.exitTime, false) << szTabDelim
-                << Ago(nSecondsAgo) << szTabDelim
-                << z.ParentPID << szTabDelim
-                << (z.sParentImagePath.length() > 0 ? z.sParentImagePath : L"(exited)")
-                << std::endl;
+            EnableWatchStop(false);
         }
     }
 
-    // Information about zombie processes for which no user-mode handles could be found:
-    if (zombieOwners.UnexplainedZombies().size() > 0)
+    // ------------------------------------------------------------------------------------------
+    // Flush the output, and close the file if output to a file.
+    if (!writer.Close())
     {
-        for (
-            ZombieProcessThreadInfoList_t::const_iterator iterUnexplained = zombieOwners.UnexplainedZombies().begin();
-            zombieOwners.UnexplainedZombies().end() != iterUnexplained;
-            ++iterUnexplained
-            )
-        {
-            const ZombieProcessThreadInfo& z = *iterUnexplained;
-            const ULONGLONG& ulExitTime = (*(const ULONGLONG*)&z.exitTime);
-            ULONGLONG nSecondsAgo = (ulNow - ulExitTime) / 10000000;
-
-            // First five fields are empty - no user-mode processes found holding handles to these zombies. TID field empty as well.
-            *pStream
-                << szTabDelim
-                << szTabDelim
-                << szTabDelim
-                << szTabDelim
-                << szTabDelim
-                << z.PID << szTabDelim
-                << szTabDelim
-                << z.sImagePath << szTabDelim
-                << z.nThreads << szTabDelim
-                << FileTimeToWString(z.createTime, false) << szTabDelim
-                << FileTimeToWString(z.exitTime, false) << szTabDelim
-                << Ago(nSecondsAgo) << szTabDelim
-                << z.ParentPID << szTabDelim
-                << (z.sParentImagePath.length() > 0 ? z.sParentImagePath : L"(exited)")
-                << std::endl;
-        }
+        std::wcerr << L"Error: cannot write output" << std::endl;
+        iExitCode = -1;
     }
 
-    // Any process enumeration errors
-    if (zombieOwners.ProcessEnumErrors().size() > 0)
+    // Instrumentation goes to stderr so that it doesn't get mixed into results that are parsed or diffed.
+    if (bStats)
     {
-        for (
-            ProcessEnumErrorInfoList_t::const_iterator iter = zombieOwners.ProcessEnumErrors().begin();
-            iter != zombieOwners.ProcessEnumErrors().end();
-            iter++
-            )
-        {
-            // First five fields are empty - no user-mode processes found holding handles to these zombies. TID field empty as well.
-            *pStream
-                << L"ERROR" << szTabDelim // Owning process name
-                << L"ERROR" << szTabDelim // Owning PID
-                << *iter << szTabDelim // Owning process image path
-                << szTabDelim // Services
-                << szTabDelim // Handle
-                << szTabDelim // Z PID
-                << szTabDelim // Z TID
-                << szTabDelim // Zombie image path
-                << szTabDelim // Threads
-                << szTabDelim // Started
-                << szTabDelim // Exited
-                << szTabDelim // Exited ago
-                << szTabDelim // PPID
-                << std::endl; // Parent image path
-        }
+        StatsAddTime(StatsPhase_t::Total, ullStartTimestamp);
+        WriteStats(&std::wcerr, OutputFormat_t::Csv == outputFormat);
     }
-}
-
-
-
-
 
+    return iExitCode;
+}
 
+#ifndef _WIN32
+/// <summary>
+/// Entry point on other operating systems: converts the arguments to wide strings for wmain.
+/// </summary>
+int main(int argc, char** argv)
+{
+    setlocale(LC_ALL, "");
+    std::vector<std::wstring> args;
+    std::vector<wchar_t*> argPointers;
+    // Arguments are decoded as UTF-8, the encoding of file names, whatever the locale (e.g., C under cron and systemd).
+    for (int ixArg = 0; ixArg < argc; ++ixArg)
+    {
+        std::wstring sArg;
+        if (!WideFromUtf8(argv[ixArg], strlen(argv[ixArg]), sArg))
+            Usage(L"Command-line arguments must be valid UTF-8", args.empty() ? L"ZombieFinder" : args[0].c_str());
+        args.push_back(sArg);
+    }
+    for (std::vector<std::wstring>::iterator iter = args.begin(); iter != args.end(); ++iter)
+        argPointers.push_back(&(*iter)[0]);
+    argPointers.push_back(nullptr);
+    return wmain(argc, argPointers.data());
+}
+#endif
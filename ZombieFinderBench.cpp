@@ -0,0 +1,860 @@
+// ZombieFinderBench.cpp : Benchmarks for performance-sensitive parts of ZombieFinder, using synthetic data:
+// the handle table search, full correlation through ZombieOwners, owner sorting, string formatting, output, and the whole
+// pipeline through the in-memory platform.
+//
+
+#include "PlatformTypes.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <clocale>
+#include <cstring>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include "HEX.h"
+#include "StringUtils.h"
+#include "UtilityFunctions.h"
+#include "FileOutput.h"
+#include "ZombieHandleMatch.h"
+#include "ObjectTypeFilter.h"
+#include "WorkerPool.h"
+#include "SyntheticWorkload.h"
+#include "ZombieDataSource.h"
+#include "ZombieOwners.h"
+#include "Utf8Writer.h"
+#include "ZombieOutput.h"
+#include "PlatformInMemory.h"
+#include "FullThreadReport.h"
+#include "ConcurrentPidTable.h"
+
+/// <summary>
+/// Write command-line syntax to stderr and then exit.
+/// </summary>
+static void Usage(const wchar_t* szError)
+{
+    if (szError)
+        std::wcerr << szError << std::endl;
+    std::wcerr
+        << std::endl
+        << L"Usage:" << std::endl
+        << std::endl
+        << L"  ZombieFinderBench [-handles count] [-processes count] [-zombieratio ratio] [-skew exponent] [-seed value]" << std::endl
+        << L"                    [-iterations count] [-workers count] [-owners count] [-calls count]" << std::endl
+        << L"                    [-threadsperprocess count] [-callcost ns] [-matches count] [-hotowner percent]" << std::endl
+        << std::endl
+        << L"    -handles count     Number of entries in the synthetic handle table (default 4000000)" << std::endl
+        << L"    -processes count   Number of running processes holding those handles (default 2000)" << std::endl
+        << L"    -zombieratio ratio Zombie processes per running process (default 1.25)" << std::endl
+        << L"    -skew exponent     Concentration of handles to zombies in a few processes: 0 for none (default 1)" << std::endl
+        << L"    -seed value        Random seed for the synthetic workload (default 12345)" << std::endl
+        << L"    -iterations count  Number of timed runs of each benchmark (default 5)" << std::endl
+        << L"    -workers count     Maximum number of workers for the partitioned scan (default: logical processor count)" << std::endl
+        << L"    -owners count      Number of synthetic owners for the owner sort benchmark (default 100000)" << std::endl
+        << L"    -calls count       Number of calls per timed run of each formatting function (default 1000000)" << std::endl
+        << L"    -threadsperprocess count  Average number of threads per process for the thread report (default 20)" << std::endl
+        << L"    -callcost ns       Simulated kernel time per process/thread query for the thread report (default 1000)" << std::endl
+        << L"    -matches count     Number of handles to zombies for the owner aggregation benchmark (default 1000000)" << std::endl
+        << L"    -hotowner percent  Share of those handles held by one owner (default 90)" << std::endl
+        << std::endl;
+    exit(-1);
+}
+
+/// <summary>
+/// Runs the hash lookup over the whole handle table the requested number of times; reports the best time.
+/// </summary>
+static double TimeHashLookup(const SyntheticWorkload& workload, size_t nIterations, ZombieHandleMatchList_t& matches)
+{
+    double bestMs = 0;
+    for (size_t iter = 0; iter < nIterations; ++iter)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        FindZombieHandleMatches(workload.HandleEntries(), workload.NumberOfHandles(), workload.ZombieObjectAddrLookup(), matches);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (0 == iter || ms < bestMs)
+            bestMs = ms;
+    }
+    return bestMs;
+}
+
+/// <summary>
+/// Prefilters the handle table by object type with the selected implementation, then runs the hash lookup
+/// on the remaining entries; reports the best time.
+/// </summary>
+static double TimePrefilteredLookup(bool bAvx2, const SyntheticWorkload& workload, size_t nIterations, ZombieHandleMatchList_t& matches)
+{
+    double bestMs = 0;
+    for (size_t iter = 0; iter < nIterations; ++iter)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        HandleIndexList_t candidates;
+        if (bAvx2)
+            FilterHandlesByObjectType_AVX2(workload.HandleEntries(), workload.NumberOfHandles(), workload.ZombieObjectTypes().data(), workload.ZombieObjectTypes().size(), candidates);
+        else
+            FilterHandlesByObjectType_Scalar(workload.HandleEntries(), workload.NumberOfHandles(), workload.ZombieObjectTypes().data(), workload.ZombieObjectTypes().size(), candidates);
+        FindZombieHandleMatches(workload.HandleEntries(), workload.NumberOfHandles(), workload.ZombieObjectAddrLookup(), matches, &candidates);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (0 == iter || ms < bestMs)
+            bestMs = ms;
+    }
+    return bestMs;
+}
+
+/// <summary>
+/// Runs the hash lookup over the handle table partitioned across nWorkers workers, combining the per-worker
+/// matches in partition order as ZombieOwners::Correlate does; reports the best time.
+/// </summary>
+static double TimePartitionedScan(size_t nWorkers, const SyntheticWorkload& workload, size_t nIterations, ZombieHandleMatchList_t& matches)
+{
+    double bestMs = 0;
+    for (size_t iter = 0; iter < nIterations; ++iter)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const size_t nPartitions = PartitionCount(workload.NumberOfHandles(), nWorkers, 1);
+        std::vector<ZombieHandleMatchList_t> fragments(nPartitions);
+        RunPartitioned(workload.NumberOfHandles(), nPartitions,
+            [&](size_t ixPartition, size_t ixBegin, size_t ixEnd)
+            {
+                ZombieHandleMatchList_t& fragment = fragments[ixPartition];
+                FindZombieHandleMatches(workload.HandleEntries() + ixBegin, ixEnd - ixBegin, workload.ZombieObjectAddrLookup(), fragment);
+                for (ZombieHandleMatchList_t::iterator iMatch = fragment.begin(); iMatch != fragment.end(); ++iMatch)
+                    iMatch->ixHandle += ixBegin;
+            });
+        matches.clear();
+        for (std::vector<ZombieHandleMatchList_t>::const_iterator iFragment = fragments.begin(); iFragment != fragments.end(); ++iFragment)
+            matches.insert(matches.end(), iFragment->begin(), iFragment->end());
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (0 == iter || ms < bestMs)
+            bestMs = ms;
+    }
+    return bestMs;
+}
+
+/// <summary>
+/// Runs fn the requested number of times; reports the best time in milliseconds.
+/// </summary>
+template <typename Fn>
+static double TimeBest(size_t nIterations, Fn fn)
+{
+    double bestMs = 0;
+    for (size_t iter = 0; iter < nIterations; ++iter)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (0 == iter || ms < bestMs)
+            bestMs = ms;
+    }
+    return bestMs;
+}
+
+/// <summary>
+/// Creates nOwners owners for the sort benchmark, in random order. Handle counts are skewed toward small values and
+/// exe names are drawn from a small pool, so that the comparator's exe name and PID tie-breakers are exercised.
+/// </summary>
+static void MakeSyntheticOwners(size_t nOwners, ULONGLONG seed, ZombieOwnersCollection_t& owners, ZombieOwnersCollectionSorted_t& ownerPointers)
+{
+    const size_t nExeNames = 200, nMaxHandles = 64;
+    std::mt19937_64 rng(seed);
+    owners.clear();
+    owners.reserve(nOwners);
+    for (size_t ixOwner = 0; ixOwner < nOwners; ++ixOwner)
+    {
+        const ULONG_PTR PID = ULONG_PTR(4 * (ixOwner + 1));
+        ZombieOwner_t& owner = owners[PID];
+        owner.PID = PID;
+        // Alternate the case of the first letter; the comparator is case-insensitive
+        owner.sExeName = std::wstring(rng() % 2 ? L"S" : L"s") + L"ervice" + std::to_wstring(rng() % nExeNames) + L".exe";
+        owner.sProcessImagePath = L"C:\\Program Files\\Vendor\\" + owner.sExeName;
+        // Square of a uniform value: most owners hold few handles, a few hold many
+        const size_t nRoot = size_t(rng() % 8) + 1;
+        owner.zombieOwningInfo.resize((std::min<size_t>)(nRoot * nRoot, nMaxHandles));
+    }
+    ownerPointers.clear();
+    for (ZombieOwnersCollection_t::const_iterator iOwner = owners.begin(); iOwner != owners.end(); ++iOwner)
+        ownerPointers.push_back(&(iOwner->second));
+    std::shuffle(ownerPointers.begin(), ownerPointers.end(), rng);
+}
+
+/// <summary>
+/// Owners of handles to zombies, each with the indexes of its handles, as the owner aggregation benchmark produces them
+/// </summary>
+typedef std::vector<std::pair<ULONG_PTR, std::vector<size_t>>> AggregatedOwners_t;
+
+/// <summary>
+/// Creates the owning PIDs of nMatches handles to zombies for the owner aggregation benchmark, in handle table order:
+/// nHotPercent percent of them owned by one process (as when one service holds most of them), and the rest spread at
+/// random over nOwners other processes.
+/// </summary>
+static void MakeOwningPids(size_t nMatches, size_t nOwners, size_t nHotPercent, ULONGLONG seed, std::vector<ULONG_PTR>& owningPids)
+{
+    const ULONG_PTR hotPID = 4;
+    std::mt19937_64 rng(seed);
+    owningPids.resize(nMatches);
+    for (size_t ix = 0; ix < nMatches; ++ix)
+        owningPids[ix] = (size_t(rng() % 100) < nHotPercent) ? hotPID : ULONG_PTR(8 + 4 * (rng() % nOwners));
+}
+
+/// <summary>
+/// Owner aggregation through one map shared by the workers, under a lock.
+/// Owners are in no particular order, and neither are their handles.
+/// </summary>
+static void AggregateOwnersLocked(const std::vector<ULONG_PTR>& owningPids, size_t nPartitions, AggregatedOwners_t& owners)
+{
+    std::unordered_map<ULONG_PTR, std::vector<size_t>> handlesByPID;
+    std::mutex lock;
+    RunPartitioned(owningPids.size(), nPartitions,
+        [&](size_t, size_t ixBegin, size_t ixEnd)
+        {
+            for (size_t ix = ixBegin; ix < ixEnd; ++ix)
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                handlesByPID[owningPids[ix]].push_back(ix);
+            }
+        });
+    owners.assign(handlesByPID.begin(), handlesByPID.end());
+}
+
+/// <summary>
+/// Owner aggregation through a map per worker, merged in partition order: owners in order of their first handle.
+/// </summary>
+static void AggregateOwnersPerWorker(const std::vector<ULONG_PTR>& owningPids, size_t nPartitions, AggregatedOwners_t& owners)
+{
+    struct Fragment
+    {
+        std::vector<ULONG_PTR> pidOrder;
+        std::unordered_map<ULONG_PTR, std::vector<size_t>> handlesByPID;
+    };
+    std::vector<Fragment> fragments(nPartitions);
+    RunPartitioned(owningPids.size(), nPartitions,
+        [&](size_t ixPartition, size_t ixBegin, size_t ixEnd)
+        {
+            Fragment& fragment = fragments[ixPartition];
+            for (size_t ix = ixBegin; ix < ixEnd; ++ix)
+            {
+                std::vector<size_t>& handles = fragment.handlesByPID[owningPids[ix]];
+                if (handles.empty())
+                    fragment.pidOrder.push_back(owningPids[ix]);
+                handles.push_back(ix);
+            }
+        });
+    owners.clear();
+    std::unordered_map<ULONG_PTR, size_t> ownerIndexes;
+    for (std::vector<Fragment>::const_iterator iFragment = fragments.begin(); iFragment != fragments.end(); ++iFragment)
+    {
+        for (std::vector<ULONG_PTR>::const_iterator iPID = iFragment->pidOrder.begin(); iPID != iFragment->pidOrder.end(); ++iPID)
+        {
+            std::unordered_map<ULONG_PTR, size_t>::const_iterator iOwner = ownerIndexes.find(*iPID);
+            if (ownerIndexes.end() == iOwner)
+            {
+                iOwner = ownerIndexes.insert(std::make_pair(*iPID, owners.size())).first;
+                owners.push_back(std::make_pair(*iPID, std::vector<size_t>()));
+            }
+            const std::vector<size_t>& handles = iFragment->handlesByPID.find(*iPID)->second;
+            std::vector<size_t>& ownerHandles = owners[iOwner->second].second;
+            ownerHandles.insert(ownerHandles.end(), handles.begin(), handles.end());
+        }
+    }
+}
+
+/// <summary>
+/// Owner aggregation as ZombieOwners::Correlate does it: the workers tag each handle with its owner's slot in a shared
+/// ConcurrentPidTable, and a serial pass in handle table order groups them by slot: owners in order of their first handle.
+/// The table is sized for nMaxOwners owners (there can't be more owners than processes), which must be enough.
+/// </summary>
+static void AggregateOwnersConcurrentTable(const std::vector<ULONG_PTR>& owningPids, size_t nMaxOwners, size_t nPartitions, ConcurrentPidTable& ownerTable, AggregatedOwners_t& owners)
+{
+    ownerTable.Reset((std::min)(owningPids.size(), nMaxOwners));
+    std::vector<size_t> ownerSlots(owningPids.size());
+    RunPartitioned(owningPids.size(), nPartitions,
+        [&](size_t, size_t ixBegin, size_t ixEnd)
+        {
+            for (size_t ix = ixBegin; ix < ixEnd; ++ix)
+                ownerTable.Insert(owningPids[ix], ownerSlots[ix]);
+        });
+    owners.clear();
+    const size_t NoOwner = size_t(-1);
+    std::vector<size_t> ownersBySlot(ownerTable.Capacity(), NoOwner);
+    for (size_t ix = 0; ix < owningPids.size(); ++ix)
+    {
+        size_t& ixOwner = ownersBySlot[ownerSlots[ix]];
+        if (NoOwner == ixOwner)
+        {
+            ixOwner = owners.size();
+            owners.push_back(std::make_pair(owningPids[ix], std::vector<size_t>()));
+        }
+        owners[ixOwner].second.push_back(ix);
+    }
+}
+
+/// <summary>
+/// True if the two aggregations have the same owners with the same handles, in any order
+/// </summary>
+static bool SameOwners(const AggregatedOwners_t& a, const AggregatedOwners_t& b)
+{
+    AggregatedOwners_t sortedA(a), sortedB(b);
+    std::sort(sortedA.begin(), sortedA.end());
+    std::sort(sortedB.begin(), sortedB.end());
+    for (AggregatedOwners_t::iterator iter = sortedA.begin(); iter != sortedA.end(); ++iter)
+        std::sort(iter->second.begin(), iter->second.end());
+    for (AggregatedOwners_t::iterator iter = sortedB.begin(); iter != sortedB.end(); ++iter)
+        std::sort(iter->second.begin(), iter->second.end());
+    return sortedA == sortedB;
+}
+
+/// <summary>
+/// True if the two match lists are identical
+/// </summary>
+static bool SameMatches(const ZombieHandleMatchList_t& a, const ZombieHandleMatchList_t& b)
+{
+    bool bSame = a.size() == b.size();
+    for (size_t ix = 0; bSame && ix < a.size(); ++ix)
+    {
+        bSame = a[ix].ixHandle == b[ix].ixHandle && a[ix].ixZombie == b[ix].ixZombie;
+    }
+    return bSame;
+}
+
+/// <summary>
+/// Returns true if two ZombieOwners instances have the same results: owners in the same sorted order with the same
+/// image paths and numbers of handles, the same zombies without owners, and the same counts.
+/// </summary>
+static bool SameResults(const ZombieOwners& a, const ZombieOwners& b)
+{
+    if (a.ZombieProcessCount() != b.ZombieProcessCount() ||
+        a.ZombieProcessAndThreadCount() != b.ZombieProcessAndThreadCount() ||
+        a.OwnersCollectionSorted().size() != b.OwnersCollectionSorted().size())
+        return false;
+    for (size_t ix = 0; ix < a.OwnersCollectionSorted().size(); ++ix)
+    {
+        const ZombieOwner_t* pA = a.OwnersCollectionSorted()[ix];
+        const ZombieOwner_t* pB = b.OwnersCollectionSorted()[ix];
+        if (pA->PID != pB->PID || pA->sProcessImagePath != pB->sProcessImagePath || pA->zombieOwningInfo.size() != pB->zombieOwningInfo.size())
+            return false;
+    }
+    std::vector<ULONG_PTR> unexplainedA, unexplainedB;
+    for (ZombieRecordIndexList_t::const_iterator iter = a.UnexplainedZombies().begin(); iter != a.UnexplainedZombies().end(); ++iter)
+        unexplainedA.push_back(a.Zombie(*iter).PID);
+    for (ZombieRecordIndexList_t::const_iterator iter = b.UnexplainedZombies().begin(); iter != b.UnexplainedZombies().end(); ++iter)
+        unexplainedB.push_back(b.Zombie(*iter).PID);
+    std::sort(unexplainedA.begin(), unexplainedA.end());
+    std::sort(unexplainedB.begin(), unexplainedB.end());
+    return unexplainedA == unexplainedB;
+}
+
+/// <summary>
+/// Writes a small diagnostic file set as the first releases' -diag wrote it (zombie handles without the raw time values,
+/// all handles as text, no context file), replays it, and checks the results. Returns false with sErrorInfo describing
+/// the first difference. The files are written to the current directory and removed afterward.
+/// </summary>
+static bool ReplayBaselineDiagFiles(std::wstring& sErrorInfo)
+{
+    const std::wstring sPrefix = L"ZombieFinderBench_20240101_120000";
+    const std::wstring sZombieHandlesFile = sPrefix + L"_ZombieHandles.txt";
+    const std::wstring sAllHandlesFile = sPrefix + L"_AllHandles.txt";
+    const std::wstring sServicesFile = sPrefix + L"_Services.txt";
+
+    // The capturing process, PID 1000, holds handles to zombie process 2000, one of its threads, and zombie process
+    // 2001. Process 500, which hosts a service, holds handles to process 2000 and its thread; nothing else holds a
+    // handle to process 2001.
+    Utf8Writer zombieHandlesWriter, allHandlesWriter, servicesWriter;
+    if (!zombieHandlesWriter.OpenFile(sZombieHandlesFile.c_str(), false, sErrorInfo) ||
+        !allHandlesWriter.OpenFile(sAllHandlesFile.c_str(), false, sErrorInfo) ||
+        !servicesWriter.OpenFile(sServicesFile.c_str(), false, sErrorInfo))
+        return false;
+    (zombieHandlesWriter << L"ThisPID\tHandleValue\tPID\tTID\tnThreads\tImagePath\tcreateTime\texitTime\tPPID\tParentImagePath").EndLine();
+    (zombieHandlesWriter << L"1000\t0x00000104\t2000\t0\t1\tC:\\Apps\\Worker.exe\t2024-01-01 11:00:00\t2024-01-01 11:59:00\t500\tC:\\Apps\\Host.exe").EndLine();
+    (zombieHandlesWriter << L"1000\t0x00000108\t2000\t2004\t1\tC:\\Apps\\Worker.exe\t2024-01-01 11:00:00\t2024-01-01 11:59:00\t500\tC:\\Apps\\Host.exe").EndLine();
+    (zombieHandlesWriter << L"1000\t0x0000010C\t2001\t0\t1\tC:\\Apps\\Other.exe\t2024-01-01 10:00:00\t2024-01-01 10:30:00\t4\t").EndLine();
+    (allHandlesWriter << L"PID\tHandle\tObjectTypeIndex\tObjectAddr").EndLine();
+    (allHandlesWriter << L"1000\t0x00000104\t7\tFFFFA00000001000").EndLine();
+    (allHandlesWriter << L"1000\t0x00000108\t8\tFFFFA00000002000").EndLine();
+    (allHandlesWriter << L"1000\t0x0000010C\t7\tFFFFA00000003000").EndLine();
+    (allHandlesWriter << L"500\t0x00000040\t7\tFFFFA00000001000").EndLine();
+    (allHandlesWriter << L"500\t0x00000044\t8\tFFFFA00000002000").EndLine();
+    (allHandlesWriter << L"600\t0x00000040\t7\tFFFFA00000009000").EndLine();
+    (servicesWriter << L"PID: 500").EndLine();
+    (servicesWriter << L"             HostSvc   Host Service").EndLine();
+    servicesWriter.EndLine();
+    bool bWritten = zombieHandlesWriter.Close();
+    bWritten = allHandlesWriter.Close() && bWritten;
+    bWritten = servicesWriter.Close() && bWritten;
+
+    ZombieOwners zombieOwners;
+    const bool bReplayed = bWritten && zombieOwners.Replay(sPrefix, sErrorInfo);
+    RemoveFile(sZombieHandlesFile.c_str());
+    RemoveFile(sAllHandlesFile.c_str());
+    RemoveFile(sServicesFile.c_str());
+    if (!bWritten)
+    {
+        sErrorInfo = L"Cannot write the diagnostic files";
+        return false;
+    }
+    if (!bReplayed)
+        return false;
+
+    const ZombieOwnersCollectionSorted_t& owners = zombieOwners.OwnersCollectionSorted();
+    if (3 != zombieOwners.ZombieProcessAndThreadCount() || 2 != zombieOwners.ZombieProcessCount() ||
+        1 != owners.size() || 500 != owners[0]->PID || 2 != owners[0]->zombieOwningInfo.size() ||
+        !owners[0]->sProcessImagePath.empty() || 1 != owners[0]->services.size() || L"HostSvc" != owners[0]->services.ServiceName(0) ||
+        1 != zombieOwners.UnexplainedZombies().size() || 2001 != zombieOwners.Zombie(zombieOwners.UnexplainedZombies().front()).PID)
+    {
+        sErrorInfo = L"Replay of diagnostic files without the context file found different owners";
+        return false;
+    }
+    const ZombieProcessThreadInfo& zombie = zombieOwners.Zombie(owners[0]->zombieOwningInfo[0].ixZombie);
+    if (L"2024-01-01 11:00:00" != FileTimeToWString(zombie.createTime, false) ||
+        L"2024-01-01 11:59:00" != FileTimeToWString(zombie.exitTime, false))
+    {
+        sErrorInfo = L"Replay of diagnostic files without the raw time values read different times";
+        return false;
+    }
+    FILETIME ftCapture;
+    if (!WStringToFileTime(L"2024-01-01 12:00:00", false, ftCapture) || zombieOwners.CaptureTime() != *(const ULONGLONG*)&ftCapture)
+    {
+        sErrorInfo = L"Replay of diagnostic files without the context file took a different capture time";
+        return false;
+    }
+    return true;
+}
+
+/// <summary>
+/// Fills an in-memory platform with nProcesses processes for the thread report benchmark. Thread counts vary from 1 to
+/// about twice the average, and about one thread in ten, and one process in twenty, has exited.
+/// </summary>
+static bool BuildThreadReportPlatform(size_t nProcesses, size_t nThreadsPerProcess, InMemoryPlatform& platform, std::wstring& sErrorInfo)
+{
+    platform.Clear();
+    ULONG_PTR nextHandleValue = 4;
+    DWORD nextTID = 8;
+    for (size_t ixProcess = 0; ixProcess < nProcesses; ++ixProcess)
+    {
+        InMemoryProcess process;
+        process.hProcess = HANDLE(nextHandleValue);
+        nextHandleValue += 4;
+        process.PID = 4 * (ixProcess + 1);
+        process.sImagePath = L"C:\\Program Files\\Synthetic\\App" + std::to_wstring(ixProcess) + L".exe";
+        process.dwHandleCount = DWORD(100 + ixProcess % 900);
+        process.exitTime = (0 == ixProcess % 20) ? 1 : 0;
+        const size_t nThreads = 1 + (ixProcess * 7919) % (2 * nThreadsPerProcess);
+        for (size_t ixThread = 0; ixThread < nThreads; ++ixThread)
+        {
+            InMemoryThread thread;
+            thread.hThread = HANDLE(nextHandleValue);
+            nextHandleValue += 4;
+            thread.TID = nextTID;
+            nextTID += 4;
+            thread.bExited = (0 == (ixProcess + ixThread) % 10);
+            process.threads.push_back(thread);
+        }
+        if (!platform.AddProcess(process, sErrorInfo))
+            return false;
+    }
+    return true;
+}
+
+int wmain(int argc, wchar_t** argv)
+{
+    SyntheticWorkloadParams params;
+    size_t nIterations = 5, nWorkers = DefaultWorkerCount(), nOwners = 100000, nCalls = 1000000;
+    size_t nThreadsPerProcess = 20, nCallCostNs = 1000, nAggregationMatches = 1000000, nHotOwnerPercent = 90;
+    for (int ixArg = 1; ixArg < argc; ++ixArg)
+    {
+        size_t* pValue = nullptr;
+        double* pDoubleValue = nullptr;
+        ULONGLONG* pSeedValue = nullptr;
+        if (0 == _wcsicmp(L"-handles", argv[ixArg]))
+            pValue = &params.nHandles;
+        else if (0 == _wcsicmp(L"-processes", argv[ixArg]))
+            pValue = &params.nProcesses;
+        else if (0 == _wcsicmp(L"-zombieratio", argv[ixArg]))
+            pDoubleValue = &params.zombieRatio;
+        else if (0 == _wcsicmp(L"-skew", argv[ixArg]))
+            pDoubleValue = &params.ownerSkew;
+        else if (0 == _wcsicmp(L"-seed", argv[ixArg]))
+            pSeedValue = &params.seed;
+        else if (0 == _wcsicmp(L"-iterations", argv[ixArg]))
+            pValue = &nIterations;
+        else if (0 == _wcsicmp(L"-workers", argv[ixArg]))
+            pValue = &nWorkers;
+        else if (0 == _wcsicmp(L"-owners", argv[ixArg]))
+            pValue = &nOwners;
+        else if (0 == _wcsicmp(L"-calls", argv[ixArg]))
+            pValue = &nCalls;
+        else if (0 == _wcsicmp(L"-threadsperprocess", argv[ixArg]))
+            pValue = &nThreadsPerProcess;
+        else if (0 == _wcsicmp(L"-callcost", argv[ixArg]))
+            pValue = &nCallCostNs;
+        else if (0 == _wcsicmp(L"-matches", argv[ixArg]))
+            pValue = &nAggregationMatches;
+        else if (0 == _wcsicmp(L"-hotowner", argv[ixArg]))
+            pValue = &nHotOwnerPercent;
+        else
+            Usage(L"Unrecognized command-line option");
+        if (++ixArg >= argc)
+            Usage(L"Missing arg");
+        if (nullptr != pValue)
+            *pValue = size_t(wcstoull(argv[ixArg], nullptr, 10));
+        else if (nullptr != pDoubleValue)
+            *pDoubleValue = wcstod(argv[ixArg], nullptr);
+        else
+            *pSeedValue = wcstoull(argv[ixArg], nullptr, 10);
+    }
+    if (0 == nIterations)
+        Usage(L"Invalid arg for -iterations");
+    if (0 == nWorkers)
+        Usage(L"Invalid arg for -workers");
+    if (0 == nCalls)
+        Usage(L"Invalid arg for -calls");
+    if (nHotOwnerPercent > 100)
+        Usage(L"Invalid arg for -hotowner");
+
+    std::wstring sErrorInfo;
+    // Captures from earlier releases must still replay.
+    if (!ReplayBaselineDiagFiles(sErrorInfo))
+    {
+        std::wcerr << L"ERROR: " << sErrorInfo << std::endl;
+        return -1;
+    }
+
+    SyntheticWorkload workload;
+    std::chrono::steady_clock::time_point generateStart = std::chrono::steady_clock::now();
+    if (!workload.Generate(params, sErrorInfo))
+    {
+        std::wcerr << L"ERROR: " << sErrorInfo << std::endl;
+        return -1;
+    }
+    double generateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - generateStart).count();
+    const size_t nHandles = workload.NumberOfHandles();
+    const size_t nZombies = workload.ZombieObjectAddrLookup().size();
+    std::wcout
+        << L"Synthetic workload: " << nHandles << L" handles, " << params.nProcesses << L" processes, "
+        << workload.TotalProcessCount() - params.nProcesses << L" zombie processes, owner skew " << params.ownerSkew
+        << L"; generated in " << std::fixed << std::setprecision(2) << generateMs << L" ms" << std::endl;
+
+    // Hash lookup of every handle
+    ZombieHandleMatchList_t hashMatches;
+    double hashMs = TimeHashLookup(workload, nIterations, hashMatches);
+
+    std::wcout
+        << L"Correlation: " << nHandles << L" handles, " << nZombies << L" zombie objects, " << hashMatches.size() << L" matches" << std::endl
+        << std::fixed << std::setprecision(2)
+        << L"  Hash lookup     " << std::setw(10) << hashMs << L" ms" << std::endl;
+
+    // Object type prefilter
+    ZombieHandleMatchList_t scalarMatches, avx2Matches;
+    double scalarMs = TimePrefilteredLookup(false, workload, nIterations, scalarMatches);
+    std::wcout
+        << L"Object type prefilter + hash lookup:" << std::endl
+        << L"  Scalar          " << std::setw(10) << scalarMs << L" ms  (speedup " << (scalarMs > 0 ? hashMs / scalarMs : 0) << L"x)" << std::endl;
+    bool bSame = SameMatches(hashMatches, scalarMatches);
+    if (Avx2Available())
+    {
+        double avx2Ms = TimePrefilteredLookup(true, workload, nIterations, avx2Matches);
+        std::wcout
+            << L"  AVX2            " << std::setw(10) << avx2Ms << L" ms  (speedup " << (avx2Ms > 0 ? hashMs / avx2Ms : 0) << L"x)" << std::endl;
+        bSame = bSame && SameMatches(hashMatches, avx2Matches);
+    }
+    else
+    {
+        std::wcout << L"  AVX2            not available" << std::endl;
+    }
+    if (!bSame)
+    {
+        std::wcerr << L"ERROR: prefiltered lookup produced different results" << std::endl;
+        return -1;
+    }
+
+    // Partitioned scan, doubling the number of workers up to nWorkers
+    std::wcout << L"Partitioned scan (hash lookup):" << std::endl;
+    double oneWorkerMs = 0;
+    for (size_t nScanWorkers = 1; ; nScanWorkers = (nScanWorkers * 2 < nWorkers) ? nScanWorkers * 2 : nWorkers)
+    {
+        ZombieHandleMatchList_t partitionedMatches;
+        double ms = TimePartitionedScan(nScanWorkers, workload, nIterations, partitionedMatches);
+        if (1 == nScanWorkers)
+            oneWorkerMs = ms;
+        std::wcout
+            << L"  " << std::setw(3) << nScanWorkers << L" workers     " << std::setw(10) << ms << L" ms"
+            << L"  (speedup " << (ms > 0 ? oneWorkerMs / ms : 0) << L"x)" << std::endl;
+        if (!SameMatches(hashMatches, partitionedMatches))
+        {
+            std::wcerr << L"ERROR: partitioned scan produced different results" << std::endl;
+            return -1;
+        }
+        if (nScanWorkers >= nWorkers)
+            break;
+    }
+
+    // Cost of handing work to the workers and waiting for them, as each scan phase and -watch sample pays it
+    const size_t nDispatches = 1000;
+    std::atomic<size_t> nDispatched(0);
+    const double dispatchMs = TimeBest(nIterations, [&]() {
+        for (size_t ixDispatch = 0; ixDispatch < nDispatches; ++ixDispatch)
+            RunPartitioned(nWorkers, nWorkers, [&](size_t, size_t, size_t) { nDispatched.fetch_add(1, std::memory_order_relaxed); });
+        });
+    std::wcout
+        << L"  Dispatch to " << std::setw(3) << nWorkers << L" workers " << std::setw(10) << dispatchMs * 1000 / nDispatches << L" us/call" << std::endl;
+
+    // Full correlation through ZombieOwners, from recorded zombie and handle information
+    ZombieOwners zombieOwners;
+    SyntheticZombieDataSource dataSource(workload);
+    bool bAnalyzed = true;
+    double analyzeMs = TimeBest(nIterations, [&]() { bAnalyzed = zombieOwners.Analyze(dataSource, sErrorInfo) && bAnalyzed; });
+    if (!bAnalyzed)
+    {
+        std::wcerr << L"ERROR: " << sErrorInfo << std::endl;
+        return -1;
+    }
+    std::wcout
+        << L"ZombieOwners::Analyze: " << zombieOwners.OwnersCollection().size() << L" owners, "
+        << zombieOwners.UnexplainedZombies().size() << L" zombie processes without owners" << std::endl
+        << L"  Correlate       " << std::setw(10) << analyzeMs << L" ms" << std::endl;
+
+    // Owner sorting
+    ZombieOwnersCollection_t syntheticOwners;
+    ZombieOwnersCollectionSorted_t shuffledOwners, sortedOwners;
+    MakeSyntheticOwners(nOwners, params.seed, syntheticOwners, shuffledOwners);
+    double sortMs = 0;
+    for (size_t iter = 0; iter < nIterations; ++iter)
+    {
+        // Sort a fresh copy of the shuffled order each time; the copy isn't timed
+        sortedOwners = shuffledOwners;
+        double ms = TimeBest(1, [&]() { std::sort(sortedOwners.begin(), sortedOwners.end(), &ZombieOwnerComparator); });
+        if (0 == iter || ms < sortMs)
+            sortMs = ms;
+    }
+    std::wcout
+        << L"ZombieOwnerComparator sort: " << nOwners << L" owners" << std::endl
+        << L"  std::sort       " << std::setw(10) << sortMs << L" ms" << std::endl;
+    // Selecting the top owners, as -top does; must match the start of the full sort.
+    const size_t topCounts[] = { 10, 100, 1000 };
+    for (size_t ixTop = 0; ixTop < sizeof(topCounts) / sizeof(topCounts[0]); ++ixTop)
+    {
+        const size_t nTop = topCounts[ixTop];
+        ZombieOwnersCollectionSorted_t topOwners;
+        double topMs = 0;
+        for (size_t iter = 0; iter < nIterations; ++iter)
+        {
+            topOwners = shuffledOwners;
+            double ms = TimeBest(1, [&]() { SortOwners(topOwners, nTop); });
+            if (0 == iter || ms < topMs)
+                topMs = ms;
+        }
+        std::wcout << L"  SortOwners, top " << std::left << std::setw(5) << nTop << std::right << std::setw(10) << topMs << L" ms" << std::endl;
+        if (topOwners.size() != (std::min)(nTop, sortedOwners.size()) || !std::equal(topOwners.begin(), topOwners.end(), sortedOwners.begin()))
+        {
+            std::wcerr << L"ERROR: SortOwners selected different top owners than the full sort" << std::endl;
+            return -1;
+        }
+    }
+
+    // Owner aggregation: grouping handles to zombies by owning PID across workers, with one owner holding most of them.
+    std::vector<ULONG_PTR> owningPids;
+    MakeOwningPids(nAggregationMatches, params.nProcesses, nHotOwnerPercent, params.seed, owningPids);
+    const size_t nAggregationPartitions = PartitionCount(owningPids.size(), nWorkers, 1);
+    AggregatedOwners_t lockedOwners, perWorkerOwners, tableOwners;
+    ConcurrentPidTable ownerTable;
+    const double lockedMs = TimeBest(nIterations, [&]() { AggregateOwnersLocked(owningPids, nAggregationPartitions, lockedOwners); });
+    const double perWorkerMs = TimeBest(nIterations, [&]() { AggregateOwnersPerWorker(owningPids, nAggregationPartitions, perWorkerOwners); });
+    const double tableMs = TimeBest(nIterations, [&]() { AggregateOwnersConcurrentTable(owningPids, params.nProcesses + 1, nAggregationPartitions, ownerTable, tableOwners); });
+    std::wcout
+        << L"Owner aggregation: " << owningPids.size() << L" handles, " << tableOwners.size() << L" owners, "
+        << nHotOwnerPercent << L"% held by one; " << nAggregationPartitions << L" workers" << std::endl
+        << L"  Shared map, locked " << std::setw(10) << lockedMs << L" ms" << std::endl
+        << L"  Map per worker     " << std::setw(10) << perWorkerMs << L" ms" << std::endl
+        << L"  ConcurrentPidTable " << std::setw(10) << tableMs << L" ms" << std::endl;
+    if (perWorkerOwners != tableOwners || !SameOwners(lockedOwners, tableOwners))
+    {
+        std::wcerr << L"ERROR: Owner aggregation methods produced different results" << std::endl;
+        return -1;
+    }
+
+    // String formatting, in nanoseconds per call. Accumulating result lengths keeps the calls from being optimized away.
+    size_t nChars = 0;
+    const ULONGLONG ullCaptureTime = workload.CaptureTime();
+    double hexwMs = TimeBest(nIterations, [&]() {
+        for (size_t ix = 0; ix < nCalls; ++ix)
+            nChars += HEXW(ULONG_PTR(ix * 4)).size();
+        });
+    double hexaMs = TimeBest(nIterations, [&]() {
+        for (size_t ix = 0; ix < nCalls; ++ix)
+            nChars += HEXA(ULONG_PTR(ix * 4)).size();
+        });
+    double fileTimeMs = TimeBest(nIterations, [&]() {
+        for (size_t ix = 0; ix < nCalls; ++ix)
+        {
+            // Successive calls one second apart
+            ULONGLONG ullFileTime = ullCaptureTime - ULONGLONG(ix) * 10000000;
+            nChars += FileTimeToWString(*(const FILETIME*)&ullFileTime, true).size();
+        }
+        });
+    double agoMs = TimeBest(nIterations, [&]() {
+        for (size_t ix = 0; ix < nCalls; ++ix)
+            nChars += Ago(ULONGLONG(ix) * 37).size();
+        });
+    // The same formatting into a Utf8Writer buffer, with no target so that only the formatting is measured
+    Utf8Writer formatWriter;
+    double writeHexMs = TimeBest(nIterations, [&]() {
+        for (size_t ix = 0; ix < nCalls; ++ix)
+            formatWriter.WriteHex(ULONG_PTR(ix * 4), sizeof(ULONG_PTR) * 2);
+        });
+    double writeFileTimeMs = TimeBest(nIterations, [&]() {
+        for (size_t ix = 0; ix < nCalls; ++ix)
+        {
+            ULONGLONG ullFileTime = ullCaptureTime - ULONGLONG(ix) * 10000000;
+            formatWriter.WriteFileTime(*(const FILETIME*)&ullFileTime, true);
+        }
+        });
+    double writeAgoMs = TimeBest(nIterations, [&]() {
+        for (size_t ix = 0; ix < nCalls; ++ix)
+            formatWriter.WriteAgo(ULONGLONG(ix) * 37);
+        });
+    const double nsPerCallPerMs = 1000000.0 / double(nCalls);
+    std::wcout
+        << L"Formatting: " << nCalls << L" calls each (" << nChars << L" characters; " << formatWriter.BytesWritten() << L" bytes written by Utf8Writer)" << std::endl
+        << L"  HEXW            " << std::setw(10) << hexwMs * nsPerCallPerMs << L" ns/call" << std::endl
+        << L"  HEXA            " << std::setw(10) << hexaMs * nsPerCallPerMs << L" ns/call" << std::endl
+        << L"  FileTimeToWString" << std::setw(9) << fileTimeMs * nsPerCallPerMs << L" ns/call" << std::endl
+        << L"  Ago             " << std::setw(10) << agoMs * nsPerCallPerMs << L" ns/call" << std::endl
+        << L"  Utf8Writer::WriteHex      " << std::setw(10) << writeHexMs * nsPerCallPerMs << L" ns/call" << std::endl
+        << L"  Utf8Writer::WriteFileTime " << std::setw(10) << writeFileTimeMs * nsPerCallPerMs << L" ns/call" << std::endl
+        << L"  Utf8Writer::WriteAgo      " << std::setw(10) << writeAgoMs * nsPerCallPerMs << L" ns/call" << std::endl;
+
+    // Output of the correlated workload, to memory so that console and disk speed aren't measured
+    typedef void (*OutputFn_t)(const ZombieOwners&, ULONGLONG, Utf8Writer*);
+    const struct { const wchar_t* szName; OutputFn_t pfn; } outputFunctions[] = {
+        { L"OutputSummary      ", &OutputSummary },
+        { L"OutputSummaryCsv   ", &OutputSummaryCsv },
+        { L"OutputSummaryJson  ", &OutputSummaryJson },
+        { L"OutputDetails      ", &OutputDetails },
+        { L"OutputDetailsCsv   ", &OutputDetailsCsv },
+        { L"OutputDetailsJson  ", &OutputDetailsJson },
+        { L"OutputResultsBinary", &OutputResultsBinary },
+    };
+    std::wcout << L"Output:" << std::endl;
+    for (size_t ixFn = 0; ixFn < sizeof(outputFunctions) / sizeof(outputFunctions[0]); ++ixFn)
+    {
+        ULONGLONG nOutputBytes = 0;
+        double ms = TimeBest(nIterations, [&]() {
+            Utf8Writer writer;
+            writer.OpenMemory();
+            outputFunctions[ixFn].pfn(zombieOwners, ullCaptureTime, &writer);
+            writer.Flush();
+            nOutputBytes = writer.MemoryContents().size();
+            });
+        std::wcout
+            << L"  " << outputFunctions[ixFn].szName << std::setw(10) << ms << L" ms  (" << nOutputBytes << L" bytes)" << std::endl;
+    }
+
+    // The whole pipeline, from process enumeration on, against an in-memory model of the workload, as -synthetic performs it.
+    // Repeated Update calls reuse the handle table buffer and the zombie process cache, as -watch does.
+    // (Last, because it replaces the PID to services information that the Analyze results above point into.)
+    InMemoryPlatform platform;
+    if (!platform.LoadWorkload(workload, sErrorInfo))
+    {
+        std::wcerr << L"ERROR: " << sErrorInfo << std::endl;
+        return -1;
+    }
+    ZombieOwners platformOwners;
+    platformOwners.SetPlatform(platform);
+    bool bUpdated = true;
+    double updateMs = TimeBest(nIterations, [&]() { bUpdated = platformOwners.Update(0, L"", sErrorInfo) && bUpdated; });
+    if (!bUpdated)
+    {
+        std::wcerr << L"ERROR: " << sErrorInfo << std::endl;
+        return -1;
+    }
+    // The same, finding this process' own zombie handles in a separate pass over the handle table
+    ZombieOwners twoPassOwners;
+    twoPassOwners.SetPlatform(platform);
+    twoPassOwners.SetSinglePassScan(false);
+    const double twoPassUpdateMs = TimeBest(nIterations, [&]() { bUpdated = twoPassOwners.Update(0, L"", sErrorInfo) && bUpdated; });
+    if (!bUpdated)
+    {
+        std::wcerr << L"ERROR: " << sErrorInfo << std::endl;
+        return -1;
+    }
+    std::wcout
+        << L"ZombieOwners::Update on InMemoryPlatform: " << platform.ProcessCount() << L" processes, "
+        << platformOwners.OwnersCollection().size() << L" owners" << std::endl
+        << L"  Update          " << std::setw(10) << updateMs << L" ms" << std::endl
+        << L"  Update, 2 passes" << std::setw(10) << twoPassUpdateMs << L" ms" << std::endl
+        << L"  Owner/parent lookups in " << nIterations << L" updates: " << platformOwners.ProcessMetadata().Hits() + platformOwners.ProcessMetadata().Misses()
+        << L", image path queries: " << platformOwners.ProcessMetadata().Misses() << std::endl;
+    if (!SameResults(zombieOwners, platformOwners))
+    {
+        std::wcerr << L"ERROR: Update on the in-memory platform and Analyze produced different results" << std::endl;
+        return -1;
+    }
+    if (!SameResults(platformOwners, twoPassOwners))
+    {
+        std::wcerr << L"ERROR: Single-pass and two-pass Update produced different results" << std::endl;
+        return -1;
+    }
+
+    // The -threads report: process enumeration on one thread, thread inspection on a pool of workers, against an
+    // in-memory platform that spends a simulated kernel call time on each query. Output must not depend on the workers.
+    InMemoryPlatform threadsPlatform;
+    if (!BuildThreadReportPlatform(params.nProcesses, nThreadsPerProcess, threadsPlatform, sErrorInfo))
+    {
+        std::wcerr << L"ERROR: " << sErrorInfo << std::endl;
+        return -1;
+    }
+    threadsPlatform.SetCallCost(ULONG(nCallCostNs));
+    std::string sSerialReport, sParallelReport;
+    const double threadReportSerialMs = TimeBest(nIterations, [&]() {
+        Utf8Writer writer;
+        writer.OpenMemory();
+        FullThreadReport(threadsPlatform, &writer, 1);
+        writer.Flush();
+        sSerialReport = writer.MemoryContents();
+        });
+    const double threadReportParallelMs = TimeBest(nIterations, [&]() {
+        Utf8Writer writer;
+        writer.OpenMemory();
+        FullThreadReport(threadsPlatform, &writer, nWorkers);
+        writer.Flush();
+        sParallelReport = writer.MemoryContents();
+        });
+    std::wcout
+        << L"FullThreadReport on InMemoryPlatform: " << params.nProcesses << L" processes, about " << nThreadsPerProcess
+        << L" threads each, " << nCallCostNs << L" ns per query" << std::endl
+        << L"  1 worker        " << std::setw(10) << threadReportSerialMs << L" ms" << std::endl
+        << L"  " << std::setw(2) << nWorkers << L" workers      " << std::setw(10) << threadReportParallelMs << L" ms" << std::endl;
+    if (sSerialReport != sParallelReport)
+    {
+        std::wcerr << L"ERROR: FullThreadReport output depends on the number of workers" << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+#ifndef _WIN32
+/// <summary>
+/// Entry point where there's no wmain: converts the arguments from UTF-8.
+/// </summary>
+int main(int argc, char** argv)
+{
+    setlocale(LC_ALL, "");
+    std::vector<std::wstring> args;
+    std::vector<wchar_t*> argPointers;
+    // Arguments are decoded as UTF-8, the encoding of file names, whatever the locale (e.g., C under cron and systemd).
+    for (int ixArg = 0; ixArg < argc; ++ixArg)
+    {
+        std::wstring sArg;
+        if (!WideFromUtf8(argv[ixArg], strlen(argv[ixArg]), sArg))
+            Usage(L"Command-line arguments must be valid UTF-8");
+        args.push_back(sArg);
+    }
+    for (std::vector<std::wstring>::iterator iter = args.begin(); iter != args.end(); ++iter)
+        argPointers.push_back(&(*iter)[0]);
+    argPointers.push_back(nullptr);
+    return wmain(argc, argPointers.data());
+}
+#endif
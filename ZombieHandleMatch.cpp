@@ -0,0 +1,29 @@
+// Finding the entries in the systemwide handle table that reference zombie process/thread objects.
+
+#include "ZombieHandleMatch.h"
+
+/// <summary>
+/// Finds all handle table entries that reference objects in the zombie object address lookup.
+/// </summary>
+void FindZombieHandleMatches(
+    const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries,
+    ULONG_PTR nEntries,
+    const ZombieObjectAddrLookup_t& zombieObjectAddrLookup,
+    ZombieHandleMatchList_t& matches,
+    const HandleIndexList_t* pCandidates)
+{
+    matches.clear();
+    const ULONG_PTR nExamine = (nullptr != pCandidates) ? pCandidates->size() : nEntries;
+    for (ULONG_PTR ixExamine = 0; ixExamine < nExamine; ++ixExamine)
+    {
+        const ULONG_PTR ix = (nullptr != pCandidates) ? (*pCandidates)[ixExamine] : ixExamine;
+        ZombieObjectAddrLookup_t::const_iterator iZombie = zombieObjectAddrLookup.find(pEntries[ix].Object);
+        if (iZombie != zombieObjectAddrLookup.end())
+        {
+            ZombieHandleMatch match;
+            match.ixHandle = ix;
+            match.ixZombie = iZombie->second;
+            matches.push_back(match);
+        }
+    }
+}
@@ -0,0 +1,43 @@
+// Finding the entries in the systemwide handle table that reference zombie process/thread objects.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <vector>
+#include "NtInternal.h"
+#include "ZombieProcessThreadInfo.h"
+#include "ObjectTypeFilter.h"
+
+/// <summary>
+/// A handle table entry that references a zombie process or thread object.
+/// </summary>
+struct ZombieHandleMatch
+{
+    /// <summary>
+    /// Index of the entry in the handle table
+    /// </summary>
+    ULONG_PTR ixHandle = 0;
+    /// <summary>
+    /// Record index of the referenced zombie process/thread (from the object address lookup)
+    /// </summary>
+    ZombieRecordIndex_t ixZombie = 0;
+};
+/// <summary>
+/// Matches in ascending order of handle table index.
+/// </summary>
+typedef std::vector<ZombieHandleMatch> ZombieHandleMatchList_t;
+
+/// <summary>
+/// Finds all handle table entries that reference objects in the zombie object address lookup.
+/// </summary>
+/// <param name="pEntries">Input: handle table entries</param>
+/// <param name="nEntries">Input: number of handle table entries</param>
+/// <param name="zombieObjectAddrLookup">Input: kernel object addresses of zombie processes and threads</param>
+/// <param name="matches">Output: matching entries, in ascending order of handle table index</param>
+/// <param name="pCandidates">Input: optional; if not null, only these entries (e.g., from FilterHandlesByObjectType) are examined</param>
+void FindZombieHandleMatches(
+    const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX* pEntries,
+    ULONG_PTR nEntries,
+    const ZombieObjectAddrLookup_t& zombieObjectAddrLookup,
+    ZombieHandleMatchList_t& matches,
+    const HandleIndexList_t* pCandidates = nullptr);
@@ -1,33 +1,41 @@
 // Class to acquire information about and new handles to processes that have exited but are still represented in kernel memory.
 // Provides option to ignore recently-exited processes. (Give handle owners a little bit of time to release handles after process exit.)
 
-// Need to define WIN32_NO_STATUS temporarily when including both Windows.h and ntstatus.h
-#define WIN32_NO_STATUS
-#include <Windows.h>
-#undef WIN32_NO_STATUS
-#include <ntstatus.h>
+#include "PlatformTypes.h"
 #include <sstream>
 #include <fstream>
+#include <algorithm>
 #include "HEX.h"
 #include "SysErrorMessage.h"
 #include "UtilityFunctions.h"
 #include "FileOutput.h"
+#include "Utf8Writer.h"
 #include "StringUtils.h"
+#include "RunStats.h"
+#include "Platform.h"
 #include "ZombieHandles.h"
 
 /// <summary>
 /// Identify and acquire handles to processes still represented in kernel memory that exited more than nAgeInSeconds ago,
 /// as well as to any still-existing threads in those processes, and get information about those processes.
-/// Fills in a handle-based lookup collection, and a PID-based lookup collection provided by the caller.
+/// Fills in a record store and a PID-based lookup provided by the caller, and a handle-based lookup.
 /// </summary>
+/// <param name="platform">Input: the system to enumerate; it must outlive this instance's handles</param>
 /// <param name="nAgeInSeconds">Input: minimum number of seconds ago that a process has exited to capture its information.</param>
-/// <param name="zombiePidLookup">Output: lookup structure based on PID (that caller can modify as needed)</param>
+/// <param name="zombieRecords">Output: information about the zombie processes/threads; must outlive this instance's use of it</param>
+/// <param name="imagePaths">Input/output: table that the records' image paths are interned in; must outlive this instance's use of it</param>
+/// <param name="zombiePidLookup">Output: lookup structure based on PID, of indexes into zombieRecords</param>
 /// <param name="processEnumErrors">Output: information about any problems during process enumeration (separate from complete failure)</param>
 /// <param name="sErrorInfo">Output: information about any failures</param>
+/// <param name="pCache">Input/output: optional cache of zombie process information from previous calls</param>
+/// <param name="pMetadataCache">Input/output: optional cache of running process information, for parent lookups</param>
 /// <returns>true if successful</returns>
-bool ZombieHandles::AcquireNewHandlesToExistingZombies(ULONGLONG nAgeInSeconds, ZombiePidLookup_t& zombiePidLookup, ProcessEnumErrorInfoList_t& processEnumErrors, std::wstring& sErrorInfo)
+bool ZombieHandles::AcquireNewHandlesToExistingZombies(Platform& platform, ULONGLONG nAgeInSeconds, ZombieRecordStore_t& zombieRecords, ImagePathTable& imagePaths, ZombiePidLookup_t& zombiePidLookup, ProcessEnumErrorInfoList_t& processEnumErrors, std::wstring& sErrorInfo, ZombieProcessCache* pCache, ProcessMetadataCache* pMetadataCache)
 {
+    StatsPhaseTimer phaseTimer(StatsPhase_t::ProcessEnumeration);
+
     // Initialize output variables
+    zombieRecords.clear();
     zombiePidLookup.clear();
     processEnumErrors.clear();
     sErrorInfo.clear();
@@ -35,61 +43,44 @@ bool ZombieHandles::AcquireNewHandlesToExistingZombies(ULONGLONG nAgeInSeconds,
     m_nZombieProcesses = 0;
     m_nTotalProcesses = 0;
     ReleaseAcquiredHandles();
-
-    // Acquire pointers to ntdll interfaces
-    HMODULE ntdll = GetModuleHandleW(L"ntdll.dll");
-    if (nullptr == ntdll)
-    {
-        sErrorInfo = L"Couldn't get module ntdll.dll";
-        return false;
-    }
-    pfn_NtGetNextProcess_t NtGetNextProcess = (pfn_NtGetNextProcess_t)GetProcAddress(ntdll, "NtGetNextProcess");
-    pfn_NtGetNextThread_t NtGetNextThread = (pfn_NtGetNextThread_t)GetProcAddress(ntdll, "NtGetNextThread");
-    pfn_NtQueryInformationProcess_t NtQueryInformationProcess = (pfn_NtQueryInformationProcess_t)GetProcAddress(ntdll, "NtQueryInformationProcess");
-    if (NtGetNextProcess == nullptr || NtGetNextThread == nullptr || NtQueryInformationProcess == nullptr)
-    {
-        sErrorInfo = L"ERROR: Unable to load functions from ntdll.dll";
-        return false;
-    }
+    m_pPlatform = &platform;
+    m_pZombieRecords = &zombieRecords;
+    m_pImagePaths = &imagePaths;
+    m_dwHandleOwnerPID = platform.CurrentProcessId();
+    ProcessEnumerator& processes = platform.Processes();
+    ThreadEnumerator& threads = platform.Threads();
 
     // Get the current time (used to determine how long ago each process exited.
-    // Note that FILETIME and ULONGLONG are somewhat interchangeable here.
-    ULONGLONG ulNow = 0;
-    GetSystemTimeAsFileTime((LPFILETIME)&ulNow);
+    const ULONGLONG ulNow = platform.Clock().Now();
 
-    // Use NtGetNextProcess to iterate through all processes including those that have exited.
+    // Iterate through all processes including those that have exited.
     // Each call opens a new handle to the identified process.
     // Close handles that we don't need as soon as we can - after using it to get the next process.
-    // Need to use PROCESS_QUERY_LIMITED_INFORMATION for the enumeration to include protected processes and other interesting processes.
-    // Using MAXIMUM_ALLOWED, or MAXIMUM_ALLOWED|PROCESS_QUERY_LIMITED_INFORMATION doesn't work. There's a never-going-to-be-fixed bug
-    // in Windows where trying to open a process with MAXIMUM_ALLOWED doesn't work if PROCESS_QUERY_LIMITED_INFORMATION is the only
-    // allowed permission - it needs to be requested explicitly.
-    // Note that NtGetNextThread requires a process handle with PROCESS_QUERY_INFORMATION, so we'll need to open a new process
-    // handle at that point.
     HANDLE hPrevProcess = nullptr, hThisProcess = nullptr;
     bool bClosePrevProcess = false;
+    // For -stats: zombie threads enumerated; tallied locally and recorded once at the end.
+    ULONGLONG nThreadsEnumerated = 0;
+    // Image paths as queried, before they're interned
+    std::wstring sImagePath;
+    if (nullptr != pCache)
+        pCache->BeginPass();
     NTSTATUS ntGNP;
-    while (STATUS_SUCCESS == (ntGNP = NtGetNextProcess(hPrevProcess, PROCESS_QUERY_LIMITED_INFORMATION, 0, 0, &hThisProcess)))
+    while (STATUS_SUCCESS == (ntGNP = processes.GetNextProcess(hPrevProcess, false, hThisProcess)))
     {
         // Close handles that we don't need to hold as soon as we can - we might otherwise end up with a ton of open handles.
         // Can't close the hThisProcess handle until after we get the next process.
         if (bClosePrevProcess && nullptr != hPrevProcess)
         {
-            CloseHandle(hPrevProcess);
+            platform.ReleaseHandle(hPrevProcess);
         }
 
         m_nTotalProcesses++;
 
         // Determine whether the process has exited and did so more than nAgeInSeconds ago.
         // If so, acquire information about that process
-        PROCESS_EXTENDED_BASIC_INFORMATION processExtBasicInfo = { 0 };
-        processExtBasicInfo.Size = sizeof(processExtBasicInfo);
-        ULONG infoLen = ULONG(sizeof(processExtBasicInfo));
+        PlatformProcessBasicInfo basicInfo;
         bClosePrevProcess = true;
-#pragma warning(push)
-#pragma warning(disable:6001) // False positive: "Using uninitialized memory '*hThisProcess'"
-        NTSTATUS ntStat = NtQueryInformationProcess(hThisProcess, ProcessBasicInformation, &processExtBasicInfo, infoLen, &infoLen);
-#pragma warning(pop)
+        NTSTATUS ntStat = processes.QueryBasicInformation(hThisProcess, basicInfo);
         if (STATUS_SUCCESS != ntStat)
         {
             std::wstringstream strErr;
@@ -101,15 +92,14 @@ bool ZombieHandles::AcquireNewHandlesToExistingZombies(ULONGLONG nAgeInSeconds,
             //TODO: See whether there are processes with non-zero exit times where IsProcessDeleting is not set.
             // The IsProcessDeleting flag is supposed to have been set when the process has exited.
             // If it's not set then we don't care about this process.
-            if (processExtBasicInfo.IsProcessDeleting)
+            if (basicInfo.bDeleting)
             {
                 ZombieProcessThreadInfo zombieInfo = { 0 };
 
                 // Get process exit time: 
                 // * verify that the process has in fact exited (I've seen instances where IsProcessDeleting is set but the process is still running)
                 // * ignore processes with very recent exit times - give handle holders a chance to release handles after process exit
-                FILETIME unused1, unused2;
-                GetProcessTimes(hThisProcess, &zombieInfo.createTime, &zombieInfo.exitTime, &unused1, &unused2);
+                processes.GetTimes(hThisProcess, zombieInfo.createTime, zombieInfo.exitTime);
 
                 // View the exit time as a ULONGLONG. It will be 0 if the process has not exited.
                 // Note: FILETIME, ULARGE_INTEGER, and ULONGLONG are all 8 bytes, and lay out the same way.
@@ -128,44 +118,60 @@ bool ZombieHandles::AcquireNewHandlesToExistingZombies(ULONGLONG nAgeInSeconds,
                         m_nZombieProcesses++;
 
                         // Process ID and Parent Process ID
-                        zombieInfo.PID = processExtBasicInfo.BasicInfo.UniqueProcessId;
-                        zombieInfo.ParentPID = processExtBasicInfo.BasicInfo.InheritedFromUniqueProcessId;
-
-                        // Get the parent image path if it's still running
-                        GetParentProcessImagePathIfStillRunning(zombieInfo.ParentPID, zombieInfo.createTime, zombieInfo.sParentImagePath);
-
-                        // Get the zombie process' image path. Need to use NtQueryInformationProcess because Win32 API won't work for
-                        // a process that has exited.
-                        // Buffer should be large enough - add extra for the UNICODE_STRING overhead.
-                        byte buffer[MAX_PATH * 2 + sizeof(UNICODE_STRING)] = { 0 };
-                        ULONG returnLength = 0;
-                        ntStat = NtQueryInformationProcess(hThisProcess, ProcessImageFileName, buffer, MAX_PATH * 2, &returnLength);
-                        if (STATUS_SUCCESS == ntStat)
+                        zombieInfo.PID = basicInfo.PID;
+                        zombieInfo.ParentPID = basicInfo.ParentPID;
+
+                        // If this zombie was seen in a previous pass, reuse what was learned about it then.
+                        const ULONGLONG& ulCreateTime = (*(const ULONGLONG*)&zombieInfo.createTime);
+                        ZombieProcessCacheEntry* pCached = (nullptr != pCache) ? pCache->Find(zombieInfo.PID, ulCreateTime) : nullptr;
+                        if (nullptr != pCached)
+                        {
+                            // (The cached paths may be from the previous generation of the table.)
+                            zombieInfo.imagePathId = pCached->imagePathId = imagePaths.Renew(pCached->imagePathId);
+                            zombieInfo.parentImagePathId = pCached->parentImagePathId = imagePaths.Renew(pCached->parentImagePathId);
+                        }
+                        else
                         {
-                            zombieInfo.sImagePath = ((UNICODE_STRING*)buffer)->Buffer;
+                            const ULONGLONG ullInfoStart = StatsTimestamp();
+
+                            // Get the parent image path if it's still running. (Many zombies often share a parent.)
+                            if (nullptr != pMetadataCache)
+                                pMetadataCache->GetParentProcessImagePathIfStillRunning(zombieInfo.ParentPID, zombieInfo.createTime, sImagePath);
+                            else
+                                processes.GetParentProcessImagePathIfStillRunning(zombieInfo.ParentPID, zombieInfo.createTime, sImagePath);
+                            zombieInfo.parentImagePathId = imagePaths.Intern(sImagePath);
+
+                            // Get the zombie process' image path (through its handle, which works for a process that has exited).
+                            processes.QueryImageFileName(hThisProcess, sImagePath);
+                            zombieInfo.imagePathId = imagePaths.Intern(sImagePath);
+                            StatsAddTime(StatsPhase_t::ZombieInfoQueries, ullInfoStart);
                         }
 
                         // If this process still has any existing threads, get handles to those threads and add them to the lookup.
                         // Note that we don't need to close any of these handles during this loop because we're adding all of them
                         // to our collection.
                         // If we can't open the process for QueryInformation, we just won't be able to get that thread information.
+                        // (A zombie that had no threads left in a previous pass can't have any now.)
                         ULONG nThreads = 0;
-#pragma warning(push)
-#pragma warning(disable:4244) // Nt vs. Win32 API issue: 'argument': conversion from 'ULONG_PTR' to 'DWORD', possible loss of data
-                        HANDLE hProcessQI = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, zombieInfo.PID);
-#pragma warning(pop)
+                        HANDLE hProcessQI = nullptr;
+                        const ULONGLONG ullThreadsStart = StatsTimestamp();
+                        if (nullptr == pCached || pCached->nThreads > 0)
+                        {
+                            hProcessQI = threads.OpenProcessForThreads(zombieInfo.PID);
+                        }
                         if (nullptr != hProcessQI)
                         {
                             HANDLE hThread = nullptr;
                             NTSTATUS ntGNT;
-                            while (STATUS_SUCCESS == (ntGNT = NtGetNextThread(hProcessQI, hThread, THREAD_QUERY_LIMITED_INFORMATION, 0, 0, &hThread)))
+                            while (STATUS_SUCCESS == (ntGNT = threads.GetNextThread(hProcessQI, hThread, false, hThread)))
                             {
                                 nThreads++;
-                                zombieInfo.TID = GetThreadId(hThread);
-                                m_ZombieHandleLookup[hThread] = zombieInfo;
+                                zombieInfo.TID = threads.GetThreadId(hThread);
+                                m_ZombieHandleLookup[hThread] = ZombieRecordIndex_t(zombieRecords.size());
+                                zombieRecords.push_back(zombieInfo);
                             }
 
-                            CloseHandle(hProcessQI);
+                            platform.ReleaseHandle(hProcessQI);
 
                             //{
                             //    std::wstringstream sDebug;
@@ -174,11 +180,29 @@ bool ZombieHandles::AcquireNewHandlesToExistingZombies(ULONGLONG nAgeInSeconds,
                             //}
                         }
 
+                        nThreadsEnumerated += nThreads;
+                        StatsAddTime(StatsPhase_t::ThreadEnumeration, ullThreadsStart);
+
                         // Add the process handle and the process info to the lookup object.
                         zombieInfo.TID = 0;
                         zombieInfo.nThreads = nThreads;
-                        m_ZombieHandleLookup[hThisProcess] = zombieInfo;
-                        zombiePidLookup[zombieInfo.PID] = zombieInfo;
+                        if (nullptr != pCached)
+                        {
+                            pCached->nThreads = nThreads;
+                        }
+                        else if (nullptr != pCache)
+                        {
+                            ZombieProcessCacheEntry entry;
+                            entry.createTime = ulCreateTime;
+                            entry.imagePathId = zombieInfo.imagePathId;
+                            entry.parentImagePathId = zombieInfo.parentImagePathId;
+                            entry.nThreads = nThreads;
+                            pCache->Store(zombieInfo.PID, entry);
+                        }
+                        const ZombieRecordIndex_t ixRecord = ZombieRecordIndex_t(zombieRecords.size());
+                        zombieRecords.push_back(zombieInfo);
+                        m_ZombieHandleLookup[hThisProcess] = ixRecord;
+                        zombiePidLookup[zombieInfo.PID] = ixRecord;
                         // Do not close the current process handle on next loop through.
                         bClosePrevProcess = false;
                     }
@@ -186,7 +210,7 @@ bool ZombieHandles::AcquireNewHandlesToExistingZombies(ULONGLONG nAgeInSeconds,
                 else
                 {
                     // Diagnostics; not particularly needed. If uncommented, should go to sErrorInfo, not to stderr.
-                    // std::wcerr << L"IsProcessDeleting is set but there's no exit time: PID " << processExtBasicInfo.BasicInfo.UniqueProcessId << std::endl; // << L" " << zombieInfo.sImagePath << std::endl;
+                    // std::wcerr << L"IsProcessDeleting is set but there's no exit time: PID " << basicInfo.PID << std::endl; // << L" " << zombieInfo.sImagePath << std::endl;
                 }
             }
         }
@@ -198,9 +222,17 @@ bool ZombieHandles::AcquireNewHandlesToExistingZombies(ULONGLONG nAgeInSeconds,
     // Close the last process unless we saved it off
     if (bClosePrevProcess && nullptr != hPrevProcess)
     {
-        CloseHandle(hPrevProcess);
+        platform.ReleaseHandle(hPrevProcess);
     }
 
+    // Forget zombies that have been released since the previous pass.
+    if (nullptr != pCache)
+        pCache->EndPass();
+
+    StatsAddCount(StatsCounter_t::ProcessesEnumerated, m_nTotalProcesses);
+    StatsAddCount(StatsCounter_t::ZombieProcesses, m_nZombieProcesses);
+    StatsAddCount(StatsCounter_t::ThreadsEnumerated, nThreadsEnumerated);
+
     // Report if terminating NTSTATUS value is other than 0x8000001a STATUS_NO_MORE_ENTRIES
     if (STATUS_NO_MORE_ENTRIES != ntGNP)
     {
@@ -223,9 +255,48 @@ void ZombieHandles::ReleaseAcquiredHandles()
         ++iter
         )
     {
-        CloseHandle(iter->first);
+        if (!m_bRecorded && nullptr != m_pPlatform)
+            m_pPlatform->ReleaseHandle(iter->first);
     }
     m_ZombieHandleLookup.clear();
+    m_pZombieRecords = nullptr;
+    m_bRecorded = false;
+    m_pPlatform = nullptr;
+}
+
+/// <summary>
+/// Gets the object type indexes of the acquired handles (Process, and Thread if any zombie thread is referenced).
+/// </summary>
+/// <param name="typeIndexes">Output: the distinct object type indexes</param>
+/// <returns>true if successful</returns>
+bool ZombieHandles::GetObjectTypeIndexes(std::vector<USHORT>& typeIndexes) const
+{
+    typeIndexes.clear();
+    // Loaded handle values aren't valid in this process.
+    if (m_bRecorded || nullptr == m_pPlatform || nullptr == m_pZombieRecords)
+        return false;
+
+    // All handles to processes have the same type, as do all handles to threads, so one of each will do.
+    bool bProcessQueried = false, bThreadQueried = false;
+    for (
+        ZombieHandleLookup_t::const_iterator iter = m_ZombieHandleLookup.begin();
+        iter != m_ZombieHandleLookup.end() && !(bProcessQueried && bThreadQueried);
+        ++iter
+        )
+    {
+        // (A TID of 0 indicates a process.)
+        const bool bThread = (0 != (*m_pZombieRecords)[iter->second].TID);
+        bool& bQueried = bThread ? bThreadQueried : bProcessQueried;
+        if (bQueried)
+            continue;
+        bQueried = true;
+        USHORT typeIndex = 0;
+        if (!m_pPlatform->HandleTable().GetObjectTypeIndex(iter->first, typeIndex))
+            return false;
+        if (typeIndexes.end() == std::find(typeIndexes.begin(), typeIndexes.end(), typeIndex))
+            typeIndexes.push_back(typeIndex);
+    }
+    return true;
 }
 
 /// <summary>
@@ -237,18 +308,18 @@ void ZombieHandles::ReleaseAcquiredHandles()
 /// <returns>true if successful</returns>
 bool ZombieHandles::Dump(const wchar_t* szOutFile, bool bAppend, std::wstring& sErrorInfo) const
 {
-    // Output file stream, optionally appending
-    std::wofstream fs;
-    if (!CreateFileOutput(szOutFile, fs, bAppend))
+    // Output file, optionally appending
+    Utf8Writer writer;
+    if (!writer.OpenFile(szOutFile, bAppend, sErrorInfo))
     {
         std::wstringstream strErrorInfo;
-        strErrorInfo << L"ZombieHandles::Dump to " << szOutFile << L" fails";
+        strErrorInfo << L"ZombieHandles::Dump to " << szOutFile << L" fails: " << sErrorInfo;
         sErrorInfo = strErrorInfo.str();
         return false;
     }
     
     // Tab-delimited headers
-    fs
+    writer
         << L"ThisPID\t"
         << L"HandleValue\t"
         << L"PID\t"
@@ -258,31 +329,196 @@ bool ZombieHandles::Dump(const wchar_t* szOutFile, bool bAppend, std::wstring& s
         << L"createTime\t"
         << L"exitTime\t" 
         << L"PPID\t"
-        << L"ParentImagePath"
-        << std::endl;
+        << L"ParentImagePath\t"
+        << L"createTimeValue\t"
+        << L"exitTimeValue";
+    writer.EndLine();
 
-    DWORD dwThisPID = GetCurrentProcessId();
+    // Raw FILETIME values are appended so that LoadFromDump can reconstruct the exact times.
+    // Note: FILETIME, ULARGE_INTEGER, and ULONGLONG are all 8 bytes, and lay out the same way.
     for (
         ZombieHandleLookup_t::const_iterator iter = m_ZombieHandleLookup.begin();
         iter != m_ZombieHandleLookup.end();
         ++iter
         )
     {
-        const ZombieProcessThreadInfo& z = iter->second;
-        fs
-            << dwThisPID << L"\t"
-            << HEX(ULONG_PTR(iter->first), 8, false, true) << L"\t"
-            << z.PID << L"\t"
-            << z.TID << L"\t"
-            << z.nThreads << L"\t"
-            << z.sImagePath << L"\t"
-            << FileTimeToWString(z.createTime, false) << L"\t"
-            << FileTimeToWString(z.exitTime, false) << L"\t"
-            << z.ParentPID << L"\t"
-            << z.sParentImagePath
-            << std::endl;
+        const ZombieProcessThreadInfo& z = (*m_pZombieRecords)[iter->second];
+        writer << m_dwHandleOwnerPID << L'\t';
+        writer.WriteHex(ULONG_PTR(iter->first), 8, false, true)
+            << L'\t' << z.PID
+            << L'\t' << z.TID
+            << L'\t' << z.nThreads
+            << L'\t' << m_pImagePaths->Path(z.imagePathId)
+            << L'\t';
+        writer.WriteFileTime(z.createTime, false) << L'\t';
+        writer.WriteFileTime(z.exitTime, false)
+            << L'\t' << z.ParentPID
+            << L'\t' << m_pImagePaths->Path(z.parentImagePathId)
+            << L'\t' << (*(const ULONGLONG*)&z.createTime)
+            << L'\t' << (*(const ULONGLONG*)&z.exitTime);
+        writer.EndLine();
+    }
+
+    if (!writer.Close())
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"ZombieHandles::Dump to " << szOutFile << L" fails: write error";
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Offline analysis: replaces any acquired information with information previously written to a tab-delimited file by Dump.
+/// The handle values in the resulting lookup are those recorded in the file; they are not valid in the current process,
+/// and are never closed.
+/// </summary>
+/// <param name="szInFile">Input: full path to input file</param>
+/// <param name="zombieRecords">Output: information about the zombie processes/threads; must outlive this instance's use of it</param>
+/// <param name="imagePaths">Input/output: table that the records' image paths are interned in; must outlive this instance's use of it</param>
+/// <param name="zombiePidLookup">Output: lookup structure based on PID, of indexes into zombieRecords</param>
+/// <param name="sErrorInfo">Output: Information about any errors on failure</param>
+/// <returns>true if successful</returns>
+bool ZombieHandles::LoadFromDump(const wchar_t* szInFile, ZombieRecordStore_t& zombieRecords, ImagePathTable& imagePaths, ZombiePidLookup_t& zombiePidLookup, std::wstring& sErrorInfo)
+{
+    // Initialize output variables
+    zombieRecords.clear();
+    zombiePidLookup.clear();
+    sErrorInfo.clear();
+    // Initialize internal data
+    m_nZombieProcesses = 0;
+    m_nTotalProcesses = 0;
+    m_dwHandleOwnerPID = 0;
+    ReleaseAcquiredHandles();
+    m_bRecorded = true;
+    m_pZombieRecords = &zombieRecords;
+    m_pImagePaths = &imagePaths;
+
+    std::wifstream fs;
+    if (!OpenFileInput(szInFile, fs))
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"ZombieHandles::LoadFromDump from " << szInFile << L" fails";
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    // Fields, as written by Dump:
+    // ThisPID, HandleValue, PID, TID, nThreads, ImagePath, createTime, exitTime, PPID, ParentImagePath, createTimeValue, exitTimeValue
+    // Files written before the raw time values were added end at ParentImagePath; their times are read from the
+    // text columns, which have only whole seconds.
+    const size_t nFieldsWithoutRawTimes = 10;
+    const size_t nFieldsWithRawTimes = 12;
+    size_t nFields = nFieldsWithRawTimes;
+    std::wstring sLine;
+    std::vector<std::wstring> fields;
+    size_t nLine = 0;
+    while (std::getline(fs, sLine))
+    {
+        if (EndsWith(sLine, L'\r'))
+            sLine.pop_back();
+        SplitStringToVector(sLine, L'\t', fields);
+        // Header line: see whether the file includes the raw time values
+        if (0 == nLine++)
+        {
+            if (fields.size() < nFieldsWithoutRawTimes)
+            {
+                std::wstringstream strErrorInfo;
+                strErrorInfo << L"ZombieHandles::LoadFromDump: " << szInFile << L" does not have the expected fields";
+                sErrorInfo = strErrorInfo.str();
+                return false;
+            }
+            if (fields.size() < nFieldsWithRawTimes)
+                nFields = nFieldsWithoutRawTimes;
+            continue;
+        }
+        if (fields.size() < nFields)
+            continue;
+
+        ZombieProcessThreadInfo zombieInfo;
+        m_dwHandleOwnerPID = DWORD(wcstoul(fields[0].c_str(), nullptr, 10));
+        HANDLE hRecorded = HANDLE(ULONG_PTR(wcstoull(fields[1].c_str(), nullptr, 16)));
+        zombieInfo.PID = ULONG_PTR(wcstoull(fields[2].c_str(), nullptr, 10));
+        zombieInfo.TID = DWORD(wcstoul(fields[3].c_str(), nullptr, 10));
+        zombieInfo.nThreads = ULONG(wcstoul(fields[4].c_str(), nullptr, 10));
+        zombieInfo.imagePathId = imagePaths.Intern(fields[5]);
+        zombieInfo.ParentPID = ULONG_PTR(wcstoull(fields[8].c_str(), nullptr, 10));
+        zombieInfo.parentImagePathId = imagePaths.Intern(fields[9]);
+        if (nFieldsWithRawTimes == nFields)
+        {
+            *(ULONGLONG*)&zombieInfo.createTime = wcstoull(fields[10].c_str(), nullptr, 10);
+            *(ULONGLONG*)&zombieInfo.exitTime = wcstoull(fields[11].c_str(), nullptr, 10);
+        }
+        else if (!WStringToFileTime(fields[6], false, zombieInfo.createTime) || !WStringToFileTime(fields[7], false, zombieInfo.exitTime))
+        {
+            std::wstringstream strErrorInfo;
+            strErrorInfo << L"ZombieHandles::LoadFromDump: " << szInFile << L" line " << nLine << L" has an invalid time";
+            sErrorInfo = strErrorInfo.str();
+            return false;
+        }
+
+        const ZombieRecordIndex_t ixRecord = ZombieRecordIndex_t(zombieRecords.size());
+        zombieRecords.push_back(zombieInfo);
+        m_ZombieHandleLookup[hRecorded] = ixRecord;
+        // Process entries (TID 0) also go into the PID-based lookup
+        if (0 == zombieInfo.TID)
+        {
+            m_nZombieProcesses++;
+            zombiePidLookup[zombieInfo.PID] = ixRecord;
+        }
     }
     fs.close();
 
     return true;
 }
+
+/// <summary>
+/// Offline analysis and benchmarking: replaces any acquired information with information supplied by the caller
+/// (e.g., a synthetic workload). As with LoadFromDump, the handle values are not valid in the current process,
+/// and are never closed.
+/// </summary>
+/// <param name="records">Input: information about the zombie processes/threads</param>
+/// <param name="recordImagePaths">Input: table that the records' image paths are interned in</param>
+/// <param name="zombieHandleLookup">Input: handle values held by dwHandleOwnerPID, mapped to the indexes in records of the zombie processes/threads they reference</param>
+/// <param name="dwHandleOwnerPID">Input: process ID of the process that holds those handles</param>
+/// <param name="nTotalProcesses">Input: total number of processes, including those that have exited</param>
+/// <param name="zombieRecords">Output: copy of records; must outlive this instance's use of it</param>
+/// <param name="imagePaths">Input/output: table that the copies' image paths are interned in; must outlive this instance's use of it</param>
+/// <param name="zombiePidLookup">Output: lookup structure based on PID, of indexes into zombieRecords</param>
+void ZombieHandles::LoadFromData(const ZombieRecordStore_t& records, const ImagePathTable& recordImagePaths, const ZombieHandleLookup_t& zombieHandleLookup, DWORD dwHandleOwnerPID, size_t nTotalProcesses, ZombieRecordStore_t& zombieRecords, ImagePathTable& imagePaths, ZombiePidLookup_t& zombiePidLookup)
+{
+    // Initialize output variables
+    zombieRecords = records;
+    for (ZombieRecordStore_t::iterator iter = zombieRecords.begin(); iter != zombieRecords.end(); ++iter)
+    {
+        iter->imagePathId = imagePaths.Intern(recordImagePaths.Path(iter->imagePathId));
+        iter->parentImagePathId = imagePaths.Intern(recordImagePaths.Path(iter->parentImagePathId));
+    }
+    zombiePidLookup.clear();
+    // Initialize internal data
+    ReleaseAcquiredHandles();
+    m_bRecorded = true;
+    m_ZombieHandleLookup = zombieHandleLookup;
+    m_pZombieRecords = &zombieRecords;
+    m_pImagePaths = &imagePaths;
+    m_dwHandleOwnerPID = dwHandleOwnerPID;
+    m_nTotalProcesses = nTotalProcesses;
+    m_nZombieProcesses = 0;
+
+    // Process entries (TID 0) also go into the PID-based lookup
+    for (
+        ZombieHandleLookup_t::const_iterator iter = m_ZombieHandleLookup.begin();
+        iter != m_ZombieHandleLookup.end();
+        ++iter
+        )
+    {
+        const ZombieProcessThreadInfo& zombieInfo = zombieRecords[iter->second];
+        if (0 == zombieInfo.TID)
+        {
+            m_nZombieProcesses++;
+            zombiePidLookup[zombieInfo.PID] = iter->second;
+        }
+    }
+}
@@ -3,15 +3,20 @@
 
 #pragma once
 
-#include <Windows.h>
+#include "PlatformTypes.h"
 #include "NtInternal.h"
 #include "ZombieProcessThreadInfo.h"
+#include "ZombieProcessCache.h"
+#include "ProcessMetadataCache.h"
+
+class Platform;
 
 /// <summary>
 /// Class to acquire information about and handles to processes that have exited but are still represented in kernel memory.
 /// Also gets handles to any still-existing threads in those processes.
 /// Provides option to ignore recently-exited processes. (Give handle owners a little bit of time to release handles after process exit.)
-/// Fills two lookup structures: one based on handle values, and one based on PID (provided by caller).
+/// Fills a store of information about the zombie processes/threads and two lookups of indexes into it: one based on
+/// handle values, and one based on PID. The store and the PID-based lookup are provided by the caller.
 /// </summary>
 class ZombieHandles
 {
@@ -26,17 +31,27 @@ public:
     /// <summary>
     /// Identify and acquire handles to processes still represented in kernel memory that exited more than nAgeInSeconds ago,
     /// as well as to any still-existing threads in those processes, and get information about those processes.
-    /// Fills in a handle-based lookup collection, and a PID-based lookup collection provided by the caller.
+    /// Fills in a record store and a PID-based lookup provided by the caller, and a handle-based lookup.
     /// </summary>
+    /// <param name="platform">Input: the system to enumerate; it must outlive this instance's handles</param>
     /// <param name="nAgeInSeconds">Input: minimum number of seconds ago that a process has exited to capture its information.</param>
-    /// <param name="zombiePidLookup">Output: lookup structure based on PID (that caller can modify as needed)</param>
+    /// <param name="zombieRecords">Output: information about the zombie processes/threads; must outlive this instance's use of it</param>
+    /// <param name="imagePaths">Input/output: table that the records' image paths are interned in; must outlive this instance's use of it</param>
+    /// <param name="zombiePidLookup">Output: lookup structure based on PID, of indexes into zombieRecords</param>
     /// <param name="processEnumErrors">Output: information about any problems during process enumeration (separate from complete failure)</param>
     /// <param name="sErrorInfo">Output: information about any failures</param>
+    /// <param name="pCache">Input/output: optional cache of zombie process information from previous calls. Zombies found in the
+    /// cache skip the image path, parent, and (if they had none left) thread queries; new zombies are added to it.
+    /// Its image paths must be from the current or the previous generation of imagePaths; they're renewed into the current one.
+    /// Handles are still acquired anew on every call.</param>
+    /// <param name="pMetadataCache">Input/output: optional cache of running process information, through which new zombies'
+    /// parents are looked up, so that a parent of many zombies is queried once. The caller begins and ends its pass.</param>
     /// <returns>true if successful</returns>
-    bool AcquireNewHandlesToExistingZombies(ULONGLONG nAgeInSeconds, ZombiePidLookup_t& zombiePidLookup, ProcessEnumErrorInfoList_t& processEnumErrors, std::wstring& sErrorInfo);
+    bool AcquireNewHandlesToExistingZombies(Platform& platform, ULONGLONG nAgeInSeconds, ZombieRecordStore_t& zombieRecords, ImagePathTable& imagePaths, ZombiePidLookup_t& zombiePidLookup, ProcessEnumErrorInfoList_t& processEnumErrors, std::wstring& sErrorInfo, ZombieProcessCache* pCache = nullptr, ProcessMetadataCache* pMetadataCache = nullptr);
 
     /// <summary>
-    /// Returns a lookup object that maps handle values in the current process to information about zombie processes/threads.
+    /// Returns a lookup object that maps handle values in the current process to information about zombie processes/threads
+    /// (indexes into the record store filled by the last call that loaded or acquired them).
     /// </summary>
     const ZombieHandleLookup_t& ZombieHandleLookup() const { return m_ZombieHandleLookup; }
 
@@ -50,6 +65,20 @@ public:
     /// </summary>
     size_t TotalProcessCount() const { return m_nTotalProcesses; }
 
+    /// <summary>
+    /// Process ID of the process that holds the handles in the handle-based lookup.
+    /// This is the platform's current process, unless the information was loaded with LoadFromDump or LoadFromData.
+    /// </summary>
+    DWORD HandleOwnerPID() const { return m_dwHandleOwnerPID; }
+
+    /// <summary>
+    /// Gets the object type indexes, as the systemwide handle table reports them, of the acquired handles: the Process
+    /// type, and the Thread type if any zombie thread is referenced. Asks the platform about one handle of each kind.
+    /// </summary>
+    /// <param name="typeIndexes">Output: the distinct object type indexes</param>
+    /// <returns>true if successful; false if the handles were loaded rather than acquired, or the platform can't tell</returns>
+    bool GetObjectTypeIndexes(std::vector<USHORT>& typeIndexes) const;
+
     /// <summary>
     /// Diagnostic dump; writes information acquired by last AcquireNewHandlesToExistingZombies call to a tab-delimited file
     /// </summary>
@@ -59,6 +88,35 @@ public:
     /// <returns>true if successful</returns>
     bool Dump(const wchar_t* szOutFile, bool bAppend, std::wstring& sErrorInfo) const;
 
+    /// <summary>
+    /// Offline analysis: replaces any acquired information with information previously written to a tab-delimited file by Dump.
+    /// The handle values in the resulting lookup are those recorded in the file; they are not valid in the current process,
+    /// and are never closed. Files written before Dump recorded the raw time values are accepted; their times are read
+    /// from the text columns, to the second.
+    /// </summary>
+    /// <param name="szInFile">Input: full path to input file</param>
+    /// <param name="zombieRecords">Output: information about the zombie processes/threads; must outlive this instance's use of it</param>
+    /// <param name="imagePaths">Input/output: table that the records' image paths are interned in; must outlive this instance's use of it</param>
+    /// <param name="zombiePidLookup">Output: lookup structure based on PID, of indexes into zombieRecords</param>
+    /// <param name="sErrorInfo">Output: Information about any errors on failure</param>
+    /// <returns>true if successful</returns>
+    bool LoadFromDump(const wchar_t* szInFile, ZombieRecordStore_t& zombieRecords, ImagePathTable& imagePaths, ZombiePidLookup_t& zombiePidLookup, std::wstring& sErrorInfo);
+
+    /// <summary>
+    /// Offline analysis and benchmarking: replaces any acquired information with information supplied by the caller
+    /// (e.g., a synthetic workload). As with LoadFromDump, the handle values are not valid in the current process,
+    /// and are never closed.
+    /// </summary>
+    /// <param name="records">Input: information about the zombie processes/threads</param>
+    /// <param name="recordImagePaths">Input: table that the records' image paths are interned in</param>
+    /// <param name="zombieHandleLookup">Input: handle values held by dwHandleOwnerPID, mapped to the indexes in records of the zombie processes/threads they reference</param>
+    /// <param name="dwHandleOwnerPID">Input: process ID of the process that holds those handles</param>
+    /// <param name="nTotalProcesses">Input: total number of processes, including those that have exited</param>
+    /// <param name="zombieRecords">Output: copy of records; must outlive this instance's use of it</param>
+    /// <param name="imagePaths">Input/output: table that the copies' image paths are interned in; must outlive this instance's use of it</param>
+    /// <param name="zombiePidLookup">Output: lookup structure based on PID, of indexes into zombieRecords</param>
+    void LoadFromData(const ZombieRecordStore_t& records, const ImagePathTable& recordImagePaths, const ZombieHandleLookup_t& zombieHandleLookup, DWORD dwHandleOwnerPID, size_t nTotalProcesses, ZombieRecordStore_t& zombieRecords, ImagePathTable& imagePaths, ZombiePidLookup_t& zombiePidLookup);
+
 private:
     /// <summary>
     /// Cleanup: release handles held in the handle-based lookup collection, and clear that collection
@@ -67,7 +125,16 @@ private:
 
 private:
     ZombieHandleLookup_t m_ZombieHandleLookup;
+    // Caller's store of the records that m_ZombieHandleLookup refers to (for Dump)
+    const ZombieRecordStore_t* m_pZombieRecords = nullptr;
+    // Caller's table that those records' image paths are interned in (for Dump)
+    const ImagePathTable* m_pImagePaths = nullptr;
     size_t m_nZombieProcesses = 0, m_nTotalProcesses = 0;
+    DWORD m_dwHandleOwnerPID = 0;
+    // true if m_ZombieHandleLookup was loaded from a dump and its handle values must not be closed
+    bool m_bRecorded = false;
+    // Platform through which the handles in m_ZombieHandleLookup were acquired, and through which they're released
+    Platform* m_pPlatform = nullptr;
 
 private:
     // Not implemented
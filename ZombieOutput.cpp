@@ -0,0 +1,929 @@
+// Output of zombie and owner information in the formats selected on the command line
+//
+
+#include "PlatformTypes.h"
+#include <cstring>
+#include "Utf8Writer.h"
+#include "ZombieOwners.h"
+#include "ZombieWatch.h"
+#include "ZombieOutput.h"
+
+static const wchar_t* const szTabDelim = L"\t";
+
+/// <summary>
+/// Internal helper: writes the key names of a process' services, each followed by a space.
+/// </summary>
+static void WriteServiceNames(const ServiceSet& services, Utf8Writer* pWriter)
+{
+    for (size_t ixSvc = 0; ixSvc < services.size(); ++ixSvc)
+    {
+        *pWriter << services.ServiceName(ixSvc) << L' ';
+    }
+}
+
+/// <summary>
+/// Internal helper: writes a parent process' PID and image path, or "(exited)" if it's no longer running.
+/// </summary>
+static void WriteParent(const ZombieProcessThreadInfo& z, const ImagePathTable& imagePaths, const wchar_t* szSeparator, Utf8Writer* pWriter)
+{
+    *pWriter << z.ParentPID << szSeparator;
+    if (imagePaths.Path(z.parentImagePathId).length() > 0)
+        *pWriter << imagePaths.Path(z.parentImagePathId);
+    else
+        *pWriter << L"(exited)";
+}
+
+/// <summary>
+/// Internal helper: writes text left-aligned in a field nWidth characters wide.
+/// </summary>
+static void WriteLeftAligned(const wchar_t* szText, size_t nWidth, Utf8Writer* pWriter)
+{
+    const size_t nLength = wcslen(szText);
+    *pWriter << szText;
+    if (nLength < nWidth)
+        pWriter->WriteRepeated(' ', nWidth - nLength);
+}
+
+// ------------------------------------------------------------------------------------------
+/// <summary>
+/// Output summary results in human-readable table format
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time (not used in this function)</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputSummary(const ZombieOwners& zombieOwners, ULONGLONG /*ulNow*/, Utf8Writer* pWriter)
+{
+    // Get the zombie owners, sorted by zombie handle counts in descending order
+    const ZombieOwnersCollectionSorted_t& coll = zombieOwners.OwnersCollectionSorted();
+
+    // Determine longest exe name, so the table can be properly formatted
+    size_t nExeAndPidFieldWidth = 0;
+    const size_t nCountFieldWidth = 6;
+
+    for (ZombieOwnersCollectionSorted_t::const_iterator iter = coll.begin();
+        iter != coll.end();
+        iter++)
+    {
+        if ((*iter)->sExeName.length() > nExeAndPidFieldWidth)
+            nExeAndPidFieldWidth = (*iter)->sExeName.length();
+    }
+    // Add to cover "(pid)" plus spaces
+    nExeAndPidFieldWidth += 10;
+
+    // Table headers
+    WriteLeftAligned(L"Exe name (PID)", nExeAndPidFieldWidth, pWriter);
+    (*pWriter << L" Count     Services").EndLine();
+    WriteLeftAligned(L"--------------", nExeAndPidFieldWidth, pWriter);
+    (*pWriter << L" -----     --------").EndLine();
+
+    // Zombie owners, counts, and services (if any)
+    for (ZombieOwnersCollectionSorted_t::const_iterator iter = coll.begin();
+        iter != coll.end();
+        iter++)
+    {
+        // "Exe name (PID)", left-aligned and padded to the field width
+        const size_t nExeAndPidLength = (*iter)->sExeName.length() + Utf8Writer::DecimalLength((*iter)->PID) + 3;
+        *pWriter << (*iter)->sExeName << L" (" << (*iter)->PID << L')';
+        if (nExeAndPidLength < nExeAndPidFieldWidth)
+            pWriter->WriteRepeated(' ', nExeAndPidFieldWidth - nExeAndPidLength);
+        pWriter->WriteUnsigned((*iter)->zombieOwningInfo.size(), nCountFieldWidth);
+        if (!(*iter)->services.empty())
+        {
+            *pWriter << L"     ";
+            WriteServiceNames((*iter)->services, pWriter);
+        }
+        pWriter->EndLine();
+    }
+
+    // Zombie processes with no user-mode handles
+    if (zombieOwners.UnexplainedZombies().size() > 0)
+    {
+        WriteLeftAligned(L"(No process)", nExeAndPidFieldWidth, pWriter);
+        pWriter->WriteUnsigned(zombieOwners.UnexplainedZombies().size(), nCountFieldWidth).EndLine();
+    }
+
+    // Any process enumeration errors
+    if (zombieOwners.ProcessEnumErrors().size() > 0)
+    {
+        for (
+            ProcessEnumErrorInfoList_t::const_iterator iter = zombieOwners.ProcessEnumErrors().begin();
+            iter != zombieOwners.ProcessEnumErrors().end();
+            iter++
+            )
+        {
+            (*pWriter << L"ERROR: " << *iter).EndLine();
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+/// <summary>
+/// Output summary results in tab-delimited fields
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time (not used in this function)</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputSummaryCsv(const ZombieOwners& zombieOwners, ULONGLONG /*ulNow*/, Utf8Writer* pWriter)
+{
+    // Get the zombie owners, sorted by zombie handle counts in descending order
+    const ZombieOwnersCollectionSorted_t& coll = zombieOwners.OwnersCollectionSorted();
+
+    // Table headers
+    (*pWriter
+        << L"Exe name" << szTabDelim
+        << L"PID" << szTabDelim
+        << L"Count" << szTabDelim
+        << L"Services"
+        ).EndLine();
+
+    // Zombie owners, counts, and services (if any)
+    for (ZombieOwnersCollectionSorted_t::const_iterator iter = coll.begin();
+        iter != coll.end();
+        iter++)
+    {
+        *pWriter
+            << (*iter)->sExeName << szTabDelim
+            << (*iter)->PID << szTabDelim
+            << (*iter)->zombieOwningInfo.size() << szTabDelim;
+        if (!(*iter)->services.empty())
+        {
+            WriteServiceNames((*iter)->services, pWriter);
+        }
+        pWriter->EndLine();
+    }
+
+    // Zombie processes with no user-mode handles
+    if (zombieOwners.UnexplainedZombies().size() > 0)
+    {
+        (*pWriter
+            << L"(No process)" << szTabDelim << szTabDelim << zombieOwners.UnexplainedZombies().size() << szTabDelim).EndLine();
+    }
+
+    // Any process enumeration errors
+    if (zombieOwners.ProcessEnumErrors().size() > 0)
+    {
+        for (
+            ProcessEnumErrorInfoList_t::const_iterator iter = zombieOwners.ProcessEnumErrors().begin();
+            iter != zombieOwners.ProcessEnumErrors().end();
+            iter++
+            )
+        {
+            (*pWriter << L"ERROR: " << *iter << szTabDelim << szTabDelim << szTabDelim).EndLine();
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+/// <summary>
+/// Output detailed results in (more or less) human-readable format
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputDetails(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter)
+{
+    const ImagePathTable& imagePaths = zombieOwners.ImagePaths();
+
+    // High-level summary
+    (*pWriter << L"Zombie processes: " << zombieOwners.ZombieProcessCount()).EndLine();
+    (*pWriter << L"Zombie threads  : " << zombieOwners.ZombieProcessAndThreadCount() - zombieOwners.ZombieProcessCount()).EndLine();
+    pWriter->EndLine();
+
+    // Existing user-mode processes holding handles to zombies, and info about those zombies
+    const ZombieOwnersCollectionSorted_t& coll = zombieOwners.OwnersCollectionSorted();
+    for (
+        ZombieOwnersCollectionSorted_t::const_iterator iterOwners = coll.begin();
+        coll.end() != iterOwners;
+        ++iterOwners
+        )
+    {
+        const ZombieOwner_t& owner = **iterOwners;
+        const ZombieOwningInfoList_t& owningInfo = owner.zombieOwningInfo;
+        *pWriter
+            << owner.sExeName << L" (" << owner.PID << L") | Full path: " << owner.sProcessImagePath;
+        if (!owner.services.empty())
+        {
+            *pWriter << L" | Service(s): ";
+            WriteServiceNames(owner.services, pWriter);
+        }
+        pWriter->EndLine();
+        (*pWriter << owningInfo.size() << L" zombie handle(s):").EndLine();
+        for (
+            ZombieOwningInfoList_t::const_iterator iterOwningInfo = owningInfo.begin();
+            owningInfo.end() != iterOwningInfo;
+            ++iterOwningInfo
+            )
+        {
+            const ZombieProcessThreadInfo& z = zombieOwners.Zombie(iterOwningInfo->ixZombie);
+            const ULONGLONG& ulExitTime = (*(const ULONGLONG*)&z.exitTime);
+            ULONGLONG nSecondsAgo = (ulNow - ulExitTime) / 10000000;
+
+            *pWriter << L"    Handle ";
+            pWriter->WriteHex(iterOwningInfo->handleValue, sizeof(iterOwningInfo->handleValue) * 2);
+            if (0 == z.TID)
+            {
+                *pWriter << L"  PID ";
+                pWriter->WriteUnsigned(z.PID, 6);
+            }
+            else
+            {
+                *pWriter << L"  PID:TID " << z.PID << L':' << z.TID;
+            }
+            *pWriter << L"  " << imagePaths.Path(z.imagePathId) << L" ; exited ";
+            pWriter->WriteFileTime(z.exitTime, false);
+            *pWriter << L": ";
+            pWriter->WriteAgo(nSecondsAgo);
+            (*pWriter << L" ago").EndLine();
+            *pWriter << L"        Parent: ";
+            WriteParent(z, imagePaths, L" ", pWriter);
+            pWriter->EndLine();
+        }
+        pWriter->EndLine();
+    }
+
+    // Information about zombie processes for which no user-mode handles could be found:
+    if (zombieOwners.UnexplainedZombies().size() > 0)
+    {
+        (*pWriter << L"Zombie processes for which no handles were found:").EndLine();
+        (*pWriter << zombieOwners.UnexplainedZombies().size() << L" process(es):").EndLine();
+        for (
+            ZombieRecordIndexList_t::const_iterator iterUnexplained = zombieOwners.UnexplainedZombies().begin();
+            zombieOwners.UnexplainedZombies().end() != iterUnexplained;
+            ++iterUnexplained
+            )
+        {
+            const ZombieProcessThreadInfo& z = zombieOwners.Zombie(*iterUnexplained);
+            const ULONGLONG& ulExitTime = (*(const ULONGLONG*)&z.exitTime);
+            ULONGLONG nSecondsAgo = (ulNow - ulExitTime) / 10000000;
+
+            (*pWriter << L"    PID " << z.PID << L"  " << imagePaths.Path(z.imagePathId)).EndLine();
+            *pWriter << L"      Exited ";
+            pWriter->WriteFileTime(z.exitTime, false);
+            *pWriter << L": ";
+            pWriter->WriteAgo(nSecondsAgo);
+            (*pWriter << L" ago").EndLine();
+            (*pWriter << L"      Threads: " << z.nThreads).EndLine();
+            *pWriter << L"      Parent: ";
+            WriteParent(z, imagePaths, L" ", pWriter);
+            pWriter->EndLine();
+        }
+    }
+
+    // Any process enumeration errors
+    if (zombieOwners.ProcessEnumErrors().size() > 0)
+    {
+        for (
+            ProcessEnumErrorInfoList_t::const_iterator iter = zombieOwners.ProcessEnumErrors().begin();
+            iter != zombieOwners.ProcessEnumErrors().end();
+            iter++
+            )
+        {
+            (*pWriter << L"ERROR: " << *iter).EndLine();
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+/// <summary>
+/// Output detailed results in tab-delimited fields
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputDetailsCsv(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter)
+{
+    const ImagePathTable& imagePaths = zombieOwners.ImagePaths();
+
+    // Tab-delimited headers
+    (*pWriter
+        << L"Owning process name" << szTabDelim
+        << L"Owning PID" << szTabDelim
+        << L"Owning process image path" << szTabDelim
+        << L"Services" << szTabDelim
+        << L"Handle" << szTabDelim
+        << L"Z PID" << szTabDelim
+        << L"Z TID" << szTabDelim
+        << L"Zombie image path" << szTabDelim
+        << L"Threads" << szTabDelim
+        << L"Started" << szTabDelim
+        << L"Exited" << szTabDelim
+        << L"Exited ago" << szTabDelim
+        << L"PPID" << szTabDelim
+        << L"Parent image path"
+        ).EndLine();
+
+    // Existing user-mode processes holding handles to zombies, and info about those zombies
+    const ZombieOwnersCollectionSorted_t& coll = zombieOwners.OwnersCollectionSorted();
+    for (
+        ZombieOwnersCollectionSorted_t::const_iterator iterOwners = coll.begin();
+        coll.end() != iterOwners;
+        ++iterOwners
+        )
+    {
+        const ZombieOwner_t& owner = **iterOwners;
+        const ZombieOwningInfoList_t& owningInfo = owner.zombieOwningInfo;
+        for (
+            ZombieOwningInfoList_t::const_iterator iterOwningInfo = owningInfo.begin();
+            owningInfo.end() != iterOwningInfo;
+            ++iterOwningInfo
+            )
+        {
+            const ZombieProcessThreadInfo& z = zombieOwners.Zombie(iterOwningInfo->ixZombie);
+            const ULONGLONG& ulExitTime = (*(const ULONGLONG*)&z.exitTime);
+            ULONGLONG nSecondsAgo = (ulNow - ulExitTime) / 10000000;
+
+            // First three tab-delimited fields
+            *pWriter
+                << owner.sExeName << szTabDelim
+                << owner.PID << szTabDelim
+                << owner.sProcessImagePath << szTabDelim;
+            // If the process hosts services, put their key names in the next field, separated by spaces
+            if (!owner.services.empty())
+            {
+                WriteServiceNames(owner.services, pWriter);
+            }
+            // Rest of the fields.
+            // If it's a thread handle, populate the TID field with the Thread ID, and leave the Threads field empty.
+            // If it's a process handle, populate the Threads field with the number of threads in the process, and leave the TID field empty.
+            *pWriter << szTabDelim; // tab following the Services field
+            pWriter->WriteHex(iterOwningInfo->handleValue, 8, false, true);
+            *pWriter << szTabDelim << z.PID << szTabDelim;
+            if (0 != z.TID)
+                *pWriter << z.TID;
+            *pWriter << szTabDelim << imagePaths.Path(z.imagePathId) << szTabDelim;
+            if (0 == z.TID)
+                *pWriter << z.nThreads;
+            *pWriter << szTabDelim;
+            pWriter->WriteFileTime(z.createTime, false);
+            *pWriter << szTabDelim;
+            pWriter->WriteFileTime(z.exitTime, false);
+            *pWriter << szTabDelim;
+            pWriter->WriteAgo(nSecondsAgo);
+            *pWriter << szTabDelim;
+            WriteParent(z, imagePaths, szTabDelim, pWriter);
+            pWriter->EndLine();
+        }
+    }
+
+    // Information about zombie processes for which no user-mode handles could be found:
+    if (zombieOwners.UnexplainedZombies().size() > 0)
+    {
+        for (
+            ZombieRecordIndexList_t::const_iterator iterUnexplained = zombieOwners.UnexplainedZombies().begin();
+            zombieOwners.UnexplainedZombies().end() != iterUnexplained;
+            ++iterUnexplained
+            )
+        {
+            const ZombieProcessThreadInfo& z = zombieOwners.Zombie(*iterUnexplained);
+            const ULONGLONG& ulExitTime = (*(const ULONGLONG*)&z.exitTime);
+            ULONGLONG nSecondsAgo = (ulNow - ulExitTime) / 10000000;
+
+            // First five fields are empty - no user-mode processes found holding handles to these zombies. TID field empty as well.
+            *pWriter
+                << szTabDelim
+                << szTabDelim
+                << szTabDelim
+                << szTabDelim
+                << szTabDelim
+                << z.PID << szTabDelim
+                << szTabDelim
+                << imagePaths.Path(z.imagePathId) << szTabDelim
+                << z.nThreads << szTabDelim;
+            pWriter->WriteFileTime(z.createTime, false);
+            *pWriter << szTabDelim;
+            pWriter->WriteFileTime(z.exitTime, false);
+            *pWriter << szTabDelim;
+            pWriter->WriteAgo(nSecondsAgo);
+            *pWriter << szTabDelim;
+            WriteParent(z, imagePaths, szTabDelim, pWriter);
+            pWriter->EndLine();
+        }
+    }
+
+    // Any process enumeration errors
+    if (zombieOwners.ProcessEnumErrors().size() > 0)
+    {
+        for (
+            ProcessEnumErrorInfoList_t::const_iterator iter = zombieOwners.ProcessEnumErrors().begin();
+            iter != zombieOwners.ProcessEnumErrors().end();
+            iter++
+            )
+        {
+            // First five fields are empty - no user-mode processes found holding handles to these zombies. TID field empty as well.
+            (*pWriter
+                << L"ERROR" << szTabDelim // Owning process name
+                << L"ERROR" << szTabDelim // Owning PID
+                << *iter << szTabDelim // Owning process image path
+                << szTabDelim // Services
+                << szTabDelim // Handle
+                << szTabDelim // Z PID
+                << szTabDelim // Z TID
+                << szTabDelim // Zombie image path
+                << szTabDelim // Threads
+                << szTabDelim // Started
+                << szTabDelim // Exited
+                << szTabDelim // Exited ago
+                << szTabDelim // PPID
+                ).EndLine(); // Parent image path
+        }
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+/// <summary>
+/// Output the result of checking the alert thresholds: one line, "OK: ..." or "ALERT: " and what exceeded a threshold
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information, after an update with alert thresholds set</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputAlertVerdict(const ZombieOwners& zombieOwners, Utf8Writer* pWriter)
+{
+    const ZombieAlertVerdict& verdict = zombieOwners.AlertVerdict();
+    if (ZombieAlert_t::None == verdict.alert)
+        (*pWriter << L"OK: no alert thresholds exceeded").EndLine();
+    else
+        (*pWriter << L"ALERT: " << verdict.sInfo).EndLine();
+}
+
+// ------------------------------------------------------------------------------------------
+/// <summary>
+/// Output the changes between two -watch samples in human-readable format
+/// </summary>
+/// <param name="delta">Input: changes since the previous sample</param>
+/// <param name="ulNow">Input: time the current sample was collected</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputWatchDelta(const ZombieSampleDelta& delta, ULONGLONG ulNow, Utf8Writer* pWriter)
+{
+    const ImagePathTable& imagePaths = *delta.pImagePaths;
+
+    pWriter->WriteFileTime(*(const FILETIME*)&ulNow, false);
+    (*pWriter
+        << L"  "
+        << delta.newZombies.size() << L" new zombie(s), "
+        << delta.releasedZombies.size() << L" released, "
+        << delta.ownerDeltas.size() << L" owner change(s)").EndLine();
+
+    for (
+        ZombieProcessThreadInfoList_t::const_iterator iter = delta.newZombies.begin();
+        iter != delta.newZombies.end();
+        ++iter
+        )
+    {
+        const ZombieProcessThreadInfo& z = *iter;
+        *pWriter << L"  + ";
+        if (0 == z.TID)
+            *pWriter << L"PID " << z.PID;
+        else
+            *pWriter << L"PID:TID " << z.PID << L':' << z.TID;
+        *pWriter << L"  " << imagePaths.Path(z.imagePathId) << L" ; exited ";
+        pWriter->WriteFileTime(z.exitTime, false).EndLine();
+    }
+    for (
+        ZombieProcessThreadInfoList_t::const_iterator iter = delta.releasedZombies.begin();
+        iter != delta.releasedZombies.end();
+        ++iter
+        )
+    {
+        const ZombieProcessThreadInfo& z = *iter;
+        *pWriter << L"  - ";
+        if (0 == z.TID)
+            *pWriter << L"PID " << z.PID;
+        else
+            *pWriter << L"PID:TID " << z.PID << L':' << z.TID;
+        (*pWriter << L"  " << imagePaths.Path(z.imagePathId)).EndLine();
+    }
+    for (
+        OwnerCountDeltaList_t::const_iterator iter = delta.ownerDeltas.begin();
+        iter != delta.ownerDeltas.end();
+        ++iter
+        )
+    {
+        *pWriter
+            << L"  Owner " << iter->sExeName << L" (" << iter->PID << L")  "
+            << iter->nPrevHandles << L" -> " << iter->nHandles << L" (";
+        if (iter->nHandles >= iter->nPrevHandles)
+            *pWriter << L'+' << (iter->nHandles - iter->nPrevHandles);
+        else
+            *pWriter << L'-' << (iter->nPrevHandles - iter->nHandles);
+        *pWriter << L')';
+        if (!iter->services.empty())
+        {
+            *pWriter << L"  ";
+            WriteServiceNames(iter->services, pWriter);
+        }
+        pWriter->EndLine();
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+/// <summary>
+/// Output the changes between two -watch samples in tab-delimited fields, one change per line:
+/// Time, Change ("New", "Released", or "Owner"), PID, TID, Image path or exe name, Previous count, Count, Services
+/// </summary>
+/// <param name="delta">Input: changes since the previous sample</param>
+/// <param name="ulNow">Input: time the current sample was collected</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputWatchDeltaCsv(const ZombieSampleDelta& delta, ULONGLONG ulNow, Utf8Writer* pWriter)
+{
+    const ImagePathTable& imagePaths = *delta.pImagePaths;
+    const FILETIME& ftNow = *(const FILETIME*)&ulNow;
+
+    for (
+        ZombieProcessThreadInfoList_t::const_iterator iter = delta.newZombies.begin();
+        iter != delta.newZombies.end();
+        ++iter
+        )
+    {
+        pWriter->WriteFileTime(ftNow, false);
+        *pWriter << szTabDelim << L"New" << szTabDelim << iter->PID << szTabDelim;
+        if (0 != iter->TID)
+            *pWriter << iter->TID;
+        (*pWriter << szTabDelim << imagePaths.Path(iter->imagePathId) << szTabDelim << szTabDelim << szTabDelim).EndLine();
+    }
+    for (
+        ZombieProcessThreadInfoList_t::const_iterator iter = delta.releasedZombies.begin();
+        iter != delta.releasedZombies.end();
+        ++iter
+        )
+    {
+        pWriter->WriteFileTime(ftNow, false);
+        *pWriter << szTabDelim << L"Released" << szTabDelim << iter->PID << szTabDelim;
+        if (0 != iter->TID)
+            *pWriter << iter->TID;
+        (*pWriter << szTabDelim << imagePaths.Path(iter->imagePathId) << szTabDelim << szTabDelim << szTabDelim).EndLine();
+    }
+    for (
+        OwnerCountDeltaList_t::const_iterator iter = delta.ownerDeltas.begin();
+        iter != delta.ownerDeltas.end();
+        ++iter
+        )
+    {
+        pWriter->WriteFileTime(ftNow, false);
+        *pWriter
+            << szTabDelim << L"Owner" << szTabDelim << iter->PID << szTabDelim << szTabDelim
+            << iter->sExeName << szTabDelim << iter->nPrevHandles << szTabDelim << iter->nHandles << szTabDelim;
+        if (!iter->services.empty())
+        {
+            WriteServiceNames(iter->services, pWriter);
+        }
+        pWriter->EndLine();
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// JSON Lines output
+
+/// <summary>
+/// Internal helper: writes a process' service key names as a JSON array.
+/// </summary>
+static void WriteJsonServiceNames(const ServiceSet& services, Utf8Writer* pWriter)
+{
+    *pWriter << L'[';
+    for (size_t ixSvc = 0; ixSvc < services.size(); ++ixSvc)
+    {
+        if (ixSvc > 0)
+            *pWriter << L',';
+        pWriter->WriteJsonString(services.ServiceName(ixSvc));
+    }
+    *pWriter << L']';
+}
+
+/// <summary>
+/// Internal helper: writes a FILETIME as a JSON ISO 8601 string, or null if it's zero.
+/// </summary>
+static void WriteJsonTime(const FILETIME& ft, Utf8Writer* pWriter)
+{
+    if (0 == ft.dwHighDateTime && 0 == ft.dwLowDateTime)
+    {
+        *pWriter << L"null";
+    }
+    else
+    {
+        *pWriter << L'"';
+        pWriter->WriteIso8601(ft);
+        *pWriter << L'"';
+    }
+}
+
+/// <summary>
+/// Internal helper: writes the members describing a zombie process or thread, without braces.
+/// The thread count is written only for a process, as in the tab-delimited output.
+/// </summary>
+static void WriteJsonZombieMembers(const ZombieProcessThreadInfo& z, const ImagePathTable& imagePaths, ULONGLONG ulNow, Utf8Writer* pWriter)
+{
+    const ULONGLONG& ulExitTime = (*(const ULONGLONG*)&z.exitTime);
+    *pWriter << L"\"pid\":" << z.PID << L",\"tid\":" << z.TID;
+    if (0 == z.TID)
+        *pWriter << L",\"threads\":" << z.nThreads;
+    *pWriter << L",\"path\":";
+    pWriter->WriteJsonString(imagePaths.Path(z.imagePathId));
+    *pWriter << L",\"created\":";
+    WriteJsonTime(z.createTime, pWriter);
+    *pWriter << L",\"exited\":";
+    WriteJsonTime(z.exitTime, pWriter);
+    *pWriter << L",\"exitedSecondsAgo\":" << (ulNow - ulExitTime) / 10000000 << L",\"ppid\":" << z.ParentPID << L",\"parentPath\":";
+    if (imagePaths.Path(z.parentImagePathId).length() > 0)
+        pWriter->WriteJsonString(imagePaths.Path(z.parentImagePathId));
+    else
+        *pWriter << L"null";
+}
+
+/// <summary>
+/// Internal helper: writes the "capture" line, and the "error" lines that follow all other results.
+/// </summary>
+static void WriteJsonCapture(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter)
+{
+    *pWriter << L"{\"type\":\"capture\",\"time\":";
+    WriteJsonTime(*(const FILETIME*)&ulNow, pWriter);
+    (*pWriter
+        << L",\"processes\":" << zombieOwners.TotalProcessCount()
+        << L",\"zombieProcesses\":" << zombieOwners.ZombieProcessCount()
+        << L",\"zombieThreads\":" << zombieOwners.ZombieProcessAndThreadCount() - zombieOwners.ZombieProcessCount()
+        << L'}').EndLine();
+}
+static void WriteJsonErrors(const ZombieOwners& zombieOwners, Utf8Writer* pWriter)
+{
+    for (
+        ProcessEnumErrorInfoList_t::const_iterator iter = zombieOwners.ProcessEnumErrors().begin();
+        iter != zombieOwners.ProcessEnumErrors().end();
+        iter++
+        )
+    {
+        *pWriter << L"{\"type\":\"error\",\"message\":";
+        pWriter->WriteJsonString(*iter);
+        (*pWriter << L'}').EndLine();
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+/// <summary>
+/// Output summary results as JSON Lines: a "capture" object with the counts, then one "owner" object per zombie owner
+/// (PID, exe name, image path, zombie handle count, services), an "unowned" object with the number of zombie processes
+/// for which no handles were found, and an "error" object per process enumeration error.
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputSummaryJson(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter)
+{
+    WriteJsonCapture(zombieOwners, ulNow, pWriter);
+
+    // Zombie owners, sorted by zombie handle counts in descending order
+    const ZombieOwnersCollectionSorted_t& coll = zombieOwners.OwnersCollectionSorted();
+    for (ZombieOwnersCollectionSorted_t::const_iterator iter = coll.begin();
+        iter != coll.end();
+        iter++)
+    {
+        const ZombieOwner_t& owner = **iter;
+        *pWriter << L"{\"type\":\"owner\",\"pid\":" << owner.PID << L",\"exe\":";
+        pWriter->WriteJsonString(owner.sExeName);
+        *pWriter << L",\"path\":";
+        pWriter->WriteJsonString(owner.sProcessImagePath);
+        *pWriter << L",\"zombieHandles\":" << owner.zombieOwningInfo.size() << L",\"services\":";
+        WriteJsonServiceNames(owner.services, pWriter);
+        (*pWriter << L'}').EndLine();
+    }
+
+    // Zombie processes with no user-mode handles
+    if (zombieOwners.UnexplainedZombies().size() > 0)
+    {
+        (*pWriter << L"{\"type\":\"unowned\",\"zombieProcesses\":" << zombieOwners.UnexplainedZombies().size() << L'}').EndLine();
+    }
+
+    WriteJsonErrors(zombieOwners, pWriter);
+}
+
+// ------------------------------------------------------------------------------------------
+/// <summary>
+/// Output detailed results as JSON Lines: a "capture" object with the counts, then one "handle" object per zombie handle
+/// (owner, handle value, and the zombie's PID, TID, image path, times, and parent), one "unowned" object per zombie
+/// process for which no handles were found, and an "error" object per process enumeration error.
+/// Times are ISO 8601 UTC strings, or null if not known; PIDs, handle values, and counts are numbers.
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputDetailsJson(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter)
+{
+    WriteJsonCapture(zombieOwners, ulNow, pWriter);
+
+    // Existing user-mode processes holding handles to zombies, and info about those zombies
+    const ZombieOwnersCollectionSorted_t& coll = zombieOwners.OwnersCollectionSorted();
+    for (
+        ZombieOwnersCollectionSorted_t::const_iterator iterOwners = coll.begin();
+        coll.end() != iterOwners;
+        ++iterOwners
+        )
+    {
+        const ZombieOwner_t& owner = **iterOwners;
+        const ZombieOwningInfoList_t& owningInfo = owner.zombieOwningInfo;
+        for (
+            ZombieOwningInfoList_t::const_iterator iterOwningInfo = owningInfo.begin();
+            owningInfo.end() != iterOwningInfo;
+            ++iterOwningInfo
+            )
+        {
+            *pWriter << L"{\"type\":\"handle\",\"ownerPid\":" << owner.PID << L",\"ownerExe\":";
+            pWriter->WriteJsonString(owner.sExeName);
+            *pWriter << L",\"ownerPath\":";
+            pWriter->WriteJsonString(owner.sProcessImagePath);
+            *pWriter << L",\"ownerServices\":";
+            WriteJsonServiceNames(owner.services, pWriter);
+            *pWriter << L",\"handle\":" << iterOwningInfo->handleValue << L',';
+            WriteJsonZombieMembers(zombieOwners.Zombie(iterOwningInfo->ixZombie), zombieOwners.ImagePaths(), ulNow, pWriter);
+            (*pWriter << L'}').EndLine();
+        }
+    }
+
+    // Zombie processes for which no user-mode handles could be found
+    for (
+        ZombieRecordIndexList_t::const_iterator iterUnexplained = zombieOwners.UnexplainedZombies().begin();
+        zombieOwners.UnexplainedZombies().end() != iterUnexplained;
+        ++iterUnexplained
+        )
+    {
+        *pWriter << L"{\"type\":\"unowned\",";
+        WriteJsonZombieMembers(zombieOwners.Zombie(*iterUnexplained), zombieOwners.ImagePaths(), ulNow, pWriter);
+        (*pWriter << L'}').EndLine();
+    }
+
+    WriteJsonErrors(zombieOwners, pWriter);
+}
+
+// ------------------------------------------------------------------------------------------
+/// <summary>
+/// Output the changes between two -watch samples as JSON Lines: one "new", "released", or "ownerChange" object per change
+/// </summary>
+/// <param name="delta">Input: changes since the previous sample</param>
+/// <param name="ulNow">Input: time the current sample was collected</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputWatchDeltaJson(const ZombieSampleDelta& delta, ULONGLONG ulNow, Utf8Writer* pWriter)
+{
+    const ImagePathTable& imagePaths = *delta.pImagePaths;
+    const FILETIME& ftNow = *(const FILETIME*)&ulNow;
+
+    for (
+        ZombieProcessThreadInfoList_t::const_iterator iter = delta.newZombies.begin();
+        iter != delta.newZombies.end();
+        ++iter
+        )
+    {
+        *pWriter << L"{\"type\":\"new\",\"time\":";
+        WriteJsonTime(ftNow, pWriter);
+        *pWriter << L',';
+        WriteJsonZombieMembers(*iter, imagePaths, ulNow, pWriter);
+        (*pWriter << L'}').EndLine();
+    }
+    for (
+        ZombieProcessThreadInfoList_t::const_iterator iter = delta.releasedZombies.begin();
+        iter != delta.releasedZombies.end();
+        ++iter
+        )
+    {
+        *pWriter << L"{\"type\":\"released\",\"time\":";
+        WriteJsonTime(ftNow, pWriter);
+        *pWriter << L",\"pid\":" << iter->PID << L",\"tid\":" << iter->TID << L",\"path\":";
+        pWriter->WriteJsonString(imagePaths.Path(iter->imagePathId));
+        (*pWriter << L'}').EndLine();
+    }
+    for (
+        OwnerCountDeltaList_t::const_iterator iter = delta.ownerDeltas.begin();
+        iter != delta.ownerDeltas.end();
+        ++iter
+        )
+    {
+        *pWriter << L"{\"type\":\"ownerChange\",\"time\":";
+        WriteJsonTime(ftNow, pWriter);
+        *pWriter << L",\"pid\":" << iter->PID << L",\"exe\":";
+        pWriter->WriteJsonString(iter->sExeName);
+        *pWriter << L",\"previousZombieHandles\":" << iter->nPrevHandles << L",\"zombieHandles\":" << iter->nHandles << L",\"services\":";
+        WriteJsonServiceNames(iter->services, pWriter);
+        (*pWriter << L'}').EndLine();
+    }
+}
+
+// ------------------------------------------------------------------------------------------
+// Binary output
+
+/// <summary>
+/// Internal helper: writes a record header for a record with the given fixed-size structure and strings.
+/// </summary>
+static void WriteBinaryRecordHeader(ZombieResultsRecord_t type, size_t nFixedSize, size_t nStringBytes, Utf8Writer* pWriter)
+{
+    ZombieResultsRecordHeader header = { 0 };
+    header.Type = USHORT(type);
+    header.Size = ULONG(sizeof(header) + nFixedSize + nStringBytes);
+    pWriter->WriteBytes(&header, sizeof(header));
+}
+
+/// <summary>
+/// Internal helper: the number of bytes a string takes in a record, and writing it: byte count, then UTF-8.
+/// </summary>
+static inline size_t BinaryStringSize(const std::wstring& str)
+{
+    return sizeof(ULONG) + Utf8Writer::Utf8Length(str);
+}
+static void WriteBinaryString(const std::wstring& str, Utf8Writer* pWriter)
+{
+    const ULONG nBytes = ULONG(Utf8Writer::Utf8Length(str));
+    pWriter->WriteBytes(&nBytes, sizeof(nBytes));
+    pWriter->Write(str);
+}
+
+/// <summary>
+/// Internal helper: writes a ZombieHandle or Unowned record.
+/// </summary>
+static void WriteBinaryZombie(ZombieResultsRecord_t type, ULONG_PTR ownerPID, ULONG_PTR handleValue, const ZombieProcessThreadInfo& z, const ImagePathTable& imagePaths, Utf8Writer* pWriter)
+{
+    ZombieResultsZombie zombie = { 0 };
+    zombie.OwnerPID = ownerPID;
+    zombie.HandleValue = handleValue;
+    zombie.PID = z.PID;
+    zombie.TID = z.TID;
+    zombie.Threads = z.nThreads;
+    zombie.CreateTime = *(const ULONGLONG*)&z.createTime;
+    zombie.ExitTime = *(const ULONGLONG*)&z.exitTime;
+    zombie.ParentPID = z.ParentPID;
+    WriteBinaryRecordHeader(type, sizeof(zombie), BinaryStringSize(imagePaths.Path(z.imagePathId)) + BinaryStringSize(imagePaths.Path(z.parentImagePathId)), pWriter);
+    pWriter->WriteBytes(&zombie, sizeof(zombie));
+    WriteBinaryString(imagePaths.Path(z.imagePathId), pWriter);
+    WriteBinaryString(imagePaths.Path(z.parentImagePathId), pWriter);
+}
+
+// ------------------------------------------------------------------------------------------
+/// <summary>
+/// Output the complete results (owners and all their zombie handles, unowned zombies, and errors) in the binary results
+/// format described in ZombieOutput.h. The writer should have been opened for binary output.
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputResultsBinary(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter)
+{
+    ZombieResultsHeader header = { { 0 } };
+    memcpy(header.Magic, ZombieResultsMagic, sizeof(header.Magic));
+    header.Version = ZombieResultsVersion;
+    header.HeaderSize = sizeof(ZombieResultsHeader);
+    header.CaptureTime = ulNow;
+    header.TotalProcesses = zombieOwners.TotalProcessCount();
+    header.ZombieProcesses = zombieOwners.ZombieProcessCount();
+    header.ZombieThreads = zombieOwners.ZombieProcessAndThreadCount() - zombieOwners.ZombieProcessCount();
+    pWriter->WriteBytes(&header, sizeof(header));
+
+    // Each owner, followed by its zombie handles
+    const ZombieOwnersCollectionSorted_t& coll = zombieOwners.OwnersCollectionSorted();
+    for (
+        ZombieOwnersCollectionSorted_t::const_iterator iterOwners = coll.begin();
+        coll.end() != iterOwners;
+        ++iterOwners
+        )
+    {
+        const ZombieOwner_t& owner = **iterOwners;
+        ZombieResultsOwner ownerRecord = { 0 };
+        ownerRecord.PID = owner.PID;
+        ownerRecord.HandleCount = owner.zombieOwningInfo.size();
+        size_t nStringBytes = BinaryStringSize(owner.sExeName) + BinaryStringSize(owner.sProcessImagePath);
+        ownerRecord.ServiceCount = ULONG(owner.services.size());
+        for (size_t ixSvc = 0; ixSvc < owner.services.size(); ++ixSvc)
+        {
+            nStringBytes += BinaryStringSize(owner.services.ServiceName(ixSvc));
+        }
+        WriteBinaryRecordHeader(ZombieResultsRecord_t::Owner, sizeof(ownerRecord), nStringBytes, pWriter);
+        pWriter->WriteBytes(&ownerRecord, sizeof(ownerRecord));
+        WriteBinaryString(owner.sExeName, pWriter);
+        WriteBinaryString(owner.sProcessImagePath, pWriter);
+        for (size_t ixSvc = 0; ixSvc < owner.services.size(); ++ixSvc)
+        {
+            WriteBinaryString(owner.services.ServiceName(ixSvc), pWriter);
+        }
+
+        for (
+            ZombieOwningInfoList_t::const_iterator iterOwningInfo = owner.zombieOwningInfo.begin();
+            owner.zombieOwningInfo.end() != iterOwningInfo;
+            ++iterOwningInfo
+            )
+        {
+            WriteBinaryZombie(ZombieResultsRecord_t::ZombieHandle, owner.PID, iterOwningInfo->handleValue, zombieOwners.Zombie(iterOwningInfo->ixZombie), zombieOwners.ImagePaths(), pWriter);
+        }
+    }
+
+    // Zombie processes for which no user-mode handles could be found
+    for (
+        ZombieRecordIndexList_t::const_iterator iterUnexplained = zombieOwners.UnexplainedZombies().begin();
+        zombieOwners.UnexplainedZombies().end() != iterUnexplained;
+        ++iterUnexplained
+        )
+    {
+        WriteBinaryZombie(ZombieResultsRecord_t::Unowned, 0, 0, zombieOwners.Zombie(*iterUnexplained), zombieOwners.ImagePaths(), pWriter);
+    }
+
+    // Process enumeration errors
+    for (
+        ProcessEnumErrorInfoList_t::const_iterator iter = zombieOwners.ProcessEnumErrors().begin();
+        iter != zombieOwners.ProcessEnumErrors().end();
+        iter++
+        )
+    {
+        WriteBinaryRecordHeader(ZombieResultsRecord_t::Error, 0, BinaryStringSize(*iter), pWriter);
+        WriteBinaryString(*iter, pWriter);
+    }
+}
@@ -0,0 +1,168 @@
+// Output of zombie and owner information in the formats selected on the command line
+
+#pragma once
+
+#include "PlatformTypes.h"
+
+class ZombieOwners;
+struct ZombieSampleDelta;
+class Utf8Writer;
+
+/// <summary>
+/// Output summary results in human-readable table format
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time (not used in this function)</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputSummary(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter);
+
+/// <summary>
+/// Output summary results in tab-delimited fields
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time (not used in this function)</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputSummaryCsv(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter);
+
+/// <summary>
+/// Output detailed results in (more or less) human-readable format
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputDetails(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter);
+
+/// <summary>
+/// Output detailed results in tab-delimited fields
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputDetailsCsv(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter);
+
+/// <summary>
+/// Output the result of checking the alert thresholds: one line, "OK: ..." or "ALERT: " and what exceeded a threshold
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information, after an update with alert thresholds set</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputAlertVerdict(const ZombieOwners& zombieOwners, Utf8Writer* pWriter);
+
+/// <summary>
+/// Output the changes between two -watch samples in human-readable format
+/// </summary>
+/// <param name="delta">Input: changes since the previous sample</param>
+/// <param name="ulNow">Input: time the current sample was collected</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputWatchDelta(const ZombieSampleDelta& delta, ULONGLONG ulNow, Utf8Writer* pWriter);
+
+/// <summary>
+/// Output the changes between two -watch samples in tab-delimited fields, one change per line:
+/// Time, Change ("New", "Released", or "Owner"), PID, TID, Image path or exe name, Previous count, Count, Services
+/// </summary>
+/// <param name="delta">Input: changes since the previous sample</param>
+/// <param name="ulNow">Input: time the current sample was collected</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputWatchDeltaCsv(const ZombieSampleDelta& delta, ULONGLONG ulNow, Utf8Writer* pWriter);
+
+/// <summary>
+/// Output summary results as JSON Lines: a "capture" object with the counts, then one "owner" object per zombie owner
+/// (PID, exe name, image path, zombie handle count, services), an "unowned" object with the number of zombie processes
+/// for which no handles were found, and an "error" object per process enumeration error.
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputSummaryJson(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter);
+
+/// <summary>
+/// Output detailed results as JSON Lines: a "capture" object with the counts, then one "handle" object per zombie handle
+/// (owner, handle value, and the zombie's PID, TID, image path, times, and parent), one "unowned" object per zombie
+/// process for which no handles were found, and an "error" object per process enumeration error.
+/// Times are ISO 8601 UTC strings, or null if not known; PIDs, handle values, and counts are numbers.
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputDetailsJson(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter);
+
+/// <summary>
+/// Output the changes between two -watch samples as JSON Lines: one "new", "released", or "ownerChange" object per change
+/// </summary>
+/// <param name="delta">Input: changes since the previous sample</param>
+/// <param name="ulNow">Input: time the current sample was collected</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputWatchDeltaJson(const ZombieSampleDelta& delta, ULONGLONG ulNow, Utf8Writer* pWriter);
+
+// ------------------------------------------------------------------------------------------
+// Binary results format (-binary), written by OutputResultsBinary.
+//
+// A ZombieResultsHeader, followed by records until the end of the file. Each record is a ZombieResultsRecordHeader
+// followed by the record's fixed-size structure, if any, and then its strings. A string is a ULONG byte count followed by
+// that many bytes of UTF-8, without terminator. Integers are in the writer's byte order (little-endian on all supported
+// platforms); times are FILETIME values (0 if not known). Readers skip records of unknown types by their Size.
+//
+// Record types, in the order written:
+//   Owner:        ZombieResultsOwner; strings: exe name, image path, then ServiceCount service names.
+//                 Followed by a ZombieHandle record for each of the owner's zombie handles.
+//   ZombieHandle: ZombieResultsZombie; strings: zombie image path, parent image path (empty if the parent has exited).
+//   Unowned:      ZombieResultsZombie for a zombie process for which no handles were found (OwnerPID and HandleValue 0);
+//                 strings as for ZombieHandle.
+//   Error:        no structure; string: the process enumeration error message.
+
+struct ZombieResultsHeader
+{
+    char Magic[8];                  // ZombieResultsMagic
+    ULONG Version;                  // ZombieResultsVersion
+    ULONG HeaderSize;               // sizeof(ZombieResultsHeader)
+    ULONGLONG CaptureTime;          // FILETIME value of the time the information was collected
+    ULONGLONG TotalProcesses;       // Number of processes enumerated, including zombies
+    ULONGLONG ZombieProcesses;
+    ULONGLONG ZombieThreads;
+};
+
+enum class ZombieResultsRecord_t : USHORT
+{
+    Owner = 1,
+    ZombieHandle = 2,
+    Unowned = 3,
+    Error = 4
+};
+
+struct ZombieResultsRecordHeader
+{
+    USHORT Type;                    // ZombieResultsRecord_t
+    USHORT Reserved;
+    ULONG Size;                     // Size in bytes of the record, including this header
+};
+
+struct ZombieResultsOwner
+{
+    ULONGLONG PID;
+    ULONGLONG HandleCount;          // Number of zombie handles; as many ZombieHandle records follow
+    ULONG ServiceCount;
+    ULONG Reserved;
+};
+
+struct ZombieResultsZombie
+{
+    ULONGLONG OwnerPID;
+    ULONGLONG HandleValue;
+    ULONGLONG PID;
+    ULONGLONG TID;                  // 0 for a handle to the process
+    ULONGLONG Threads;              // Number of still-existing threads in the zombie process
+    ULONGLONG CreateTime;
+    ULONGLONG ExitTime;
+    ULONGLONG ParentPID;
+};
+
+const char ZombieResultsMagic[8] = { 'Z', 'F', 'R', 'E', 'S', 'U', 'L', 'T' };
+const ULONG ZombieResultsVersion = 1;
+
+/// <summary>
+/// Output the complete results (owners and all their zombie handles, unowned zombies, and errors) in the binary results
+/// format described above. The writer should have been opened for binary output.
+/// </summary>
+/// <param name="zombieOwners">Input: zombie process/owner information</param>
+/// <param name="ulNow">Input: representation of current time</param>
+/// <param name="pWriter">Input: pointer to the writer into which to write; not flushed</param>
+void OutputResultsBinary(const ZombieOwners& zombieOwners, ULONGLONG ulNow, Utf8Writer* pWriter);
@@ -3,22 +3,87 @@
 // Not yet worked out how to identify what holds those pointers.
 
 #include <sstream>
+#include <fstream>
 #include <algorithm>
+#include <iterator>
 #include "UtilityFunctions.h"
+#include "FileOutput.h"
+#include "Utf8Writer.h"
 #include "StringUtils.h"
 #include "SysErrorMessage.h"
-#include "SecurityUtils.h"
+#include "Platform.h"
 #include "ZombieHandles.h"
 #include "AllHandlesSystemwide.h"
+#include "WorkerPool.h"
+#include "RunStats.h"
 #include "ZombieOwners.h"
 
+// File name suffixes of the diagnostic files written by Update and read by Replay
+static const wchar_t* const szDiagSuffix_ZombieHandles = L"_ZombieHandles.txt";
+static const wchar_t* const szDiagSuffix_AllHandles = L"_AllHandles.txt";
+static const wchar_t* const szDiagSuffix_AllHandlesSnapshot = L"_AllHandles.bin";
+static const wchar_t* const szDiagSuffix_Services = L"_Services.txt";
+static const wchar_t* const szDiagSuffix_Context = L"_Context.txt";
+
+// Names in the name/value lines of the context diagnostic file
+static const wchar_t* const szContext_CaptureTime = L"CaptureTime";
+static const wchar_t* const szContext_TotalProcesses = L"TotalProcesses";
+static const wchar_t* const szContext_Error = L"Error";
+static const wchar_t* const szContext_Owner = L"Owner";
+
+// Smallest range of handle table entries worth handing to a separate worker thread
+static const size_t nMinHandlesPerPartition = 65536;
+
+// Room in the owner table: more owning processes than this are looked up by PID instead
+static const size_t nMaxOwnerTablePids = 65536;
+// Owner table slot of a match whose owner didn't fit in the table
+static const size_t NoOwnerSlot = size_t(-1);
+
+/// <summary>
+/// One worker's share of the handles to zombies.
+/// </summary>
+struct OwnerFragment
+{
+    /// <summary>
+    /// Matching handle table entries in handle table order, except for this process' own handles to the zombies
+    /// </summary>
+    ZombieHandleMatchList_t matches;
+    /// <summary>
+    /// Slot of each match's owning PID in the owner table
+    /// </summary>
+    std::vector<size_t> ownerSlots;
+    /// <summary>
+    /// Number of handle table entries the worker looked up (all of them, unless prefiltered by object type)
+    /// </summary>
+    size_t nCandidates = 0;
+    /// <summary>
+    /// Number of matching handle table entries, before excluding this process' own handles
+    /// </summary>
+    size_t nMatches = 0;
+};
+
+/// <summary>
+/// Capture time of a diagnostic file set from the timestamp at the end of its file name prefix (as Update_Impl
+/// writes it: UTC, to the second); 0 if the prefix doesn't end with one.
+/// </summary>
+static ULONGLONG CaptureTimeFromDiagFilePrefix(const std::wstring& sDiagFilePrefix)
+{
+    // yyyyMMdd_HHmmss
+    const size_t nTimestampChars = 15;
+    const std::wstring sFileName = GetFileNameFromFilePath(sDiagFilePrefix);
+    FILETIME ft;
+    if (sFileName.length() < nTimestampChars || !WStringToFileTime(sFileName.substr(sFileName.length() - nTimestampChars), true, ft))
+        return 0;
+    return *(const ULONGLONG*)&ft;
+}
+
 /// <summary>
 /// Comparator that sorts descending by handle count, then ascending by exe name and PID.
 /// </summary>
-/// <param name="a"></param>
-/// <param name="b"></param>
+/// <param name="pA"></param>
+/// <param name="pB"></param>
 /// <returns></returns>
-static bool ZombieOwnerComparator(const ZombieOwner_t* pA, const ZombieOwner_t* pB)
+bool ZombieOwnerComparator(const ZombieOwner_t* pA, const ZombieOwner_t* pB)
 {
     // If the handle counts are the same...
     if (pA->zombieOwningInfo.size() == pB->zombieOwningInfo.size())
@@ -38,6 +103,78 @@ static bool ZombieOwnerComparator(const ZombieOwner_t* pA, const ZombieOwner_t*
     }
 }
 
+/// <summary>
+/// An owner's ZombieOwnerComparator sort key, computed once: for SortOwners.
+/// </summary>
+struct OwnerSortKey
+{
+    size_t nHandles;
+    // Exe name folded to lowercase as _wcsicmp folds it, so that its ordinal order is _wcsicmp's
+    std::wstring sFoldedExeName;
+    ULONG_PTR PID;
+    const ZombieOwner_t* pOwner;
+};
+
+/// <summary>
+/// Orders sort keys as ZombieOwnerComparator orders the owners.
+/// </summary>
+static bool OwnerSortKeyLess(const OwnerSortKey& a, const OwnerSortKey& b)
+{
+    if (a.nHandles != b.nHandles)
+        return a.nHandles > b.nHandles;
+    const int cmpResult = a.sFoldedExeName.compare(b.sFoldedExeName);
+    if (0 != cmpResult)
+        return cmpResult < 0;
+    return a.PID < b.PID;
+}
+
+/// <summary>
+/// Sorts owners as ZombieOwnerComparator does, keeping only the first nTop of them; 0 for all.
+/// </summary>
+void SortOwners(ZombieOwnersCollectionSorted_t& owners, size_t nTop)
+{
+    if (0 == nTop || nTop >= owners.size())
+    {
+        std::sort(owners.begin(), owners.end(), &ZombieOwnerComparator);
+        return;
+    }
+
+    // Owners with more handles than the nTop-th owner are all in the top nTop; owners with fewer aren't.
+    // Those with the same number are ranked by exe name and PID.
+    std::nth_element(owners.begin(), owners.begin() + (nTop - 1), owners.end(),
+        [](const ZombieOwner_t* pA, const ZombieOwner_t* pB) { return pA->zombieOwningInfo.size() > pB->zombieOwningInfo.size(); });
+    const size_t nThresholdHandles = owners[nTop - 1]->zombieOwningInfo.size();
+    const ZombieOwnersCollectionSorted_t::iterator iCandidatesEnd = std::partition(owners.begin(), owners.end(),
+        [nThresholdHandles](const ZombieOwner_t* pOwner) { return pOwner->zombieOwningInfo.size() >= nThresholdHandles; });
+
+    std::vector<OwnerSortKey> keys(iCandidatesEnd - owners.begin());
+    for (size_t ix = 0; ix < keys.size(); ++ix)
+    {
+        const ZombieOwner_t* pOwner = owners[ix];
+        OwnerSortKey& key = keys[ix];
+        key.nHandles = pOwner->zombieOwningInfo.size();
+        key.sFoldedExeName = pOwner->sExeName;
+        if (!key.sFoldedExeName.empty())
+            _wcslwr_s(&key.sFoldedExeName[0], key.sFoldedExeName.size() + 1);
+        key.PID = pOwner->PID;
+        key.pOwner = pOwner;
+    }
+    std::partial_sort(keys.begin(), keys.begin() + nTop, keys.end(), &OwnerSortKeyLess);
+
+    owners.resize(nTop);
+    for (size_t ix = 0; ix < nTop; ++ix)
+        owners[ix] = keys[ix].pOwner;
+}
+
+/// <summary>
+/// Selects the system that subsequent Update calls analyze, and makes it the source of the PID to services information.
+/// </summary>
+void ZombieOwners::SetPlatform(Platform& platform)
+{
+    m_pPlatform = &platform;
+    m_serviceIndex.SetProvider(platform.Services());
+}
+
 /// <summary>
 /// Update information about zombies and their owners, if any.
 /// </summary>
@@ -47,37 +184,27 @@ static bool ZombieOwnerComparator(const ZombieOwner_t* pA, const ZombieOwner_t*
 bool ZombieOwners::Update(ULONGLONG nAgeInSeconds, const std::wstring& sDiagDirectory, std::wstring& sErrorInfo)
 {
     // The work is done in Update_Impl.
-    // This function exists to enable the Debug Programs privilege for the current thread
-    // and to ensure that we properly revert to previous state before returning in all cases.
-    // (ImpersonateSelf, AdjustTokenPrivileges, RevertToSelf.)
-
-    // Essentially, ensure that this thread has its own token and not that of the process token.
-    if (!ImpersonateSelf(SecurityImpersonation))
+    // This function exists to acquire the platform's privileged access (on Windows, the Debug Programs privilege)
+    // for the current thread and to ensure that we properly revert to previous state before returning in all cases.
+    if (!m_pPlatform->BeginPrivilegedAccess(sErrorInfo))
     {
-        std::wstringstream strErrorInfo;
-        DWORD dwLastErr = GetLastError();
-        strErrorInfo << L"ImpersonateSelf failed: " << SysErrorMessageWithCode(dwLastErr);
-        sErrorInfo = strErrorInfo.str();
         return false;
     }
 
-    // Enable the Debug Programs privilege. Fail if it's not available to be enabled.
-    std::wstring sPrivError;
-    if (!EnablePrivilege(SE_DEBUG_NAME, sPrivError))
+    // Do the work. For -stats, the calls into the kernel are those the platform makes in the meantime.
+    const ULONGLONG nSystemCallsBefore = m_pPlatform->SystemCallCount();
+    bool retval = Update_Impl(nAgeInSeconds, sDiagDirectory, sErrorInfo);
+    if (!retval)
     {
-        std::wstringstream strErrorInfo;
-        strErrorInfo 
-            << L"Cannot enable Debug Programs privilege. This program must be executed with administrative privileges." << std::endl
-            << sPrivError;
-        sErrorInfo = strErrorInfo.str();
-        return false;
+        // Keep the image paths of the last successful call (e.g., the -watch sample that the next one is compared with).
+        // The zombie cache may hold paths from the discarded generation, so it starts over.
+        m_imagePaths.RevertGeneration();
+        m_zombieProcessCache.Clear();
     }
+    StatsAddCount(StatsCounter_t::SystemCalls, m_pPlatform->SystemCallCount() - nSystemCallsBefore);
 
-    // Do the work
-    bool retval = Update_Impl(nAgeInSeconds, sDiagDirectory, sErrorInfo);
-
-    // Revert to using process token.
-    RevertToSelf();
+    // Revert to previous state.
+    m_pPlatform->EndPrivilegedAccess();
 
     return retval;
 }
@@ -93,17 +220,32 @@ bool ZombieOwners::Update_Impl(ULONGLONG nAgeInSeconds, const std::wstring& sDia
     // Init output variable
     sErrorInfo.clear();
     // Init internal state
-    m_owners.clear();
-    m_unexplained.clear();
     m_nZombieProcessesAndThreads = m_nZombieProcesses = m_nTotalProcesses = 0;
+    // (The previous results refer to m_zombieRecords, which this call refills.)
+    ClearResults();
+    m_bReplay = false;
+    m_recordedOwnerImagePaths.clear();
+    m_ulCaptureTime = m_pPlatform->Clock().Now();
+    m_imagePaths.BeginGeneration();
 
     // Acquire new handles in this process to existing zombie processes and any threads they still have.
     // Also get a PID-based lookup so that we can identify zombie processes to which no process holds a handle.
     ZombieHandles zombieHandles;
     ZombiePidLookup_t zombiePidLookup;
-    if (!zombieHandles.AcquireNewHandlesToExistingZombies(nAgeInSeconds, zombiePidLookup, m_processEnumErrors, sErrorInfo))
+    m_processMetadataCache.BeginPass(m_pPlatform->Processes());
+    // Ends the pass over the processes, and reports the caches' use for -stats
+    auto endProcessPass = [this]()
+    {
+        m_processMetadataCache.EndPass();
+        StatsSetCount(StatsCounter_t::ZombieCacheHits, m_zombieProcessCache.Hits());
+        StatsSetCount(StatsCounter_t::ZombieCacheMisses, m_zombieProcessCache.Misses());
+        StatsSetCount(StatsCounter_t::ProcessCacheHits, m_processMetadataCache.Hits());
+        StatsSetCount(StatsCounter_t::ProcessCacheMisses, m_processMetadataCache.Misses());
+    };
+    if (!zombieHandles.AcquireNewHandlesToExistingZombies(*m_pPlatform, nAgeInSeconds, m_zombieRecords, m_imagePaths, zombiePidLookup, m_processEnumErrors, sErrorInfo, &m_zombieProcessCache, &m_processMetadataCache))
     {
         // On failure, sErrorInfo will already have been set.
+        endProcessPass();
         return false;
     }
 
@@ -112,112 +254,576 @@ bool ZombieOwners::Update_Impl(ULONGLONG nAgeInSeconds, const std::wstring& sDia
     m_nZombieProcesses = zombieHandles.ZombieProcessCount();
     m_nTotalProcesses = zombieHandles.TotalProcessCount();
 
+    // If the zombies alone settle the alert verdict, there's no need to examine the handle table.
+    if (m_alertThresholds.Any() && CheckZombieAlerts(zombiePidLookup))
+    {
+        endProcessPass();
+        return true;
+    }
+
     // Get information about all handles held by all processes.
-    AllHandlesSystemwide allHandlesSystemwide;
-    if (!allHandlesSystemwide.Update(sErrorInfo))
+    const AllHandlesQueryCounters prevQueryCounters = m_allHandlesSystemwide.QueryCounters();
+    const ULONGLONG ullQueryStart = StatsTimestamp();
+    const bool bQueried = m_allHandlesSystemwide.Update(*m_pPlatform, sErrorInfo);
+    StatsAddTime(StatsPhase_t::HandleTableQuery, ullQueryStart);
+    StatsAddCount(StatsCounter_t::HandleQueryCalls, m_allHandlesSystemwide.QueryCounters().nQueryCalls - prevQueryCounters.nQueryCalls);
+    StatsAddCount(StatsCounter_t::HandleQueryRetries, m_allHandlesSystemwide.QueryCounters().nRetries - prevQueryCounters.nRetries);
+    if (!bQueried)
     {
         // On failure, sErrorInfo will already have been set.
+        endProcessPass();
         return false;
     }
 
+    // The owners to report, if not all. (Resolved only once nothing else can fail, so that a refresh of the services
+    // happens only in an update that succeeds; see ServiceSet.)
+    if (m_ownerFilter.Any() && !ResolveOwnerFilter(sErrorInfo))
+    {
+        endProcessPass();
+        return false;
+    }
+
+    // Identify the owners of handles to the zombies
+    Correlate(zombieHandles, zombiePidLookup, m_allHandlesSystemwide);
+    if (m_alertThresholds.Any())
+        CheckOwnerAlerts();
+    endProcessPass();
+
+    // Diagnostic data-dump option
+    if (sDiagDirectory.size() > 0)
+    {
+        StatsPhaseTimer phaseTimer(StatsPhase_t::DiagnosticDump);
+
+        // Get timestamp as string
+        FILETIME ft;
+        SYSTEMTIME st;
+        GetSystemTimeAsFileTime(&ft);
+        FileTimeToSystemTime(&ft, &st);
+        wchar_t szTimestamp[32];
+        swprintf(szTimestamp, sizeof(szTimestamp) / sizeof(szTimestamp[0]), L"%04d%02d%02d_%02d%02d%02d", st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+        std::wstringstream strPrefix;
+#ifdef _WIN32
+        strPrefix << sDiagDirectory << L"\\ZombieFinder_" << szTimestamp;
+#else
+        strPrefix << sDiagDirectory << L"/ZombieFinder_" << szTimestamp;
+#endif
+        const std::wstring sPrefix = strPrefix.str();
+
+        zombieHandles.Dump((sPrefix + szDiagSuffix_ZombieHandles).c_str(), false, sErrorInfo);
+        // All handles go into a binary snapshot; text output for millions of handles takes far longer than the capture.
+        // (ZombieFinder -convert turns the snapshot into the tab-delimited text format.)
+        m_allHandlesSystemwide.SaveSnapshot((sPrefix + szDiagSuffix_AllHandlesSnapshot).c_str(), sErrorInfo);
+        m_serviceIndex.EnsureCurrent(m_ulCaptureTime);
+        m_serviceIndex.Dump((sPrefix + szDiagSuffix_Services).c_str(), false, sErrorInfo);
+        DumpContext((sPrefix + szDiagSuffix_Context).c_str(), sErrorInfo);
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Offline analysis: update information about zombies and their owners from the files written by a previous
+/// Update call's diagnostic dump, rather than from the live system. Runs the same correlation as Update.
+/// Does not require administrative rights.
+/// </summary>
+/// <param name="sDiagFilePrefix">Input: path and common file name prefix of the diagnostic files; e.g., "C:\Diag\ZombieFinder_20240101_120000"</param>
+/// <param name="sErrorInfo">Output: information about any failures</param>
+/// <returns>true if successful</returns>
+bool ZombieOwners::Replay(const std::wstring& sDiagFilePrefix, std::wstring& sErrorInfo)
+{
+    // Init output variable
+    sErrorInfo.clear();
+    // Init internal state
+    m_nZombieProcessesAndThreads = m_nZombieProcesses = m_nTotalProcesses = 0;
+    // (The previous results refer to m_zombieRecords, which this call refills.)
+    ClearResults();
+    m_processEnumErrors.clear();
+    m_bReplay = true;
+    m_imagePaths.BeginGeneration();
+
+    // Capture time, process count, enumeration errors, and owner image paths.
+    // Diagnostic files written before the context file was added have only the capture time, in their names;
+    // owners' image paths are left blank.
+    const std::wstring sContextFile = sDiagFilePrefix + szDiagSuffix_Context;
+    if (FileExists(sContextFile.c_str()))
+    {
+        if (!LoadContext(sContextFile.c_str(), sErrorInfo))
+            return false;
+    }
+    else
+    {
+        m_recordedOwnerImagePaths.clear();
+        m_ulCaptureTime = CaptureTimeFromDiagFilePrefix(sDiagFilePrefix);
+    }
+
+    // The zombies and the handles the capturing process held to them
+    ZombieHandles zombieHandles;
+    ZombiePidLookup_t zombiePidLookup;
+    if (!zombieHandles.LoadFromDump((sDiagFilePrefix + szDiagSuffix_ZombieHandles).c_str(), m_zombieRecords, m_imagePaths, zombiePidLookup, sErrorInfo))
+        return false;
+
+    // Failing any other record of the capture time, the last exit preceded it.
+    if (0 == m_ulCaptureTime)
+    {
+        for (ZombieRecordStore_t::const_iterator iter = m_zombieRecords.begin(); iter != m_zombieRecords.end(); ++iter)
+            m_ulCaptureTime = std::max<ULONGLONG>(m_ulCaptureTime, *(const ULONGLONG*)&iter->exitTime);
+    }
+
+    m_nZombieProcessesAndThreads = zombieHandles.ZombieHandleLookup().size();
+    m_nZombieProcesses = zombieHandles.ZombieProcessCount();
+
+    // If the zombies alone settle the alert verdict, there's no need to load the handles.
+    if (m_alertThresholds.Any() && CheckZombieAlerts(zombiePidLookup))
+        return true;
+
+    // All handles held by all processes at the time of the capture: binary snapshot if present, otherwise tab-delimited text.
+    // (Separate instance, so that the buffer m_allHandlesSystemwide keeps for live Update calls isn't released.)
+    AllHandlesSystemwide allHandlesSystemwide;
+    const std::wstring sSnapshotFile = sDiagFilePrefix + szDiagSuffix_AllHandlesSnapshot;
+    if (FileExists(sSnapshotFile.c_str()))
+    {
+        if (!allHandlesSystemwide.LoadSnapshot(sSnapshotFile.c_str(), sErrorInfo))
+            return false;
+    }
+    else
+    {
+        if (!allHandlesSystemwide.LoadFromDump((sDiagFilePrefix + szDiagSuffix_AllHandles).c_str(), sErrorInfo))
+            return false;
+    }
+
+    // Services hosted by each process at the time of the capture
+    if (!m_serviceIndex.Load((sDiagFilePrefix + szDiagSuffix_Services).c_str(), sErrorInfo))
+        return false;
+
+    // The owners to report, if not all
+    if (m_ownerFilter.Any() && !ResolveOwnerFilter(sErrorInfo))
+        return false;
+
+    // Identify the owners of handles to the zombies
+    Correlate(zombieHandles, zombiePidLookup, allHandlesSystemwide);
+    if (m_alertThresholds.Any())
+        CheckOwnerAlerts();
+
+    return true;
+}
+
+/// <summary>
+/// Offline analysis and benchmarking: update information about zombies and their owners from a caller-supplied
+/// data source (e.g., a synthetic workload) rather than from the live system. Runs the same correlation as Update.
+/// Does not require administrative rights. Replaces the PID to services information with the data source's.
+/// </summary>
+/// <param name="dataSource">Input: source of the zombie, handle, owner, and service information</param>
+/// <param name="sErrorInfo">Output: information about any failures</param>
+/// <returns>true if successful</returns>
+bool ZombieOwners::Analyze(ZombieDataSource& dataSource, std::wstring& sErrorInfo)
+{
+    // Init output variable
+    sErrorInfo.clear();
+    // Init internal state
+    m_nZombieProcessesAndThreads = m_nZombieProcesses = m_nTotalProcesses = 0;
+    // (The previous results refer to m_zombieRecords, which this call refills.)
+    ClearResults();
+    m_processEnumErrors.clear();
+    m_bReplay = true;
+    m_ulCaptureTime = dataSource.CaptureTime();
+    m_imagePaths.BeginGeneration();
+    dataSource.GetOwnerImagePaths(m_recordedOwnerImagePaths);
+
+    // The zombies and the handles the capturing process held to them
+    ZombieHandles zombieHandles;
+    ZombiePidLookup_t zombiePidLookup;
+    if (!dataSource.GetZombieHandles(zombieHandles, m_zombieRecords, m_imagePaths, zombiePidLookup, sErrorInfo))
+        return false;
+
+    m_nZombieProcessesAndThreads = zombieHandles.ZombieHandleLookup().size();
+    m_nZombieProcesses = zombieHandles.ZombieProcessCount();
+    m_nTotalProcesses = zombieHandles.TotalProcessCount();
+
+    // If the zombies alone settle the alert verdict, there's no need to get the handles.
+    if (m_alertThresholds.Any() && CheckZombieAlerts(zombiePidLookup))
+        return true;
+
+    // All handles held by all processes.
+    // (Separate instance, so that the buffer m_allHandlesSystemwide keeps for live Update calls isn't released.)
+    AllHandlesSystemwide allHandlesSystemwide;
+    if (!dataSource.GetAllHandles(allHandlesSystemwide, sErrorInfo))
+        return false;
+
+    // Services hosted by each process
+    ServiceLookupByPID_t serviceLookup;
+    dataSource.GetServices(serviceLookup);
+    m_serviceIndex.Set(serviceLookup);
+
+    // The owners to report, if not all
+    if (m_ownerFilter.Any() && !ResolveOwnerFilter(sErrorInfo))
+        return false;
+
+    // Identify the owners of handles to the zombies
+    Correlate(zombieHandles, zombiePidLookup, allHandlesSystemwide);
+    if (m_alertThresholds.Any())
+        CheckOwnerAlerts();
+
+    return true;
+}
+
+/// <summary>
+/// Clears m_owners, m_ownersSorted, and m_unexplained.
+/// </summary>
+void ZombieOwners::ClearResults()
+{
+    m_owners.clear();
+    m_ownersSorted.clear();
+    m_unexplained.clear();
+    m_alertVerdict = ZombieAlertVerdict();
+}
+
+/// <summary>
+/// Correlates all handles systemwide with the zombie processes/threads to which zombieHandles holds handles, 
+/// and populates m_owners, m_ownersSorted, and m_unexplained.
+/// Shared by Update_Impl, Replay, and Analyze.
+/// </summary>
+/// <param name="zombieHandles">Input: handles to the zombie processes/threads in m_zombieRecords</param>
+/// <param name="zombiePidLookup">Input: PID lookup of the zombie processes in m_zombieRecords</param>
+/// <param name="allHandlesSystemwide">Input: information about all handles held by all processes</param>
+void ZombieOwners::Correlate(const ZombieHandles& zombieHandles, const ZombiePidLookup_t& zombiePidLookup, const AllHandlesSystemwide& allHandlesSystemwide)
+{
+    ClearResults();
+    StatsAddCount(StatsCounter_t::Samples);
+
+    // The scans of the systemwide handle table below read only the handle table and the zombie lookups, so they can be
+    // split across workers. Each worker processes a contiguous range of handle table entries and keeps its results in its
+    // own fragment; the fragments are then combined in handle table order, so the results are identical to a serial scan.
+    // (Workers don't call into the OS, so it doesn't matter that they don't share this thread's impersonation token.)
+    const ULONG_PTR numHandles = allHandlesSystemwide.NumberOfHandles();
+    const size_t nPartitions = PartitionCount(numHandles, m_nWorkers, nMinHandlesPerPartition);
+
     // Create an object address lookup to map kernel object addresses of zombie process/thread objects to information about those processes/threads.
     ZombieObjectAddrLookup_t zombieObjectAddrLookup;
     const ZombieHandleLookup_t& zombieHandleLookup = zombieHandles.ZombieHandleLookup();
 
     // Identify the process/thread handles in the current process created by the ZombieHandles instance:
-    DWORD dwCurrPID = GetCurrentProcessId();
-    const ULONG_PTR numHandles = allHandlesSystemwide.NumberOfHandles();
-    // Iterate through all handles...
-    for (ULONG_PTR ix = 0; ix < numHandles; ++ix)
+    // (When replaying, the "current process" is the one that made the capture.)
+    const ULONG_PTR dwCurrPID = zombieHandles.HandleOwnerPID();
+    typedef std::vector<std::pair<PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX, ZombieRecordIndex_t>> OwnHandleObjects_t;
+    std::vector<OwnHandleObjects_t> ownHandleObjectFragments(nPartitions);
+
+    // If the platform reports the object types of our handles, a single pass over the handle table selects the process
+    // and thread handles, and finds our own among them; the second scan then examines only the selected handles.
+    // Otherwise, our own handles are found in a pass of their own, and their types then select the handles to examine.
+    std::vector<USHORT> knownObjectTypes;
+    bool bSinglePass =
+        m_bSinglePassScan &&
+        zombieHandles.GetObjectTypeIndexes(knownObjectTypes) &&
+        !knownObjectTypes.empty() &&
+        knownObjectTypes.size() <= MaxFilterObjectTypes;
+    // Process and thread handles of each range, when making a single pass
+    std::vector<HandleIndexList_t> candidateFragments;
+    ULONGLONG ullPhaseStart = StatsTimestamp();
+    if (bSinglePass)
     {
-        PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX pHandleInfo = allHandlesSystemwide.HandleInfo(ix);
-        // (Safety: but this check should never fail)
-        if (nullptr != pHandleInfo)
+        candidateFragments.resize(nPartitions);
+        RunPartitioned(numHandles, nPartitions,
+            [&](size_t ixPartition, size_t ixBegin, size_t ixEnd)
+            {
+                OwnHandleObjects_t& ownHandleObjects = ownHandleObjectFragments[ixPartition];
+                HandleIndexList_t& candidates = candidateFragments[ixPartition];
+                FilterHandlesByObjectType(allHandlesSystemwide.HandleInfo(ixBegin), ixEnd - ixBegin, knownObjectTypes.data(), knownObjectTypes.size(), candidates);
+                // Our own handles are among the process and thread handles.
+                for (
+                    HandleIndexList_t::const_iterator iCandidate = candidates.begin();
+                    iCandidate != candidates.end();
+                    ++iCandidate
+                    )
+                {
+                    PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX pHandleInfo = allHandlesSystemwide.HandleInfo(ixBegin + *iCandidate);
+                    if (pHandleInfo->UniqueProcessId == dwCurrPID)
+                    {
+                        ZombieHandleLookup_t::const_iterator iZombie = zombieHandleLookup.find(HANDLE(pHandleInfo->HandleValue));
+                        if (iZombie != zombieHandleLookup.end())
+                        {
+                            ownHandleObjects.push_back(std::make_pair(pHandleInfo, iZombie->second));
+                        }
+                    }
+                }
+            });
+
+        // If any of our handles wasn't selected, its type isn't one the platform reported, and the selection can't be
+        // relied on. (This shouldn't happen.) Start over with the separate pass.
+        size_t nOwnHandles = 0;
+        for (
+            std::vector<OwnHandleObjects_t>::const_iterator iFragment = ownHandleObjectFragments.begin();
+            iFragment != ownHandleObjectFragments.end();
+            ++iFragment
+            )
+        {
+            nOwnHandles += iFragment->size();
+        }
+        if (nOwnHandles < zombieHandleLookup.size())
+        {
+            bSinglePass = false;
+            candidateFragments.clear();
+            ownHandleObjectFragments.assign(nPartitions, OwnHandleObjects_t());
+            StatsAddCount(StatsCounter_t::SinglePassFallbacks);
+        }
+        else
         {
-            // ... and look at handles belonging to the current process...
-            if (pHandleInfo->UniqueProcessId == dwCurrPID)
+            StatsAddCount(StatsCounter_t::HandleTablePasses);
+        }
+    }
+    if (!bSinglePass)
+    {
+        RunPartitioned(numHandles, nPartitions,
+            [&](size_t ixPartition, size_t ixBegin, size_t ixEnd)
             {
-                // ... and specifically for the handles to the zombie processes/threads we acquired
-                ZombieHandleLookup_t::const_iterator iZombie = zombieHandleLookup.find(HANDLE(pHandleInfo->HandleValue));
-                if (iZombie != zombieHandleLookup.end())
+                OwnHandleObjects_t& ownHandleObjects = ownHandleObjectFragments[ixPartition];
+                // Iterate through all handles...
+                for (size_t ix = ixBegin; ix < ixEnd; ++ix)
                 {
-                    // If found, map the corresponding kernel object address to the information we collected about the process/thread.
-                    zombieObjectAddrLookup[pHandleInfo->Object] = iZombie->second;
+                    PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX pHandleInfo = allHandlesSystemwide.HandleInfo(ix);
+                    // (Safety: but this check should never fail)
+                    if (nullptr != pHandleInfo)
+                    {
+                        // ... and look at handles belonging to the current process...
+                        if (pHandleInfo->UniqueProcessId == dwCurrPID)
+                        {
+                            // ... and specifically for the handles to the zombie processes/threads we acquired
+                            ZombieHandleLookup_t::const_iterator iZombie = zombieHandleLookup.find(HANDLE(pHandleInfo->HandleValue));
+                            if (iZombie != zombieHandleLookup.end())
+                            {
+                                ownHandleObjects.push_back(std::make_pair(pHandleInfo, iZombie->second));
+                            }
+                        }
+                    }
                 }
-            }
+            });
+        StatsAddCount(StatsCounter_t::HandleTablePasses);
+    }
+    // Map the corresponding kernel object addresses to the information we collected about the processes/threads.
+    // Also note the object type indexes of those handles: the Process and Thread types. Handles of any other type
+    // (files, keys, events, ...) can't reference a zombie, so the second scan can skip them without a lookup.
+    std::vector<USHORT> zombieObjectTypes;
+    zombieObjectAddrLookup.reserve(zombieHandleLookup.size());
+    for (
+        std::vector<OwnHandleObjects_t>::const_iterator iFragment = ownHandleObjectFragments.begin();
+        iFragment != ownHandleObjectFragments.end();
+        ++iFragment
+        )
+    {
+        for (
+            OwnHandleObjects_t::const_iterator iter = iFragment->begin();
+            iter != iFragment->end();
+            ++iter
+            )
+        {
+            zombieObjectAddrLookup[iter->first->Object] = iter->second;
+            m_zombieRecords[iter->second].pObject = iter->first->Object;
+            if (zombieObjectTypes.end() == std::find(zombieObjectTypes.begin(), zombieObjectTypes.end(), iter->first->ObjectTypeIndex))
+                zombieObjectTypes.push_back(iter->first->ObjectTypeIndex);
         }
     }
 
-    // Now look for other processes' handles to those zombie objects.
-    // Iterate through all handles...
-    for (ULONG_PTR ix = 0; ix < numHandles; ++ix)
-    {
-        PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX pHandleInfo = allHandlesSystemwide.HandleInfo(ix);
-        // (Safety: but this check should never fail)
-        if (nullptr != pHandleInfo)
+    StatsAddTime(StatsPhase_t::CorrelateOwnHandles, ullPhaseStart);
+    StatsAddCount(StatsCounter_t::HandlesScanned, numHandles);
+
+    // (There's nothing to prefilter on if there are no zombies, and if there were somehow more types than the filter
+    // supports, examine every handle. A single pass has already selected the handles to examine.)
+    const bool bPrefilter = !bSinglePass && !zombieObjectTypes.empty() && zombieObjectTypes.size() <= MaxFilterObjectTypes;
+    if (!bSinglePass)
+        StatsAddCount(StatsCounter_t::HandleTablePasses);
+
+    // Now look for other processes' handles to those zombie objects; only the selected owners', if not all.
+    const bool bOwnerFilter = m_ownerFilter.Any();
+    // Each worker identifies the handles in its range that point to one of the zombie objects, and groups them by owning PID.
+    std::vector<OwnerFragment> ownerFragments(nPartitions);
+    ullPhaseStart = StatsTimestamp();
+    RunPartitioned(numHandles, nPartitions,
+        [&](size_t ixPartition, size_t ixBegin, size_t ixEnd)
         {
-            // ... and identify whether the handle points to one of the zombie objects ...
-            ZombieObjectAddrLookup_t::const_iterator iZombie = zombieObjectAddrLookup.find(pHandleInfo->Object);
-            if (iZombie != zombieObjectAddrLookup.end())
+            OwnerFragment& ownerFragment = ownerFragments[ixPartition];
+            const PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX pRangeBegin = allHandlesSystemwide.HandleInfo(ixBegin);
+            // Process and thread handles in this range
+            HandleIndexList_t candidates;
+            if (bPrefilter)
+                FilterHandlesByObjectType(pRangeBegin, ixEnd - ixBegin, zombieObjectTypes.data(), zombieObjectTypes.size(), candidates);
+            const HandleIndexList_t* pCandidates = bSinglePass ? &candidateFragments[ixPartition] : (bPrefilter ? &candidates : nullptr);
+            // Of those, the handles held by the selected owners, if not all
+            HandleIndexList_t ownerCandidates;
+            if (bOwnerFilter)
             {
-                // Get information about the handle owner unless it's one that was created by the ZombieHandles instance in this process...
+                const size_t nExamine = (nullptr != pCandidates) ? pCandidates->size() : ixEnd - ixBegin;
+                for (size_t ixExamine = 0; ixExamine < nExamine; ++ixExamine)
+                {
+                    const ULONG_PTR ixHandle = (nullptr != pCandidates) ? (*pCandidates)[ixExamine] : ixExamine;
+                    if (std::binary_search(m_ownerFilterPids.begin(), m_ownerFilterPids.end(), pRangeBegin[ixHandle].UniqueProcessId))
+                        ownerCandidates.push_back(ixHandle);
+                }
+                pCandidates = &ownerCandidates;
+            }
+            ZombieHandleMatchList_t matches;
+            FindZombieHandleMatches(pRangeBegin, ixEnd - ixBegin, zombieObjectAddrLookup, matches, pCandidates);
+            ownerFragment.nCandidates = (nullptr != pCandidates) ? pCandidates->size() : ixEnd - ixBegin;
+            ownerFragment.nMatches = matches.size();
+            for (
+                ZombieHandleMatchList_t::iterator iMatch = matches.begin();
+                iMatch != matches.end();
+                ++iMatch
+                )
+            {
+                // Match indexes are relative to the start of the range.
+                iMatch->ixHandle += ixBegin;
+                const PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX pHandleInfo = allHandlesSystemwide.HandleInfo(iMatch->ixHandle);
+
+                // Keep the handle unless it's one that was created by the ZombieHandles instance in this process...
                 // Not just ignoring ALL handles in this process - want to know if something else in this process is responsible for zombies.
                 if (
                     // If the handle doesn't belong to the current process, or
-                    pHandleInfo->UniqueProcessId != dwCurrPID || 
+                    pHandleInfo->UniqueProcessId != dwCurrPID ||
                     // It belongs to the current process but isn't one of the ones we created in the ZombieHandles instance,
                     // then keep it.
                     zombieHandleLookup.find(HANDLE(pHandleInfo->HandleValue)) == zombieHandleLookup.end())
                 {
-                    // The owning process' PID
-                    ULONG_PTR pid = pHandleInfo->UniqueProcessId;
-                    // Have we added this PID to the set yet?
-                    ZombieOwnersCollection_t::iterator iterOwners = m_owners.find(pid);
-                    // If not, create a new entry in the m_owners collection.
-                    if (m_owners.end() == iterOwners)
-                    {
-                        ZombieOwner_t owner = { 0 };
-                        owner.PID = pid;
-                        // Get the full executable image path and exe name of the owning process
-                        GetImagePathFromPID(pid, owner.sProcessImagePath);
-                        owner.sExeName = GetFileNameFromFilePath(owner.sProcessImagePath);
-                        // If it's a service process, get info about the hosted service(s)
-                        LookupServicesByPID(pid, &owner.pServiceList);
-                        // Add it to the collection
-                        m_owners[pid] = owner;
-                    }
+                    ownerFragment.matches.push_back(*iMatch);
+                }
+            }
+        });
+
+    // Identify the owning processes. Each worker adds the PIDs of its matches to the shared owner table, and tags each
+    // match with its owner's slot. There are no more owners than matches, nor (ordinarily) than the table has room for;
+    // matches of owners that don't fit are tagged with no slot, and looked up by PID when merged.
+    size_t nOwnedMatches = 0;
+    for (
+        std::vector<OwnerFragment>::const_iterator iFragment = ownerFragments.begin();
+        iFragment != ownerFragments.end();
+        ++iFragment
+        )
+    {
+        nOwnedMatches += iFragment->matches.size();
+    }
+    m_ownerTable.Reset((std::min)(nOwnedMatches, nMaxOwnerTablePids));
+    RunPartitioned(ownerFragments.size(), ownerFragments.size(),
+        [&](size_t ixPartition, size_t, size_t)
+        {
+            OwnerFragment& ownerFragment = ownerFragments[ixPartition];
+            ownerFragment.ownerSlots.resize(ownerFragment.matches.size());
+            for (size_t ixMatch = 0; ixMatch < ownerFragment.matches.size(); ++ixMatch)
+            {
+                const ULONG_PTR pid = allHandlesSystemwide.HandleInfo(ownerFragment.matches[ixMatch].ixHandle)->UniqueProcessId;
+                if (!m_ownerTable.Insert(pid, ownerFragment.ownerSlots[ixMatch]))
+                    ownerFragment.ownerSlots[ixMatch] = NoOwnerSlot;
+            }
+        });
+
+    StatsAddTime(StatsPhase_t::CorrelateOtherHandles, ullPhaseStart);
+
+    // When checking alert thresholds, owners are only counted; only the one that raises an alert, if any, is named.
+    const bool bAlerting = m_alertThresholds.Any();
 
-                    // Add information about this handle and the corresponding zombie process/thread to the owning process' entry in m_owners.
-                    ZombieOwningInfo owningInfo = { 0 };
-                    owningInfo.handleValue = pHandleInfo->HandleValue;
-                    owningInfo.zombieInfo = iZombie->second;
-                    m_owners[pid].zombieOwningInfo.push_back(owningInfo);
+    // Services are looked up for each owner. Acquire them only if there are owners, and again only once they've expired.
+    for (
+        std::vector<OwnerFragment>::const_iterator iFragment = ownerFragments.begin();
+        iFragment != ownerFragments.end();
+        ++iFragment
+        )
+    {
+        if (!bAlerting && !iFragment->matches.empty())
+        {
+            m_serviceIndex.EnsureCurrent(m_ulCaptureTime);
+            break;
+        }
+    }
 
-                    // Remove this PID from the collection of zombies we don't have handles for.
-                    ZombiePidLookup_t::iterator iPID = zombiePidLookup.find(iZombie->second.PID);
-                    if (zombiePidLookup.end() != iPID)
+    // Merge the fragments in handle table order, creating each owner when its first handle is reached.
+    // Owners by slot in the owner table; nullptr until created
+    std::vector<ZombieOwner_t*> ownersBySlot(m_ownerTable.Capacity(), nullptr);
+    // Zombie processes that a handle references, directly or through one of their threads, by index in m_zombieRecords
+    std::vector<bool> referencedZombies(m_zombieRecords.size());
+    ullPhaseStart = StatsTimestamp();
+    for (
+        std::vector<OwnerFragment>::const_iterator iFragment = ownerFragments.begin();
+        iFragment != ownerFragments.end();
+        ++iFragment
+        )
+    {
+        StatsAddCount(StatsCounter_t::CandidateHandles, iFragment->nCandidates);
+        StatsAddCount(StatsCounter_t::ZombieHandleMatches, iFragment->nMatches);
+        for (size_t ixMatch = 0; ixMatch < iFragment->matches.size(); ++ixMatch)
+        {
+            const ZombieHandleMatch& match = iFragment->matches[ixMatch];
+            const PSYSTEM_HANDLE_TABLE_ENTRY_INFO_EX pHandleInfo = allHandlesSystemwide.HandleInfo(match.ixHandle);
+            // The owning process' PID
+            const ULONG_PTR pid = pHandleInfo->UniqueProcessId;
+            // Have we added the owning process to the set yet?
+            const size_t ixSlot = iFragment->ownerSlots[ixMatch];
+            ZombieOwner_t* pUntabledOwner = nullptr;
+            if (NoOwnerSlot == ixSlot)
+            {
+                ZombieOwnersCollection_t::iterator iterOwners = m_owners.find(pid);
+                if (m_owners.end() != iterOwners)
+                    pUntabledOwner = &iterOwners->second;
+            }
+            ZombieOwner_t*& pOwner = (NoOwnerSlot == ixSlot) ? pUntabledOwner : ownersBySlot[ixSlot];
+            // If not, create a new entry in the m_owners collection.
+            if (nullptr == pOwner)
+            {
+                ZombieOwner_t owner = { 0 };
+                owner.PID = pid;
+                if (!bAlerting)
+                {
+                    // Get the full executable image path and exe name of the owning process
+                    if (m_bReplay)
                     {
-                        zombiePidLookup.erase(iZombie->second.PID);
+                        owner.sProcessImagePath = m_recordedOwnerImagePaths[pid];
                     }
+                    else
+                    {
+                        StatsPhaseTimer phaseTimer(StatsPhase_t::OwnerImagePathLookups);
+                        m_processMetadataCache.GetImagePathFromPID(pid, owner.sProcessImagePath);
+                    }
+                    owner.sExeName = GetFileNameFromFilePath(owner.sProcessImagePath);
+                    // If it's a service process, get info about the hosted service(s)
+                    owner.services = m_serviceIndex.Lookup(pid);
                 }
+                // Add it to the collection
+                pOwner = &m_owners.insert(std::make_pair(pid, owner)).first->second;
+            }
+
+            // Add this handle and the index of the corresponding zombie process/thread to the owning process' entry in m_owners.
+            ZombieOwningInfo owningInfo;
+            owningInfo.handleValue = pHandleInfo->HandleValue;
+            owningInfo.ixZombie = match.ixZombie;
+            pOwner->zombieOwningInfo.push_back(owningInfo);
+
+            // Note that the zombie process isn't one of those we don't have handles for.
+            ZombiePidLookup_t::const_iterator iZombiePID = zombiePidLookup.find(m_zombieRecords[match.ixZombie].PID);
+            if (zombiePidLookup.end() != iZombiePID)
+            {
+                referencedZombies[iZombiePID->second] = true;
             }
         }
     }
 
-    // Populate the sorted collection
-    for (
-        ZombieOwnersCollection_t::const_iterator iter = m_owners.begin();
-        iter != m_owners.end();
-        iter++
-        )
+    StatsAddTime(StatsPhase_t::OwnerAttribution, ullPhaseStart);
+    StatsAddCount(StatsCounter_t::Owners, m_owners.size());
+
+    // Populate the sorted collection (not needed for checking alert thresholds)
+    ullPhaseStart = StatsTimestamp();
+    if (!bAlerting)
     {
-        const ZombieOwner_t* pOwner = &(iter->second);
-        m_ownersSorted.push_back(pOwner);
+        for (
+            ZombieOwnersCollection_t::const_iterator iter = m_owners.begin();
+            iter != m_owners.end();
+            iter++
+            )
+        {
+            const ZombieOwner_t* pOwner = &(iter->second);
+            m_ownersSorted.push_back(pOwner);
+        }
+        SortOwners(m_ownersSorted, m_nTopOwners);
     }
-    std::sort(m_ownersSorted.begin(), m_ownersSorted.end(), &ZombieOwnerComparator);
 
     // Populate the m_unexplained collection with information about zombie processes we found no handles for.
-    if (zombiePidLookup.size() > 0)
+    // (Not when only some owners' handles were examined: other owners might hold handles to them.)
+    if (zombiePidLookup.size() > 0 && !bOwnerFilter)
     {
         for (
             ZombiePidLookup_t::const_iterator iter = zombiePidLookup.begin();
@@ -225,29 +831,278 @@ bool ZombieOwners::Update_Impl(ULONGLONG nAgeInSeconds, const std::wstring& sDia
             ++iter
             )
         {
-            m_unexplained.push_back(iter->second);
+            if (!referencedZombies[iter->second])
+                m_unexplained.push_back(iter->second);
+        }
+        // Order by PID so that the output doesn't depend on hash table iteration order; a replay must match the live run.
+        if (!bAlerting)
+        {
+            std::sort(m_unexplained.begin(), m_unexplained.end(),
+                [this](ZombieRecordIndex_t a, ZombieRecordIndex_t b) { return m_zombieRecords[a].PID < m_zombieRecords[b].PID; }
+            );
         }
     }
+    StatsAddTime(StatsPhase_t::Sort, ullPhaseStart);
+}
 
-    // Diagnostic data-dump option
-    if (sDiagDirectory.size() > 0)
+/// <summary>
+/// Determines the PIDs of the owners that m_ownerFilter selects, into m_ownerFilterPids.
+/// Shared by Update_Impl, Replay, and Analyze.
+/// </summary>
+/// <param name="sErrorInfo">Output: information about the failure, on failure</param>
+/// <returns>true if successful</returns>
+bool ZombieOwners::ResolveOwnerFilter(std::wstring& sErrorInfo)
+{
+    // PIDs that meet every criterion so far, sorted; each criterion narrows them
+    std::vector<ULONG_PTR> selected;
+    bool bSelected = false;
+    auto narrow = [&selected, &bSelected](std::vector<ULONG_PTR>& pids)
     {
-        // Get timestamp as string
-        FILETIME ft;
-        SYSTEMTIME st;
-        GetSystemTimeAsFileTime(&ft);
-        FileTimeToSystemTime(&ft, &st);
-        wchar_t szTimestamp[32];
-        swprintf(szTimestamp, sizeof(szTimestamp) / sizeof(szTimestamp[0]), L"%04d%02d%02d_%02d%02d%02d", st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
-        std::wstringstream strZH, strAH, strSV;
-        strZH << sDiagDirectory << L"\\ZombieFinder_" << szTimestamp << L"_ZombieHandles.txt";
-        strAH << sDiagDirectory << L"\\ZombieFinder_" << szTimestamp << L"_AllHandles.txt";
-        strSV << sDiagDirectory << L"\\ZombieFinder_" << szTimestamp << L"_Services.txt";
+        std::sort(pids.begin(), pids.end());
+        if (bSelected)
+        {
+            std::vector<ULONG_PTR> both;
+            std::set_intersection(selected.begin(), selected.end(), pids.begin(), pids.end(), std::back_inserter(both));
+            pids.swap(both);
+        }
+        selected.swap(pids);
+        bSelected = true;
+    };
+
+    std::vector<ULONG_PTR> pids;
+    if (!m_ownerFilter.pids.empty())
+    {
+        pids = m_ownerFilter.pids;
+        narrow(pids);
+    }
+
+    if (!m_ownerFilter.sExeName.empty())
+    {
+        pids.clear();
+        if (m_bReplay)
+        {
+            // Every owner's image path was recorded; other processes can't be owners.
+            for (
+                OwnerImagePathLookup_t::const_iterator iter = m_recordedOwnerImagePaths.begin();
+                iter != m_recordedOwnerImagePaths.end();
+                ++iter
+                )
+            {
+                if (0 == _wcsicmp(m_ownerFilter.sExeName.c_str(), GetFileNameFromFilePath(iter->second).c_str()))
+                    pids.push_back(iter->first);
+            }
+        }
+        else if (!m_pPlatform->Processes().FindRunningProcessesByExeName(m_ownerFilter.sExeName, pids))
+        {
+            sErrorInfo = L"Cannot get the names of the running processes";
+            return false;
+        }
+        narrow(pids);
+    }
+
+    if (!m_ownerFilter.sServiceName.empty())
+    {
+        // (Replayed and analyzed services were loaded; they're never reacquired.)
+        m_serviceIndex.EnsureCurrent(m_ulCaptureTime);
+        m_serviceIndex.FindProcessesHostingService(m_ownerFilter.sServiceName, pids);
+        narrow(pids);
+    }
 
-        zombieHandles.Dump(strZH.str().c_str(), false, sErrorInfo);
-        allHandlesSystemwide.Dump(strAH.str().c_str(), false, sErrorInfo);
-        DumpPIDtoServiceLookupInfo(strSV.str().c_str(), false, sErrorInfo);
+    selected.erase(std::unique(selected.begin(), selected.end()), selected.end());
+    m_ownerFilterPids.swap(selected);
+    return true;
+}
+
+/// <summary>
+/// Checks the alert thresholds that need only the zombies (count and age), setting m_alertVerdict.
+/// Shared by Update_Impl, Replay, and Analyze.
+/// </summary>
+/// <param name="zombiePidLookup">Input: PID lookup of the zombie processes in m_zombieRecords</param>
+/// <returns>true if the verdict is known without examining the owners</returns>
+bool ZombieOwners::CheckZombieAlerts(const ZombiePidLookup_t& zombiePidLookup)
+{
+    if (m_alertThresholds.nZombies != ZombieAlertThresholds::NotChecked && m_nZombieProcesses > m_alertThresholds.nZombies)
+    {
+        std::wstringstream strInfo;
+        strInfo << m_nZombieProcesses << L" zombie processes (threshold " << m_alertThresholds.nZombies << L")";
+        m_alertVerdict.alert = ZombieAlert_t::Zombies;
+        m_alertVerdict.sInfo = strInfo.str();
+        return true;
+    }
+
+    if (m_alertThresholds.nOldestAgeSecs != ZombieAlertThresholds::NotChecked && zombiePidLookup.size() > 0)
+    {
+        // The zombie process that exited first
+        const ZombieProcessThreadInfo* pOldest = nullptr;
+        ULONGLONG ulOldestExitTime = 0;
+        for (
+            ZombiePidLookup_t::const_iterator iter = zombiePidLookup.begin();
+            zombiePidLookup.end() != iter;
+            ++iter
+            )
+        {
+            const ZombieProcessThreadInfo& z = m_zombieRecords[iter->second];
+            const ULONGLONG& ulExitTime = (*(const ULONGLONG*)&z.exitTime);
+            if (nullptr == pOldest || ulExitTime < ulOldestExitTime || (ulExitTime == ulOldestExitTime && z.PID < pOldest->PID))
+            {
+                pOldest = &z;
+                ulOldestExitTime = ulExitTime;
+            }
+        }
+        const ULONGLONG nSecondsAgo = (m_ulCaptureTime > ulOldestExitTime) ? (m_ulCaptureTime - ulOldestExitTime) / 10000000 : 0;
+        if (nSecondsAgo > m_alertThresholds.nOldestAgeSecs)
+        {
+            std::wstringstream strInfo;
+            strInfo << m_imagePaths.Path(pOldest->imagePathId) << L" (PID " << pOldest->PID << L") exited " << nSecondsAgo
+                << L" seconds ago (threshold " << m_alertThresholds.nOldestAgeSecs << L")";
+            m_alertVerdict.alert = ZombieAlert_t::OldestAge;
+            m_alertVerdict.sInfo = strInfo.str();
+            return true;
+        }
+    }
+
+    return !m_alertThresholds.NeedOwners();
+}
+
+/// <summary>
+/// Checks the alert thresholds that need the owners (per-owner handle count and unexplained zombies), after Correlate,
+/// setting m_alertVerdict. Looks up the image path of the owner that exceeds the threshold, if any.
+/// </summary>
+void ZombieOwners::CheckOwnerAlerts()
+{
+    if (m_alertThresholds.nOwnerHandles != ZombieAlertThresholds::NotChecked)
+    {
+        // The owner holding the most handles; the lowest PID among those tied, so that a replay matches the live run
+        ZombieOwner_t* pTop = nullptr;
+        for (
+            ZombieOwnersCollection_t::iterator iter = m_owners.begin();
+            iter != m_owners.end();
+            ++iter
+            )
+        {
+            ZombieOwner_t& owner = iter->second;
+            if (nullptr == pTop ||
+                owner.zombieOwningInfo.size() > pTop->zombieOwningInfo.size() ||
+                (owner.zombieOwningInfo.size() == pTop->zombieOwningInfo.size() && owner.PID < pTop->PID))
+            {
+                pTop = &owner;
+            }
+        }
+        if (nullptr != pTop && pTop->zombieOwningInfo.size() > m_alertThresholds.nOwnerHandles)
+        {
+            // Correlate didn't name the owners; name this one.
+            if (m_bReplay)
+            {
+                OwnerImagePathLookup_t::const_iterator iPath = m_recordedOwnerImagePaths.find(pTop->PID);
+                if (m_recordedOwnerImagePaths.end() != iPath)
+                    pTop->sProcessImagePath = iPath->second;
+            }
+            else
+            {
+                m_processMetadataCache.GetImagePathFromPID(pTop->PID, pTop->sProcessImagePath);
+            }
+            pTop->sExeName = GetFileNameFromFilePath(pTop->sProcessImagePath);
+
+            std::wstringstream strInfo;
+            strInfo << (pTop->sExeName.empty() ? std::wstring(L"Process") : pTop->sExeName) << L" (PID " << pTop->PID << L") holds "
+                << pTop->zombieOwningInfo.size() << L" zombie handles (threshold " << m_alertThresholds.nOwnerHandles << L")";
+            m_alertVerdict.alert = ZombieAlert_t::OwnerHandles;
+            m_alertVerdict.sInfo = strInfo.str();
+            return;
+        }
+    }
+
+    if (m_alertThresholds.nUnexplained != ZombieAlertThresholds::NotChecked && m_unexplained.size() > m_alertThresholds.nUnexplained)
+    {
+        std::wstringstream strInfo;
+        strInfo << m_unexplained.size() << L" zombie processes with no handles held to them (threshold " << m_alertThresholds.nUnexplained << L")";
+        m_alertVerdict.alert = ZombieAlert_t::Unexplained;
+        m_alertVerdict.sInfo = strInfo.str();
+    }
+}
+
+/// <summary>
+/// Diagnostic dump of the information that Replay needs beyond what the ZombieHandles, AllHandlesSystemwide, 
+/// and service lookup dumps contain: capture time, process count, process enumeration errors, and owner image paths.
+/// </summary>
+bool ZombieOwners::DumpContext(const wchar_t* szOutFile, std::wstring& sErrorInfo) const
+{
+    Utf8Writer writer;
+    if (!writer.OpenFile(szOutFile, false, sErrorInfo))
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"ZombieOwners::DumpContext to " << szOutFile << L" fails: " << sErrorInfo;
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    // Tab-delimited name/value lines. (Neither image paths nor the enumeration error messages contain tabs or line breaks.)
+    (writer << szContext_CaptureTime << L'\t' << m_ulCaptureTime).EndLine();
+    (writer << szContext_TotalProcesses << L'\t' << m_nTotalProcesses).EndLine();
+    for (
+        ProcessEnumErrorInfoList_t::const_iterator iter = m_processEnumErrors.begin();
+        iter != m_processEnumErrors.end();
+        iter++
+        )
+    {
+        (writer << szContext_Error << L'\t' << *iter).EndLine();
+    }
+    for (
+        ZombieOwnersCollection_t::const_iterator iter = m_owners.begin();
+        iter != m_owners.end();
+        iter++
+        )
+    {
+        (writer << szContext_Owner << L'\t' << iter->first << L'\t' << iter->second.sProcessImagePath).EndLine();
+    }
+
+    if (!writer.Close())
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"ZombieOwners::DumpContext to " << szOutFile << L" fails: write error";
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Loads information written by DumpContext.
+/// </summary>
+bool ZombieOwners::LoadContext(const wchar_t* szInFile, std::wstring& sErrorInfo)
+{
+    m_recordedOwnerImagePaths.clear();
+    m_ulCaptureTime = 0;
+
+    std::wifstream fs;
+    if (!OpenFileInput(szInFile, fs))
+    {
+        std::wstringstream strErrorInfo;
+        strErrorInfo << L"ZombieOwners::LoadContext from " << szInFile << L" fails";
+        sErrorInfo = strErrorInfo.str();
+        return false;
+    }
+
+    std::wstring sLine;
+    std::vector<std::wstring> fields;
+    while (std::getline(fs, sLine))
+    {
+        if (EndsWith(sLine, L'\r'))
+            sLine.pop_back();
+        SplitStringToVector(sLine, L'\t', fields);
+        if (fields.size() < 2)
+            continue;
+        if (fields[0] == szContext_CaptureTime)
+            m_ulCaptureTime = wcstoull(fields[1].c_str(), nullptr, 10);
+        else if (fields[0] == szContext_TotalProcesses)
+            m_nTotalProcesses = size_t(wcstoull(fields[1].c_str(), nullptr, 10));
+        else if (fields[0] == szContext_Error)
+            m_processEnumErrors.push_back(fields[1]);
+        else if (fields[0] == szContext_Owner && fields.size() >= 3)
+            m_recordedOwnerImagePaths[ULONG_PTR(wcstoull(fields[1].c_str(), nullptr, 10))] = fields[2];
     }
+    fs.close();
 
     return true;
 }
@@ -6,6 +6,16 @@
 
 #include "ZombieProcessThreadInfo.h"
 #include "ServiceLookupByPID.h"
+#include "ZombieHandleMatch.h"
+#include "AllHandlesSystemwide.h"
+#include "ZombieProcessCache.h"
+#include "ProcessMetadataCache.h"
+#include "ConcurrentPidTable.h"
+#include "ZombieDataSource.h"
+#include "ZombieAlerts.h"
+#include "Platform.h"
+
+class ZombieHandles;
 
 /// <summary>
 /// Structure combining a handle value and its corresponding process or thread.
@@ -13,12 +23,15 @@
 struct ZombieOwningInfo
 {
     ULONG_PTR handleValue = 0;
-    ZombieProcessThreadInfo zombieInfo;
+    /// <summary>
+    /// Index of the process/thread in the ZombieOwners instance's record store (see ZombieOwners::Zombie)
+    /// </summary>
+    ZombieRecordIndex_t ixZombie = 0;
 };
 /// <summary>
 /// List of handle values and corresponding processes/threads
 /// </summary>
-typedef std::list<ZombieOwningInfo> ZombieOwningInfoList_t;
+typedef std::vector<ZombieOwningInfo> ZombieOwningInfoList_t;
 
 /// <summary>
 /// Structure identifying an existing process (PID and path) that retains handles to processes that have exited
@@ -29,7 +42,7 @@ struct ZombieOwner_t
     ULONG_PTR PID = 0;
     std::wstring sProcessImagePath;
     std::wstring sExeName;
-    const ServiceList_t* pServiceList = nullptr;
+    ServiceSet services;
     ZombieOwningInfoList_t zombieOwningInfo;
 };
 /// <summary>
@@ -42,6 +55,44 @@ typedef std::unordered_map<ULONG_PTR, ZombieOwner_t> ZombieOwnersCollection_t;
 /// </summary>
 typedef std::vector<const ZombieOwner_t*> ZombieOwnersCollectionSorted_t;
 
+/// <summary>
+/// Comparator that sorts descending by handle count, then ascending by exe name and PID.
+/// </summary>
+bool ZombieOwnerComparator(const ZombieOwner_t* pA, const ZombieOwner_t* pB);
+
+/// <summary>
+/// Sorts owners as ZombieOwnerComparator does, keeping only the first nTop of them.
+/// With fewer owners than nTop, or nTop 0, sorts them all. Otherwise, selects the candidates by handle count alone,
+/// and sorts only those, on precomputed keys with case-folded exe names: O(n + m log nTop) for m candidates.
+/// </summary>
+/// <param name="owners">Input/output: owners to sort; on return, the first nTop of them in sorted order</param>
+/// <param name="nTop">Input: number of owners to keep; 0 for all</param>
+void SortOwners(ZombieOwnersCollectionSorted_t& owners, size_t nTop);
+
+/// <summary>
+/// Selects the owners to report: those that meet every criterion given. An empty criterion isn't applied.
+/// </summary>
+struct ZombieOwnerFilter
+{
+    /// <summary>
+    /// The owner's PID is one of these
+    /// </summary>
+    std::vector<ULONG_PTR> pids;
+    /// <summary>
+    /// The owner's executable file name (not the full path) is this, compared case-insensitively
+    /// </summary>
+    std::wstring sExeName;
+    /// <summary>
+    /// The owner hosts the service with this key name, compared case-insensitively
+    /// </summary>
+    std::wstring sServiceName;
+
+    /// <summary>
+    /// true if any criterion is given
+    /// </summary>
+    bool Any() const { return !pids.empty() || !sExeName.empty() || !sServiceName.empty(); }
+};
+
 /// <summary>
 /// Class to identify zombie processes and the processes holding handles to those processes and/or their threads,
 /// and zombie processes for which no process has an open handle. Typically: HandleCount = 0, PointerCount > 0.
@@ -62,6 +113,85 @@ public:
     /// <returns>true if successful</returns>
     bool Update(ULONGLONG nAgeInSeconds, const std::wstring& sDiagDirectory, std::wstring& sErrorInfo);
 
+    /// <summary>
+    /// Offline analysis: update information about zombies and their owners from the files written by a previous
+    /// Update call's diagnostic dump, rather than from the live system. Runs the same correlation as Update.
+    /// Does not require administrative rights.
+    /// Diagnostic files written before the context file was added can be replayed: the capture time is then taken from
+    /// the timestamp in the file names, and the owners' image paths and the total process count are not known.
+    /// </summary>
+    /// <param name="sDiagFilePrefix">Input: path and common file name prefix of the diagnostic files; e.g., "C:\Diag\ZombieFinder_20240101_120000"</param>
+    /// <param name="sErrorInfo">Output: information about any failures</param>
+    /// <returns>true if successful</returns>
+    bool Replay(const std::wstring& sDiagFilePrefix, std::wstring& sErrorInfo);
+
+    /// <summary>
+    /// Offline analysis and benchmarking: update information about zombies and their owners from a caller-supplied
+    /// data source (e.g., a synthetic workload) rather than from the live system. Runs the same correlation as Update.
+    /// Does not require administrative rights. Replaces the PID to services information with the data source's.
+    /// </summary>
+    /// <param name="dataSource">Input: source of the zombie, handle, owner, and service information</param>
+    /// <param name="sErrorInfo">Output: information about any failures</param>
+    /// <returns>true if successful</returns>
+    bool Analyze(ZombieDataSource& dataSource, std::wstring& sErrorInfo);
+
+    /// <summary>
+    /// Selects the system that subsequent Update calls analyze (by default, the one the program is running on),
+    /// and makes it the source of the PID to services information. The platform must outlive this instance.
+    /// </summary>
+    void SetPlatform(Platform& platform);
+
+    /// <summary>
+    /// Sets the number of worker threads that subsequent Update and Replay calls use to scan the systemwide handle table.
+    /// 0 (default) uses one per logical processor; 1 scans serially. Results are the same regardless of the number of workers.
+    /// </summary>
+    void SetWorkerCount(size_t nWorkers) { m_nWorkers = nWorkers; }
+
+    /// <summary>
+    /// Selects whether subsequent Update calls find this process' own zombie handles in the same pass over the systemwide
+    /// handle table as the process/thread handles to examine (default), rather than in a separate first pass.
+    /// The single pass requires the platform to report the handles' object type indexes; otherwise, and for Replay and
+    /// Analyze, the separate pass is made regardless. Results are the same either way.
+    /// </summary>
+    void SetSinglePassScan(bool bSinglePass) { m_bSinglePassScan = bSinglePass; }
+
+    /// <summary>
+    /// Sets how long subsequent Update calls use the PID to services information before reacquiring it. Default 60 seconds.
+    /// </summary>
+    void SetServiceTimeToLive(ULONGLONG nSeconds) { m_serviceIndex.SetTimeToLive(nSeconds); }
+
+    /// <summary>
+    /// Limits OwnersCollectionSorted after subsequent Update, Replay, and Analyze calls to the nTop owners that sort first,
+    /// which are selected without sorting the rest. 0 (default) for all. OwnersCollection still has all of the owners.
+    /// </summary>
+    void SetTopOwners(size_t nTop) { m_nTopOwners = nTop; }
+
+    /// <summary>
+    /// Limits subsequent Update, Replay, and Analyze calls to the owners that the filter selects. The selected PIDs are
+    /// determined before the systemwide handle table is scanned, from the running processes' names and the services, and
+    /// the scan skips other processes' handles, so that other owners' image paths and services are never looked up.
+    /// With a filter, UnexplainedZombies is empty: zombies that only unselected owners hold handles to would be in it.
+    /// </summary>
+    void SetOwnerFilter(const ZombieOwnerFilter& filter) { m_ownerFilter = filter; }
+
+    /// <summary>
+    /// Sets thresholds that subsequent Update, Replay, and Analyze calls check, for AlertVerdict. With any set, those calls
+    /// stop collecting information once the verdict is known: if the zombie count or age thresholds are exceeded (or are
+    /// the only ones set), the systemwide handle table isn't examined at all; otherwise owners aren't named or sorted,
+    /// other than the one that exceeds the threshold. OwnersCollectionSorted is then empty and the owners have no image paths.
+    /// </summary>
+    void SetAlertThresholds(const ZombieAlertThresholds& thresholds) { m_alertThresholds = thresholds; }
+
+    /// <summary>
+    /// Returns the result of checking the alert thresholds in the most recent Update, Replay, or Analyze call.
+    /// </summary>
+    const ZombieAlertVerdict& AlertVerdict() const { return m_alertVerdict; }
+
+    /// <summary>
+    /// Time at which the information was collected (as a FILETIME value), for computing how long ago zombies exited.
+    /// </summary>
+    ULONGLONG CaptureTime() const { return m_ulCaptureTime; }
+
     /// <summary>
     /// Returns information from most recent Update call about processes holding handles to exited processes and/or their threads.
     /// </summary>
@@ -74,9 +204,22 @@ public:
     const ZombieOwnersCollectionSorted_t& OwnersCollectionSorted() const { return m_ownersSorted; }
 
     /// <summary>
-    /// Returns information from most recent Update call about zombie processes to which no process holds an open handle.
+    /// Returns information from most recent Update call about the zombie process/thread that an owner's handle references,
+    /// or that UnexplainedZombies lists.
+    /// </summary>
+    const ZombieProcessThreadInfo& Zombie(ZombieRecordIndex_t ixZombie) const { return m_zombieRecords[ixZombie]; }
+
+    /// <summary>
+    /// Table of the image paths in the zombie records. The identifiers from the most recent successful Update, Replay, or
+    /// Analyze call remain valid through the next call (so that a -watch sample can be compared with the next one).
     /// </summary>
-    const ZombieProcessThreadInfoList_t& UnexplainedZombies() const { return m_unexplained; }
+    const ImagePathTable& ImagePaths() const { return m_imagePaths; }
+
+    /// <summary>
+    /// Returns the indexes (see Zombie) of the zombie processes from most recent Update call to which no process holds
+    /// an open handle.
+    /// </summary>
+    const ZombieRecordIndexList_t& UnexplainedZombies() const { return m_unexplained; }
 
     /// <summary>
     /// Returns information about any errors that occurred during process enumeration.
@@ -98,12 +241,76 @@ public:
     /// </summary>
     size_t TotalProcessCount() const { return m_nTotalProcesses; }
 
+    /// <summary>
+    /// Cumulative counters of the work done acquiring the systemwide handle information across all Update calls.
+    /// </summary>
+    const AllHandlesQueryCounters& AllHandlesCounters() const { return m_allHandlesSystemwide.QueryCounters(); }
+
+    /// <summary>
+    /// Cache of zombie process information kept across Update calls (for its counters).
+    /// </summary>
+    const ZombieProcessCache& ZombieCache() const { return m_zombieProcessCache; }
+
+    /// <summary>
+    /// Cache of owner and parent process information kept across Update calls (for its counters).
+    /// </summary>
+    const ProcessMetadataCache& ProcessMetadata() const { return m_processMetadataCache; }
+
 private:
     /// <summary>
     /// Internal implementation for ZombieOwners::Update
     /// </summary>
     bool Update_Impl(ULONGLONG nAgeInSeconds, const std::wstring& sDiagDirectory, std::wstring& sErrorInfo);
 
+    /// <summary>
+    /// Clears m_owners, m_ownersSorted, and m_unexplained.
+    /// </summary>
+    void ClearResults();
+
+    /// <summary>
+    /// Correlates all handles systemwide with the zombie processes/threads to which zombieHandles holds handles, 
+    /// and populates m_owners, m_ownersSorted, and m_unexplained.
+    /// Shared by Update_Impl, Replay, and Analyze.
+    /// </summary>
+    /// <param name="zombieHandles">Input: handles to the zombie processes/threads in m_zombieRecords</param>
+    /// <param name="zombiePidLookup">Input: PID lookup of the zombie processes in m_zombieRecords</param>
+    /// <param name="allHandlesSystemwide">Input: information about all handles held by all processes</param>
+    void Correlate(const ZombieHandles& zombieHandles, const ZombiePidLookup_t& zombiePidLookup, const AllHandlesSystemwide& allHandlesSystemwide);
+
+    /// <summary>
+    /// Determines the PIDs of the owners that m_ownerFilter selects, into m_ownerFilterPids: from the running processes
+    /// and the services, or during Replay and Analyze, from the recorded owner image paths and services.
+    /// Shared by Update_Impl, Replay, and Analyze.
+    /// </summary>
+    /// <param name="sErrorInfo">Output: information about the failure, on failure</param>
+    /// <returns>true if successful</returns>
+    bool ResolveOwnerFilter(std::wstring& sErrorInfo);
+
+    /// <summary>
+    /// Checks the alert thresholds that need only the zombies (count and age), setting m_alertVerdict.
+    /// Shared by Update_Impl, Replay, and Analyze.
+    /// </summary>
+    /// <param name="zombiePidLookup">Input: PID lookup of the zombie processes in m_zombieRecords</param>
+    /// <returns>true if the verdict is known without examining the owners</returns>
+    bool CheckZombieAlerts(const ZombiePidLookup_t& zombiePidLookup);
+
+    /// <summary>
+    /// Checks the alert thresholds that need the owners (per-owner handle count and unexplained zombies), after Correlate,
+    /// setting m_alertVerdict. Looks up the image path of the owner that exceeds the threshold, if any.
+    /// </summary>
+    void CheckOwnerAlerts();
+
+    /// <summary>
+    /// Diagnostic dump of the information that Replay needs beyond what the ZombieHandles, AllHandlesSystemwide, 
+    /// and service lookup dumps contain: capture time, process count, process enumeration errors, and owner image paths.
+    /// </summary>
+    bool DumpContext(const wchar_t* szOutFile, std::wstring& sErrorInfo) const;
+
+    /// <summary>
+    /// Loads information written by DumpContext.
+    /// </summary>
+    bool LoadContext(const wchar_t* szInFile, std::wstring& sErrorInfo);
+
 private:
     /// <summary>
     /// Collection of information about existing processes and the handles they're holding to processes/threads that have exited.
@@ -112,15 +319,40 @@ private:
 
     /// <summary>
     /// Collection of information about existing processes and the handles they're holding, sorted in descending order by handle count, then ascending by exe name.
+    /// Only the first m_nTopOwners of them, if set.
     /// </summary>
     ZombieOwnersCollectionSorted_t m_ownersSorted;
 
+    // Number of owners to keep in m_ownersSorted; 0 for all
+    size_t m_nTopOwners = 0;
+
+    // Owners to report, if not all, and the PIDs it selects in the current call, sorted
+    ZombieOwnerFilter m_ownerFilter;
+    std::vector<ULONG_PTR> m_ownerFilterPids;
+
+    // Alert thresholds to check, if any, and the result of checking them
+    ZombieAlertThresholds m_alertThresholds;
+    ZombieAlertVerdict m_alertVerdict;
+
+    /// <summary>
+    /// Information about the zombie processes/threads found by the most recent Update call, referenced by index from
+    /// m_owners. Kept between Update calls so that its memory is reused.
+    /// </summary>
+    ZombieRecordStore_t m_zombieRecords;
+
     /// <summary>
-    /// List of zombie processes for which no process holds a process or thread handle.
+    /// Image paths of the zombies and their parents, which m_zombieRecords and m_zombieProcessCache refer to. Each call
+    /// begins a new generation, and a failed Update reverts it, so it holds no more than two calls' paths.
+    /// Only the thread that calls Update, Replay, and Analyze touches it; the scan's workers don't.
+    /// </summary>
+    ImagePathTable m_imagePaths;
+
+    /// <summary>
+    /// Indexes in m_zombieRecords of zombie processes for which no process holds a process or thread handle.
     /// These appear to have HandleCount = 0 and PointerCount > 0.
     /// Not yet worked out how to identify what holds those pointers.
     /// </summary>
-    ZombieProcessThreadInfoList_t m_unexplained;
+    ZombieRecordIndexList_t m_unexplained;
 
     /// <summary>
     /// Errors that occur during process enumeration
@@ -132,6 +364,51 @@ private:
     size_t m_nZombieProcesses = 0;
     size_t m_nTotalProcesses = 0;
 
+    // Time of the most recent Update, or the recorded time of the replayed capture
+    ULONGLONG m_ulCaptureTime = 0;
+
+    /// <summary>
+    /// During Replay and Analyze, recorded owner image paths, used in place of querying the live system.
+    /// </summary>
+    OwnerImagePathLookup_t m_recordedOwnerImagePaths;
+    bool m_bReplay = false;
+
+    /// <summary>
+    /// Information about all handles held by all processes. Kept between Update calls so that its memory buffer
+    /// (which can be hundreds of MB) is reused rather than reallocated every time.
+    /// </summary>
+    AllHandlesSystemwide m_allHandlesSystemwide;
+
+    /// <summary>
+    /// Information about zombie processes from previous Update calls, so that zombies that persist between calls
+    /// aren't re-queried.
+    /// </summary>
+    ZombieProcessCache m_zombieProcessCache;
+
+    /// <summary>
+    /// Image paths of owners and of zombies' parents from previous Update calls, so that each running process is
+    /// queried once rather than once per zombie and per call.
+    /// </summary>
+    ProcessMetadataCache m_processMetadataCache;
+
+    // Number of workers for scanning the systemwide handle table; 0 for one per logical processor
+    size_t m_nWorkers = 0;
+
+    // Owning PIDs of the handles to zombies, which the workers that find the handles add concurrently; kept for reuse
+    ConcurrentPidTable m_ownerTable;
+
+    // Find own zombie handles and candidate handles in one pass over the handle table, if the platform supports it
+    bool m_bSinglePassScan = true;
+
+    // The system that Update analyzes
+    Platform* m_pPlatform = &SystemPlatform();
+
+    /// <summary>
+    /// Services hosted by each process, by PID; owners' ServiceSets refer to it. Kept between Update calls and
+    /// refreshed when it expires.
+    /// </summary>
+    ServiceIndex m_serviceIndex;
+
 private:
     // Not implemented
     ZombieOwners(const ZombieOwners&) = delete;
@@ -0,0 +1,61 @@
+// Cache of information about zombie processes, kept across process enumeration passes.
+
+#include "ZombieProcessCache.h"
+
+/// <summary>
+/// Call at the start of each enumeration pass.
+/// </summary>
+void ZombieProcessCache::BeginPass()
+{
+    ++m_nPass;
+}
+
+/// <summary>
+/// Call at the end of each enumeration pass: evicts entries for zombies not seen during the pass.
+/// </summary>
+void ZombieProcessCache::EndPass()
+{
+    std::unordered_map<ULONG_PTR, ZombieProcessCacheEntry>::iterator iter = m_entries.begin();
+    while (iter != m_entries.end())
+    {
+        if (iter->second.nLastPass != m_nPass)
+        {
+            iter = m_entries.erase(iter);
+            ++m_nEvictions;
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+/// <summary>
+/// Looks up a zombie process and marks it as seen in this pass.
+/// </summary>
+/// <param name="pid">Input: process ID</param>
+/// <param name="createTime">Input: process creation time (FILETIME value)</param>
+/// <returns>Pointer to the cached information if found; nullptr otherwise</returns>
+ZombieProcessCacheEntry* ZombieProcessCache::Find(ULONG_PTR pid, ULONGLONG createTime)
+{
+    std::unordered_map<ULONG_PTR, ZombieProcessCacheEntry>::iterator iter = m_entries.find(pid);
+    // Same PID but different creation time: the PID was reused, and the cached information is for a different process.
+    if (iter == m_entries.end() || iter->second.createTime != createTime)
+    {
+        ++m_nMisses;
+        return nullptr;
+    }
+    ++m_nHits;
+    iter->second.nLastPass = m_nPass;
+    return &iter->second;
+}
+
+/// <summary>
+/// Adds or replaces the information about a zombie process, and marks it as seen in this pass.
+/// </summary>
+void ZombieProcessCache::Store(ULONG_PTR pid, const ZombieProcessCacheEntry& entry)
+{
+    ZombieProcessCacheEntry& cached = m_entries[pid];
+    cached = entry;
+    cached.nLastPass = m_nPass;
+}
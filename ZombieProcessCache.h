@@ -0,0 +1,99 @@
+// Cache of information about zombie processes, kept across process enumeration passes.
+
+#pragma once
+
+#include "PlatformTypes.h"
+#include <string>
+#include <unordered_map>
+#include "ImagePathTable.h"
+
+/// <summary>
+/// Information about a zombie process that doesn't change once the process has exited, or that is expensive to re-acquire.
+/// </summary>
+struct ZombieProcessCacheEntry
+{
+    /// <summary>
+    /// Process creation time; together with the PID, identifies the process. (PIDs are reused.)
+    /// </summary>
+    ULONGLONG createTime = 0;
+    /// <summary>
+    /// Executable image path, in Object Manager namespace
+    /// </summary>
+    ImagePathId_t imagePathId = 0;
+    /// <summary>
+    /// The parent's image path if it was still running when the zombie was first seen
+    /// </summary>
+    ImagePathId_t parentImagePathId = 0;
+    /// <summary>
+    /// Number of still-existing threads found in the last pass. An exited process can't create threads,
+    /// so once this is 0 there's no need to enumerate threads again.
+    /// </summary>
+    ULONG nThreads = 0;
+    /// <summary>
+    /// Pass in which the zombie was last seen
+    /// </summary>
+    ULONGLONG nLastPass = 0;
+};
+
+/// <summary>
+/// Cache of information about zombie processes, keyed by PID and validated by process creation time, so that repeated
+/// process enumeration passes pay the full query cost only for processes that have exited since the previous pass.
+/// Entries for zombies that weren't seen in a pass (i.e., that have been released) are evicted at the end of the pass.
+/// </summary>
+class ZombieProcessCache
+{
+public:
+    // Default ctor and dtor
+    ZombieProcessCache() = default;
+    virtual ~ZombieProcessCache() = default;
+
+    /// <summary>
+    /// Call at the start of each enumeration pass.
+    /// </summary>
+    void BeginPass();
+
+    /// <summary>
+    /// Call at the end of each enumeration pass: evicts entries for zombies not seen during the pass.
+    /// </summary>
+    void EndPass();
+
+    /// <summary>
+    /// Looks up a zombie process and marks it as seen in this pass.
+    /// </summary>
+    /// <param name="pid">Input: process ID</param>
+    /// <param name="createTime">Input: process creation time (FILETIME value)</param>
+    /// <returns>Pointer to the cached information if found; nullptr otherwise</returns>
+    ZombieProcessCacheEntry* Find(ULONG_PTR pid, ULONGLONG createTime);
+
+    /// <summary>
+    /// Adds or replaces the information about a zombie process, and marks it as seen in this pass.
+    /// </summary>
+    void Store(ULONG_PTR pid, const ZombieProcessCacheEntry& entry);
+
+    /// <summary>
+    /// Removes all entries. Counters are not reset.
+    /// </summary>
+    void Clear() { m_entries.clear(); }
+
+    /// <summary>
+    /// Number of cached zombie processes
+    /// </summary>
+    size_t Size() const { return m_entries.size(); }
+
+    /// <summary>
+    /// Cumulative numbers of lookups that found and didn't find cached information, and of evicted entries
+    /// </summary>
+    ULONGLONG Hits() const { return m_nHits; }
+    ULONGLONG Misses() const { return m_nMisses; }
+    ULONGLONG Evictions() const { return m_nEvictions; }
+
+private:
+    std::unordered_map<ULONG_PTR, ZombieProcessCacheEntry> m_entries;
+    ULONGLONG m_nPass = 0;
+    ULONGLONG m_nHits = 0, m_nMisses = 0, m_nEvictions = 0;
+
+private:
+    // Not implemented
+    ZombieProcessCache(const ZombieProcessCache&) = delete;
+    ZombieProcessCache& operator = (const ZombieProcessCache&) = delete;
+};
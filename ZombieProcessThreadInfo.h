@@ -2,8 +2,13 @@
 
 #pragma once
 
+#include "PlatformTypes.h"
+#include <string>
 #include <unordered_map>
 #include <list>
+#include <vector>
+#include "ImagePathTable.h"
+#include "FlatIndexLookup.h"
 
 /// <summary>
 /// Information collected about zombie processes and threads
@@ -22,10 +27,11 @@ struct ZombieProcessThreadInfo
     DWORD TID = 0;
 
     /// <summary>
-    /// Executable image path of zombie process, in Object Manager namespace
+    /// Executable image path of zombie process, in Object Manager namespace (identifier in the ImagePathTable that
+    /// the record's store goes with; e.g., ZombieOwners::ImagePaths)
     /// E.g., "\Device\HarddiskVolume3\Windows\System32\SearchProtocolHost.exe"
     /// </summary>
-    std::wstring sImagePath;
+    ImagePathId_t imagePathId = 0;
     
     /// <summary>
     /// The start and exit times of the zombie process
@@ -44,19 +50,31 @@ struct ZombieProcessThreadInfo
     
     /// <summary>
     /// The executable image path of the zombie's parent process, if it is still running. Empty string if it has since exited.
-    /// In Win32 notation; e.g., "C:\Windows\System32\winlogon.exe"
+    /// In Win32 notation; e.g., "C:\Windows\System32\winlogon.exe" (identifier in the same ImagePathTable)
     /// </summary>
-    std::wstring sParentImagePath;
+    ImagePathId_t parentImagePathId = 0;
+
+    /// <summary>
+    /// Kernel object address of the zombie process/thread object, as the handle table reports it; null until correlated.
+    /// Identifies the zombie where PID, TID, and start time don't (e.g., Linux processes that have already been reaped).
+    /// </summary>
+    PVOID pObject = nullptr;
 };
 
 // Typedefs for collections and lookups
 // 
+// Contiguous store of the zombie processes and threads found in a pass; the lookups and the owners' handle lists refer
+// to its records by 32-bit index rather than holding copies of them.
+typedef ULONG ZombieRecordIndex_t;
+typedef std::vector<ZombieProcessThreadInfo> ZombieRecordStore_t;
+// Indexes of records in a ZombieRecordStore_t
+typedef std::vector<ZombieRecordIndex_t> ZombieRecordIndexList_t;
 // Handle-based lookup
-typedef std::unordered_map<HANDLE, ZombieProcessThreadInfo> ZombieHandleLookup_t;
+typedef FlatIndexLookup<HANDLE> ZombieHandleLookup_t;
 // Object address-based lookup
-typedef std::unordered_map<PVOID, ZombieProcessThreadInfo> ZombieObjectAddrLookup_t;
+typedef FlatIndexLookup<PVOID> ZombieObjectAddrLookup_t;
 // PID-based lookup
-typedef std::unordered_map<ULONG_PTR, ZombieProcessThreadInfo> ZombiePidLookup_t;
+typedef FlatIndexLookup<ULONG_PTR> ZombiePidLookup_t;
 // List of ZombieProcessThreadInfo objects
 typedef std::list<ZombieProcessThreadInfo> ZombieProcessThreadInfoList_t;
 
@@ -0,0 +1,136 @@
+// Support for continuous monitoring: samples of zombie/owner information and the differences between successive samples.
+
+#include "PlatformTypes.h"
+#include "ZombieWatch.h"
+
+/// <summary>
+/// Key for a zombie process/thread
+/// </summary>
+static ZombieKey MakeZombieKey(const ZombieProcessThreadInfo& zombieInfo)
+{
+    ZombieKey key;
+    key.PID = zombieInfo.PID;
+    key.TID = zombieInfo.TID;
+    key.createTime = *(const ULONGLONG*)&zombieInfo.createTime;
+    key.pObject = zombieInfo.pObject;
+    return key;
+}
+
+/// <summary>
+/// Replaces the sample with the information from the most recent ZombieOwners::Update call.
+/// </summary>
+void ZombieSample::Capture(const ZombieOwners& zombieOwners)
+{
+    m_zombies.clear();
+    m_owners.clear();
+    m_ulCaptureTime = zombieOwners.CaptureTime();
+    m_pImagePaths = &zombieOwners.ImagePaths();
+
+    const ZombieOwnersCollection_t& owners = zombieOwners.OwnersCollection();
+    for (
+        ZombieOwnersCollection_t::const_iterator iterOwners = owners.begin();
+        iterOwners != owners.end();
+        ++iterOwners
+        )
+    {
+        const ZombieOwner_t& owner = iterOwners->second;
+        OwnerSample_t& ownerSample = m_owners[OwnerKey_t(owner.PID, owner.sProcessImagePath)];
+        ownerSample.sExeName = owner.sExeName;
+        ownerSample.services = owner.services;
+        ownerSample.nHandles = owner.zombieOwningInfo.size();
+
+        // (Several owners, or several handles of one owner, can reference the same zombie.)
+        for (
+            ZombieOwningInfoList_t::const_iterator iterOwningInfo = owner.zombieOwningInfo.begin();
+            iterOwningInfo != owner.zombieOwningInfo.end();
+            ++iterOwningInfo
+            )
+        {
+            const ZombieProcessThreadInfo& zombieInfo = zombieOwners.Zombie(iterOwningInfo->ixZombie);
+            m_zombies[MakeZombieKey(zombieInfo)] = zombieInfo;
+        }
+    }
+
+    const ZombieRecordIndexList_t& unexplained = zombieOwners.UnexplainedZombies();
+    for (
+        ZombieRecordIndexList_t::const_iterator iter = unexplained.begin();
+        iter != unexplained.end();
+        ++iter
+        )
+    {
+        const ZombieProcessThreadInfo& zombieInfo = zombieOwners.Zombie(*iter);
+        m_zombies[MakeZombieKey(zombieInfo)] = zombieInfo;
+    }
+}
+
+/// <summary>
+/// Compares this sample with an earlier one.
+/// </summary>
+/// <param name="previous">Input: the earlier sample</param>
+/// <param name="delta">Output: the differences</param>
+void ZombieSample::CompareWith(const ZombieSample& previous, ZombieSampleDelta& delta) const
+{
+    delta.newZombies.clear();
+    delta.releasedZombies.clear();
+    delta.ownerDeltas.clear();
+    delta.pImagePaths = m_pImagePaths;
+
+    // Both collections are ordered maps, so a single merge pass over each pair finds the additions and removals.
+    std::map<ZombieKey, ZombieProcessThreadInfo>::const_iterator iPrev = previous.m_zombies.begin(), iCurr = m_zombies.begin();
+    while (iPrev != previous.m_zombies.end() || iCurr != m_zombies.end())
+    {
+        if (iCurr == m_zombies.end() || (iPrev != previous.m_zombies.end() && iPrev->first < iCurr->first))
+        {
+            delta.releasedZombies.push_back(iPrev->second);
+            ++iPrev;
+        }
+        else if (iPrev == previous.m_zombies.end() || iCurr->first < iPrev->first)
+        {
+            delta.newZombies.push_back(iCurr->second);
+            ++iCurr;
+        }
+        else
+        {
+            ++iPrev;
+            ++iCurr;
+        }
+    }
+
+    std::map<OwnerKey_t, OwnerSample_t>::const_iterator iPrevOwner = previous.m_owners.begin(), iCurrOwner = m_owners.begin();
+    while (iPrevOwner != previous.m_owners.end() || iCurrOwner != m_owners.end())
+    {
+        OwnerCountDelta_t ownerDelta;
+        if (iCurrOwner == m_owners.end() || (iPrevOwner != previous.m_owners.end() && iPrevOwner->first < iCurrOwner->first))
+        {
+            // Owner no longer holds any zombie handles (or has exited)
+            ownerDelta.PID = iPrevOwner->first.first;
+            ownerDelta.sExeName = iPrevOwner->second.sExeName;
+            ownerDelta.services = iPrevOwner->second.services;
+            ownerDelta.nPrevHandles = iPrevOwner->second.nHandles;
+            ++iPrevOwner;
+        }
+        else if (iPrevOwner == previous.m_owners.end() || iCurrOwner->first < iPrevOwner->first)
+        {
+            // New owner
+            ownerDelta.PID = iCurrOwner->first.first;
+            ownerDelta.sExeName = iCurrOwner->second.sExeName;
+            ownerDelta.services = iCurrOwner->second.services;
+            ownerDelta.nHandles = iCurrOwner->second.nHandles;
+            ++iCurrOwner;
+        }
+        else
+        {
+            ownerDelta.PID = iCurrOwner->first.first;
+            ownerDelta.sExeName = iCurrOwner->second.sExeName;
+            ownerDelta.services = iCurrOwner->second.services;
+            ownerDelta.nPrevHandles = iPrevOwner->second.nHandles;
+            ownerDelta.nHandles = iCurrOwner->second.nHandles;
+            ++iPrevOwner;
+            ++iCurrOwner;
+        }
+        if (ownerDelta.nPrevHandles != ownerDelta.nHandles)
+        {
+            delta.ownerDeltas.push_back(ownerDelta);
+        }
+    }
+}
@@ -0,0 +1,126 @@
+// Support for continuous monitoring: samples of zombie/owner information and the differences between successive samples.
+
+#pragma once
+
+#include <map>
+#include <list>
+#include "ZombieOwners.h"
+
+/// <summary>
+/// Identifies a zombie process or thread across samples. (PIDs and TIDs can be reused; the creation time distinguishes reuse.
+/// The object address tells apart zombies that have neither, such as Linux processes that have already been reaped.)
+/// </summary>
+struct ZombieKey
+{
+    ULONG_PTR PID = 0;
+    DWORD TID = 0;
+    ULONGLONG createTime = 0;
+    PVOID pObject = nullptr;
+
+    bool operator < (const ZombieKey& other) const
+    {
+        if (PID != other.PID)
+            return PID < other.PID;
+        if (TID != other.TID)
+            return TID < other.TID;
+        if (createTime != other.createTime)
+            return createTime < other.createTime;
+        return std::less<PVOID>()(pObject, other.pObject);
+    }
+};
+
+/// <summary>
+/// Identifies a zombie owner across samples: PID and image path (in case the PID is reused).
+/// </summary>
+typedef std::pair<ULONG_PTR, std::wstring> OwnerKey_t;
+
+/// <summary>
+/// Information about a zombie owner in a sample.
+/// </summary>
+struct OwnerSample_t
+{
+    std::wstring sExeName;
+    ServiceSet services;
+    size_t nHandles = 0;
+};
+
+/// <summary>
+/// Change in the number of zombie handles held by one owner between two samples.
+/// </summary>
+struct OwnerCountDelta_t
+{
+    ULONG_PTR PID = 0;
+    std::wstring sExeName;
+    ServiceSet services;
+    size_t nPrevHandles = 0;
+    size_t nHandles = 0;
+};
+typedef std::list<OwnerCountDelta_t> OwnerCountDeltaList_t;
+
+/// <summary>
+/// Differences between two samples.
+/// </summary>
+struct ZombieSampleDelta
+{
+    /// <summary>
+    /// Zombie processes/threads in the current sample that weren't in the previous one, ordered by PID and TID
+    /// </summary>
+    ZombieProcessThreadInfoList_t newZombies;
+    /// <summary>
+    /// Zombie processes/threads in the previous sample that are no longer in the current one, ordered by PID and TID
+    /// </summary>
+    ZombieProcessThreadInfoList_t releasedZombies;
+    /// <summary>
+    /// Owners whose zombie handle counts changed, including owners that appeared (previous count 0) 
+    /// or disappeared (current count 0), ordered by PID
+    /// </summary>
+    OwnerCountDeltaList_t ownerDeltas;
+    /// <summary>
+    /// Table of the zombies' image paths: the sampled ZombieOwners instance's, in which both samples' paths are valid
+    /// until its next call
+    /// </summary>
+    const ImagePathTable* pImagePaths = nullptr;
+
+    /// <summary>
+    /// True if nothing changed
+    /// </summary>
+    bool Empty() const { return newZombies.empty() && releasedZombies.empty() && ownerDeltas.empty(); }
+};
+
+/// <summary>
+/// Class that captures from a ZombieOwners instance the information needed to compare it with a later sample:
+/// the set of zombie processes and threads, and the zombie handle counts of their owners.
+/// </summary>
+class ZombieSample
+{
+public:
+    // Default ctor and dtor
+    ZombieSample() = default;
+    virtual ~ZombieSample() = default;
+
+    /// <summary>
+    /// Replaces the sample with the information from the most recent ZombieOwners::Update call.
+    /// </summary>
+    void Capture(const ZombieOwners& zombieOwners);
+
+    /// <summary>
+    /// Compares this sample with an earlier one, captured from the same ZombieOwners instance before its previous call.
+    /// </summary>
+    /// <param name="previous">Input: the earlier sample</param>
+    /// <param name="delta">Output: the differences</param>
+    void CompareWith(const ZombieSample& previous, ZombieSampleDelta& delta) const;
+
+    /// <summary>
+    /// Time at which the sampled information was collected (FILETIME value)
+    /// </summary>
+    ULONGLONG CaptureTime() const { return m_ulCaptureTime; }
+
+private:
+    // All zombie processes and threads: those with owners, and those without
+    std::map<ZombieKey, ZombieProcessThreadInfo> m_zombies;
+    // Zombie owners
+    std::map<OwnerKey_t, OwnerSample_t> m_owners;
+    ULONGLONG m_ulCaptureTime = 0;
+    // Table of the zombies' image paths
+    const ImagePathTable* m_pImagePaths = nullptr;
+};